@@ -38,6 +38,7 @@ struct x86_arch_proc_members {
 
 struct x86_arch_task_members {
    u16 fpu_regs_size;
+   u16 tls_gdt_entry; /* Index in gdt of thread's TLS entry, valid if > 0 */
    void *fpu_regs;
 };
 
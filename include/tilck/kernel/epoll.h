@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+
+/*
+ * Called by vfs_close() for handles having VFS_SPFL_EPOLL_WATCHED set: removes
+ * the handle from the interest list of all the epoll instances watching it.
+ */
+void epoll_on_handle_close(fs_handle h);
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_userlim.h>
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/fs/vfs_base.h>
+
+/*
+ * Per-process table of file descriptors.
+ *
+ * The table starts with FD_TABLE_INLINE_FDS slots stored inline in the struct
+ * process and doubles its size on demand, up to MAX_HANDLES slots. Next to the
+ * array of handles, there are two bitmaps: `open_fds` marks the used slots and
+ * `cloexec_fds` the ones having FD_CLOEXEC set. In addition to that, each bit
+ * of `full_words` tells whether the corresponding word of `open_fds` is full:
+ * that allows finding the lowest free fd by looking at a couple of words,
+ * instead of scanning the whole table.
+ *
+ * All the functions here below require the process' `fslock` to be held,
+ * with the exception of the ones called when the process cannot be accessed
+ * by anyone else (creation and destruction).
+ */
+
+#define FD_TABLE_INLINE_FDS                     NBITS
+
+struct fd_table {
+
+   u32 size;                     /* count of slots, a multiple of NBITS */
+   u32 open_count;               /* count of used slots */
+
+   fs_handle *handles;
+   ulong *open_fds;
+   ulong *cloexec_fds;
+   ulong *full_words;
+
+   fs_handle inline_handles[FD_TABLE_INLINE_FDS];
+   ulong inline_open_fds;
+   ulong inline_cloexec_fds;
+   ulong inline_full_words;
+};
+
+void fd_table_init(struct fd_table *t);
+int fd_table_copy(struct fd_table *dst, struct fd_table *src);
+void fd_table_destroy(struct fd_table *t);
+
+/*
+ * Returns the lowest free fd >= `ge`, growing the table if necessary. Fails
+ * with -EMFILE when there are no free fds below MAX_HANDLES and with -ENOMEM
+ * when the table cannot grow. The fd is not reserved: it's up to the caller
+ * to install a handle there, while still holding the `fslock`.
+ */
+int fd_table_get_free_fd(struct fd_table *t, int ge);
+
+/* Makes sure that `fd` is a slot in the table, growing it if necessary */
+int fd_table_reserve(struct fd_table *t, int fd);
+
+void fd_table_install(struct fd_table *t, int fd, fs_handle h);
+fs_handle fd_table_remove(struct fd_table *t, int fd);
+void fd_table_set_cloexec(struct fd_table *t, int fd, bool cloexec);
+
+/* Return the first used/close-on-exec fd >= `fd` or -1, if there's none */
+int fd_table_next_open_fd(struct fd_table *t, int fd);
+int fd_table_next_cloexec_fd(struct fd_table *t, int fd);
+
+static ALWAYS_INLINE fs_handle fd_table_get(struct fd_table *t, int fd)
+{
+   return (u32)fd < t->size ? t->handles[fd] : NULL;
+}
+
+#define fd_table_for_each_open(t, fd)                                     \
+   for (fd = fd_table_next_open_fd((t), 0);                               \
+        fd >= 0;                                                          \
+        fd = fd_table_next_open_fd((t), fd + 1))
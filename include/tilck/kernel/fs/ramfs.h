@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Fault-around window of the ramfs mappings, in pages: see the comments in
+ * kernel/fs/ramfs/mmap.c.h. The value is clamped to RAMFS_FAULT_AROUND_MAX
+ * and it can be changed at runtime through sysfs (/syst/ramfs/fault_around).
+ */
+#define RAMFS_FAULT_AROUND_DEF           16u
+#define RAMFS_FAULT_AROUND_MAX          256u
+
+struct ramfs_fault_stats {
+   ulong faults;                 /* faults handled on ramfs mappings */
+   ulong pages;                  /* pages mapped by those faults */
+};
+
+extern ulong ramfs_fault_around;
+extern struct ramfs_fault_stats ramfs_fault_stats;
@@ -322,3 +322,9 @@ mp_get_retained_at(struct mnt_fs *host_fs,
                    vfs_inode_ptr_t inode);
 
 struct mnt_fs *mp_get_root(void);
+
+/* ------------ Dentry cache interface ------------- */
+
+void vfs_dcache_invalidate(vfs_inode_ptr_t dir, const char *name, size_t len);
+void vfs_dcache_invalidate_dir(vfs_inode_ptr_t dir);
+void vfs_dcache_flush(struct mnt_fs *fs);
@@ -70,6 +70,7 @@ struct vfs_path {
 
 #define VFS_FS_RW             (1 << 0)  /* struct mnt_fs mounted in RW mode */
 #define VFS_FS_RQ_DE_SKIP     (1 << 1)  /* FS requires vfs dents skip */
+#define VFS_FS_DCACHE         (1 << 2)  /* FS entries can be in the dcache */
 
 /* This struct is Tilck's analogue of Linux's "superblock" */
 struct mnt_fs {
@@ -116,6 +117,7 @@ struct fs_handle_base {
 #define VFS_SPFL_NO_USER_COPY                  (1 << 0)
 #define VFS_SPFL_MMAP_SUPPORTED                (1 << 1)
 #define VFS_SPFL_NO_LF                         (1 << 2)
+#define VFS_SPFL_EPOLL_WATCHED                 (1 << 3)
 
 /*
  * vfs_mmap()'s flags
@@ -141,6 +143,7 @@ bool vfs_handle_fault(struct user_mapping *um, void *va, bool p, bool rw);
 int vfs_dup(fs_handle h, fs_handle *dup_h);
 void vfs_close(fs_handle h);
 fs_handle get_fs_handle(int fd);
+int install_fs_handle(fs_handle h, bool cloexec);
 
 static ALWAYS_INLINE bool
 is_mmap_supported(fs_handle h)
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Wake up at most `nr` tasks of the current process waiting on the futex at
+ * `uaddr` with a bitset matching `bitset`. Returns the number of tasks woken.
+ */
+int futex_wake(u32 *uaddr, int nr, u32 bitset);
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/page_size.h>
 
 #define KMALLOC_METADATA_BLOCK_NODE_SIZE      1
 #define KMALLOC_HEAPS_COUNT                  32
@@ -79,6 +80,9 @@ kmalloc_heap_dup_expanded(struct kmalloc_heap *h, size_t sz);
 void *
 per_heap_kmalloc(struct kmalloc_heap *h, size_t *size, u32 flags);
 
+bool
+per_heap_kmalloc_at(struct kmalloc_heap *h, void *ptr, size_t size, u32 flags);
+
 void
 per_heap_kfree(struct kmalloc_heap *h, void *ptr, size_t *size, u32 flags);
 
@@ -111,6 +115,17 @@ kfree2(void *ptr, size_t size)
    general_kfree(ptr, &size, 0);
 }
 
+/*
+ * Free a single page, which might be part of a bigger chunk allocated with
+ * KMALLOC_FL_MULTI_STEP. Works for standalone PAGE_SIZE blocks as well.
+ */
+static inline void
+kfree_chunk_page(void *ptr)
+{
+   size_t size = PAGE_SIZE;
+   general_kfree(ptr, &size, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+}
+
 void *
 kzmalloc(size_t size);
 
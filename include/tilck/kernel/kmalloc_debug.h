@@ -24,6 +24,19 @@ struct kmalloc_small_heaps_stats {
    int lifetime_created_heaps_count;
 };
 
+#define KMALLOC_CACHES_COUNT                  7    /* 32 B .. 2 KB */
+
+struct kmalloc_cache_stats {
+
+   u32 obj_size;
+   u32 depth;                 /* max objects in the magazine */
+   u32 cached;                /* objects currently in the magazine */
+   u64 hits;
+   u64 misses;
+   u64 frees_cached;
+   u64 frees_to_heap;         /* frees passed through (magazine full) */
+};
+
 struct debug_kmalloc_chunks_ctx {
    struct bintree_walk_ctx ctx;
 };
@@ -31,6 +44,7 @@ struct debug_kmalloc_chunks_ctx {
 struct debug_kmalloc_stats {
 
    struct kmalloc_small_heaps_stats small_heaps;
+   struct kmalloc_cache_stats caches[KMALLOC_CACHES_COUNT];
    size_t chunk_sizes_count;
 };
 
@@ -44,6 +58,9 @@ debug_kmalloc_get_heap_info_by_ptr(struct kmalloc_heap *h,
 void
 debug_kmalloc_get_stats(struct debug_kmalloc_stats *stats);
 
+bool
+debug_kmalloc_set_caches_enabled(bool enabled);
+
 void
 debug_kmalloc_chunks_stats_start_read(struct debug_kmalloc_chunks_ctx *ctx);
 
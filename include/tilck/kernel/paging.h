@@ -17,6 +17,16 @@
 
 #define INVALID_PADDR                                  ((ulong)-1)
 
+/*
+ * Size of the big pages that user mappings can use (see map_big_page()) or 0,
+ * if the architecture does not support them.
+ */
+#if defined(__i386__)
+   #define USER_BIG_PAGE_SIZE                                (4 * MB)
+#else
+   #define USER_BIG_PAGE_SIZE                                      0
+#endif
+
 /* Paging flags (pg_flags) */
 #define PAGING_FL_RW                                      (1 << 0)
 #define PAGING_FL_US                                      (1 << 1)
@@ -24,6 +34,7 @@
 #define PAGING_FL_SHARED                                  (1 << 3)
 #define PAGING_FL_DO_ALLOC                                (1 << 4)
 #define PAGING_FL_ZERO_PG                                 (1 << 5)
+#define PAGING_FL_COW                                     (1 << 6)
 
 /* Combo values */
 #define PAGING_FL_RWUS               (PAGING_FL_RW | PAGING_FL_US)
@@ -88,6 +99,16 @@ map_page_int(pdir_t *pdir, void *vaddr, ulong paddr, ulong hw_flags);
 NODISCARD int
 map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags);
 
+/*
+ * Map the USER_BIG_PAGE_SIZE-aligned physical range at `paddr` at the aligned
+ * user address `vaddr` with a single big page. The pageframes are ref-counted
+ * as if they were mapped with regular pages and the big page is transparently
+ * split when any of them needs to be handled individually (unmap, fork etc.).
+ * Returns -EOPNOTSUPP when the architecture does not support big pages.
+ */
+NODISCARD int
+map_big_page(pdir_t *pdir, void *vaddr, ulong paddr, u32 pg_flags);
+
 NODISCARD size_t
 map_pages(pdir_t *pdir,
           void *vaddr,
@@ -116,11 +137,35 @@ void unmap_page(pdir_t *pdir, void *vaddr, bool do_free);
 int unmap_page_permissive(pdir_t *pdir, void *vaddrp, bool do_free);
 void unmap_pages(pdir_t *pdir, void *vaddr, size_t count, bool do_free);
 size_t unmap_pages_permissive(pdir_t *pd, void *va, size_t count, bool do_free);
+
+/*
+ * Make `pdir` own the page tables covering the `page_count` pages at `vaddr`,
+ * copying the ones shared after fork() and splitting the big pages, so that
+ * the pages in the range can be unmapped or swapped without allocating any
+ * memory. With `skip_whole`, the 4 MB entries entirely inside the range are
+ * left alone, as unmap_pages() drops them as a whole. The unmap functions
+ * cannot fail: the syscalls have to call this first and return -ENOMEM when
+ * it fails. No mapping changes, in either case.
+ */
+NODISCARD int
+pdir_own_page_tables(pdir_t *pdir,
+                     void *vaddr,
+                     size_t page_count,
+                     bool skip_whole);
+
+/*
+ * Swap the mappings of the `page_count` pages at `vaddr1` with the ones at
+ * `vaddr2`, keeping their flags. All the pages must be mapped. No pageframe is
+ * copied or ref-counted: they just change their address.
+ */
+void swap_pages(pdir_t *pdir, void *vaddr1, void *vaddr2, size_t page_count);
+
 ulong get_mapping(pdir_t *pdir, void *vaddr);
 int get_mapping2(pdir_t *pdir, void *vaddrp, ulong *pa_ref);
 pdir_t *pdir_clone(pdir_t *pdir);
 pdir_t *pdir_deep_clone(pdir_t *pdir);
 void pdir_destroy(pdir_t *pdir);
+size_t pdir_get_user_rss(pdir_t *pdir);
 void invalidate_page(ulong vaddr);
 void set_page_rw(pdir_t *pdir, void *vaddr, bool rw);
 void retain_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
@@ -17,6 +17,7 @@
 #include <tilck/kernel/elf_loader.h>
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/fs/fd_table.h>
 #include <tilck/kernel/sys_types.h>
 
 struct kernel_alloc {
@@ -31,6 +32,35 @@ struct mappings_info {
    struct kmalloc_heap *mmap_heap;
    size_t mmap_heap_size;
    struct list mappings;
+   struct user_mapping *mappings_tree;    /* the same mappings, by address */
+};
+
+struct session {
+
+   REF_COUNTED_OBJECT;                    /* number of process groups */
+
+   union {
+      int sid;
+      ulong padding_0;                    /* see the comment in struct task */
+   };
+
+   struct bintree_node node;
+   struct list groups;
+};
+
+struct process_group {
+
+   REF_COUNTED_OBJECT;                    /* number of member processes */
+
+   union {
+      int pgid;
+      ulong padding_0;                    /* see the comment in struct task */
+   };
+
+   struct bintree_node node;
+   struct session *session;
+   struct list_node session_node;
+   struct list members;
 };
 
 struct process {
@@ -41,6 +71,9 @@ struct process {
    int pgid;                         /* process group ID (same as in Linux)   */
    int sid;                          /* process session ID (as in Linux)      */
    int parent_pid;
+
+   struct process_group *pgrp;       /* pgrp->pgid == pgid, always */
+   struct list_node pgrp_node;       /* node in pgrp->members */
    pdir_t *pdir;
 
    void *brk;
@@ -48,6 +81,7 @@ struct process {
    struct mappings_info *mi;
 
    struct list children;
+   struct list threads;              /* all the threads except the main one */
 
    void *proc_tty;
    bool did_call_execve;
@@ -55,17 +89,17 @@ struct process {
    bool vforked;                 /* after vfork(), before execve() */
    bool inherited_mmap_heap;
    bool did_set_tty_medium_raw;
+   bool group_exit;              /* the other threads are being terminated */
+   s32 group_exit_wstatus;       /* valid only when `group_exit` is true */
 
-   int *set_child_tid;                    /* NOTE: this is an user pointer */
-
-   struct kmutex fslock;                  /* protects `handles` and `cwd` */
+   struct kmutex fslock;                  /* protects `fdt` and `cwd` */
    mode_t umask;
 
    struct vfs_path cwd;                   /* CWD as a struct vfs_path */
    char *debug_cmdline;                   /* debug field used by debugpanel */
 
    struct locked_file *elf;
-   fs_handle handles[MAX_HANDLES];        /* just a small fixed-size array */
+   struct fd_table fdt;                   /* file descriptors table */
 
    /*
     * The purpose of having this opaque `arch_fields` member here is to avoid
@@ -126,6 +160,12 @@ task_is_parent(struct task *parent, struct task *child)
 }
 
 int do_fork(regs_t *user_regs, bool vfork);
+int do_clone_thread(regs_t *user_regs,
+                    ulong flags,
+                    ulong newsp,
+                    int *u_parent_tidptr,
+                    int *u_child_tidptr,
+                    ulong tls);
 void unblock_parent_of_vforked_child(struct process *pi);
 void vforked_child_transfer_dispose_mi(struct process *pi);
 
@@ -152,12 +192,16 @@ bool arch_specific_new_task_setup(struct task *ti, struct task *parent);
 void arch_specific_free_task(struct task *ti);
 void arch_specific_new_proc_setup(struct process *pi, struct process *parent);
 void arch_specific_free_proc(struct process *pi);
+int arch_specific_set_thread_tls(struct task *ti, ulong tls);
+void arch_specific_free_thread_tls(struct task *ti);
 void wake_up_tasks_waiting_on(struct task *ti, enum wakeup_reason r);
 void init_process_lists(struct process *pi);
 
 void process_set_cwd2_nolock(struct vfs_path *tp);
 void process_set_cwd2_nolock_raw(struct process *pi, struct vfs_path *tp);
 void terminate_process(int exit_code, int term_sig);
+NORETURN void terminate_thread(void);
+void kill_other_threads(void);
 void close_cloexec_handles(struct process *pi);
 int setup_sig_handler(struct task *ti,
                       enum sig_state sig_state,
@@ -5,11 +5,13 @@
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/list.h>
+#include <tilck/kernel/bintree.h>
 
 struct user_mapping {
 
    struct list_node pi_node;
    struct list_node inode_node;
+   struct bintree_node tree_node;      /* node in mi->mappings_tree */
    struct process *pi;
 
    fs_handle h;
@@ -22,12 +24,18 @@ struct user_mapping {
    };
 
    int prot;
-
+   int flags;                          /* MAP_SHARED/PRIVATE, MAP_HUGETLB */
+   int advice;                         /* MADV_NORMAL/SEQUENTIAL/RANDOM */
 };
 
 struct user_mapping *
-process_add_user_mapping(fs_handle h, void *v, size_t ln, size_t off, int prot);
-void process_remove_user_mapping(struct user_mapping *um);
+process_add_user_mapping(fs_handle h,
+                         void *v,
+                         size_t ln,
+                         size_t off,
+                         int prot,
+                         int flags);
+void process_remove_user_mapping(struct process *pi, struct user_mapping *um);
 void full_remove_user_mapping(struct process *pi, struct user_mapping *um);
 void remove_all_mappings_of_handle(struct process *pi, fs_handle h);
 void remove_all_user_zero_mem_mappings(struct process *pi);
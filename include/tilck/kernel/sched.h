@@ -77,9 +77,11 @@ struct task {
    void *worker_thread;                      /* only for worker threads */
 
    struct bintree_node tree_by_tid_node;
-   struct list_node runnable_node;
+   struct bintree_node runnable_tree_node;   /* see sched.c */
+   struct list_node runnable_node;           /* see sched.c */
    struct list_node wakeup_timer_node;
-   struct list_node siblings_node;    /* nodes in parent's pi's children list */
+   struct list_node siblings_node;    /* node in parent's pi->children list
+                                       * or, for threads, in pi->threads */
 
    struct list tasks_waiting_list;    /* tasks waiting this task to end */
 
@@ -95,7 +97,7 @@ struct task {
    };
 
    struct wait_obj wobj;
-   u32 ticks_before_wake_up;
+   u64 wakeup_tick;                   /* timer wheel's tick, 0 = no timer */
 
    /* List of callbacks to call on exit */
    struct list on_exit;
@@ -121,6 +123,9 @@ struct task {
    /* Kernel thread name, NULL for user tasks */
    const char *kthread_name;
 
+   /* CLONE_CHILD_CLEARTID / set_tid_address() user pointer, see exit.c */
+   int *clear_child_tid;
+
    /* Pending signals bitset */
    ulong sa_pending[K_SIGACTION_MASK_WORDS];
 
@@ -141,7 +146,6 @@ extern struct task *kernel_process;
 extern struct process *kernel_process_pi;
 extern struct task *idle_task;
 
-extern struct list runnable_tasks_list;
 extern const char *const task_state_str[5];
 
 #define KTH_ALLOC_BUFS                       (1 << 0)
@@ -406,6 +410,7 @@ int kthread_join_all(const int *tids, size_t n, bool ignore_signals);
 void task_set_wakeup_timer(struct task *task, u32 ticks);
 void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks);
 u32 task_cancel_wakeup_timer(struct task *ti);
+void sched_requeue_timer_ready_task(struct task *ti);
 
 typedef void (*kthread_func_ptr)();
 
@@ -420,6 +425,9 @@ NODISCARD int kthread_create2(kthread_func_ptr func,
 int iterate_over_tasks(bintree_visit_cb func, void *arg);
 int sched_count_proc_in_group(int pgid);
 int sched_get_session_of_group(int pgid);
+struct process_group *sched_get_process_group(int pgid);
+NODISCARD int sched_set_process_group(struct process *pi, int pgid, int sid);
+void sched_leave_process_group(struct process *pi);
 
 struct process *task_get_pi_opaque(struct task *ti);
 void process_set_tty(struct process *pi, void *t);
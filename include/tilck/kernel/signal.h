@@ -28,9 +28,10 @@ bool process_signals(void *curr, enum sig_state new_sig_state, void *regs);
 void drop_all_pending_signals(void *curr);
 void reset_all_custom_signal_handlers(void *curr);
 
+/* Send a signal to the task `tid`, no matter which process it belongs to */
 static inline int send_signal(int tid, int signum, int flags)
 {
-   return send_signal2(tid, tid, signum, flags);
+   return send_signal2(0, tid, signum, flags);
 }
 
 #define K_SIGACTION_MASK_WORDS                              (_NSIG / NBITS)
@@ -19,7 +19,8 @@ enum wo_type {
    /* Special "meta-object" types */
 
    WOBJ_MWO_WAITER, /* struct multi_obj_waiter */
-   WOBJ_MWO_ELEM    /* a pointer to this wobj is castable to mwobj_elem */
+   WOBJ_MWO_ELEM,   /* a pointer to this wobj is castable to mwobj_elem */
+   WOBJ_KCOND_WATCHER /* a pointer to this wobj is castable to kcond_watcher */
 };
 
 #define NO_EXTRA                 0
@@ -190,11 +191,13 @@ bool kmutex_is_curr_task_holding_lock(struct kmutex *m);
 struct kcond {
 
    struct list wait_list;
+   u32 watchers;                 /* count of kcond_watcher in wait_list */
 };
 
 #define STATIC_KCOND_INIT(s)                     \
    {                                             \
       .wait_list = STATIC_LIST_INIT(s.wait_list),\
+      .watchers = 0,                             \
    }
 
 #define KCOND_WAIT_FOREVER 0
@@ -205,3 +208,42 @@ void kcond_signal_one(struct kcond *c);
 void kcond_signal_all(struct kcond *c);
 bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks);
 bool kcond_is_anyone_waiting(struct kcond *c);
+
+/*
+ * Wake up at most `max` tasks waiting on `c` whose wait object's `extra` field
+ * has at least one bit in common with `mask`. Returns the number of tasks
+ * actually woken up. Used by futexes, whose waiters store there their bitset.
+ */
+int kcond_signal_extra(struct kcond *c, u32 mask, int max);
+
+/*
+ * Move at most `max` waiters from `src` to `dst`, without waking them up.
+ * Returns the number of waiters moved.
+ */
+int kcond_requeue(struct kcond *src, struct kcond *dst, int max);
+
+/*
+ * A kcond watcher is a persistent waiter which, instead of waking up a task,
+ * gets its callback called every time the kcond is signaled, no matter if with
+ * kcond_signal_one() or kcond_signal_all(). The watcher stays in the kcond's
+ * wait list until kcond_unwatch() is called. The callback runs with the
+ * preemption disabled: it must NOT sleep and must NOT touch the wait list of
+ * the same kcond. Used by epoll.
+ */
+
+struct kcond_watcher;
+typedef void (*kcond_watcher_cb)(struct kcond_watcher *w);
+
+struct kcond_watcher {
+
+   struct wait_obj wobj;
+   kcond_watcher_cb cb;
+   void *arg;
+};
+
+void kcond_watch(struct kcond *c,
+                 struct kcond_watcher *w,
+                 kcond_watcher_cb cb,
+                 void *arg);
+
+void kcond_unwatch(struct kcond_watcher *w);
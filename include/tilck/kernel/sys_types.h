@@ -25,6 +25,9 @@
 #include <sys/utsname.h>  // system header
 #include <sys/stat.h>     // system header
 #include <fcntl.h>        // system header
+#include <sys/epoll.h>    // system header
+#include <sys/eventfd.h>  // system header
+#include <sys/timerfd.h>  // system header
 
 /*
  * RUSAGE_THREAD is linux-specific, so it
@@ -129,6 +132,18 @@ struct k_timespec64 {
    long tv_nsec;
 };
 
+struct k_itimerspec32 {
+
+   struct k_timespec32 it_interval;
+   struct k_timespec32 it_value;
+};
+
+struct k_itimerspec64 {
+
+   struct k_timespec64 it_interval;
+   struct k_timespec64 it_value;
+};
+
 
 
 #if defined(__i386__)
@@ -260,7 +260,9 @@ int sys_nanosleep_time32(const struct k_timespec32 *req,
 long sys_nanosleep(const struct k_timespec64 *u_req,
                    struct k_timespec64 *u_rem);
 
-CREATE_STUB_SYSCALL_IMPL(sys_mremap)
+long sys_mremap(void *old_addr, size_t old_len, size_t new_len,
+                int flags, void *new_addr);
+
 CREATE_STUB_SYSCALL_IMPL(sys_setresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_getresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_vm86)
@@ -368,7 +370,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_fremovexattr)
 int sys_tkill(int tid, int sig);
 
 CREATE_STUB_SYSCALL_IMPL(sys_sendfile64)
-CREATE_STUB_SYSCALL_IMPL(sys_futex_time32)
+int sys_futex_time32(u32 *uaddr, int op, u32 val,
+                     const struct k_timespec32 *u_timeout,
+                     u32 *uaddr2, u32 val3);
+
 CREATE_STUB_SYSCALL_IMPL(sys_sched_setaffinity)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_getaffinity)
 
@@ -386,9 +391,11 @@ CREATE_STUB_SYSCALL_IMPL(sys_ia32_fadvise64)
 NORETURN int sys_exit_group(int status);
 
 CREATE_STUB_SYSCALL_IMPL(sys_lookup_dcookie)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_create)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_ctl)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_wait)
+
+int sys_epoll_create(int size);
+int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *u_ev);
+int sys_epoll_wait(int epfd, struct epoll_event *u_evs, int maxev, int timeout);
+
 CREATE_STUB_SYSCALL_IMPL(sys_remap_file_pages)
 
 // TODO: complete the implementation when thread creation is implemented.
@@ -482,7 +489,9 @@ CREATE_STUB_SYSCALL_IMPL(sys_tee)
 CREATE_STUB_SYSCALL_IMPL(sys_vmsplice)
 CREATE_STUB_SYSCALL_IMPL(sys_move_pages)
 CREATE_STUB_SYSCALL_IMPL(sys_getcpu)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_pwait)
+
+int sys_epoll_pwait(int epfd, struct epoll_event *u_evs, int maxev,
+                    int timeout, const sigset_t *sigmask, size_t sigsetsize);
 
 int sys_utimensat_time32(int dirfd, const char *u_path,
                          const struct k_timespec32 times[2], int flags);
@@ -491,14 +500,23 @@ long sys_utimensat(int dirfd, const char *u_path,
                    struct k_timespec64 utimes[2], int flags);
 
 CREATE_STUB_SYSCALL_IMPL(sys_signalfd)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_create)
-CREATE_STUB_SYSCALL_IMPL(sys_eventfd)
+
+int sys_timerfd_create(int clockid, int flags);
+int sys_eventfd(unsigned int initval);
+
 CREATE_STUB_SYSCALL_IMPL(sys_fallocate)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_settime32)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_gettime32)
+
+int sys_timerfd_settime32(int fd, int flags,
+                          const struct k_itimerspec32 *u_new,
+                          struct k_itimerspec32 *u_old);
+
+int sys_timerfd_gettime32(int fd, struct k_itimerspec32 *u_curr);
+
 CREATE_STUB_SYSCALL_IMPL(sys_signalfd4)
-CREATE_STUB_SYSCALL_IMPL(sys_eventfd2)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_create1)
+
+int sys_eventfd2(unsigned int initval, int flags);
+
+int sys_epoll_create1(int flags);
 
 long sys_dup3(int oldfd, int newfd, int flags);
 
@@ -589,8 +607,13 @@ int sys_clock_getres(clockid_t clk_id, struct k_timespec64 *user_res);
 CREATE_STUB_SYSCALL_IMPL(sys_clock_nanosleep)
 CREATE_STUB_SYSCALL_IMPL(sys_timer_gettime)
 CREATE_STUB_SYSCALL_IMPL(sys_timer_settime)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_gettime)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_settime)
+
+int sys_timerfd_gettime(int fd, struct k_itimerspec64 *u_curr);
+
+int sys_timerfd_settime(int fd, int flags,
+                        const struct k_itimerspec64 *u_new,
+                        struct k_itimerspec64 *u_old);
+
 CREATE_STUB_SYSCALL_IMPL(sys_pselect6_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_ppoll_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_io_pgetevents)
@@ -599,7 +622,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_mq_timedsend)
 CREATE_STUB_SYSCALL_IMPL(sys_mq_timedreceive)
 CREATE_STUB_SYSCALL_IMPL(sys_semtimedop)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait)
-CREATE_STUB_SYSCALL_IMPL(sys_futex)
+
+int sys_futex(u32 *uaddr, int op, u32 val,
+              const struct k_timespec64 *u_timeout, u32 *uaddr2, u32 val3);
+
 CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_send_signal)
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_setup)
@@ -3,6 +3,7 @@
 #pragma once
 #include <tilck_gen_headers/config_sched.h>
 #include <tilck/common/basic_defs.h>
+#include <tilck/kernel/list.h>
 
 void kernel_sleep(u64 ticks);  /* sleep for `ticks` timer ticks (jiffies) */
 void kernel_sleep_ms(u64 ms);  /* sleep for `ms` milliseconds */
@@ -16,3 +17,43 @@ ms_to_ticks(u64 ms)
 
 u64 get_ticks(void);
 void init_timer(void);
+
+/*
+ * Hierarchical timer wheel
+ * ---------------------------
+ *
+ * The wakeup timers of the tasks are kept in a multi-level timer wheel, in the
+ * style of the classic Linux one. The root level has TW_ROOT_SIZE slots, each
+ * one containing the timers expiring exactly at a given tick in the next
+ * TW_ROOT_SIZE ticks. Each one of the TW_LEVELS upper levels has TW_LVL_SIZE
+ * slots, covering exponentially bigger time ranges. Every TW_ROOT_SIZE ticks,
+ * the timers in the next slot of the 1st upper level get "cascaded" down
+ * in the root level (and so on, recursively, for the higher levels).
+ *
+ * This way, adding and removing a timer is O(1) and, on each tick, we visit
+ * only the timers actually expiring (plus the amortized cascading work).
+ *
+ * NOTE: struct timer_wheel is exposed here only for the self-tests: the rest
+ * of the kernel is expected to use just the task_*_wakeup_timer() functions.
+ */
+
+#define TW_ROOT_BITS                            8
+#define TW_LVL_BITS                             6
+#define TW_LEVELS                               4
+#define TW_ROOT_SIZE              (1 << TW_ROOT_BITS)
+#define TW_LVL_SIZE               (1 << TW_LVL_BITS)
+#define TW_ROOT_MASK              (TW_ROOT_SIZE - 1)
+#define TW_LVL_MASK               (TW_LVL_SIZE - 1)
+
+struct task;
+
+struct timer_wheel {
+   u64 next_tick;                            /* the next tick to process */
+   struct list root[TW_ROOT_SIZE];
+   struct list lvl[TW_LEVELS][TW_LVL_SIZE];
+};
+
+void timer_wheel_init(struct timer_wheel *tw);
+void timer_wheel_add(struct timer_wheel *tw, struct task *ti, u32 ticks);
+u32 timer_wheel_del(struct timer_wheel *tw, struct task *ti);
+struct list *timer_wheel_advance(struct timer_wheel *tw);
@@ -6,7 +6,10 @@
 
 static inline bool user_out_of_range(const void *user_ptr, size_t n)
 {
-   return !user_ptr || ((ulong)user_ptr + n) > BASE_VA;
+   const ulong va = (ulong)user_ptr;
+
+   /* NOTE: `va + n` might overflow, therefore compare `n` with the room left */
+   return !user_ptr || va > BASE_VA || n > BASE_VA - va;
 }
 
 int copy_from_user(void *dest, const void *user_ptr, size_t n);
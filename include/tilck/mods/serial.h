@@ -13,6 +13,11 @@ char serial_read(u16 port);
 bool serial_write_ready(u16 port);
 void serial_wait_for_write(u16 port);
 void serial_write(u16 port, char c);
+void serial_write_nowait(u16 port, char c);
+
+u32 serial_get_tx_fifo_size(u16 port);
+void serial_set_tx_intr(u16 port, bool enabled);
+void serial_write_buf(u16 port, const char *buf, size_t len);
 
 #if MOD_serial
    void early_init_serial_ports(void);
@@ -63,6 +63,17 @@ static void __unknown_syscall(void)
 #define DECL_SYS(func, flags) { {func}, flags }
 #define DECL_UNKNOWN_SYSCALL  DECL_SYS(__unknown_syscall, 0)
 
+/*
+ * On i386, clone() has the "CLONE_BACKWARDS" ABI: the `tls` argument comes
+ * before `child_tidptr`, while sys_clone() uses the generic order.
+ */
+static long
+sys_clone_backwards(regs_t *u_regs, ulong flags, ulong newsp,
+                    int *u_parent_tidptr, ulong tls, int *u_child_tidptr)
+{
+   return sys_clone(u_regs, flags, newsp, u_parent_tidptr, u_child_tidptr, tls);
+}
+
 /*
  * The syscall numbers are ARCH-dependent
  *
@@ -195,7 +206,7 @@ static struct syscall syscalls[MAX_SYSCALLS] =
    [117] = DECL_SYS(sys_ipc, 0),
    [118] = DECL_SYS(sys_fsync, 0),
    [119] = DECL_SYS(sys_sigreturn, 0),
-   [120] = DECL_SYS(sys_clone, 0),
+   [120] = DECL_SYS(sys_clone_backwards, SYSFL_RAW_REGS),
    [121] = DECL_SYS(sys_setdomainname, 0),
    [122] = DECL_SYS(sys_newuname, 0),
    [123] = DECL_SYS(sys_modify_ldt, 0),
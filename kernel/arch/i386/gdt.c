@@ -381,6 +381,36 @@ static void gdt_set_slot(struct process *pi, u16 slot, u16 gdt_index)
    get_proc_arch_fields(pi)->gdt_entries[slot] = gdt_index;
 }
 
+static void
+user_desc_to_gdt_entry(struct user_desc *dc, struct gdt_entry *e)
+{
+   gdt_set_entry(e, dc->base_addr, dc->limit, 0, 0);
+   e->s = 1;
+   e->dpl = 3;
+   e->d = dc->seg_32bit;
+   e->type |= (dc->contents << 2);
+   e->type |= !dc->read_exec_only ? GDT_ACCESS_RW : 0;
+   e->g = dc->limit_in_pages;
+   e->avl = dc->useable;
+   e->p = !dc->seg_not_present;
+}
+
+static int gdt_add_entry_or_expand(struct gdt_entry *e)
+{
+   int n = gdt_add_entry(e);
+
+   if (n < 0) {
+
+      if (gdt_expand() < 0)
+         return -1;
+
+      n = gdt_add_entry(e);
+      ASSERT(n >= 0);
+   }
+
+   return n;
+}
+
 int sys_set_thread_area(void *arg)
 {
    int rc = 0;
@@ -396,15 +426,7 @@ int sys_set_thread_area(void *arg)
    disable_preemption();
 
    if (!(dc.flags == USER_DESC_FLAGS_EMPTY && !dc.base_addr && !dc.limit)) {
-      gdt_set_entry(&e, dc.base_addr, dc.limit, 0, 0);
-      e.s = 1;
-      e.dpl = 3;
-      e.d = dc.seg_32bit;
-      e.type |= (dc.contents << 2);
-      e.type |= !dc.read_exec_only ? GDT_ACCESS_RW : 0;
-      e.g = dc.limit_in_pages;
-      e.avl = dc.useable;
-      e.p = !dc.seg_not_present;
+      user_desc_to_gdt_entry(&dc, &e);
    } else {
       /* The user passed an empty descriptor: entry_number cannot be -1 */
       if (dc.entry_number == INVALID_ENTRY_NUM) {
@@ -422,19 +444,11 @@ int sys_set_thread_area(void *arg)
          goto out;
       }
 
-      dc.entry_number = (u32)gdt_add_entry(&e);
+      dc.entry_number = (u32)gdt_add_entry_or_expand(&e);
 
       if (dc.entry_number == INVALID_ENTRY_NUM) {
-
-         rc = gdt_expand();
-
-         if (rc < 0) {
-            rc = -ESRCH;
-            goto out;
-         }
-
-         dc.entry_number = (u32)gdt_add_entry(&e);
-         ASSERT(dc.entry_number != INVALID_ENTRY_NUM);
+         rc = -ESRCH;
+         goto out;
       }
 
       gdt_set_slot(get_curr_proc(), (u16)slot, (u16)dc.entry_number);
@@ -493,6 +507,40 @@ out:
    return rc;
 }
 
+/*
+ * clone(CLONE_SETTLS): `tls` is a pointer to a struct user_desc, like for
+ * set_thread_area(). Because the GDT is shared by all the tasks, instead of
+ * reusing the user-specified entry number, give each thread its own GDT entry
+ * and make thread's %gs point to it. The entry is released in free_task().
+ * Called with preemption enabled, as it reads the descriptor from the user
+ * memory: do_clone_thread() keeps the new thread stopped in the meanwhile.
+ */
+int arch_specific_set_thread_tls(struct task *ti, ulong tls)
+{
+   struct gdt_entry e = {0};
+   struct user_desc dc;
+   int n;
+
+   ASSERT(is_preemption_enabled());
+   ASSERT(!is_main_thread(ti));
+   ASSERT(!get_task_arch_fields(ti)->tls_gdt_entry);
+
+   if (copy_from_user(&dc, TO_PTR(tls), sizeof(struct user_desc)))
+      return -EFAULT;
+
+   if (dc.flags == USER_DESC_FLAGS_EMPTY && !dc.base_addr && !dc.limit)
+      return -EINVAL;
+
+   user_desc_to_gdt_entry(&dc, &e);
+
+   if ((n = gdt_add_entry_or_expand(&e)) < 0)
+      return -ESRCH;
+
+   get_task_arch_fields(ti)->tls_gdt_entry = (u16)n;
+   ti->state_regs->gs = X86_SELECTOR(n, TABLE_GDT, 3);
+   return 0;
+}
+
 void copy_main_tss_on_regs(regs_t *ctx)
 {
    *ctx = (regs_t) {
@@ -40,6 +40,157 @@ pdir_get_page_table(pdir_t *pdir, u32 i)
    return PA_TO_LIN_VA(pdir->entries[i].ptaddr << PAGE_SHIFT);
 }
 
+/*
+ * Shared page tables
+ * --------------------
+ *
+ * pdir_clone() does not copy the page tables: it makes the parent and the
+ * child to share them, making the page directory entries read-only. A page
+ * table gets copied only when one of the two needs to change it or a write
+ * fault hits one of its pages: at that point, its pages become shared between
+ * the two page tables and, therefore, copy-on-write. In other words, that's
+ * the same work that pdir_clone() would do, deferred and made only for the
+ * page tables actually touched after the fork. The last page directory using
+ * a shared page table just gets it back.
+ */
+static page_table_t *pdir_unshare_page_table(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   page_table_t *pt = pdir_get_page_table(pdir, pd_index);
+   const ulong pt_paddr = LIN_VA_TO_PA(pt);
+   page_table_t *new_pt;
+
+   ASSERT(e->avail & PDE_SHARED_PT);
+   ASSERT(pf_ref_count_get(pt_paddr) > 0);
+
+   if (pf_ref_count_get(pt_paddr) > 1) {
+
+      if (!(new_pt = kalloc_obj(page_table_t)))
+         return NULL;
+
+      /* Mark all the non-shared pages in the page table as COW */
+      for (u32 j = 0; j < 1024; j++) {
+
+         page_t *const p = &pt->pages[j];
+
+         if (!p->present)
+            continue;
+
+         if (!(p->avail & PAGE_SHARED)) {
+
+            if (p->rw)
+               p->avail |= PAGE_COW_ORIG_RW;
+
+            p->rw = false;
+         }
+
+         pf_ref_count_inc((ulong)p->pageAddr << PAGE_SHIFT);
+      }
+
+      memcpy32(new_pt, pt, sizeof(page_table_t) / 4);
+      e->ptaddr = SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
+      pt = new_pt;
+   }
+
+   pf_ref_count_dec(pt_paddr);
+   e->avail &= ~PDE_SHARED_PT;
+   e->rw = true;
+
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);    /* flush the TLB */
+
+   return pt;
+}
+
+/*
+ * User big pages
+ * ----------------
+ *
+ * User mappings can opt-in for 4-MB pages (see map_big_page()). Because all
+ * the rest of the kernel works with 4-KB pages, a big page is split in a page
+ * table of 1024 regular pages as soon as one of them needs to be handled
+ * individually: partial unmap, copy-on-write after fork() etc. The ref-count
+ * of the pageframes is always kept as if they were mapped with regular pages,
+ * so splitting a big page costs just the allocation of a page table.
+ *
+ * For the same reason, the user pageframes are always released one by one with
+ * kfree_chunk_page(): both the big pages and the ramfs extents are allocated as
+ * KMALLOC_FL_MULTI_STEP chunks.
+ */
+static page_table_t *pdir_split_big_page(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   const ulong paddr = (ulong)e->big_4mb_page.paddr << BIG_PAGE_SHIFT;
+   const u32 flags = e->raw & (PG_RW_BIT | PG_US_BIT | PG_CUSTOM_BITS);
+   page_table_t *pt;
+
+   ASSERT(e->present && e->psize && e->us);
+
+   if (!(pt = kalloc_obj(page_table_t)))
+      return NULL;
+
+   for (u32 j = 0; j < 1024; j++)
+      pt->pages[j].raw = PG_PRESENT_BIT | flags | (paddr + (j << PAGE_SHIFT));
+
+   e->raw = PG_PRESENT_BIT | PG_RW_BIT | PG_US_BIT | LIN_VA_TO_PA(pt);
+   invalidate_page_hw(pd_index << BIG_PAGE_SHIFT);
+   return pt;
+}
+
+/* Unmaps the whole big page `pd_index`, releasing its pageframes */
+static void pdir_unmap_big_page(pdir_t *pdir, u32 pd_index, bool do_free)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   const ulong paddr = (ulong)e->big_4mb_page.paddr << BIG_PAGE_SHIFT;
+
+   ASSERT(e->present && e->psize && e->us);
+
+   e->raw = 0;
+   invalidate_page_hw(pd_index << BIG_PAGE_SHIFT);
+
+   for (u32 j = 0; j < 1024; j++) {
+
+      const ulong pa = paddr + (j << PAGE_SHIFT);
+
+      if (!pf_ref_count_dec(pa) && do_free)
+         kfree_chunk_page(PA_TO_LIN_VA(pa));
+   }
+}
+
+/*
+ * Returns the page table `pd_index` of `pdir`, unsharing it or splitting the
+ * big page, if necessary. Returns NULL in case of OOM.
+ */
+static page_table_t *pdir_get_own_page_table(pdir_t *pdir, u32 pd_index)
+{
+   if (pdir->entries[pd_index].psize)
+      return pdir_split_big_page(pdir, pd_index);
+
+   if (pdir->entries[pd_index].avail & PDE_SHARED_PT)
+      return pdir_unshare_page_table(pdir, pd_index);
+
+   return pdir_get_page_table(pdir, pd_index);
+}
+
+static void cow_out_of_memory(void)
+{
+   struct task *curr = get_curr_task();
+
+   if (!in_syscall(curr)) {
+
+      // The task was not running in kernel: we can safely kill it.
+      printk("Out-of-memory: killing pid %d\n", get_curr_pid());
+      send_signal(get_curr_pid(), SIGKILL, SIG_FL_PROCESS | SIG_FL_FAULT);
+
+   } else {
+
+      // We cannot kill a task running in kernel during a CoW page fault
+      // In this case (but in the one above too), Linux puts the process to
+      // sleep, while the OOM killer runs and frees some memory.
+      panic("Out-of-memory: can't copy a CoW page [pid %d]", get_curr_pid());
+   }
+}
+
 bool handle_potential_cow(void *context)
 {
    regs_t *r = context;
@@ -53,7 +204,22 @@ bool handle_potential_cow(void *context)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
    const void *const page_vaddr = (void *)(vaddr & PAGE_MASK);
-   page_table_t *pt = pdir_get_page_table(get_curr_pdir(), pd_index);
+   pdir_t *pdir = get_curr_pdir();
+   page_table_t *pt = pdir_get_page_table(pdir, pd_index);
+
+   if (pdir->entries[pd_index].psize)
+      return false; /* Big pages are never COW */
+
+   if (pdir->entries[pd_index].avail & PDE_SHARED_PT) {
+
+      if (!(pt = pdir_unshare_page_table(pdir, pd_index))) {
+         cow_out_of_memory();
+         return true;
+      }
+
+      if (pt->pages[pt_index].rw)
+         return true; /* Just the page table was read-only */
+   }
 
    if (!(pt->pages[pt_index].avail & PAGE_COW_ORIG_RW))
       return false; /* Not a COW page */
@@ -82,24 +248,8 @@ bool handle_potential_cow(void *context)
    void *new_page_vaddr = kmalloc(PAGE_SIZE);
 
    if (!new_page_vaddr) {
-
-      // Out-of-memory case
-      struct task *curr = get_curr_task();
-
-      if (!in_syscall(curr)) {
-
-         // The task was not running in kernel: we can safely kill it.
-         printk("Out-of-memory: killing pid %d\n", get_curr_pid());
-         send_signal(get_curr_pid(), SIGKILL, SIG_FL_PROCESS | SIG_FL_FAULT);
-         return true;
-
-      } else {
-
-         // We cannot kill a task running in kernel during a CoW page fault
-         // In this case (but in the one above too), Linux puts the process to
-         // sleep, while the OOM killer runs and frees some memory.
-         panic("Out-of-memory: can't copy a CoW page [pid %d]", get_curr_pid());
-      }
+      cow_out_of_memory();
+      return true;
    }
 
    ASSERT(IS_PAGE_ALIGNED(new_page_vaddr));
@@ -199,7 +349,7 @@ void handle_page_fault_int(regs_t *r)
       get_curr_proc()->debug_cmdline
    );
 
-   send_signal(get_curr_tid(), sig, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal(get_curr_tid(), sig, SIG_FL_FAULT);
 }
 
 bool is_mapped(pdir_t *pdir, void *vaddrp)
@@ -251,6 +401,8 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
 
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(LIN_VA_TO_PA(pt) != 0);
+   ASSERT(!pdir->entries[pd_index].psize);
+   ASSERT(~pdir->entries[pd_index].avail & PDE_SHARED_PT);
    pt->pages[pt_index].rw = rw;
    invalidate_page_hw(vaddr);
 }
@@ -263,6 +415,8 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
 
+   /* The caller must have split the big page: see pdir_own_page_tables() */
+   ASSERT(!pdir->entries[pd_index].psize);
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
 
    if (permissive) {
@@ -278,6 +432,8 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
       ASSERT(pt->pages[pt_index].present);
    }
 
+   ASSERT(~pdir->entries[pd_index].avail & PDE_SHARED_PT);
+
    const ulong paddr = (ulong)
       pt->pages[pt_index].pageAddr << PAGE_SHIFT;
 
@@ -286,7 +442,7 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 
    if (!pf_ref_count_dec(paddr) && free_pageframe) {
       ASSERT(paddr != KERNEL_VA_TO_PA(zero_page));
-      kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+      kfree_chunk_page(PA_TO_LIN_VA(paddr));
    }
 
    return 0;
@@ -304,14 +460,70 @@ unmap_page_permissive(pdir_t *pdir, void *vaddrp, bool free_pageframe)
    return __unmap_page(pdir, vaddrp, free_pageframe, true);
 }
 
+/*
+ * Unmaps the whole page directory entry `pd_index` when it's a big page or a
+ * page table shared with other pdirs, without splitting or copying anything.
+ * Returns the number of pages unmapped, 0 if the entry has to be handled page
+ * by page.
+ */
+static size_t pdir_unmap_whole_entry(pdir_t *pdir, u32 pd_index, bool do_free)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   page_table_t *pt;
+   size_t count = 0;
+
+   if (e->psize) {
+      pdir_unmap_big_page(pdir, pd_index, do_free);
+      return 1024;
+   }
+
+   if (!e->present || !(e->avail & PDE_SHARED_PT))
+      return 0;
+
+   pt = pdir_get_page_table(pdir, pd_index);
+
+   if (pf_ref_count_get(LIN_VA_TO_PA(pt)) == 1) {
+
+      /* We're the last user: taking the table back costs nothing */
+      pdir_unshare_page_table(pdir, pd_index);
+      return 0;
+   }
+
+   /* Other pdirs still use this page table: just drop our reference */
+   for (u32 j = 0; j < 1024; j++)
+      count += pt->pages[j].present;
+
+   pf_ref_count_dec(LIN_VA_TO_PA(pt));
+   e->raw = 0;
+
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);    /* flush the TLB */
+
+   return count;
+}
+
 void
 unmap_pages(pdir_t *pdir,
             void *vaddr,
             size_t page_count,
             bool do_free)
 {
-   for (size_t i = 0; i < page_count; i++) {
-      unmap_page(pdir, (char *)vaddr + (i << PAGE_SHIFT), do_free);
+   size_t i = 0;
+
+   while (i < page_count) {
+
+      const ulong va = (ulong)vaddr + (i << PAGE_SHIFT);
+      const u32 pd_index = va >> BIG_PAGE_SHIFT;
+
+      if (!(va & (4 * MB - 1)) && page_count - i >= 1024 &&
+          pdir_unmap_whole_entry(pdir, pd_index, do_free))
+      {
+         i += 1024;
+         continue;
+      }
+
+      unmap_page(pdir, (void *)va, do_free);
+      i++;
    }
 }
 
@@ -322,20 +534,110 @@ unmap_pages_permissive(pdir_t *pdir,
                        bool do_free)
 {
    size_t unmapped_pages = 0;
+   size_t i = 0, cnt;
    int rc;
 
-   for (size_t i = 0; i < page_count; i++) {
-      rc = unmap_page_permissive(
-         pdir,
-         (char *)vaddr + (i << PAGE_SHIFT),
-         do_free
-      );
+   while (i < page_count) {
+
+      const ulong va = (ulong)vaddr + (i << PAGE_SHIFT);
+      const u32 pd_index = va >> BIG_PAGE_SHIFT;
+
+      if (!(va & (4 * MB - 1)) && page_count - i >= 1024 &&
+          (cnt = pdir_unmap_whole_entry(pdir, pd_index, do_free)))
+      {
+         unmapped_pages += cnt;
+         i += 1024;
+         continue;
+      }
+
+      rc = unmap_page_permissive(pdir, (void *)va, do_free);
       unmapped_pages += (rc == 0);
+      i++;
    }
 
    return unmapped_pages;
 }
 
+int
+pdir_own_page_tables(pdir_t *pdir,
+                     void *vaddrp,
+                     size_t page_count,
+                     bool skip_whole)
+{
+   const ulong vaddr = (ulong)vaddrp;
+   const ulong vend = vaddr + (page_count << PAGE_SHIFT);
+
+   for (ulong va = vaddr; va < vend; va = (va | (4 * MB - 1)) + 1) {
+
+      const u32 pd_index = va >> BIG_PAGE_SHIFT;
+      const page_dir_entry_t e = pdir->entries[pd_index];
+
+      if (!e.present || (!e.psize && !(e.avail & PDE_SHARED_PT)))
+         continue;
+
+      if (skip_whole && !(va & (4 * MB - 1)) && vend - va >= 4 * MB)
+         continue; /* unmap_pages() will drop the whole entry */
+
+      if (!pdir_get_own_page_table(pdir, pd_index))
+         return -ENOMEM;
+   }
+
+   return 0;
+}
+
+void
+swap_pages(pdir_t *pdir, void *vaddr1, void *vaddr2, size_t page_count)
+{
+   bool flush_tlb = false;
+   size_t i = 0;
+
+   while (i < page_count) {
+
+      const ulong va1 = (ulong)vaddr1 + (i << PAGE_SHIFT);
+      const ulong va2 = (ulong)vaddr2 + (i << PAGE_SHIFT);
+      const u32 pd_index1 = va1 >> BIG_PAGE_SHIFT;
+      const u32 pd_index2 = va2 >> BIG_PAGE_SHIFT;
+      page_table_t *pt1, *pt2;
+      page_dir_entry_t e;
+      page_t p;
+
+      if (!((va1 | va2) & (4 * MB - 1)) && page_count - i >= 1024) {
+
+         /*
+          * Swap the whole page dir entries: their page tables (or their big
+          * pages) don't care about the address they're mapped at.
+          */
+         e = pdir->entries[pd_index1];
+         pdir->entries[pd_index1] = pdir->entries[pd_index2];
+         pdir->entries[pd_index2] = e;
+         flush_tlb = true;
+         i += 1024;
+         continue;
+      }
+
+      /* The caller must own the page tables: see pdir_own_page_tables() */
+      ASSERT(!pdir->entries[pd_index1].psize);
+      ASSERT(!pdir->entries[pd_index2].psize);
+      ASSERT(~pdir->entries[pd_index1].avail & PDE_SHARED_PT);
+      ASSERT(~pdir->entries[pd_index2].avail & PDE_SHARED_PT);
+
+      pt1 = pdir_get_page_table(pdir, pd_index1);
+      pt2 = pdir_get_page_table(pdir, pd_index2);
+
+      p = pt1->pages[(va1 >> PAGE_SHIFT) & 1023];
+      pt1->pages[(va1 >> PAGE_SHIFT) & 1023] =
+         pt2->pages[(va2 >> PAGE_SHIFT) & 1023];
+      pt2->pages[(va2 >> PAGE_SHIFT) & 1023] = p;
+
+      invalidate_page_hw(va1);
+      invalidate_page_hw(va2);
+      i++;
+   }
+
+   if (flush_tlb && pdir == get_curr_pdir())
+      set_curr_pdir(pdir);
+}
+
 ulong get_mapping(pdir_t *pdir, void *vaddrp)
 {
    page_table_t *pt;
@@ -353,6 +655,12 @@ ulong get_mapping(pdir_t *pdir, void *vaddrp)
 
    e.raw = pdir->entries[pd_index].raw;
    ASSERT(e.present);
+
+   if (e.psize) {
+      return ((ulong) e.big_4mb_page.paddr << BIG_PAGE_SHIFT) |
+             (vaddr & (4 * MB - 1));
+   }
+
    ASSERT(e.ptaddr != 0);
 
    pt = PA_TO_LIN_VA(e.ptaddr << PAGE_SHIFT);
@@ -417,6 +725,9 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, ulong hw_flags)
    ASSERT(!(vaddr & OFFSET_IN_PAGE_MASK)); // the vaddr must be page-aligned
    ASSERT(!(paddr & OFFSET_IN_PAGE_MASK)); // the paddr must be page-aligned
 
+   if (pdir->entries[pd_index].psize)
+      return -EADDRINUSE;
+
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(IS_PAGE_ALIGNED(pt));
 
@@ -440,6 +751,9 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, ulong hw_flags)
    if (pt->pages[pt_index].present)
       return -EADDRINUSE;
 
+   if (UNLIKELY(!(pt = pdir_get_own_page_table(pdir, pd_index))))
+      return -ENOMEM;
+
    pt->pages[pt_index].raw = PG_PRESENT_BIT | hw_flags | paddr;
    pf_ref_count_inc(paddr);
    invalidate_page_hw(vaddr);
@@ -510,7 +824,7 @@ out:
 NODISCARD int
 map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
 {
-   const bool rw = !!(pg_flags & PAGING_FL_RW);
+   bool rw = !!(pg_flags & PAGING_FL_RW);
    const bool us = !!(pg_flags & PAGING_FL_US);
    u32 avail_bits = 0;
    int rc;
@@ -518,6 +832,17 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
    if (pg_flags & PAGING_FL_SHARED)
       avail_bits |= PAGE_SHARED;
 
+   if (pg_flags & PAGING_FL_COW) {
+
+      /* Private mapping of a shared page: copy it on the first write */
+      ASSERT(~pg_flags & PAGING_FL_SHARED);
+
+      if (rw)
+         avail_bits |= PAGE_COW_ORIG_RW;
+
+      rw = false;
+   }
+
    if (pg_flags & PAGING_FL_DO_ALLOC) {
 
       void *va;
@@ -576,6 +901,55 @@ map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags)
                    /* Kernel pages are global */
 }
 
+NODISCARD int
+map_big_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
+{
+   const u32 vaddr = (u32) vaddrp;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+   const bool rw = !!(pg_flags & PAGING_FL_RW);
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   u32 avail_bits = 0;
+
+   ASSERT(!(vaddr & (4*MB - 1))); // the vaddr must be 4MB-aligned
+   ASSERT(!(paddr & (4*MB - 1))); // the paddr must be 4MB-aligned
+   ASSERT(pd_index < BASE_VADDR_PD_IDX);
+   ASSERT(pg_flags & PAGING_FL_US);
+
+   /* Big pages are split on COW: they cannot be COW themselves */
+   ASSERT(!(pg_flags & (PAGING_FL_COW | PAGING_FL_DO_ALLOC)));
+
+   if (pg_flags & PAGING_FL_SHARED)
+      avail_bits |= PAGE_SHARED;
+
+   if (e->present) {
+
+      page_table_t *pt = pdir_get_page_table(pdir, pd_index);
+
+      if (e->psize || (e->avail & PDE_SHARED_PT))
+         return -EADDRINUSE;
+
+      for (u32 j = 0; j < 1024; j++)
+         if (pt->pages[j].present)
+            return -EADDRINUSE;
+
+      /* The page table is empty: the big page will replace it */
+      kfree_obj(pt, page_table_t);
+   }
+
+   for (u32 j = 0; j < 1024; j++)
+      pf_ref_count_inc(paddr + (j << PAGE_SHIFT));
+
+   e->raw = PG_PRESENT_BIT                        |
+            PG_4MB_BIT                            |
+            PG_US_BIT                             |
+            (u32)(rw << PG_RW_BIT_POS)            |
+            (u32)(avail_bits << PG_CUSTOM_B0_POS) |
+            paddr;
+
+   invalidate_page_hw(vaddr);
+   return 0;
+}
+
 NODISCARD size_t
 map_pages(pdir_t *pdir,
           void *vaddr,
@@ -584,13 +958,24 @@ map_pages(pdir_t *pdir,
           u32 pg_flags)
 {
    const bool us = !!(pg_flags & PAGING_FL_US);
-   const bool rw = !!(pg_flags & PAGING_FL_RW);
+   bool rw = !!(pg_flags & PAGING_FL_RW);
    const bool big_pages = !!(pg_flags & PAGING_FL_BIG_PAGES_ALLOWED);
    u32 avail_bits = 0;
 
    if (pg_flags & PAGING_FL_SHARED)
       avail_bits |= PAGE_SHARED;
 
+   if (pg_flags & PAGING_FL_COW) {
+
+      /* Private mapping of a shared page: copy it on the first write */
+      ASSERT(~pg_flags & PAGING_FL_SHARED);
+
+      if (rw)
+         avail_bits |= PAGE_COW_ORIG_RW;
+
+      rw = false;
+   }
+
    if (pg_flags & PAGING_FL_DO_ALLOC)
       NOT_IMPLEMENTED();
 
@@ -608,76 +993,96 @@ map_pages(pdir_t *pdir,
 
 pdir_t *pdir_clone(pdir_t *pdir)
 {
-   pdir_t *new_pdir = kalloc_obj(pdir_t);
+   pdir_t *new_pdir;
 
-   if (!new_pdir)
+   /*
+    * The private big pages have to become COW: split them in advance, so that
+    * the loop below cannot fail half-way.
+    */
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+
+      page_dir_entry_t *e = &pdir->entries[i];
+
+      if (e->psize && !(e->avail & PAGE_SHARED)) {
+         if (!pdir_split_big_page(pdir, i))
+            return NULL;
+      }
+   }
+
+   if (!(new_pdir = kalloc_obj(pdir_t)))
       return NULL;
 
    ASSERT(IS_PAGE_ALIGNED(new_pdir));
-   memcpy32(new_pdir, pdir, sizeof(pdir_t) / 4);
 
+   /* Share the page tables: see pdir_unshare_page_table() */
    for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-      /* User-space cannot use 4-MB pages */
-      ASSERT(!pdir->entries[i].psize);
+      page_dir_entry_t *e = &pdir->entries[i];
+      const ulong pt_paddr = (ulong)e->ptaddr << PAGE_SHIFT;
 
-      if (!pdir->entries[i].present)
-         continue;
+      if (e->psize) {
+
+         /* Shared big page: both the pdirs map it */
+         const ulong paddr = (ulong)e->big_4mb_page.paddr << BIG_PAGE_SHIFT;
 
-      page_table_t *pt = kalloc_obj(page_table_t);
+         for (u32 j = 0; j < 1024; j++)
+            pf_ref_count_inc(paddr + (j << PAGE_SHIFT));
 
-      if (UNLIKELY(!pt)) {
+      } else if (e->present) {
 
-         for (; i > 0; i--) {
-            if (pdir->entries[i - 1].present)
-               kfree_obj(pdir_get_page_table(pdir, i - 1), page_table_t);
+         if (!(e->avail & PDE_SHARED_PT)) {
+            ASSERT(pf_ref_count_get(pt_paddr) == 0);
+            pf_ref_count_inc(pt_paddr);
+            e->avail |= PDE_SHARED_PT;
+            e->rw = false;
          }
 
-         kfree_obj(new_pdir, pdir_t);
-         return NULL;
+         pf_ref_count_inc(pt_paddr);
       }
 
-      ASSERT(IS_PAGE_ALIGNED(pt));
-      new_pdir->entries[i].ptaddr=SHR_BITS(LIN_VA_TO_PA(pt),PAGE_SHIFT,u32);
+      new_pdir->entries[i].raw = e->raw;
    }
 
-   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
-
-      if (!pdir->entries[i].present)
-         continue;
+   for (u32 i = BASE_VADDR_PD_IDX; i < 1024; i++)
+      new_pdir->entries[i].raw = pdir->entries[i].raw;
 
-      page_table_t *orig_pt = pdir_get_page_table(pdir, i);
-      page_table_t *new_pt = pdir_get_page_table(new_pdir, i);
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);    /* flush the TLB: the entries are now read-only */
 
-      /* Mark all the non-shared pages in that page-table as COW. */
-      for (u32 j = 0; j < 1024; j++) {
+   return new_pdir;
+}
 
-         page_t *const p = &orig_pt->pages[j];
+/*
+ * Returns the number of user pages actually backed by memory: the pages
+ * mapping the zero page are not counted.
+ */
+size_t pdir_get_user_rss(pdir_t *pdir)
+{
+   const ulong zero_paddr = KERNEL_VA_TO_PA(&zero_page);
+   size_t count = 0;
 
-         if (!p->present)
-            continue;
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-         const ulong orig_paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+      if (!pdir->entries[i].present)
+         continue;
 
-         /* Sanity-check: a mapped page MUST have ref-count > 0 */
-         ASSERT(pf_ref_count_get(orig_paddr) > 0);
+      if (pdir->entries[i].psize) {
+         count += 1024;
+         continue;
+      }
 
-         if (!(p->avail & PAGE_SHARED)) {
+      page_table_t *pt = pdir_get_page_table(pdir, i);
 
-            if (p->rw)
-               p->avail |= PAGE_COW_ORIG_RW;
+      for (u32 j = 0; j < 1024; j++) {
 
-            p->rw = false;
-         }
+         const page_t *p = &pt->pages[j];
 
-         pf_ref_count_inc(orig_paddr);
+         if (p->present && ((ulong)p->pageAddr << PAGE_SHIFT) != zero_paddr)
+            count++;
       }
-
-      // copy the page table
-      memcpy(new_pt, orig_pt, sizeof(page_table_t));
    }
 
-   return new_pdir;
+   return count;
 }
 
 pdir_t *
@@ -698,14 +1103,20 @@ pdir_deep_clone(pdir_t *pdir)
 
    for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-      new_pdir->entries[i].raw = pdir->entries[i].raw;
+      if (pdir->entries[i].psize) {
+         if (!pdir_split_big_page(pdir, i))
+            goto oom_exit;
+      }
 
-      /* User-space cannot use 4-MB pages */
-      ASSERT(!pdir->entries[i].psize);
+      new_pdir->entries[i].raw = pdir->entries[i].raw;
 
       if (!pdir->entries[i].present)
          continue;
 
+      /* The new page table won't be shared */
+      new_pdir->entries[i].avail &= ~PDE_SHARED_PT;
+      new_pdir->entries[i].rw = true;
+
       page_table_t *orig_pt = pdir_get_page_table(pdir, i);
       page_table_t *new_pt = kmalloc_accelerator_get_elem(&acc);
 
@@ -772,8 +1183,20 @@ void pdir_destroy(pdir_t *pdir)
       if (!pdir->entries[i].present)
          continue;
 
+      if (pdir->entries[i].psize) {
+         pdir_unmap_big_page(pdir, i, true);
+         continue;
+      }
+
       page_table_t *pt = pdir_get_page_table(pdir, i);
 
+      if (pdir->entries[i].avail & PDE_SHARED_PT) {
+
+         /* Other pdirs still use this page table: just drop our reference */
+         if (pf_ref_count_dec(LIN_VA_TO_PA(pt)) > 0)
+            continue;
+      }
+
       for (u32 j = 0; j < 1024; j++) {
 
          if (!pt->pages[j].present)
@@ -782,7 +1205,7 @@ void pdir_destroy(pdir_t *pdir)
          const ulong paddr = (ulong)pt->pages[j].pageAddr << PAGE_SHIFT;
 
          if (pf_ref_count_dec(paddr) == 0)
-            kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+            kfree_chunk_page(PA_TO_LIN_VA(paddr));
       }
 
       // We freed all the pages, now free the whole page-table.
@@ -43,6 +43,14 @@
 
 #define PAGE_FAULT_FL_COW (PAGE_FAULT_FL_PRESENT | PAGE_FAULT_FL_RW)
 #define BIG_PAGE_SHIFT                                            22
+
+/*
+ * When this flag is set in the 'avail' bits of a page directory entry, the
+ * page table is shared, after fork(), with other page directories and the
+ * entry is read-only. The ref-count of the page table's pageframe is the
+ * number of page directories sharing it.
+ */
+#define PDE_SHARED_PT                          (1 << 0)
 #define BASE_VADDR_PD_IDX                (BASE_VA >> BIG_PAGE_SHIFT)
 
 // A page table entry
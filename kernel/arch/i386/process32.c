@@ -40,7 +40,7 @@ STATIC_ASSERT(
    OFFSET_OF(struct task, faults_resume_mask) == TI_FAULTS_MASK_OFF
 );
 
-STATIC_ASSERT(sizeof(struct task_and_process) <= 1024);
+STATIC_ASSERT(sizeof(struct task_and_process) <= 2048);
 
 int setup_sig_handler(struct task *ti,
                       enum sig_state sig_state,
@@ -198,6 +198,7 @@ void
 arch_specific_new_proc_setup(struct process *pi, struct process *parent)
 {
    arch_proc_members_t *arch = get_proc_arch_fields(pi);
+   u16 tls_entry = get_task_arch_fields(get_curr_task())->tls_gdt_entry;
 
    if (!parent)
       return;      /* we're done */
@@ -211,7 +212,22 @@ arch_specific_new_proc_setup(struct process *pi, struct process *parent)
       if (arch->gdt_entries[i])
          gdt_entry_inc_ref_count(arch->gdt_entries[i]);
 
-   pi->set_child_tid = NULL;
+   if (tls_entry) {
+
+      /*
+       * We're forking from a thread having its own TLS entry in the GDT and
+       * the main thread of the child process will continue using it: keep it
+       * alive by turning it into a regular entry of the child process.
+       */
+
+      for (int i = 0; i < ARRAY_SIZE(arch->gdt_entries); i++) {
+         if (!arch->gdt_entries[i]) {
+            gdt_entry_inc_ref_count(tls_entry);
+            arch->gdt_entries[i] = tls_entry;
+            break;
+         }
+      }
+   }
 }
 
 void
@@ -232,10 +248,21 @@ arch_specific_free_proc(struct process *pi)
    }
 }
 
+void
+arch_specific_free_thread_tls(struct task *ti)
+{
+   arch_task_members_t *arch = get_task_arch_fields(ti);
+
+   if (arch->tls_gdt_entry) {
+      gdt_clear_entry(arch->tls_gdt_entry);
+      arch->tls_gdt_entry = 0;
+   }
+}
+
 static void
 handle_fatal_error(regs_t *r, int signum)
 {
-   send_signal(get_curr_tid(), signum, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal(get_curr_tid(), signum, SIG_FL_FAULT);
 }
 
 /* General protection fault handler */
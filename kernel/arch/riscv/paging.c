@@ -223,7 +223,7 @@ void handle_page_fault_int(regs_t *r)
       get_curr_proc()->debug_cmdline
    );
 
-   send_signal(get_curr_tid(), sig, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal(get_curr_tid(), sig, SIG_FL_FAULT);
 }
 
 bool is_mapped(pdir_t *pdir, void *vaddrp)
@@ -367,6 +367,38 @@ unmap_pages_permissive(pdir_t *pdir,
    return unmapped_pages;
 }
 
+int
+pdir_own_page_tables(pdir_t *pdir,
+                     void *vaddrp,
+                     size_t page_count,
+                     bool skip_whole)
+{
+   /* No shared page tables and no user big pages here: nothing to do */
+   return 0;
+}
+
+void
+swap_pages(pdir_t *pdir, void *vaddr1, void *vaddr2, size_t page_count)
+{
+   for (size_t i = 0; i < page_count; i++) {
+
+      const ulong va1 = (ulong)vaddr1 + (i << PAGE_SHIFT);
+      const ulong va2 = (ulong)vaddr2 + (i << PAGE_SHIFT);
+      page_table_t *pt1 = pdir_get_page_table(pdir, va1);
+      page_table_t *pt2 = pdir_get_page_table(pdir, va2);
+      page_t p;
+
+      ASSERT(pt1 && pt2);
+
+      p = pt1->entries[PTE_INDEX(0, va1)];
+      pt1->entries[PTE_INDEX(0, va1)] = pt2->entries[PTE_INDEX(0, va2)];
+      pt2->entries[PTE_INDEX(0, va2)] = p;
+
+      invalidate_page_hw(va1);
+      invalidate_page_hw(va2);
+   }
+}
+
 ulong get_mapping(pdir_t *pdir, void *vaddrp)
 {
    page_table_t *pt;
@@ -538,7 +570,7 @@ out:
 NODISCARD int
 map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
 {
-   const bool rw = !!(pg_flags & PAGING_FL_RW);
+   bool rw = !!(pg_flags & PAGING_FL_RW);
    const bool us = !!(pg_flags & PAGING_FL_US);
    ulong avail_bits = 0;
    ulong hw_pg_flags = 0;
@@ -547,6 +579,17 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
    if (pg_flags & PAGING_FL_SHARED)
       avail_bits |= PAGE_SHARED;
 
+   if (pg_flags & PAGING_FL_COW) {
+
+      /* Private mapping of a shared page: copy it on the first write */
+      ASSERT(~pg_flags & PAGING_FL_SHARED);
+
+      if (rw)
+         avail_bits |= PAGE_COW_ORIG_RW;
+
+      rw = false;
+   }
+
    if (pg_flags & PAGING_FL_DO_ALLOC) {
 
       void *va;
@@ -605,6 +648,13 @@ map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags)
                    hw_pg_flags);
 }
 
+NODISCARD int
+map_big_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
+{
+   /* User mappings use only regular pages on riscv: see USER_BIG_PAGE_SIZE */
+   return -EOPNOTSUPP;
+}
+
 NODISCARD size_t
 map_pages(pdir_t *pdir,
           void *vaddr,
@@ -613,7 +663,7 @@ map_pages(pdir_t *pdir,
           u32 pg_flags)
 {
    const bool us = !!(pg_flags & PAGING_FL_US);
-   const bool rw = !!(pg_flags & PAGING_FL_RW);
+   bool rw = !!(pg_flags & PAGING_FL_RW);
    const bool big_pages = !!(pg_flags & PAGING_FL_BIG_PAGES_ALLOWED);
    ulong avail_bits = 0;
    ulong hw_pg_flags = 0;
@@ -621,6 +671,17 @@ map_pages(pdir_t *pdir,
    if (pg_flags & PAGING_FL_SHARED)
       avail_bits |= PAGE_SHARED;
 
+   if (pg_flags & PAGING_FL_COW) {
+
+      /* Private mapping of a shared page: copy it on the first write */
+      ASSERT(~pg_flags & PAGING_FL_SHARED);
+
+      if (rw)
+         avail_bits |= PAGE_COW_ORIG_RW;
+
+      rw = false;
+   }
+
    if (pg_flags & PAGING_FL_DO_ALLOC)
       NOT_IMPLEMENTED();
 
@@ -795,6 +856,44 @@ void pdir_destroy(pdir_t *pdir)
    pdir_destroy_int(pdir, BASE_VADDR_PD_IDX, RV_PAGE_LEVEL);
 }
 
+static size_t
+pdir_get_user_rss_int(pdir_t *pdir, u32 pd_idx, u32 level)
+{
+   const ulong zero_paddr = KERNEL_VA_TO_PA(&zero_page);
+   size_t count = 0;
+
+   for (u32 i = 0; i < pd_idx; i++) {
+
+      const page_t *e = &pdir->entries[i];
+
+      if (!e->present)
+         continue;
+
+      if (level == 0) {
+
+         if (((ulong)e->pfn << PAGE_SHIFT) != zero_paddr)
+            count++;
+
+         continue;
+      }
+
+      count += pdir_get_user_rss_int(PA_TO_LIN_VA(e->pfn << PAGE_SHIFT),
+                                     PTRS_PER_PT,
+                                     level - 1);
+   }
+
+   return count;
+}
+
+/*
+ * Returns the number of user pages actually backed by memory: the pages
+ * mapping the zero page are not counted.
+ */
+size_t pdir_get_user_rss(pdir_t *pdir)
+{
+   return pdir_get_user_rss_int(pdir, BASE_VADDR_PD_IDX, RV_PAGE_LEVEL);
+}
+
 pdir_t *
 pdir_deep_clone(pdir_t *pdir)
 {
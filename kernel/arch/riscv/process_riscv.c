@@ -152,10 +152,8 @@ arch_usermode_task_switch(struct task *ti)
 void
 arch_specific_new_proc_setup(struct process *pi, struct process *parent)
 {
-   if (!parent)
-      return;      /* we're done */
-
-   pi->set_child_tid = NULL;
+   /* do nothing */
+   return;
 }
 
 void
@@ -165,10 +163,25 @@ arch_specific_free_proc(struct process *pi)
    return;
 }
 
+int
+arch_specific_set_thread_tls(struct task *ti, ulong tls)
+{
+   /* On RISC-V, the TLS pointer is just the `tp` register */
+   ti->state_regs->tp = tls;
+   return 0;
+}
+
+void
+arch_specific_free_thread_tls(struct task *ti)
+{
+   /* do nothing */
+   return;
+}
+
 static void
 handle_fatal_error(regs_t *r, int signum)
 {
-   send_signal(get_curr_tid(), signum, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal(get_curr_tid(), signum, SIG_FL_FAULT);
 }
 
 /* Access fault handler */
@@ -94,6 +94,18 @@ map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags)
    NOT_IMPLEMENTED();
 }
 
+NODISCARD int
+map_big_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
+{
+   NOT_IMPLEMENTED();
+}
+
+void
+swap_pages(pdir_t *pdir, void *vaddr1, void *vaddr2, size_t page_count)
+{
+   NOT_IMPLEMENTED();
+}
+
 static inline int
 __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 {
@@ -132,6 +144,15 @@ unmap_pages_permissive(pdir_t *pdir,
    NOT_IMPLEMENTED();
 }
 
+int
+pdir_own_page_tables(pdir_t *pdir,
+                     void *vaddrp,
+                     size_t page_count,
+                     bool skip_whole)
+{
+   NOT_IMPLEMENTED();
+}
+
 pdir_t *pdir_clone(pdir_t *pdir)
 {
    NOT_IMPLEMENTED();
@@ -42,6 +42,18 @@ arch_specific_free_proc(struct process *pi)
    NOT_IMPLEMENTED();
 }
 
+int
+arch_specific_set_thread_tls(struct task *ti, ulong tls)
+{
+   NOT_IMPLEMENTED();
+}
+
+void
+arch_specific_free_thread_tls(struct task *ti)
+{
+   NOT_IMPLEMENTED();
+}
+
 void
 kthread_create_init_regs_arch(regs_t *r, void *func)
 {
@@ -694,6 +694,37 @@ void monotonic_time_get_timespec(struct k_timespec64 *tp)
    real_time_get_timespec(tp);
 }
 
+/*
+ * Convert an absolute time on the given clock (CLOCK_REALTIME or
+ * CLOCK_MONOTONIC) to the number of ticks from now. Returns 0 for times in
+ * the past.
+ */
+u64 abs_timespec_to_ticks(clockid_t clk_id, const struct k_timespec64 *tp)
+{
+   struct k_timespec64 now, rel;
+
+   if (clk_id == CLOCK_REALTIME)
+      real_time_get_timespec(&now);
+   else
+      monotonic_time_get_timespec(&now);
+
+   if (tp->tv_sec < now.tv_sec ||
+       (tp->tv_sec == now.tv_sec && tp->tv_nsec <= now.tv_nsec))
+   {
+      return 0; /* already expired */
+   }
+
+   rel.tv_sec = tp->tv_sec - now.tv_sec;
+   rel.tv_nsec = tp->tv_nsec - now.tv_nsec;
+
+   if (rel.tv_nsec < 0) {
+      rel.tv_sec--;
+      rel.tv_nsec += BILLION;
+   }
+
+   return timespec_to_ticks(&rel);
+}
+
 static void
 task_cpu_get_timespec(struct k_timespec64 *tp)
 {
@@ -5,6 +5,7 @@
 
 #include <tilck/common/string_util.h>
 #include <tilck/common/utils.h>
+#include <tilck/common/printk.h>
 
 #include <tilck/kernel/elf_loader.h>
 #include <tilck/kernel/paging.h>
@@ -16,6 +17,7 @@
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/fault_resumable.h>
 #include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/sort.h>
 
 #include <sys/mman.h>      // system header
 
@@ -166,18 +168,123 @@ static inline int check_segment_alignment(Elf_Phdr *phdr)
    return 0;
 }
 
+/*
+ * Copy the file data of a writable segment contained in the page at `va`,
+ * the one where the file data ends and .bss begins. The rest of the page
+ * must be zero, therefore it cannot be mapped from the file.
+ */
+static int
+load_rw_segment_tail_page(fs_handle *elf_h,
+                          pdir_t *pdir,
+                          Elf_Phdr *phdr,
+                          ulong va)
+{
+   const ulong data_va = MAX(va, (ulong)phdr->p_vaddr);
+   const ulong data_end = phdr->p_vaddr + phdr->p_filesz;
+   const offt off = (offt)(phdr->p_offset + (data_va - phdr->p_vaddr));
+   const size_t len = data_end - data_va;
+   offt rc;
+   char *p;
+
+   if (!(p = kzmalloc(PAGE_SIZE)))
+      return -ENOMEM;
+
+   if ((rc = map_page(pdir, (void *)va, LIN_VA_TO_PA(p), PAGING_FL_RWUS))) {
+      kfree2(p, PAGE_SIZE);
+      return (int)rc;
+   }
+
+   if ((rc = vfs_seek(elf_h, off, SEEK_SET)) != off)
+      return rc < 0 ? (int)rc : -ENOEXEC;
+
+   if ((rc = vfs_read(elf_h, p + (data_va - va), len)) != (offt)len)
+      return rc < 0 ? (int)rc : -ENOEXEC;
+
+   return 0;
+}
+
+/*
+ * Writable segments are mapped privately: their pages are shared with the
+ * file until the first write, which makes a private copy of the page. The
+ * .bss pages (and the holes in the file, if any) get the zero page, while
+ * the page where the file data ends, if followed by .bss, is copied.
+ */
+static int
+load_rw_segment_by_mmap(fs_handle *elf_h,
+                        pdir_t *pdir,
+                        Elf_Phdr *phdr,
+                        ulong *end_vaddr_ref)
+{
+   const ulong va_begin = phdr->p_vaddr & PAGE_MASK;
+   const ulong va_end = round_up_at(phdr->p_vaddr + phdr->p_memsz, PAGE_SIZE);
+   const ulong file_end = phdr->p_vaddr + phdr->p_filesz;
+   const ulong file_pg_end = round_up_at(file_end, PAGE_SIZE);
+   struct user_mapping um = {0};
+   ulong mmap_end = file_pg_end;
+   int rc;
+
+   for (ulong va = va_begin; va < va_end; va += PAGE_SIZE) {
+
+      /*
+       * A page shared with the previous segment: very unusual. Just use the
+       * simple approach, which copies the data in the pages already mapped.
+       */
+      if (is_mapped(pdir, (void *)va))
+         return load_segment_by_copy(elf_h, pdir, phdr, end_vaddr_ref);
+   }
+
+   if (phdr->p_memsz > phdr->p_filesz)
+      mmap_end = file_end & PAGE_MASK;
+
+   *end_vaddr_ref = va_end;
+
+   if (mmap_end > va_begin) {
+
+      um.h = elf_h;
+      um.off = phdr->p_offset & PAGE_MASK;
+      um.vaddr = va_begin;
+      um.len = mmap_end - va_begin;
+      um.prot = PROT_READ | PROT_WRITE;
+      um.flags = MAP_PRIVATE;
+
+      if ((rc = vfs_mmap(&um, pdir, VFS_MM_DONT_REGISTER)))
+         return rc;
+   }
+
+   if (mmap_end < file_pg_end) {
+      if ((rc = load_rw_segment_tail_page(elf_h, pdir, phdr, mmap_end)))
+         return rc;
+   }
+
+   for (ulong va = va_begin; va < va_end; va += PAGE_SIZE) {
+
+      if (is_mapped(pdir, (void *)va))
+         continue;
+
+      if ((rc = map_zero_page(pdir, (void *)va, PAGING_FL_RWUS)))
+         return rc;
+   }
+
+   return 0;
+}
+
 static int
 load_segment_by_mmap(fs_handle *elf_h,
                      pdir_t *pdir,
                      Elf_Phdr *phdr,
                      ulong *end_vaddr_ref)
 {
-   if (phdr->p_flags & PF_W)
-      return load_segment_by_copy(elf_h, pdir, phdr, end_vaddr_ref);
-
    if (UNLIKELY(phdr->p_memsz == 0))
       return 0; /* very weird (because the phdr has type LOAD) */
 
+   if (phdr->p_flags & PF_W) {
+
+      if (MMAP_NO_COW)
+         return load_segment_by_copy(elf_h, pdir, phdr, end_vaddr_ref);
+
+      return load_rw_segment_by_mmap(elf_h, pdir, phdr, end_vaddr_ref);
+   }
+
    /*
     * Logic behind the calculation of `um.len`.
     *
@@ -514,21 +621,231 @@ void get_symtab_and_strtab(Elf_Shdr **symtab, Elf_Shdr **strtab)
    VERIFY(*strtab != NULL);
 }
 
+/*
+ * Symbol index
+ * --------------
+ *
+ * Built once at boot by init_kernel_symbols_index(), it allows both the
+ * address -> symbol and the name -> address lookups to avoid scanning the
+ * whole .symtab every time. The address index is an array of all the symbols
+ * having a size, sorted by address: each entry also stores the max end address
+ * of all the symbols up to it, so that a lookup can do a binary search and
+ * then walk back just while some previous symbol might still contain the
+ * address. The name index is a chained hash table of symbol indexes. Before
+ * the index is built (or if we ran out of memory building it), the lookups
+ * fall back to the linear scan.
+ */
+
+struct ksym_addr_entry {
+
+   ulong start;
+   ulong max_end;       /* max(start + size) for this entry and all before */
+   Elf_Sym *sym;
+};
+
+static struct ksym_addr_entry *ksyms_by_addr;
+static u32 ksyms_by_addr_count;
+
+static u32 *ksyms_name_buckets;      /* symbol index + 1, 0 if empty */
+static u32 *ksyms_name_next;         /* next symbol index + 1 in the chain */
+static u32 ksyms_name_buckets_count;
+
+static Elf_Sym *ksyms;
+static const char *ksyms_strtab;
+
+static u32 ksym_name_hash(const char *name)
+{
+   u32 h = 2166136261u;      /* FNV-1a */
+
+   for (; *name; name++)
+      h = (h ^ (u8)*name) * 16777619u;
+
+   return h;
+}
+
+static long ksym_addr_entry_cmp(const void *a, const void *b)
+{
+   const struct ksym_addr_entry *e1 = a;
+   const struct ksym_addr_entry *e2 = b;
+
+   if (e1->start != e2->start)
+      return e1->start < e2->start ? -1 : 1;
+
+   /*
+    * Aliases: sort them in reverse .symtab order, so that the backwards walk
+    * in ksyms_lookup_addr() finds first the same symbol as the linear scan.
+    */
+   if (e1->sym != e2->sym)
+      return e1->sym > e2->sym ? -1 : 1;
+
+   return 0;
+}
+
+static bool init_ksyms_by_addr(u32 sym_count)
+{
+   ulong max_end = 0;
+   u32 n = 0;
+
+   for (u32 i = 0; i < sym_count; i++)
+      if (ksyms[i].st_size)
+         n++;
+
+   if (!n)
+      return false;
+
+   if (!(ksyms_by_addr = kalloc_array_obj(struct ksym_addr_entry, n)))
+      return false;
+
+   for (u32 i = 0, j = 0; i < sym_count; i++) {
+
+      if (ksyms[i].st_size) {
+         ksyms_by_addr[j].start = ksyms[i].st_value;
+         ksyms_by_addr[j].sym = &ksyms[i];
+         j++;
+      }
+   }
+
+   heap_sort_generic(ksyms_by_addr,
+                     sizeof(ksyms_by_addr[0]),
+                     n,
+                     &ksym_addr_entry_cmp);
+
+   for (u32 i = 0; i < n; i++) {
+      struct ksym_addr_entry *e = &ksyms_by_addr[i];
+      max_end = MAX(max_end, e->start + e->sym->st_size);
+      e->max_end = max_end;
+   }
+
+   ksyms_by_addr_count = n;
+   return true;
+}
+
+static bool init_ksyms_name_index(u32 sym_count)
+{
+   const u32 buckets_count = roundup_next_power_of_2(MAX(sym_count, 2u));
+   u32 *buckets, *next, h;
+
+   if (!(buckets = kzalloc_array_obj(u32, buckets_count)))
+      return false;
+
+   if (!(next = kzalloc_array_obj(u32, sym_count))) {
+      kfree_array_obj(buckets, u32, buckets_count);
+      return false;
+   }
+
+   /* Insert in reverse order: the first symbol with a given name wins */
+   for (u32 i = sym_count; i > 0; i--) {
+
+      const char *name = ksyms_strtab + ksyms[i - 1].st_name;
+
+      if (!*name)
+         continue;
+
+      h = ksym_name_hash(name) & (buckets_count - 1);
+      next[i - 1] = buckets[h];
+      buckets[h] = i;
+   }
+
+   ksyms_name_next = next;
+   ksyms_name_buckets = buckets;
+   ksyms_name_buckets_count = buckets_count;
+   return true;
+}
+
+void init_kernel_symbols_index(void)
+{
+   Elf_Shdr *symtab;
+   Elf_Shdr *strtab;
+   u32 sym_count;
+
+   if (!KERNEL_SYMBOLS)
+      return;
+
+   get_symtab_and_strtab(&symtab, &strtab);
+   sym_count = (u32)(symtab->sh_size / sizeof(Elf_Sym));
+
+   ksyms = (Elf_Sym *) symtab->sh_addr;
+   ksyms_strtab = (const char *) strtab->sh_addr;
+
+   if (!init_ksyms_by_addr(sym_count))
+      printk("WARNING: unable to build the symbols address index\n");
+
+   if (!init_ksyms_name_index(sym_count))
+      printk("WARNING: unable to build the symbols name index\n");
+}
+
+static Elf_Sym *ksyms_lookup_addr(ulong vaddr)
+{
+   u32 lo = 0, hi = ksyms_by_addr_count, mid;
+   struct ksym_addr_entry *e;
+
+   /* Find the number of entries having start <= vaddr */
+   while (lo < hi) {
+
+      mid = lo + (hi - lo) / 2;
+
+      if (ksyms_by_addr[mid].start <= vaddr)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   for (u32 i = lo; i > 0; i--) {
+
+      e = &ksyms_by_addr[i - 1];
+
+      if (e->max_end <= vaddr)
+         break; /* no symbol up to this one can contain `vaddr` */
+
+      if (vaddr < e->start + e->sym->st_size)
+         return e->sym;
+   }
+
+   return NULL;
+}
+
+static Elf_Sym *ksyms_lookup_name(const char *name)
+{
+   const u32 h = ksym_name_hash(name) & (ksyms_name_buckets_count - 1);
+
+   for (u32 i = ksyms_name_buckets[h]; i; i = ksyms_name_next[i - 1]) {
+      if (!strcmp(ksyms_strtab + ksyms[i - 1].st_name, name))
+         return &ksyms[i - 1];
+   }
+
+   return NULL;
+}
+
 const char *find_sym_at_addr(ulong vaddr, long *offset, u32 *sym_size)
 {
    Elf_Shdr *symtab;
    Elf_Shdr *strtab;
+   Elf_Sym *s = NULL;
 
    if (!KERNEL_SYMBOLS)
       return NULL;
 
+   if (ksyms_by_addr) {
+
+      if (!(s = ksyms_lookup_addr(vaddr)))
+         return NULL;
+
+      if (offset)
+         *offset = (long)(vaddr - s->st_value);
+
+      if (sym_size)
+         *sym_size = (u32) s->st_size;
+
+      return ksyms_strtab + s->st_name;
+   }
+
    get_symtab_and_strtab(&symtab, &strtab);
 
    Elf_Sym *syms = (Elf_Sym *) symtab->sh_addr;
    const ulong sym_count = symtab->sh_size / sizeof(Elf_Sym);
 
    for (ulong i = 0; i < sym_count; i++) {
-      Elf_Sym *s = syms + i;
+      s = syms + i;
 
       if (IN_RANGE(vaddr, s->st_value, s->st_value + s->st_size)) {
 
@@ -549,10 +866,16 @@ ulong find_addr_of_symbol(const char *searched_sym)
 {
    Elf_Shdr *symtab;
    Elf_Shdr *strtab;
+   Elf_Sym *s;
 
    if (!KERNEL_SYMBOLS)
       return 0;
 
+   if (ksyms_name_buckets) {
+      s = ksyms_lookup_name(searched_sym);
+      return s ? s->st_value : 0;
+   }
+
    get_symtab_and_strtab(&symtab, &strtab);
 
    Elf_Sym *syms = (Elf_Sym *) symtab->sh_addr;
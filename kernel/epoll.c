@@ -0,0 +1,629 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_userlim.h>
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/bintree.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/epoll.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+
+/*
+ * epoll
+ * ---------
+ *
+ * Unlike poll() and select(), which have to register a waiter on the kcond of
+ * every fd at each call and then check all of them after waking up, an epoll
+ * instance keeps a persistent interest list: each item in it has a watcher
+ * (see struct kcond_watcher) on the kconds of its handle, which are set once,
+ * in epoll_ctl(). When any of those kconds is signaled, the watcher callback
+ * appends the item to the instance's ready list and wakes up the waiters.
+ * Therefore, epoll_wait() looks only at the items in the ready list: its cost
+ * is O(ready), not O(watched).
+ *
+ * Like the kconds of the handles, the ready list is a "hint": being signaled
+ * doesn't mean being ready. Each item in the ready list is checked with the
+ * vfs_*_ready() functions before being reported and dropped if not ready.
+ * Level-triggered items are re-appended to the ready list after having been
+ * reported, so that the next epoll_wait() will check them again; edge-triggered
+ * ones (EPOLLET) are not, so they won't be reported again until the next
+ * signal on their kconds.
+ *
+ * Locking: `lock` protects the interest list, while the ready list (and the
+ * `queued` field of the items) is protected by disabling the preemption, since
+ * it's modified by the watcher callbacks, which run in the context of whoever
+ * signals the kconds. The global `epoll_list_lock` protects the list of all
+ * the epoll instances and must be acquired before any epoll's `lock`.
+ *
+ * Items are keyed by handle, not by fd: when a watched handle is closed, it's
+ * automatically removed from the interest lists watching it. Because dup-ed
+ * fds in Tilck have their own handle, the item is removed when the fd passed
+ * to epoll_ctl() is closed, even if other fds refer to the same file.
+ */
+
+#define EPOLL_MAX_WATCHERS             3
+#define EPOLL_SUPPORTED_EVENTS         (EPOLLIN | EPOLLOUT | EPOLLRDNORM |   \
+                                        EPOLLWRNORM | EPOLLPRI | EPOLLERR |  \
+                                        EPOLLHUP | EPOLLET | EPOLLONESHOT)
+
+struct epoll {
+
+   KOBJ_BASE_FIELDS
+
+   struct kmutex lock;
+   struct epoll_item *items_tree;      /* interest list, keyed by handle */
+   struct list ready_list;
+   u32 ready_count;
+   struct kcond wait_cond;             /* signaled when an item gets ready */
+   struct list_node node;              /* node in `epoll_list` */
+};
+
+struct epoll_item {
+
+   struct bintree_node node;           /* node in epoll->items_tree */
+   struct list_node ready_node;        /* node in epoll->ready_list */
+   struct epoll *ep;
+   fs_handle h;
+   u32 events;
+   u64 data;
+   bool queued;                        /* true if in epoll->ready_list */
+   bool disabled;                      /* EPOLLONESHOT item already reported */
+   u8 watchers_count;
+   struct kcond_watcher watchers[EPOLL_MAX_WATCHERS];
+};
+
+static struct kmutex epoll_list_lock = STATIC_KMUTEX_INIT(epoll_list_lock, 0);
+static struct list epoll_list = STATIC_LIST_INIT(epoll_list);
+
+/* Must be called with the preemption disabled */
+static void epoll_queue_item(struct epoll_item *it)
+{
+   struct epoll *ep = it->ep;
+   ASSERT(!is_preemption_enabled());
+
+   if (it->queued || it->disabled)
+      return;
+
+   it->queued = true;
+   ep->ready_count++;
+   list_add_tail(&ep->ready_list, &it->ready_node);
+   kcond_signal_all(&ep->wait_cond);
+}
+
+/* Must be called with the preemption disabled */
+static void epoll_dequeue_item(struct epoll_item *it)
+{
+   ASSERT(!is_preemption_enabled());
+
+   if (!it->queued)
+      return;
+
+   it->queued = false;
+   it->ep->ready_count--;
+   list_remove(&it->ready_node);
+}
+
+static void epoll_watcher_cb(struct kcond_watcher *w)
+{
+   epoll_queue_item(w->arg);
+}
+
+static void
+epoll_item_watch_cond(struct epoll_item *it, struct kcond *c)
+{
+   if (!c)
+      return;
+
+   ASSERT(it->watchers_count < EPOLL_MAX_WATCHERS);
+   kcond_watch(c, &it->watchers[it->watchers_count++], &epoll_watcher_cb, it);
+}
+
+static void epoll_item_watch(struct epoll_item *it)
+{
+   ASSERT(it->watchers_count == 0);
+
+   if (it->events & (EPOLLIN | EPOLLRDNORM | EPOLLPRI))
+      epoll_item_watch_cond(it, vfs_get_rready_cond(it->h));
+
+   if (it->events & (EPOLLOUT | EPOLLWRNORM))
+      epoll_item_watch_cond(it, vfs_get_wready_cond(it->h));
+
+   /* Like poll(), epoll always listens for exception events */
+   epoll_item_watch_cond(it, vfs_get_except_cond(it->h));
+}
+
+static void epoll_item_unwatch(struct epoll_item *it)
+{
+   for (u32 i = 0; i < it->watchers_count; i++)
+      kcond_unwatch(&it->watchers[i]);
+
+   it->watchers_count = 0;
+}
+
+static void epoll_remove_item(struct epoll *ep, struct epoll_item *it)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&ep->lock));
+
+   epoll_item_unwatch(it);
+
+   disable_preemption();
+   {
+      epoll_dequeue_item(it);
+   }
+   enable_preemption();
+
+   bintree_remove_ptr(&ep->items_tree, it, struct epoll_item, node, h);
+   kfree_obj(it, struct epoll_item);
+}
+
+static u32 epoll_item_revents(struct epoll_item *it)
+{
+   u32 revents = 0;
+   int rc;
+
+   if (it->events & (EPOLLIN | EPOLLRDNORM | EPOLLPRI))
+      if (vfs_read_ready(it->h))
+         revents |= it->events & (EPOLLIN | EPOLLRDNORM);
+
+   if (it->events & (EPOLLOUT | EPOLLWRNORM))
+      if (vfs_write_ready(it->h))
+         revents |= it->events & (EPOLLOUT | EPOLLWRNORM);
+
+   if ((rc = vfs_except_ready(it->h)))
+      revents |= rc > 0 ? (u32)rc : EPOLLERR;
+
+   return revents;
+}
+
+/*
+ * Check the items in the ready list and fill `evs` with the ones actually
+ * ready. Only the items queued at the moment of the call are checked: the
+ * level-triggered items re-appended here are left for the next call.
+ */
+static int
+epoll_collect_events(struct epoll *ep, struct epoll_event *evs, int maxevents)
+{
+   struct epoll_item *it;
+   u32 revents, n;
+   int cnt = 0;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&ep->lock));
+
+   disable_preemption();
+   {
+      n = ep->ready_count;
+   }
+   enable_preemption();
+
+   for (; n > 0 && cnt < maxevents; n--) {
+
+      disable_preemption();
+      {
+         it = list_first_obj(&ep->ready_list, struct epoll_item, ready_node);
+         epoll_dequeue_item(it);
+      }
+      enable_preemption();
+
+      if (it->disabled || !(revents = epoll_item_revents(it)))
+         continue; /* spurious wake-up or not ready anymore: drop the item */
+
+      evs[cnt++] = (struct epoll_event) {
+         .events = revents,
+         .data.u64 = it->data,
+      };
+
+      if (it->events & EPOLLONESHOT) {
+         it->disabled = true;
+         continue;
+      }
+
+      if (!(it->events & EPOLLET)) {
+
+         /* Level-triggered: check it again at the next epoll_wait() */
+         disable_preemption();
+         {
+            epoll_queue_item(it);
+         }
+         enable_preemption();
+      }
+   }
+
+   return cnt;
+}
+
+static int
+epoll_wait_int(struct epoll *ep,
+               struct epoll_event *evs,
+               int maxevents,
+               int timeout)
+{
+   struct task *curr = get_curr_task();
+   u64 deadline = 0, now = 0;
+   int cnt;
+
+   if (timeout > 0)
+      deadline = get_ticks() + MAX((u32)timeout / (1000 / TIMER_HZ), 1u);
+
+   while (true) {
+
+      kmutex_lock(&ep->lock);
+      {
+         cnt = epoll_collect_events(ep, evs, maxevents);
+      }
+      kmutex_unlock(&ep->lock);
+
+      if (cnt > 0 || !timeout)
+         break;
+
+      if (timeout > 0 && (now = get_ticks()) >= deadline)
+         break;
+
+      disable_preemption();
+
+      /*
+       * Check the ready list again, with the preemption disabled: an item
+       * might have been queued after we released the lock. Without this
+       * check, we could go to sleep while an item is ready.
+       */
+      if (ep->ready_count > 0) {
+         enable_preemption();
+         continue;
+      }
+
+      prepare_to_wait_on(WOBJ_KCOND,
+                         &ep->wait_cond,
+                         NO_EXTRA,
+                         &ep->wait_cond.wait_list);
+
+      /*
+       * Set the timer at every iteration, as kcond_signal_int() cancels it
+       * when it wakes us up, even when no item turns out to be ready.
+       */
+      if (timeout > 0)
+         task_set_wakeup_timer(curr, (u32)(deadline - now));
+
+      enter_sleep_wait_state();
+
+      /*
+       * In case we woke up because of the timeout or a signal, the wobj has
+       * not been reset by kcond_signal_int(): reset it here.
+       */
+      wait_obj_reset(&curr->wobj);
+
+      if (timeout > 0)
+         task_cancel_wakeup_timer(curr);
+
+      if (pending_signals())
+         return -EINTR;
+   }
+
+   return cnt;
+}
+
+static void destroy_epoll(struct epoll *ep)
+{
+   kmutex_lock(&epoll_list_lock);
+   {
+      list_remove(&ep->node);
+   }
+   kmutex_unlock(&epoll_list_lock);
+
+   kmutex_lock(&ep->lock);
+   {
+      while (ep->items_tree)
+         epoll_remove_item(ep, ep->items_tree);
+   }
+   kmutex_unlock(&ep->lock);
+
+   kcond_destory(&ep->wait_cond);
+   kmutex_destroy(&ep->lock);
+   kfree_obj(ep, struct epoll);
+}
+
+static struct epoll *create_epoll(void)
+{
+   struct epoll *ep;
+
+   if (!(ep = kzalloc_obj(struct epoll)))
+      return NULL;
+
+   ep->destory_obj = (void *)&destroy_epoll;
+   kmutex_init(&ep->lock, 0);
+   list_init(&ep->ready_list);
+   kcond_init(&ep->wait_cond);
+
+   kmutex_lock(&epoll_list_lock);
+   {
+      list_add_tail(&epoll_list, &ep->node);
+   }
+   kmutex_unlock(&epoll_list_lock);
+   return ep;
+}
+
+void epoll_on_handle_close(fs_handle h)
+{
+   struct epoll *ep;
+   struct epoll_item *it;
+
+   kmutex_lock(&epoll_list_lock);
+
+   list_for_each_ro(ep, &epoll_list, node) {
+
+      kmutex_lock(&ep->lock);
+      {
+         it = bintree_find_ptr(ep->items_tree, h, struct epoll_item, node, h);
+
+         if (it)
+            epoll_remove_item(ep, it);
+      }
+      kmutex_unlock(&ep->lock);
+   }
+
+   kmutex_unlock(&epoll_list_lock);
+}
+
+static int epoll_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct epoll *ep = (void *)kh->kobj;
+   return ep->ready_count > 0;
+}
+
+static struct kcond *epoll_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct epoll *ep = (void *)kh->kobj;
+   return &ep->wait_cond;
+}
+
+static const struct file_ops static_ops_epoll =
+{
+   .read_ready = epoll_read_ready,
+   .get_rready_cond = epoll_get_rready_cond,
+};
+
+static struct epoll *get_epoll(int epfd)
+{
+   struct kfs_handle *kh = get_fs_handle(epfd);
+
+   if (!kh || kh->fops != &static_ops_epoll)
+      return NULL;
+
+   return (void *)kh->kobj;
+}
+
+int sys_epoll_create1(int flags)
+{
+   struct epoll *ep;
+   struct kfs_handle *h;
+   int fd;
+
+   if (flags & ~EPOLL_CLOEXEC)
+      return -EINVAL;
+
+   if (!(ep = create_epoll()))
+      return -ENOMEM;
+
+   if (!(h = kfs_create_new_handle(&static_ops_epoll, (void *)ep, O_RDONLY))) {
+      destroy_epoll(ep);
+      return -ENOMEM;
+   }
+
+   if ((fd = install_fs_handle(h, !!(flags & EPOLL_CLOEXEC))) < 0) {
+      kfs_destroy_handle(h);
+      destroy_epoll(ep);
+   }
+
+   return fd;
+}
+
+int sys_epoll_create(int size)
+{
+   if (size <= 0)
+      return -EINVAL;
+
+   return sys_epoll_create1(0);
+}
+
+static int
+epoll_ctl_add(struct epoll *ep, fs_handle h, struct epoll_event *ev)
+{
+   struct fs_handle_base *hb = h;
+   struct epoll_item *it;
+
+   if (bintree_find_ptr(ep->items_tree, h, struct epoll_item, node, h))
+      return -EEXIST;
+
+   if (hb->fops == &static_ops_epoll)
+      return -EINVAL; /* nested epoll instances are not supported */
+
+   if (!vfs_get_rready_cond(h) &&
+       !vfs_get_wready_cond(h) &&
+       !vfs_get_except_cond(h))
+   {
+      return -EPERM; /* the file does not support waiting, like with poll() */
+   }
+
+   if (!(it = kzalloc_obj(struct epoll_item)))
+      return -ENOMEM;
+
+   bintree_node_init(&it->node);
+   list_node_init(&it->ready_node);
+   it->ep = ep;
+   it->h = h;
+   it->events = ev->events;
+   it->data = ev->data.u64;
+
+   bintree_insert_ptr(&ep->items_tree, it, struct epoll_item, node, h);
+   hb->spec_flags |= VFS_SPFL_EPOLL_WATCHED;
+   epoll_item_watch(it);
+
+   /* The handle might be ready already: let epoll_wait() check it */
+   disable_preemption();
+   {
+      epoll_queue_item(it);
+   }
+   enable_preemption();
+   return 0;
+}
+
+static int
+epoll_ctl_mod(struct epoll *ep, struct epoll_item *it, struct epoll_event *ev)
+{
+   epoll_item_unwatch(it);
+
+   disable_preemption();
+   {
+      epoll_dequeue_item(it);
+   }
+   enable_preemption();
+
+   it->events = ev->events;
+   it->data = ev->data.u64;
+   it->disabled = false;
+   epoll_item_watch(it);
+
+   disable_preemption();
+   {
+      epoll_queue_item(it);
+   }
+   enable_preemption();
+   return 0;
+}
+
+int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *u_ev)
+{
+   struct process *pi = get_curr_proc();
+   struct epoll_event ev = {0};
+   struct epoll_item *it;
+   struct epoll *ep;
+   fs_handle h;
+   int rc = 0;
+
+   if (op != EPOLL_CTL_DEL) {
+
+      if (copy_from_user(&ev, u_ev, sizeof(ev)))
+         return -EFAULT;
+
+      if (ev.events & ~(u32)EPOLL_SUPPORTED_EVENTS)
+         return -EINVAL;
+   }
+
+   kmutex_lock(&pi->fslock);
+
+   if (!(h = get_fs_handle(epfd)) || !(h = get_fs_handle(fd))) {
+      rc = -EBADF;
+      goto out;
+   }
+
+   if (!(ep = get_epoll(epfd)) || epfd == fd) {
+      rc = -EINVAL;
+      goto out;
+   }
+
+   kmutex_lock(&ep->lock);
+   {
+      it = bintree_find_ptr(ep->items_tree, h, struct epoll_item, node, h);
+
+      switch (op) {
+
+         case EPOLL_CTL_ADD:
+            rc = epoll_ctl_add(ep, h, &ev);
+            break;
+
+         case EPOLL_CTL_MOD:
+            rc = it ? epoll_ctl_mod(ep, it, &ev) : -ENOENT;
+            break;
+
+         case EPOLL_CTL_DEL:
+
+            if (it)
+               epoll_remove_item(ep, it);
+            else
+               rc = -ENOENT;
+
+            break;
+
+         default:
+            rc = -EINVAL;
+      }
+   }
+   kmutex_unlock(&ep->lock);
+
+out:
+   kmutex_unlock(&pi->fslock);
+   return rc;
+}
+
+int sys_epoll_wait(int epfd, struct epoll_event *u_evs, int maxev, int timeout)
+{
+   struct task *curr = get_curr_task();
+   struct epoll_event *evs = curr->args_copybuf;
+   struct epoll *ep;
+   int rc;
+
+   if (maxev <= 0)
+      return -EINVAL;
+
+   /* Events beyond the staging buffer will be returned by the next calls */
+   maxev = MIN(maxev, (int)(ARGS_COPYBUF_SIZE / sizeof(struct epoll_event)));
+
+   /*
+    * Keep the epoll object alive while we're sleeping, even if `epfd` gets
+    * closed in the meanwhile.
+    */
+   kmutex_lock(&curr->pi->fslock);
+   {
+      if ((ep = get_epoll(epfd)))
+         retain_obj(ep);
+      else
+         rc = get_fs_handle(epfd) ? -EINVAL : -EBADF;
+   }
+   kmutex_unlock(&curr->pi->fslock);
+
+   if (!ep)
+      return rc;
+
+   rc = epoll_wait_int(ep, evs, maxev, timeout);
+
+   if (release_obj(ep) == 0)
+      destroy_epoll(ep);
+
+   if (rc > 0) {
+      if (copy_to_user(u_evs, evs, sizeof(struct epoll_event) * (u32)rc))
+         return -EFAULT;
+   }
+
+   return rc;
+}
+
+int sys_epoll_pwait(int epfd, struct epoll_event *u_evs, int maxev,
+                    int timeout, const sigset_t *sigmask, size_t sigsetsize)
+{
+   // TODO: Add full support for epoll_pwait()
+
+   ulong mask[K_SIGACTION_MASK_WORDS];
+
+   if (sigmask) {
+
+      if (copy_from_user(mask, sigmask, sizeof(mask)))
+         return -EFAULT;
+
+      for (int i = 0; i < K_SIGACTION_MASK_WORDS; i++) {
+
+         if (mask[i]) {
+            /* We don't support signal masks here yet. */
+            return -ENOSYS;
+         }
+      }
+   }
+
+   return sys_epoll_wait(epfd, u_evs, maxev, timeout);
+}
@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+
+/*
+ * eventfd: a 64-bit counter behind a file descriptor. Writes add to it and
+ * reads return it and reset it to 0 (or, with EFD_SEMAPHORE, return 1 and
+ * decrement it by 1). Compared to a pipe used just for wake-ups, there's no
+ * buffer and no data to copy: the whole state is the counter.
+ */
+
+#define EVENTFD_MAX_COUNT        (~0ull - 1)
+
+struct eventfd {
+
+   KOBJ_BASE_FIELDS
+
+   struct kmutex mutex;
+   u64 count;
+   bool semaphore;
+   struct kcond rready_cond;           /* signaled when `count` grows */
+   struct kcond wready_cond;           /* signaled when `count` shrinks */
+};
+
+static ssize_t eventfd_do_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   ssize_t rc = sizeof(u64);
+   u64 val;
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   kmutex_lock(&e->mutex);
+
+   while (!e->count) {
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         rc = -EAGAIN;
+         goto out;
+      }
+
+      kcond_wait(&e->rready_cond, &e->mutex, KCOND_WAIT_FOREVER);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         goto out;
+      }
+   }
+
+   val = e->semaphore ? 1 : e->count;
+   e->count -= val;
+   memcpy(buf, &val, sizeof(val));
+
+   kcond_signal_all(&e->wready_cond);
+
+   if (e->count) {
+      /* Semaphore mode: there's still something for another reader */
+      kcond_signal_one(&e->rready_cond);
+   }
+
+out:
+   kmutex_unlock(&e->mutex);
+   return rc;
+}
+
+static ssize_t eventfd_do_write(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   ssize_t rc = sizeof(u64);
+   u64 val;
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   memcpy(&val, buf, sizeof(val));
+
+   if (val > EVENTFD_MAX_COUNT)
+      return -EINVAL;
+
+   kmutex_lock(&e->mutex);
+
+   while (EVENTFD_MAX_COUNT - e->count < val) {
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         rc = -EAGAIN;
+         goto out;
+      }
+
+      kcond_wait(&e->wready_cond, &e->mutex, KCOND_WAIT_FOREVER);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         goto out;
+      }
+   }
+
+   if (val) {
+      e->count += val;
+      kcond_signal_all(&e->rready_cond);
+   }
+
+out:
+   kmutex_unlock(&e->mutex);
+   return rc;
+}
+
+static int eventfd_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   bool ret;
+
+   kmutex_lock(&e->mutex);
+   {
+      ret = e->count > 0;
+   }
+   kmutex_unlock(&e->mutex);
+   return ret;
+}
+
+static int eventfd_write_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   bool ret;
+
+   kmutex_lock(&e->mutex);
+   {
+      ret = e->count < EVENTFD_MAX_COUNT;
+   }
+   kmutex_unlock(&e->mutex);
+   return ret;
+}
+
+static struct kcond *eventfd_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   return &e->rready_cond;
+}
+
+static struct kcond *eventfd_get_wready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   return &e->wready_cond;
+}
+
+static const struct file_ops static_ops_eventfd =
+{
+   .read = eventfd_do_read,
+   .write = eventfd_do_write,
+   .read_ready = eventfd_read_ready,
+   .write_ready = eventfd_write_ready,
+   .get_rready_cond = eventfd_get_rready_cond,
+   .get_wready_cond = eventfd_get_wready_cond,
+};
+
+static void destroy_eventfd(struct eventfd *e)
+{
+   kcond_destory(&e->wready_cond);
+   kcond_destory(&e->rready_cond);
+   kmutex_destroy(&e->mutex);
+   kfree_obj(e, struct eventfd);
+}
+
+static struct eventfd *create_eventfd(u64 initval, bool semaphore)
+{
+   struct eventfd *e;
+
+   if (!(e = kzalloc_obj(struct eventfd)))
+      return NULL;
+
+   e->destory_obj = (void *)&destroy_eventfd;
+   e->count = initval;
+   e->semaphore = semaphore;
+   kmutex_init(&e->mutex, 0);
+   kcond_init(&e->rready_cond);
+   kcond_init(&e->wready_cond);
+   return e;
+}
+
+int sys_eventfd2(unsigned int initval, int flags)
+{
+   struct kfs_handle *h;
+   struct eventfd *e;
+   int fd;
+
+   if (flags & ~(EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE))
+      return -EINVAL;
+
+   if (!(e = create_eventfd(initval, !!(flags & EFD_SEMAPHORE))))
+      return -ENOMEM;
+
+   h = kfs_create_new_handle(&static_ops_eventfd,
+                             (void *)e,
+                             O_RDWR | (flags & EFD_NONBLOCK));
+
+   if (!h) {
+      destroy_eventfd(e);
+      return -ENOMEM;
+   }
+
+   if ((fd = install_fs_handle(h, !!(flags & EFD_CLOEXEC))) < 0) {
+      kfs_destroy_handle(h);
+      destroy_eventfd(e);
+   }
+
+   return fd;
+}
+
+int sys_eventfd(unsigned int initval)
+{
+   return sys_eventfd2(initval, 0);
+}
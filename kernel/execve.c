@@ -406,12 +406,28 @@ int sys_execve(const char *user_filename,
    struct task *curr = get_curr_task();
    ASSERT(curr != NULL);
 
+   /*
+    * Tilck does not support by design execve() called by threads other than
+    * the main one: the calling thread would have to take over the tid and the
+    * struct task of the main thread, which is embedded in struct process.
+    * In that case, we fail with -EINVAL, as documented in docs/syscalls.md.
+    */
+   if (!is_main_thread(curr))
+      return -EINVAL;
+
    if ((rc = execve_get_path(user_filename, &path)))
       return rc;
 
    if ((rc = execve_get_args(user_argv, user_env, &argv, &env)))
       return rc;
 
+   /*
+    * NOTE: unlike Linux, we terminate the other threads before loading the
+    * new program, therefore they won't survive a failed execve().
+    */
+   kill_other_threads();
+   curr->pi->group_exit = false;
+
    return do_execve(curr,
                     path,
                     (const char *const *)argv,
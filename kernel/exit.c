@@ -13,9 +13,13 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/futex.h>
+#include <tilck/kernel/user.h>
 
 #include <tilck/mods/tracing.h>
 
+#include <linux/futex.h> // system header
+
 static void
 task_free_all_kernel_allocs(struct task *ti)
 {
@@ -100,14 +104,13 @@ static void
 close_all_handles(void)
 {
    struct process *pi = get_curr_proc();
+   int fd;
    ASSERT(is_preemption_enabled());
 
-   for (int i = 0; i < MAX_HANDLES; i++) {
-      if (pi->handles[i]) {
-         vfs_close(pi->handles[i]);
-         pi->handles[i] = NULL;
-      }
-   }
+   fd_table_for_each_open(&pi->fdt, fd)
+      vfs_close(fd_table_remove(&pi->fdt, fd));
+
+   fd_table_destroy(&pi->fdt);
 }
 
 struct on_task_exit_cb {
@@ -199,11 +202,125 @@ switch_stack_and_reschedule(void)
 
 
 /*
- * NOTE: this code ASSUMES that user processes have a _single_ thread:
- *
- *    process = task = thread
+ * Detach the dying task `ti` from anything it might have been waiting on and
+ * prevent new signals from being enqueued.
+ */
+static void
+detach_dying_task(struct task *ti)
+{
+   ASSERT(!is_preemption_enabled());
+
+   if (ti->wobj.type != WOBJ_NONE) {
+
+      /*
+       * If the task has been waiting on something, we have to reset its wobj
+       * and remove its pointer from the target object's wait_list.
+       */
+
+      wait_obj_reset(&ti->wobj);
+   }
+
+   /*
+    * Sleep-based wake-up timers work without the wait_obj mechanism: we have
+    * to cancel any potential wake-up timer as well.
+    */
+   task_cancel_wakeup_timer(ti);
+
+   /* Here we can either be RUNNABLE (if ti->wobj was set) or RUNNING */
+   ASSERT(ti->state == TASK_STATE_RUNNING || ti->state == TASK_STATE_RUNNABLE);
+
+   /* Drop the any pending signals and prevent new from being enqueued */
+   drop_all_pending_signals(ti);
+   ti->nested_sig_handlers = -1;
+}
+
+/*
+ * Terminate the current thread, which cannot be the main one. All the
+ * resources belong to the process, therefore there's very little to do here.
+ */
+NORETURN void terminate_thread(void)
+{
+   struct task *const ti = get_curr_task();
+   const int zero = 0;
+
+   ASSERT(ti->state != TASK_STATE_ZOMBIE);
+   ASSERT(!is_kernel_thread(ti));
+   ASSERT(!is_main_thread(ti));
+   ASSERT(is_preemption_enabled());
+
+   disable_preemption();
+   {
+      detach_dying_task(ti);
+   }
+   enable_preemption();
+
+   if (ti->clear_child_tid) {
+
+      /*
+       * CLONE_CHILD_CLEARTID: clear the tid in user space and wake up one
+       * task waiting on it as a futex. That's how pthread_join() works.
+       */
+
+      if (!copy_to_user(ti->clear_child_tid, &zero, sizeof(zero)))
+         futex_wake((u32 *)ti->clear_child_tid, 1, FUTEX_BITSET_MATCH_ANY);
+   }
+
+   disable_preemption();
+
+   /* OK, from now on the preemption won't be enabled until the end */
+   task_change_state(ti, TASK_STATE_ZOMBIE);
+
+   call_on_task_exit_callbacks();
+   task_free_all_kernel_allocs(ti);
+
+   /* Wake-up the main thread, in case it's waiting for us to exit */
+   wake_up_tasks_waiting_on(ti, task_died);
+   switch_stack_and_reschedule();
+}
+
+/*
+ * Kill all the threads of the current process, except the main one, which
+ * must be the current task, and wait for them to die. Setting `group_exit`
+ * prevents the dying threads from trying to kill the main thread in turn.
+ * Because they might create new threads in the meanwhile, repeat until there
+ * are none left.
+ */
+void kill_other_threads(void)
+{
+   struct process *pi = get_curr_proc();
+   struct task *pos;
+   int tid;
+
+   ASSERT(is_main_thread(get_curr_task()));
+   ASSERT(is_preemption_enabled());
+
+   disable_preemption();
+   pi->group_exit = true;
+
+   while (!list_is_empty(&pi->threads)) {
+
+      list_for_each_ro(pos, &pi->threads, siblings_node)
+         send_signal(pos->tid, SIGKILL, 0);
+
+      tid = list_first_obj(&pi->threads, struct task, siblings_node)->tid;
+
+      enable_preemption();
+      {
+         kthread_join(tid, true);
+      }
+      disable_preemption();
+   }
+
+   enable_preemption();
+}
+
+/*
+ * Terminate the whole process the current task belongs to.
  *
- * TODO: re-design this function when thread support is introduced.
+ * When called by a thread other than the main one, record the exit status,
+ * kill the main thread and terminate just the current thread: it will be the
+ * main thread to kill all the others and wait for them, before releasing the
+ * resources of the process.
  *
  * NOTE: the kernel "process" has multiple threads (kthreads), but they cannot
  * be signalled nor killed.
@@ -224,41 +341,36 @@ void terminate_process(int exit_code, int term_sig)
 
    disable_preemption();
 
-   if (ti->wobj.type != WOBJ_NONE) {
+   if (!pi->group_exit) {
 
-      /*
-       * If the task has been waiting on something, we have to reset its wobj
-       * and remove its pointer from the target object's wait_list.
-       */
+      pi->group_exit = true;
+      pi->group_exit_wstatus = EXITCODE(exit_code, term_sig);
 
-      wait_obj_reset(&ti->wobj);
+      if (!is_main_thread(ti))
+         send_signal(pi->pid, SIGKILL, 0);
    }
 
-   /*
-    * Sleep-based wake-up timers work without the wait_obj mechanism: we have
-    * to cancel any potential wake-up timer as well.
-    */
-   task_cancel_wakeup_timer(ti);
-
-   /* Here we can either be RUNNABLE (if ti->wobj was set) or RUNNING */
-   ASSERT(ti->state == TASK_STATE_RUNNING || ti->state == TASK_STATE_RUNNABLE);
+   if (!is_main_thread(ti)) {
+      enable_preemption();
+      terminate_thread();
+   }
 
-   /* Drop the any pending signals and prevent new from being enqueued */
-   drop_all_pending_signals(ti);
-   ti->nested_sig_handlers = -1;
+   detach_dying_task(ti);
 
    /*
-    * Close all the handles, keeping the preemption enabled while doing so.
+    * Terminate the other threads and close all the handles, keeping the
+    * preemption enabled while doing so.
     */
    enable_preemption();
    {
+      kill_other_threads();
       close_all_handles();
    }
    disable_preemption();
 
    /* OK, from now on the preemption won't be enabled until the end */
    task_change_state(ti, TASK_STATE_ZOMBIE);
-   ti->wstatus = EXITCODE(exit_code, term_sig);
+   ti->wstatus = pi->group_exit_wstatus;
    parent = get_task(pi->parent_pid);
 
    call_on_task_exit_callbacks();
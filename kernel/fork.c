@@ -10,39 +10,50 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/test/fork.h>
+#include <tilck/kernel/user.h>
+
+#include <linux/sched.h> // system header
 
 STATIC int fork_dup_all_handles(struct process *pi)
 {
+   struct fd_table *t = &pi->fdt;
+   int fd;
+
    ASSERT(!is_preemption_enabled());
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   fd_table_for_each_open(t, fd) {
 
       int rc;
       fs_handle dup_h = NULL;
-      fs_handle h = pi->handles[i];
+      fs_handle h = t->handles[fd];
       struct user_mapping *um;
 
-      if (!h)
-         continue;
-
       rc = vfs_dup(h, &dup_h);
 
       if (rc < 0 || !dup_h) {
 
          enable_preemption();
          {
-            for (u32 j = 0; j < i; j++)
-               vfs_close(pi->handles[j]);
+            /* Close the handles dup-ed so far and drop the parent's ones */
+            int j = fd_table_next_open_fd(t, 0);
+
+            for (; j >= 0 && j < fd; j = fd_table_next_open_fd(t, j + 1))
+               vfs_close(fd_table_remove(t, j));
          }
          disable_preemption();
+         fd_table_destroy(t);
          return -ENOMEM;
       }
 
       /* Update file handle's process pointer to the new process */
       ((struct fs_handle_base *)dup_h)->pi = pi;
 
+      /* Unlike dup(), fork() preserves the fd flags (e.g. FD_CLOEXEC) */
+      ((struct fs_handle_base *)dup_h)->fd_flags =
+         ((struct fs_handle_base *)h)->fd_flags;
+
       /* Replace the older (parent's) handle with the new one */
-      pi->handles[i] = dup_h;
+      t->handles[fd] = dup_h;
 
       if (!pi->mi)
          continue;
@@ -177,3 +188,98 @@ out:
    enable_preemption();
    return rc;
 }
+
+/*
+ * Create a new thread in the current process, sharing with it everything: the
+ * address space, the file descriptors, the cwd and the signal handlers. The
+ * new thread starts returning 0 from clone(), on its own user stack `newsp`.
+ * Returns the tid of the new thread.
+ */
+int do_clone_thread(regs_t *user_regs,
+                    ulong flags,
+                    ulong newsp,
+                    int *u_parent_tidptr,
+                    int *u_child_tidptr,
+                    ulong tls)
+{
+   struct task *curr = get_curr_task();
+   struct process *pi = curr->pi;
+   struct task *child = NULL;
+   int tid, rc = -EAGAIN;
+
+   if (pi->vforked)
+      return -EINVAL; /* we're sharing the address space with our parent */
+
+   disable_preemption();
+
+   if ((tid = create_new_pid()) < 0)
+      goto out; /* NOTE: rc is already set to -EAGAIN */
+
+   if (!(child = allocate_new_thread(pi, tid, true))) {
+      rc = -ENOMEM;
+      goto out;
+   }
+
+   child->state = TASK_STATE_RUNNABLE;
+   child->running_in_kernel = 0;
+   task_info_reset_kernel_stack(child);
+
+   child->state_regs--; // make room for a regs_t struct in child's stack
+   *child->state_regs = *user_regs; // copy creator's regs_t
+   set_return_register(child->state_regs, 0);
+
+   if (newsp)
+      regs_set_usersp(child->state_regs, newsp);
+
+   /* The new thread inherits the blocked signals mask from its creator */
+   memcpy(child->sa_mask, curr->sa_mask, sizeof(child->sa_mask));
+
+   if (flags & CLONE_CHILD_CLEARTID)
+      child->clear_child_tid = u_child_tidptr;
+
+   /*
+    * Add the task in order to reserve its tid, but keep it stopped until the
+    * tid has been written in user space: the thread library might need it
+    * (e.g. as owner of a mutex) as soon as the thread runs. Being also
+    * `vfork_stopped`, no signal can make it runnable in the meanwhile. That
+    * allows us to access the user memory with preemption enabled, as usual:
+    * that includes reading the TLS descriptor, for CLONE_SETTLS.
+    */
+   child->stopped = true;
+   child->vfork_stopped = true;
+   add_task(child);
+   enable_preemption();
+   rc = 0;
+
+   if (flags & CLONE_PARENT_SETTID) {
+      if (copy_to_user(u_parent_tidptr, &tid, sizeof(tid)) < 0)
+         rc = -EFAULT;
+   }
+
+   if (flags & CLONE_CHILD_SETTID) {
+      if (copy_to_user(u_child_tidptr, &tid, sizeof(tid)) < 0)
+         rc = -EFAULT;
+   }
+
+   if (!rc && (flags & CLONE_SETTLS))
+      rc = arch_specific_set_thread_tls(child, tls);
+
+   disable_preemption();
+
+   if (rc < 0) {
+      task_change_state(child, TASK_STATE_ZOMBIE);
+      free_common_task_allocs(child);
+      remove_task(child);
+      goto out;
+   }
+
+   list_add_tail(&pi->threads, &child->siblings_node);
+   child->vfork_stopped = false;
+   child->stopped = false;
+   enable_preemption();
+   return tid;
+
+out:
+   enable_preemption();
+   return rc;
+}
@@ -638,7 +638,7 @@ struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
    fs = create_fs_obj("fat",
                       &static_fsops_fat,
                       d,
-                      flags | VFS_FS_RQ_DE_SKIP);
+                      flags | VFS_FS_RQ_DE_SKIP | VFS_FS_DCACHE);
 
    if (!fs) {
       kfree_obj(d, struct fat_fs_device_data);
@@ -11,6 +11,8 @@
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/fs/fat32.h>
 
+#include <sys/mman.h>      // system header
+
 int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size)
 {
    struct fat_hdr *hdr = d->hdr;
@@ -101,6 +103,7 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    const size_t off_end = off_begin + um->len;
    ulong vaddr = um->vaddr, off = 0;
    size_t mapped_cnt, tot_mapped_cnt = 0;
+   u32 pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
    u32 clu;
 
    if (!d->mmap_support)
@@ -112,6 +115,15 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (flags & VFS_MM_DONT_MMAP)
       return 0;
 
+   if (um->flags & MAP_PRIVATE) {
+
+      /* Private mappings: copy the pages on the first write */
+      pg_flags = PAGING_FL_US | PAGING_FL_COW;
+
+      if (um->prot & PROT_WRITE)
+         pg_flags |= PAGING_FL_RW;
+   }
+
    clu = fat_get_first_cluster(fh->e);
 
    do {
@@ -133,8 +145,8 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
 
             // Our region begins somewhere in the middle of this cluster.
             // This can happen only with cluster_size > PAGE_SIZE.
-            off = off_begin;
             data += off_begin - off;
+            off = off_begin;
          }
 
          /*
@@ -148,7 +160,7 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
                                 (void *)vaddr,
                                 LIN_VA_TO_PA(data),
                                 pg_count,
-                                PAGING_FL_US | PAGING_FL_SHARED);
+                                pg_flags);
 
          if (mapped_cnt != pg_count) {
             unmap_pages_permissive(pdir,
@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/fs/fd_table.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+
+#define BIT_WORD(n)                                 ((n) / NBITS)
+#define BIT_MASK(n)                        (1UL << ((n) % NBITS))
+
+STATIC_ASSERT(FD_TABLE_INLINE_FDS == NBITS);
+
+static ALWAYS_INLINE u32 fdt_words(u32 size)
+{
+   return size / NBITS;
+}
+
+static ALWAYS_INLINE u32 fdt_summary_words(u32 size)
+{
+   return (fdt_words(size) + NBITS - 1) / NBITS;
+}
+
+/* The table never grows beyond this size, see fd_table_get_free_fd() */
+static ALWAYS_INLINE u32 fdt_max_size(void)
+{
+   return MAX((u32)FD_TABLE_INLINE_FDS, (u32)round_up_at(MAX_HANDLES, NBITS));
+}
+
+static ALWAYS_INLINE size_t fdt_bitmaps_size(u32 size)
+{
+   return (2 * fdt_words(size) + fdt_summary_words(size)) * sizeof(ulong);
+}
+
+/* Index of the lowest set bit: `w` must be != 0 */
+static ALWAYS_INLINE u32 fdt_ffs(ulong w)
+{
+   ASSERT(w != 0);
+   return (u32)__builtin_ctzl(w);
+}
+
+static ALWAYS_INLINE bool fdt_is_inline(struct fd_table *t)
+{
+   return t->handles == t->inline_handles;
+}
+
+void fd_table_init(struct fd_table *t)
+{
+   bzero(t, sizeof(*t));
+   t->size = FD_TABLE_INLINE_FDS;
+   t->handles = t->inline_handles;
+   t->open_fds = &t->inline_open_fds;
+   t->cloexec_fds = &t->inline_cloexec_fds;
+   t->full_words = &t->inline_full_words;
+}
+
+/*
+ * Allocates the arrays for a table of `size` slots and copies there the
+ * content of the current ones. On success, the old arrays are freed.
+ */
+static int fdt_resize(struct fd_table *t, u32 size)
+{
+   const u32 old_words = fdt_words(t->size);
+   const u32 words = fdt_words(size);
+   fs_handle *handles;
+   ulong *bmp;
+
+   ASSERT(size > t->size);
+   ASSERT(!(size % NBITS));
+
+   if (!(handles = kzalloc_array_obj(fs_handle, size)))
+      return -ENOMEM;
+
+   if (!(bmp = kzmalloc(fdt_bitmaps_size(size)))) {
+      kfree_array_obj(handles, fs_handle, size);
+      return -ENOMEM;
+   }
+
+   memcpy(handles, t->handles, t->size * sizeof(fs_handle));
+   memcpy(bmp, t->open_fds, old_words * sizeof(ulong));
+   memcpy(bmp + words, t->cloexec_fds, old_words * sizeof(ulong));
+   memcpy(bmp + 2 * words,
+          t->full_words,
+          fdt_summary_words(t->size) * sizeof(ulong));
+
+   if (!fdt_is_inline(t)) {
+      kfree_array_obj(t->handles, fs_handle, t->size);
+      kfree2(t->open_fds, fdt_bitmaps_size(t->size));
+   }
+
+   t->size = size;
+   t->handles = handles;
+   t->open_fds = bmp;
+   t->cloexec_fds = bmp + words;
+   t->full_words = bmp + 2 * words;
+   return 0;
+}
+
+static int fdt_grow(struct fd_table *t, u32 min_size)
+{
+   const u32 max_size = fdt_max_size();
+   u32 size = t->size;
+
+   if (min_size > max_size)
+      return -EMFILE;
+
+   while (size < min_size)
+      size *= 2;
+
+   return fdt_resize(t, MIN(size, max_size));
+}
+
+void fd_table_destroy(struct fd_table *t)
+{
+   if (!fdt_is_inline(t)) {
+      kfree_array_obj(t->handles, fs_handle, t->size);
+      kfree2(t->open_fds, fdt_bitmaps_size(t->size));
+   }
+
+   fd_table_init(t);
+}
+
+int fd_table_copy(struct fd_table *dst, struct fd_table *src)
+{
+   const u32 words = fdt_words(src->size);
+
+   fd_table_init(dst);
+
+   if (src->size > dst->size) {
+      if (fdt_resize(dst, src->size))
+         return -ENOMEM;
+   }
+
+   memcpy(dst->handles, src->handles, src->size * sizeof(fs_handle));
+   memcpy(dst->open_fds, src->open_fds, words * sizeof(ulong));
+   memcpy(dst->cloexec_fds, src->cloexec_fds, words * sizeof(ulong));
+   memcpy(dst->full_words,
+          src->full_words,
+          fdt_summary_words(src->size) * sizeof(ulong));
+
+   dst->open_count = src->open_count;
+   return 0;
+}
+
+/* Returns the lowest free slot >= `ge` or t->size, if there's none */
+static u32 fdt_find_free(struct fd_table *t, u32 ge)
+{
+   const u32 words = fdt_words(t->size);
+   u32 w = BIT_WORD(ge);
+   ulong bits;
+
+   if (ge >= t->size)
+      return t->size;
+
+   /* The word containing `ge`, ignoring the bits below it */
+   bits = t->open_fds[w] | (BIT_MASK(ge) - 1);
+
+   if (~bits)
+      return w * NBITS + fdt_ffs(~bits);
+
+   /* The following words: skip the full ones using the summary bitmap */
+   for (w++; w < words; w = (u32)round_up_at(w + 1, NBITS)) {
+
+      bits = t->full_words[BIT_WORD(w)] | (BIT_MASK(w) - 1);
+
+      if (~bits) {
+
+         w = (u32)round_down_at(w, NBITS) + fdt_ffs(~bits);
+
+         if (w >= words)
+            break;
+
+         return w * NBITS + fdt_ffs(~t->open_fds[w]);
+      }
+   }
+
+   return t->size;
+}
+
+int fd_table_get_free_fd(struct fd_table *t, int ge)
+{
+   u32 fd;
+   int rc;
+
+   if (ge < 0 || ge >= MAX_HANDLES)
+      return -EMFILE;
+
+   fd = fdt_find_free(t, (u32)ge);
+
+   if (fd == t->size) {
+
+      if ((rc = fdt_grow(t, MAX(t->size, (u32)ge) + 1)))
+         return rc;
+
+      fd = fdt_find_free(t, (u32)ge);
+      ASSERT(fd < t->size);
+   }
+
+   return fd < MAX_HANDLES ? (int)fd : -EMFILE;
+}
+
+int fd_table_reserve(struct fd_table *t, int fd)
+{
+   if (fd < 0 || fd >= MAX_HANDLES)
+      return -EBADF;
+
+   if ((u32)fd < t->size)
+      return 0;
+
+   return fdt_grow(t, (u32)fd + 1);
+}
+
+static ALWAYS_INLINE void
+fdt_set_bit(ulong *bmp, u32 n, bool val)
+{
+   if (val)
+      bmp[BIT_WORD(n)] |= BIT_MASK(n);
+   else
+      bmp[BIT_WORD(n)] &= ~BIT_MASK(n);
+}
+
+void fd_table_install(struct fd_table *t, int fd, fs_handle h)
+{
+   struct fs_handle_base *hb = h;
+   const u32 w = BIT_WORD((u32)fd);
+
+   ASSERT((u32)fd < t->size);
+   ASSERT(!t->handles[fd]);
+   ASSERT(h != NULL);
+
+   t->handles[fd] = h;
+   t->open_count++;
+   fdt_set_bit(t->open_fds, (u32)fd, true);
+   fdt_set_bit(t->cloexec_fds, (u32)fd, !!(hb->fd_flags & FD_CLOEXEC));
+
+   if (t->open_fds[w] == ~0UL)
+      fdt_set_bit(t->full_words, w, true);
+}
+
+fs_handle fd_table_remove(struct fd_table *t, int fd)
+{
+   fs_handle h;
+
+   if (!(h = fd_table_get(t, fd)))
+      return NULL;
+
+   t->handles[fd] = NULL;
+   t->open_count--;
+   fdt_set_bit(t->open_fds, (u32)fd, false);
+   fdt_set_bit(t->cloexec_fds, (u32)fd, false);
+   fdt_set_bit(t->full_words, BIT_WORD((u32)fd), false);
+   return h;
+}
+
+void fd_table_set_cloexec(struct fd_table *t, int fd, bool cloexec)
+{
+   struct fs_handle_base *hb = fd_table_get(t, fd);
+   ASSERT(hb != NULL);
+
+   if (cloexec)
+      hb->fd_flags |= FD_CLOEXEC;
+   else
+      hb->fd_flags &= (u16)~FD_CLOEXEC;
+
+   fdt_set_bit(t->cloexec_fds, (u32)fd, cloexec);
+}
+
+static int fdt_next_set_bit(struct fd_table *t, ulong *bmp, int n)
+{
+   const u32 words = fdt_words(t->size);
+   u32 w;
+   ulong bits;
+
+   if (n < 0 || (u32)n >= t->size)
+      return -1;
+
+   w = BIT_WORD((u32)n);
+   bits = bmp[w] & ~(BIT_MASK((u32)n) - 1);
+
+   while (!bits) {
+
+      if (++w == words)
+         return -1;
+
+      bits = bmp[w];
+   }
+
+   return (int)(w * NBITS + fdt_ffs(bits));
+}
+
+int fd_table_next_open_fd(struct fd_table *t, int fd)
+{
+   return fdt_next_set_bit(t, t->open_fds, fd);
+}
+
+int fd_table_next_cloexec_fd(struct fd_table *t, int fd)
+{
+   return fdt_next_set_bit(t, t->cloexec_fds, fd);
+}
@@ -20,12 +20,7 @@ static inline bool is_fd_in_valid_range(int fd)
 static int get_free_handle_num_ge(struct process *pi, int ge)
 {
    ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
-
-   for (int free_fd = ge; free_fd < MAX_HANDLES; free_fd++)
-      if (!pi->handles[free_fd])
-         return free_fd;
-
-   return -1;
+   return fd_table_get_free_fd(&pi->fdt, ge);
 }
 
 static int get_free_handle_num(struct process *pi)
@@ -48,13 +43,35 @@ fs_handle get_fs_handle(int fd)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if (is_fd_in_valid_range(fd) && curr->pi->handles[fd])
-      handle = curr->pi->handles[fd];
+   handle = fd_table_get(&curr->pi->fdt, fd);
 
    kmutex_unlock(&curr->pi->fslock);
    return handle;
 }
 
+/*
+ * Install `h` at the lowest free fd of the current process and return that fd.
+ * Used by the syscalls creating handles not backed by any path, like
+ * epoll_create(). On failure, the caller still owns the handle.
+ */
+int install_fs_handle(fs_handle h, bool cloexec)
+{
+   struct process *pi = get_curr_proc();
+   int fd;
+
+   kmutex_lock(&pi->fslock);
+   {
+      if ((fd = get_free_handle_num(pi)) >= 0) {
+
+         fd_table_install(&pi->fdt, fd, h);
+
+         if (cloexec)
+            fd_table_set_cloexec(&pi->fdt, fd, true);
+      }
+   }
+   kmutex_unlock(&pi->fslock);
+   return fd;
+}
 
 int sys_open(const char *u_path, int flags, mode_t mode)
 {
@@ -85,24 +102,20 @@ int sys_open(const char *u_path, int flags, mode_t mode)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if ((free_fd = get_free_handle_num(curr->pi)) < 0)
-      goto no_fds;
+   if ((ret = free_fd = get_free_handle_num(curr->pi)) < 0)
+      goto end;
 
    if ((ret = vfs_open(path, &h, flags, mode)) < 0)
       goto end;
 
    ASSERT(h != NULL);
 
-   curr->pi->handles[free_fd] = h;
+   fd_table_install(&curr->pi->fdt, free_fd, h);
    ret = free_fd;
 
 end:
    kmutex_unlock(&curr->pi->fslock);
    return ret;
-
-no_fds:
-   ret = -EMFILE;
-   goto end;
 }
 
 long sys_openat(int dfd, const char *u_path, int flags, mode_t mode)
@@ -169,8 +182,8 @@ int sys_close(int fd)
 
    kmutex_lock(&curr->pi->fslock);
    {
+      fd_table_remove(&curr->pi->fdt, fd);
       vfs_close(handle);
-      curr->pi->handles[fd] = NULL;
    }
    kmutex_unlock(&curr->pi->fslock);
    return ret;
@@ -228,6 +241,9 @@ int sys_read(int fd, void *u_buf, size_t count)
 
    if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
 
+      if (count && user_out_of_range(u_buf, count))
+         return -EFAULT;
+
       ret = (int) vfs_read(h, u_buf, count);
 
    } else {
@@ -259,6 +275,9 @@ int sys_write(int fd, const void *u_buf, size_t count)
 
    if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
 
+      if (count && user_out_of_range(u_buf, count))
+         return -EFAULT;
+
       ret = (int)vfs_write(h, (void *)u_buf, count);
 
    } else {
@@ -290,6 +309,9 @@ int sys_pread64(int fd, void *u_buf, size_t count, s64 off)
 
    if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
 
+      if (count && user_out_of_range(u_buf, count))
+         return -EFAULT;
+
       ret = (int) vfs_pread(h, u_buf, count, (offt)off);
 
    } else {
@@ -324,6 +346,9 @@ int sys_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
 
    if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
 
+      if (count && user_out_of_range(u_buf, count))
+         return -EFAULT;
+
       ret = (int)vfs_pwrite(h, (void *)u_buf, count, (offt)off);
 
    } else {
@@ -696,7 +721,10 @@ int sys_dup2(int oldfd, int newfd)
       goto out;
    }
 
-   new_h = get_fs_handle(newfd);
+   if ((rc = fd_table_reserve(&curr->pi->fdt, newfd)))
+      goto out;
+
+   new_h = fd_table_remove(&curr->pi->fdt, newfd);
 
    if (new_h) {
 
@@ -732,7 +760,7 @@ int sys_dup2(int oldfd, int newfd)
       goto out;
    }
 
-   curr->pi->handles[newfd] = new_h;
+   fd_table_install(&curr->pi->fdt, newfd, new_h);
    rc = newfd;
 
 out:
@@ -757,9 +785,7 @@ int sys_dup(int oldfd)
 
    kmutex_lock(&pi->fslock);
    {
-      free_fd = get_free_handle_num(pi);
-
-      if (is_fd_in_valid_range(free_fd))
+      if ((rc = free_fd = get_free_handle_num(pi)) >= 0)
          rc = sys_dup2(oldfd, free_fd);
    }
    kmutex_unlock(&pi->fslock);
@@ -807,16 +833,14 @@ static void debug_print_fcntl_command(int cmd)
 
 void close_cloexec_handles(struct process *pi)
 {
+   int fd;
    kmutex_lock(&pi->fslock);
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
-
-      struct fs_handle_base *h = pi->handles[i];
-
-      if (h && (h->fd_flags & FD_CLOEXEC)) {
-         vfs_close(h);
-         pi->handles[i] = NULL;
-      }
+   for (fd = fd_table_next_cloexec_fd(&pi->fdt, 0);
+        fd >= 0;
+        fd = fd_table_next_cloexec_fd(&pi->fdt, fd + 1))
+   {
+      vfs_close(fd_table_remove(&pi->fdt, fd));
    }
 
    kmutex_unlock(&pi->fslock);
@@ -834,30 +858,31 @@ int sys_fcntl64(int fd, int cmd, int arg)
    switch (cmd) {
 
       case F_DUPFD:
+      case F_DUPFD_CLOEXEC:
          {
             kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            rc = sys_dup2(fd, new_fd);
+
+            if (!is_fd_in_valid_range(arg))
+               rc = -EINVAL;
+            else if ((rc = get_free_handle_num_ge(curr->pi, arg)) >= 0)
+               rc = sys_dup2(fd, rc);
+
+            if (rc >= 0 && cmd == F_DUPFD_CLOEXEC)
+               fd_table_set_cloexec(&curr->pi->fdt, rc, true);
+
             kmutex_unlock(&curr->pi->fslock);
             return rc;
          }
 
-      case F_DUPFD_CLOEXEC:
+      case F_SETFD:
+         kmutex_lock(&curr->pi->fslock);
          {
-            kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            if (!(rc = sys_dup2(fd, new_fd))) {
-               /* dup2 succeeded */
-               struct fs_handle_base *h2 = get_fs_handle(new_fd);
-               ASSERT(h2 != NULL);
-               h2->fd_flags |= FD_CLOEXEC;
+            if (fd_table_get(&curr->pi->fdt, fd) == hb) {
+               hb->fd_flags = arg & 0xffff;
+               fd_table_set_cloexec(&curr->pi->fdt, fd, !!(arg & FD_CLOEXEC));
             }
-            kmutex_unlock(&curr->pi->fslock);
-            return rc;
          }
-
-      case F_SETFD:
-         hb->fd_flags = arg & 0xffff;
+         kmutex_unlock(&curr->pi->fslock);
          break;
 
       case F_GETFD:
@@ -1137,7 +1162,7 @@ int sys_pipe2(int u_pipefd[2], int flags)
    if (!(read_h = pipe_create_read_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[0]] = read_h;
+   fd_table_install(&curr->pi->fdt, fds[0], read_h);
 
    if ((fds[1] = get_free_handle_num(curr->pi)) < 0)
       goto no_fds;
@@ -1145,14 +1170,14 @@ int sys_pipe2(int u_pipefd[2], int flags)
    if (!(write_h = pipe_create_write_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[1]] = write_h;
+   fd_table_install(&curr->pi->fdt, fds[1], write_h);
 
    if (copy_to_user(u_pipefd, fds, sizeof(fds)))
       goto fault;
 
    if (flags & O_CLOEXEC) {
-      read_h->fd_flags |= FD_CLOEXEC;
-      write_h->fd_flags |= FD_CLOEXEC;
+      fd_table_set_cloexec(&curr->pi->fdt, fds[0], true);
+      fd_table_set_cloexec(&curr->pi->fdt, fds[1], true);
    }
 
 end:
@@ -1162,12 +1187,12 @@ end:
 err_end:
 
    if (read_h) {
-      curr->pi->handles[fds[0]] = NULL;
+      fd_table_remove(&curr->pi->fdt, fds[0]);
       kfs_destroy_handle((void *)read_h);
    }
 
    if (write_h) {
-      curr->pi->handles[fds[1]] = NULL;
+      fd_table_remove(&curr->pi->fdt, fds[1]);
       kfs_destroy_handle((void *)write_h);
    }
 
@@ -14,7 +14,7 @@
  * objects like pipes. It's existence cannot be avoided since all handles must
  * have a valid `fs` pointer.
  *
- * Currently, only pipes use it.
+ * It is used by pipes, epoll, eventfd and timerfd.
  */
 
 static struct mnt_fs *kernelfs;
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Entries arena
+ * ---------------
+ *
+ * The directory entries are packed in page-size arena pages, each one holding
+ * objects of a single size class. Because the pages are page-aligned, the
+ * page owning an object is found just by masking its address. Each size class
+ * keeps a list of its pages having at least one free slot and a page gets
+ * freed as soon as it becomes empty.
+ *
+ * The arena is protected by the exclusive lock of the ramfs instance, held
+ * by all the operations creating or removing dir entries.
+ */
+
+struct ramfs_arena_page {
+
+   struct list_node node;           /* node in arena->partial[class] */
+   void *free_list;                 /* singly-linked list of free slots */
+   u16 used;                        /* count of allocated slots */
+   u16 obj_size;
+   char objs[] ALIGNED_AT(sizeof(void *));
+};
+
+static inline u32 ramfs_arena_class(size_t size)
+{
+   ASSERT(size > 0);
+   return (u32)((size - 1) / RAMFS_ARENA_GRANULE);
+}
+
+static void ramfs_arena_init(struct ramfs_arena *a)
+{
+   for (u32 i = 0; i < RAMFS_ARENA_CLASSES; i++)
+      list_init(&a->partial[i]);
+
+   a->pages_count = 0;
+}
+
+static struct ramfs_arena_page *ramfs_arena_new_page(u32 obj_size)
+{
+   const u32 n = (PAGE_SIZE - sizeof(struct ramfs_arena_page)) / obj_size;
+   struct ramfs_arena_page *pg;
+   char *obj;
+
+   if (!(pg = aligned_kmalloc(PAGE_SIZE, PAGE_SIZE)))
+      return NULL;
+
+   list_node_init(&pg->node);
+   pg->free_list = NULL;
+   pg->used = 0;
+   pg->obj_size = (u16)obj_size;
+
+   /* Build the free list in address order */
+   for (u32 k = n; k > 0; k--) {
+      obj = pg->objs + (k - 1) * obj_size;
+      *(void **)obj = pg->free_list;
+      pg->free_list = obj;
+   }
+
+   return pg;
+}
+
+static void *ramfs_arena_alloc(struct ramfs_arena *a, size_t size)
+{
+   const u32 cl = ramfs_arena_class(size);
+   struct ramfs_arena_page *pg;
+   void *obj;
+
+   ASSERT(cl < RAMFS_ARENA_CLASSES);
+
+   if (list_is_empty(&a->partial[cl])) {
+
+      if (!(pg = ramfs_arena_new_page((cl + 1) * RAMFS_ARENA_GRANULE)))
+         return NULL;
+
+      list_add_tail(&a->partial[cl], &pg->node);
+      a->pages_count++;
+   }
+
+   pg = list_first_obj(&a->partial[cl], struct ramfs_arena_page, node);
+   obj = pg->free_list;
+   pg->free_list = *(void **)obj;
+   pg->used++;
+
+   if (!pg->free_list)
+      list_remove(&pg->node);    /* the page is now full */
+
+   return obj;
+}
+
+static void ramfs_arena_free(struct ramfs_arena *a, void *obj)
+{
+   struct ramfs_arena_page *pg = (void *)((ulong)obj & PAGE_MASK);
+   const bool was_full = !pg->free_list;
+
+   ASSERT(pg->used > 0);
+
+   *(void **)obj = pg->free_list;
+   pg->free_list = obj;
+   pg->used--;
+
+   if (!pg->used) {
+
+      if (!was_full)
+         list_remove(&pg->node);
+
+      aligned_kfree2(pg, PAGE_SIZE);
+      a->pages_count--;
+
+   } else if (was_full) {
+
+      list_add_head(&a->partial[ramfs_arena_class(pg->obj_size)], &pg->node);
+   }
+}
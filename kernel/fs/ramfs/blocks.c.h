@@ -1,52 +1,342 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static struct ramfs_block *ramfs_new_block(offt page)
+/*
+ * Block index
+ * ---------------
+ *
+ * The data blocks of each file are indexed by a radix tree keyed by page
+ * number, where each node has RAMFS_RADIX_SLOTS slots. A tree of height `h`
+ * covers the pages [0, RAMFS_RADIX_SLOTS^h): the height grows on demand
+ * when writing past the covered range and it's 0 only for files without
+ * blocks. Consecutive pages live in consecutive slots of the same leaf node,
+ * therefore sequential I/O needs just one lookup every RAMFS_RADIX_SLOTS pages.
+ *
+ * The blocks themselves are allocated with KMALLOC_FL_MULTI_STEP, split in
+ * page-size sub-blocks: that allows large writes to allocate a whole
+ * contiguous extent in one go (and to copy it with a single memcpy), while
+ * keeping each page independently free-able on truncate.
+ */
+
+#define RAMFS_RADIX_SHIFT(h)        (((h) - 1) * RAMFS_RADIX_BITS)
+
+/* Returns the number of pages covered by a tree of the given height */
+static ALWAYS_INLINE ulong ramfs_radix_pages(u32 height)
+{
+   if (!height)
+      return 0;
+
+   if (height * RAMFS_RADIX_BITS >= NBITS)
+      return ~0UL;
+
+   return 1UL << (height * RAMFS_RADIX_BITS);
+}
+
+/*
+ * Returns a pointer to the leaf slot for the page `pn` or NULL, if there's no
+ * leaf node covering that page.
+ */
+static void **ramfs_get_block_slot(struct ramfs_inode *i, ulong pn)
+{
+   struct ramfs_radix_node *n = i->blocks_root;
+
+   if (pn >= ramfs_radix_pages(i->blocks_height))
+      return NULL;
+
+   for (u32 h = i->blocks_height; h > 1; h--) {
+
+      n = n->slots[(pn >> RAMFS_RADIX_SHIFT(h)) & RAMFS_RADIX_MASK];
+
+      if (!n)
+         return NULL;
+   }
+
+   return &n->slots[pn & RAMFS_RADIX_MASK];
+}
+
+/*
+ * Like ramfs_get_block_slot(), but creates the missing nodes along the path.
+ * Returns NULL only in case of OOM.
+ */
+static void **ramfs_get_or_create_block_slot(struct ramfs_inode *i, ulong pn)
+{
+   struct ramfs_radix_node *n, **np;
+
+   while (pn >= ramfs_radix_pages(i->blocks_height)) {
+
+      if (!(n = kzalloc_obj(struct ramfs_radix_node)))
+         return NULL;
+
+      n->slots[0] = i->blocks_root;
+      i->blocks_root = n;
+      i->blocks_height++;
+   }
+
+   np = &i->blocks_root;
+
+   for (u32 h = i->blocks_height; h > 1; h--) {
+
+      n = *np;
+      np = (void *)&n->slots[(pn >> RAMFS_RADIX_SHIFT(h)) & RAMFS_RADIX_MASK];
+
+      if (!*np && !(*np = kzalloc_obj(struct ramfs_radix_node)))
+         return NULL;
+   }
+
+   return &(*np)->slots[pn & RAMFS_RADIX_MASK];
+}
+
+/*
+ * Returns the number of pages, starting from the one in `slot`, which are
+ * contiguous in memory. The count is limited by `max` and by the end of the
+ * leaf node.
+ */
+static size_t ramfs_contig_blocks(void **slot, ulong pn, size_t max)
+{
+   const size_t leaf_rem = RAMFS_RADIX_SLOTS - (pn & RAMFS_RADIX_MASK);
+   size_t n = 1;
+
+   max = MIN(max, leaf_rem);
+
+   while (n < max && slot[n] == (char *)slot[0] + (n << PAGE_SHIFT))
+      n++;
+
+   return n;
+}
+
+/*
+ * Allocate a contiguous extent of up to `count` blocks for the empty slots
+ * starting at `slot`, falling back to smaller extents in case of memory
+ * pressure. Returns the number of blocks actually allocated (0 means OOM).
+ * The content of the new blocks is NOT initialized.
+ */
+static size_t
+ramfs_alloc_blocks(struct ramfs_inode *i, void **slot, ulong pn, size_t count)
+{
+   size_t n = 0, size = 0;
+   char *va = NULL;
+
+   count = MIN(count, RAMFS_RADIX_SLOTS - (pn & RAMFS_RADIX_MASK));
+
+   while (n < count && !slot[n])
+      n++;
+
+   for (count = n; count > 0; count /= 2) {
+
+      size = count << PAGE_SHIFT;
+
+      if ((va = general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE)))
+         break;
+   }
+
+   if (!va)
+      return 0;
+
+   ASSERT(size == count << PAGE_SHIFT);
+
+   /* Retain the pageframes used by the blocks */
+   retain_pageframes_mapped_at(get_kernel_pdir(), va, size);
+
+   for (n = 0; n < count; n++)
+      slot[n] = va + (n << PAGE_SHIFT);
+
+   i->blocks_count += count;
+   return count;
+}
+
+/*
+ * Big extents
+ * -------------
+ *
+ * When a write covers a whole RAMFS_BIG_EXTENT_PAGES-aligned range of pages
+ * not having blocks yet, ramfs tries to allocate them as a single extent,
+ * physically aligned at USER_BIG_PAGE_SIZE: that allows shared mappings to map
+ * the whole range with a single big page (see ramfs_mmap()). A big extent
+ * spans several leaf nodes, but its pages are still independently free-able,
+ * exactly like the ones of the regular extents. On architectures not having
+ * big pages (USER_BIG_PAGE_SIZE is 0), big extents are never allocated.
+ */
+#define RAMFS_BIG_EXTENT_PAGES      ((ulong)USER_BIG_PAGE_SIZE >> PAGE_SHIFT)
+
+#if USER_BIG_PAGE_SIZE
+
+STATIC_ASSERT(!(RAMFS_BIG_EXTENT_PAGES % RAMFS_RADIX_SLOTS));
+
+/*
+ * Returns true if the `count` pages starting at `pn` cover a whole big extent
+ * starting at `pn`.
+ */
+static inline bool ramfs_covers_big_extent(ulong pn, size_t count)
+{
+   return count >= RAMFS_BIG_EXTENT_PAGES &&
+          !(pn & (RAMFS_BIG_EXTENT_PAGES - 1));
+}
+
+/*
+ * Allocate a big extent for the pages starting at `pn`. Returns the number of
+ * blocks allocated: 0 when not all the slots are empty or when no aligned
+ * memory is available. The content of the new blocks is NOT initialized.
+ */
+static size_t ramfs_alloc_big_extent(struct ramfs_inode *i, ulong pn)
+{
+   size_t size = USER_BIG_PAGE_SIZE;
+   void **slot = NULL;
+   char *va;
+
+   ASSERT(!(pn & (RAMFS_BIG_EXTENT_PAGES - 1)));
+
+   for (ulong n = 0; n < RAMFS_BIG_EXTENT_PAGES; n += RAMFS_RADIX_SLOTS) {
+
+      if (!(slot = ramfs_get_or_create_block_slot(i, pn + n)))
+         return 0;
+
+      for (u32 s = 0; s < RAMFS_RADIX_SLOTS; s++)
+         if (slot[s])
+            return 0;
+   }
+
+   if (!(va = general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE)))
+      return 0;
+
+   if (LIN_VA_TO_PA(va) & (USER_BIG_PAGE_SIZE - 1)) {
+
+      /* The heaps give no guarantee about the physical alignment */
+      general_kfree(va, &size, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+      return 0;
+   }
+
+   /* Retain the pageframes used by the blocks */
+   retain_pageframes_mapped_at(get_kernel_pdir(), va, size);
+
+   for (ulong n = 0; n < RAMFS_BIG_EXTENT_PAGES; n++) {
+
+      if (!(n & RAMFS_RADIX_MASK))
+         slot = ramfs_get_block_slot(i, pn + n);
+
+      slot[n & RAMFS_RADIX_MASK] = va + (n << PAGE_SHIFT);
+   }
+
+   i->blocks_count += RAMFS_BIG_EXTENT_PAGES;
+   return RAMFS_BIG_EXTENT_PAGES;
+}
+
+/*
+ * Returns the big extent backing the pages [pn, pn + RAMFS_BIG_EXTENT_PAGES)
+ * or NULL, if they're not backed by a single physically aligned extent.
+ */
+static void *ramfs_get_big_extent(struct ramfs_inode *i, ulong pn)
 {
-   struct ramfs_block *b;
+   void **slot;
+   char *va;
 
-   /* Allocate memory for the block object */
-   if (!(b = kalloc_obj(struct ramfs_block)))
+   if (pn & (RAMFS_BIG_EXTENT_PAGES - 1))
       return NULL;
 
-   /* Allocate block's data */
-   if (!(b->vaddr = kzmalloc(PAGE_SIZE))) {
-      kfree_obj(b, struct ramfs_block);
+   if (!(slot = ramfs_get_block_slot(i, pn)) || !(va = *slot))
       return NULL;
+
+   if (LIN_VA_TO_PA(va) & (USER_BIG_PAGE_SIZE - 1))
+      return NULL;
+
+   for (ulong n = 0; n < RAMFS_BIG_EXTENT_PAGES; n += RAMFS_RADIX_SLOTS) {
+
+      if (!(slot = ramfs_get_block_slot(i, pn + n)))
+         return NULL;
+
+      if (*slot != va + (n << PAGE_SHIFT))
+         return NULL;
+
+      if (ramfs_contig_blocks(slot, pn + n, RAMFS_RADIX_SLOTS)
+            != RAMFS_RADIX_SLOTS)
+      {
+         return NULL;
+      }
    }
 
-   /* Retain the pageframe used by this block */
-   retain_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
+   return va;
+}
 
-   /* Init the block object */
-   bintree_node_init(&b->node);
-   b->offset = page;
-   return b;
+#else
+
+static inline bool ramfs_covers_big_extent(ulong pn, size_t count)
+{
+   return false;
 }
 
-static void ramfs_destroy_block(struct ramfs_block *b)
+static inline size_t ramfs_alloc_big_extent(struct ramfs_inode *i, ulong pn)
+{
+   return 0;
+}
+
+static inline void *ramfs_get_big_extent(struct ramfs_inode *i, ulong pn)
+{
+   return NULL;
+}
+
+#endif
+
+static void ramfs_free_block(struct ramfs_inode *i, void *vaddr)
 {
    /* Release the pageframe used by this block */
-   release_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
+   release_pageframes_mapped_at(get_kernel_pdir(), vaddr, PAGE_SIZE);
+
+   /*
+    * Free the memory pointed by this block: it might be a page of a multi-step
+    * extent, so it must be freed as a split sub-block of that chunk.
+    */
+   kfree_chunk_page(vaddr);
+   i->blocks_count--;
+}
+
+/*
+ * Free all the blocks with page number >= `first` in the subtree `n`, having
+ * height `h` and covering the pages starting from `base`. Returns true if the
+ * node itself has been freed, because it became empty.
+ */
+static bool
+ramfs_truncate_subtree(struct ramfs_inode *i,
+                       struct ramfs_radix_node *n,
+                       u32 h,
+                       ulong base,
+                       ulong first)
+{
+   const ulong span = 1UL << RAMFS_RADIX_SHIFT(h);
+   bool empty = true;
+
+   for (u32 s = 0; s < RAMFS_RADIX_SLOTS; s++, base += span) {
 
-   /* Free the memory pointed by this block */
-   kfree2(b->vaddr, PAGE_SIZE);
+      if (!n->slots[s])
+         continue;
 
-   /* Free the memory used by the block object itself */
-   kfree_obj(b, struct ramfs_block);
+      if (base + span <= first) {
+         empty = false;       /* the whole slot is below `first` */
+         continue;
+      }
+
+      if (h == 1) {
+         ramfs_free_block(i, n->slots[s]);
+      } else if (!ramfs_truncate_subtree(i, n->slots[s], h - 1, base, first)) {
+         empty = false;
+         continue;
+      }
+
+      n->slots[s] = NULL;
+   }
+
+   if (empty)
+      kfree_obj(n, struct ramfs_radix_node);
+
+   return empty;
 }
 
-static void
-ramfs_append_new_block(struct ramfs_inode *inode, struct ramfs_block *block)
+static void ramfs_truncate_blocks(struct ramfs_inode *i, ulong first)
 {
-   DEBUG_ONLY_UNSAFE(bool success =)
-      bintree_insert_ptr(&inode->blocks_tree_root,
-                         block,
-                         struct ramfs_block,
-                         node,
-                         offset);
+   if (!i->blocks_root)
+      return;
 
-   ASSERT(success);
-   inode->blocks_count++;
+   if (ramfs_truncate_subtree(i, i->blocks_root, i->blocks_height, 0, first)) {
+      i->blocks_root = NULL;
+      i->blocks_height = 0;
+   }
 }
 
 static int ramfs_inode_extend(struct ramfs_inode *i, offt new_len)
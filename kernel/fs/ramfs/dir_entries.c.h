@@ -1,59 +1,114 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static long ramfs_insert_remove_entry_cmp(const void *a, const void *b)
+/*
+ * Directory entries
+ * -------------------
+ *
+ * Each directory indexes its entries with a chained hash table keyed by name,
+ * which doubles its size when the average chain length exceeds
+ * RAMFS_DIR_MAX_LOAD. The entries are also linked in `entries_list` in their
+ * creation order, which is the order used by ramfs_getdents().
+ */
+
+#define RAMFS_DIR_MIN_BUCKETS          8u
+#define RAMFS_DIR_MAX_LOAD             2
+
+static u32 ramfs_name_hash(const char *name, size_t len)
 {
-   const struct ramfs_entry *e1 = a;
-   const struct ramfs_entry *e2 = b;
-   return strcmp(e1->name, e2->name);
+   u32 h = 2166136261u;      /* FNV-1a */
+
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ (u8)name[i]) * 16777619u;
+
+   return h;
+}
+
+static inline struct ramfs_entry **
+ramfs_dir_bucket(struct ramfs_inode *idir, u32 hash)
+{
+   return &idir->buckets[hash & (idir->buckets_count - 1)];
 }
 
-static long ramfs_find_entry_cmp(const void *obj, const void *valptr)
+/*
+ * Resizes the hash table of `idir` to `count` buckets. In case of OOM, the
+ * current table is kept: it will just have longer chains.
+ */
+static void ramfs_dir_rehash(struct ramfs_inode *idir, u32 count)
 {
-   const struct ramfs_entry *e = obj;
-   const char *searched_str = valptr;
-   return strcmp(e->name, searched_str);
+   struct ramfs_entry **new_buckets, *pos, **b;
+
+   if (!(new_buckets = kzalloc_array_obj(struct ramfs_entry *, count)))
+      return;
+
+   if (idir->buckets)
+      kfree_array_obj(idir->buckets, struct ramfs_entry *, idir->buckets_count);
+
+   idir->buckets = new_buckets;
+   idir->buckets_count = count;
+
+   list_for_each_ro(pos, &idir->entries_list, lnode) {
+      b = ramfs_dir_bucket(idir, pos->hash);
+      pos->hnext = *b;
+      *b = pos;
+   }
+}
+
+static void ramfs_dir_free_buckets(struct ramfs_inode *idir)
+{
+   ASSERT(idir->num_entries == 0);
+
+   if (idir->buckets) {
+      kfree_array_obj(idir->buckets, struct ramfs_entry *, idir->buckets_count);
+      idir->buckets = NULL;
+      idir->buckets_count = 0;
+   }
 }
 
 static int
-ramfs_dir_add_entry(struct ramfs_inode *idir,
+ramfs_dir_add_entry(struct ramfs_data *d,
+                    struct ramfs_inode *idir,
                     const char *iname,
                     struct ramfs_inode *ie)
 {
-   struct ramfs_entry *e;
+   struct ramfs_entry *e, **b;
    size_t enl = strlen(iname) + 1;
    ASSERT(idir->type == VFS_DIR);
 
    if (enl == 1)
       return -ENOENT;
 
-   if (enl > sizeof(e->name))
+   if (iname[enl - 2] == '/')
+      enl--;             /* drop the trailing slash */
+
+   if (enl > RAMFS_ENTRY_MAX_LEN)
       return -ENAMETOOLONG;
 
-   if (!(e = kalloc_obj(struct ramfs_entry)))
+   if ((u64)idir->num_entries >= (u64)idir->buckets_count * RAMFS_DIR_MAX_LOAD)
+      ramfs_dir_rehash(idir, MAX(2 * idir->buckets_count,
+                                 RAMFS_DIR_MIN_BUCKETS));
+
+   if (!idir->buckets)
+      return -ENOSPC;
+
+   if (!(e = ramfs_arena_alloc(&d->entries_arena, RAMFS_ENTRY_SIZE(enl))))
       return -ENOSPC;
 
    ASSERT(ie->parent_dir != NULL);
 
-   bintree_node_init(&e->node);
    list_node_init(&e->lnode);
 
    e->inode = ie;
-   memcpy(e->name, iname, enl);
-
-   if (e->name[enl-2] == '/') {
-      e->name[enl-2] = 0; /* drop the trailing slash */
-      enl--;
-   }
-
    e->name_len = (u8) enl;
+   memcpy(e->name, iname, enl - 1);
+   e->name[enl - 1] = 0;
+   e->hash = ramfs_name_hash(e->name, enl - 1);
 
-   bintree_insert(&idir->entries_tree_root,
-                  e,
-                  ramfs_insert_remove_entry_cmp,
-                  struct ramfs_entry,
-                  node);
+   b = ramfs_dir_bucket(idir, e->hash);
+   e->hnext = *b;
+   *b = e;
 
    list_add_tail(&idir->entries_list, &e->lnode);
+   vfs_dcache_invalidate(idir, e->name, enl - 1); /* drop negative entries */
 
    ie->nlink++;
    idir->num_entries++;
@@ -61,10 +116,13 @@ ramfs_dir_add_entry(struct ramfs_inode *idir,
 }
 
 static void
-ramfs_dir_remove_entry(struct ramfs_inode *idir, struct ramfs_entry *e)
+ramfs_dir_remove_entry(struct ramfs_data *d,
+                       struct ramfs_inode *idir,
+                       struct ramfs_entry *e)
 {
    struct ramfs_handle *pos;
    struct ramfs_inode *ie = e->inode;
+   struct ramfs_entry **b;
    ASSERT(idir->type == VFS_DIR);
 
    /*
@@ -79,18 +137,17 @@ ramfs_dir_remove_entry(struct ramfs_inode *idir, struct ramfs_entry *e)
          pos->dpos = list_next_obj(pos->dpos, lnode);
    }
 
-   bintree_remove(&idir->entries_tree_root,
-                  e,
-                  ramfs_insert_remove_entry_cmp,
-                  struct ramfs_entry,
-                  node);
+   for (b = ramfs_dir_bucket(idir, e->hash); *b != e; b = &(*b)->hnext)
+      ASSERT(*b != NULL);
 
+   *b = e->hnext;
    list_remove(&e->lnode);
+   vfs_dcache_invalidate(idir, e->name, e->name_len - 1u);
 
    ASSERT(ie->nlink > 0);
    ie->nlink--;
    idir->num_entries--;
-   kfree_obj(e, struct ramfs_entry);
+   ramfs_arena_free(&d->entries_arena, e);
 }
 
 static struct ramfs_entry *
@@ -98,13 +155,21 @@ ramfs_dir_get_entry_by_name(struct ramfs_inode *idir,
                             const char *name,
                             ssize_t len)
 {
-   char buf[RAMFS_ENTRY_MAX_LEN];
-   memcpy(buf, name, (size_t) len);
-   buf[len] = 0;
-
-   return bintree_find(idir->entries_tree_root,
-                       buf,
-                       ramfs_find_entry_cmp,
-                       struct ramfs_entry,
-                       node);
+   const u32 hash = ramfs_name_hash(name, (size_t)len);
+   struct ramfs_entry *e;
+
+   if (len >= RAMFS_ENTRY_MAX_LEN || !idir->buckets)
+      return NULL;
+
+   for (e = *ramfs_dir_bucket(idir, hash); e; e = e->hnext) {
+
+      if (e->hash == hash &&
+          e->name_len == len + 1 &&
+          !memcmp(e->name, name, (size_t)len))
+      {
+         return e;
+      }
+   }
+
+   return NULL;
 }
@@ -44,16 +44,19 @@ ramfs_create_inode_dir(struct ramfs_data *d,
 
    i->parent_dir = parent;
 
-   if (ramfs_dir_add_entry(i, ".", i) < 0) {
+   if (ramfs_dir_add_entry(d, i, ".", i) < 0) {
+      ramfs_dir_free_buckets(i);
       kfree_obj(i, struct ramfs_inode);
       return NULL;
    }
 
-   if (ramfs_dir_add_entry(i, "..", parent) < 0) {
+   if (ramfs_dir_add_entry(d, i, "..", parent) < 0) {
 
-      struct ramfs_entry *e = i->entries_tree_root;
-      ramfs_dir_remove_entry(i, e);
+      struct ramfs_entry *e =
+         list_first_obj(&i->entries_list, struct ramfs_entry, lnode);
 
+      ramfs_dir_remove_entry(d, i, e);
+      ramfs_dir_free_buckets(i);
       kfree_obj(i, struct ramfs_inode);
       return NULL;
    }
@@ -99,11 +102,12 @@ static int ramfs_destroy_inode(struct ramfs_data *d, struct ramfs_inode *i)
          break;
 
       case VFS_FILE:
-         ASSERT(i->blocks_tree_root == NULL);
+         ASSERT(i->blocks_root == NULL);
          break;
 
       case VFS_DIR:
-         ASSERT(i->entries_tree_root == NULL);
+         ramfs_dir_free_buckets(i);
+         vfs_dcache_invalidate_dir(i); /* drop the negative entries */
          break;
 
       case VFS_SYMLINK:
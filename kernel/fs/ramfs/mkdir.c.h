@@ -16,7 +16,7 @@ static int ramfs_mkdir(struct vfs_path *p, mode_t mode)
    if (!(new_dir = ramfs_create_inode_dir(d, mode, rp->dir_inode)))
       return -ENOSPC;
 
-   if ((rc = ramfs_dir_add_entry(rp->dir_inode, p->last_comp, new_dir))) {
+   if ((rc = ramfs_dir_add_entry(d, rp->dir_inode, p->last_comp, new_dir))) {
       ramfs_destroy_inode(d, new_dir);
       return rc;
    }
@@ -58,17 +58,17 @@ static int ramfs_rmdir(struct vfs_path *p)
       return -EBUSY;
    }
 
-   ASSERT(i->entries_tree_root != NULL);
-   ramfs_dir_remove_entry(i, i->entries_tree_root);   // drop .
-
-   ASSERT(i->entries_tree_root != NULL);
-   ramfs_dir_remove_entry(i, i->entries_tree_root);   // drop ..
+   /* Drop the '.' and '..' entries */
+   while (!list_is_empty(&i->entries_list)) {
+      ramfs_dir_remove_entry(
+         d, i, list_first_obj(&i->entries_list, struct ramfs_entry, lnode)
+      );
+   }
 
    ASSERT(i->num_entries == 0);
-   ASSERT(i->entries_tree_root == NULL);
 
    /* Remove the dir entry */
-   ramfs_dir_remove_entry(rp->dir_inode, rp->dir_entry);
+   ramfs_dir_remove_entry(d, rp->dir_inode, rp->dir_entry);
 
    /* Destroy the inode */
    ramfs_destroy_inode(d, i);
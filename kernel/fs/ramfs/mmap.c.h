@@ -5,19 +5,58 @@ static int ramfs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
    return generic_fs_munmap(um, vaddrp, len);
 }
 
+/*
+ * Shared mappings map the blocks themselves, while private mappings map them
+ * copy-on-write: a write to such a page will make a private copy of it.
+ */
+static u32 ramfs_mmap_pg_flags(struct user_mapping *um)
+{
+   struct ramfs_handle *rh = um->h;
+
+   if (um->flags & MAP_PRIVATE) {
+      return PAGING_FL_US | PAGING_FL_COW |
+             ((um->prot & PROT_WRITE) ? PAGING_FL_RW : 0);
+   }
+
+   if ((rh->fl_flags & O_RDWR) == O_RDWR)
+      return PAGING_FL_US | PAGING_FL_SHARED | PAGING_FL_RW;
+
+   return PAGING_FL_US | PAGING_FL_SHARED;
+}
+
+/*
+ * Shared mappings having MAP_HUGETLB map the big extents of the file (see
+ * ramfs_alloc_big_extent()) with big pages, as long as the user vaddr has the
+ * same alignment. Private mappings always use regular pages, as they're COW.
+ */
+static inline bool
+ramfs_mmap_can_use_big_page(struct user_mapping *um,
+                            ulong vaddr,
+                            ulong pn,
+                            ulong rem)
+{
+   if (!USER_BIG_PAGE_SIZE || (um->flags & MAP_PRIVATE))
+      return false;
+
+   if (!(um->flags & MAP_HUGETLB) || !ramfs_covers_big_extent(pn, rem))
+      return false;
+
+   return !(vaddr & (USER_BIG_PAGE_SIZE - 1));
+}
+
 static int
 ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
 {
    struct ramfs_handle *rh = um->h;
    struct ramfs_inode *i = rh->inode;
    ulong vaddr = um->vaddr;
-   struct bintree_walk_ctx ctx;
-   struct ramfs_block *b;
+   void **slot = NULL;
+   void *extent;
    u32 pg_flags;
    int rc;
 
-   const size_t off_begin = um->off;
-   const size_t off_end = off_begin + um->len;
+   const ulong pn_begin = um->off >> PAGE_SHIFT;
+   const ulong pn_end = pn_begin + (um->len >> PAGE_SHIFT);
 
    ASSERT(IS_PAGE_ALIGNED(um->len));
 
@@ -27,43 +66,47 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (flags & VFS_MM_DONT_MMAP)
       goto register_mapping;
 
-   bintree_in_order_visit_start(&ctx,
-                                i->blocks_tree_root,
-                                struct ramfs_block,
-                                node,
-                                false);
+   pg_flags = ramfs_mmap_pg_flags(um);
 
-   pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
+   for (ulong pn = pn_begin; pn < pn_end; pn++, vaddr += PAGE_SIZE) {
 
-   if ((rh->fl_flags & O_RDWR) == O_RDWR)
-      pg_flags |= PAGING_FL_RW;
+      if (ramfs_mmap_can_use_big_page(um, vaddr, pn, pn_end - pn) &&
+          (extent = ramfs_get_big_extent(i, pn)))
+      {
+         rc = map_big_page(pdir, (void *)vaddr, LIN_VA_TO_PA(extent), pg_flags);
+
+         if (!rc) {
+            pn += RAMFS_BIG_EXTENT_PAGES - 1;
+            vaddr += USER_BIG_PAGE_SIZE - PAGE_SIZE;
+            slot = NULL;
+            continue;
+         }
 
-   while ((b = bintree_in_order_visit_next(&ctx))) {
+         /* Just fall back to regular pages */
+      }
 
-      if ((size_t)b->offset < off_begin)
-         continue; /* skip this block */
+      if (slot && (pn & RAMFS_RADIX_MASK))
+         slot++;
+      else
+         slot = ramfs_get_block_slot(i, pn);
 
-      if ((size_t)b->offset >= off_end)
-         break;
+      if (!slot || !*slot)
+         continue; /* hole: the page will be mapped on fault */
 
       rc = map_page(pdir,
                     (void *)vaddr,
-                    LIN_VA_TO_PA(b->vaddr),
+                    LIN_VA_TO_PA(*slot),
                     pg_flags);
 
       if (rc) {
 
          /* mmap failed, we have to unmap the pages already mapped */
-         vaddr -= PAGE_SIZE;
-
-         for (; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
+         for (vaddr -= PAGE_SIZE; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
             unmap_page_permissive(pdir, (void *)vaddr, false);
          }
 
          return rc;
       }
-
-      vaddr += PAGE_SIZE;
    }
 
 register_mapping:
@@ -74,6 +117,176 @@ register_mapping:
    return 0;
 }
 
+/*
+ * Fault-around
+ * --------------
+ *
+ * ramfs_mmap() maps all the blocks existing at mmap() time, so the faults hit
+ * the holes and the blocks allocated later (e.g. by write()). To avoid taking
+ * one fault per page in the latter case, a fault maps also all the pages of
+ * the surrounding window of `ramfs_fault_around` pages (aligned relative to
+ * the mapping start and clipped to it and to the EOF) having a block and not
+ * mapped yet. The holes in the window are left alone: they're handled by
+ * their own faults. The window grows to RAMFS_FAULT_AROUND_MAX pages for the
+ * mappings advised as MADV_SEQUENTIAL and it's disabled for the MADV_RANDOM
+ * ones.
+ */
+ulong ramfs_fault_around = RAMFS_FAULT_AROUND_DEF;
+struct ramfs_fault_stats ramfs_fault_stats;
+
+static inline ulong ramfs_fault_around_pages(struct user_mapping *um)
+{
+   if (um->advice == MADV_SEQUENTIAL)
+      return RAMFS_FAULT_AROUND_MAX;
+
+   if (um->advice == MADV_RANDOM)
+      return 1;
+
+   return MIN(ramfs_fault_around, RAMFS_FAULT_AROUND_MAX);
+}
+
+static size_t
+ramfs_map_fault_around(struct process *pi,
+                       struct user_mapping *um,
+                       ulong vaddr,
+                       u32 pg_flags)
+{
+   struct ramfs_inode *i = ((struct ramfs_handle *)um->h)->inode;
+   const ulong win = ramfs_fault_around_pages(um);
+   const ulong win_sz = win << PAGE_SHIFT;
+   const ulong file_end = (ulong)i->fsize - um->off;
+   void **slot = NULL;
+   size_t count = 0;
+   ulong va, end, pn;
+
+   if (win < 2)
+      return 0;
+
+   va = um->vaddr + (vaddr - um->vaddr) / win_sz * win_sz;
+   end = MIN3(va + win_sz,
+              um->vaddr + um->len,
+              um->vaddr + pow2_round_up_at(file_end, PAGE_SIZE));
+   pn = (um->off + (va - um->vaddr)) >> PAGE_SHIFT;
+
+   for (; va < end; va += PAGE_SIZE, pn++) {
+
+      if (slot && (pn & RAMFS_RADIX_MASK))
+         slot++;
+      else
+         slot = ramfs_get_block_slot(i, pn);
+
+      if (!slot || !*slot || is_mapped(pi->pdir, (void *)va))
+         continue;
+
+      if (map_page(pi->pdir, (void *)va, LIN_VA_TO_PA(*slot), pg_flags))
+         break; /* OOM: no big deal, that's just an optimization */
+
+      count++;
+   }
+
+   return count;
+}
+
+/*
+ * Handle a fault on a non-present page of a private mapping: map the block
+ * copy-on-write if it exists, otherwise the zero page. In both cases, the
+ * first write will make a private copy of the page: the file is never touched.
+ */
+static bool
+ramfs_handle_private_fault(struct process *pi,
+                           struct user_mapping *um,
+                           ulong vaddr,
+                           ulong abs_off)
+{
+   struct ramfs_handle *rh = um->h;
+   void **slot = ramfs_get_block_slot(rh->inode, abs_off >> PAGE_SHIFT);
+   const u32 pg_flags = ramfs_mmap_pg_flags(um);
+   int rc;
+
+   if (slot && *slot) {
+
+      rc = map_page(pi->pdir,
+                    (void *)(vaddr & PAGE_MASK),
+                    LIN_VA_TO_PA(*slot),
+                    pg_flags);
+
+   } else {
+
+      rc = map_zero_page(pi->pdir,
+                         (void *)(vaddr & PAGE_MASK),
+                         pg_flags & ~PAGING_FL_COW);
+   }
+
+   if (rc)
+      panic("Out-of-memory: unable to map a ramfs block. No OOM killer");
+
+   return true;
+}
+
+/*
+ * Handle a fault on a page of a shared mapping. A read fault on a hole maps
+ * the zero page read-only, while a write fault allocates the block, replacing
+ * the zero page, if it was mapped there by a previous read fault.
+ */
+static bool
+ramfs_handle_shared_fault(struct process *pi,
+                          struct user_mapping *um,
+                          ulong vaddr,
+                          ulong abs_off,
+                          bool p,
+                          bool rw)
+{
+   struct ramfs_handle *rh = um->h;
+   void *const page = (void *)(vaddr & PAGE_MASK);
+   const ulong pn = abs_off >> PAGE_SHIFT;
+   void **slot = ramfs_get_block_slot(rh->inode, pn);
+   int rc;
+
+   if (p) {
+
+      /*
+       * The page is present but read-only and the user code tried to write:
+       * we can do something only if that's the zero page mapped on a hole.
+       */
+      ASSERT(rw);
+
+      if (get_mapping(pi->pdir, page) != KERNEL_VA_TO_PA(&zero_page))
+         return false;
+
+      if (pdir_own_page_tables(pi->pdir, page, 1, false))
+         panic("Out-of-memory: unable to unshare a page table. No OOM killer");
+
+      unmap_page(pi->pdir, page, false);
+   }
+
+   if (!rw && !(slot && *slot)) {
+
+      if (map_zero_page(pi->pdir, page, PAGING_FL_US))
+         panic("Out-of-memory: unable to map a ramfs hole. No OOM killer");
+
+      return true;
+   }
+
+   if (rw) {
+
+      /* Create on-the-fly the block, if it doesn't exist yet */
+      if ((slot = ramfs_get_or_create_block_slot(rh->inode, pn)) && !*slot) {
+         if (ramfs_alloc_blocks(rh->inode, slot, pn, 1))
+            bzero(*slot, PAGE_SIZE);
+      }
+
+      if (!slot || !*slot)
+         panic("Out-of-memory: unable to alloc a ramfs block. No OOM killer");
+   }
+
+   rc = map_page(pi->pdir, page, LIN_VA_TO_PA(*slot), ramfs_mmap_pg_flags(um));
+
+   if (rc)
+      panic("Out-of-memory: unable to map a ramfs block. No OOM killer");
+
+   return true;
+}
+
 static bool
 ramfs_handle_fault_int(struct process *pi,
                        struct user_mapping *um,
@@ -84,44 +297,37 @@ ramfs_handle_fault_int(struct process *pi,
    struct ramfs_handle *rh = um->h;
    ulong vaddr = (ulong) vaddrp;
    ulong abs_off;
-   struct ramfs_block *block;
-   int rc;
+   bool ok;
 
    ASSERT(um != NULL);
 
-   if (p) {
+   if (p && (um->flags & MAP_PRIVATE)) {
 
       /*
        * The page is present, just is read-only and the user code tried to
-       * write: there's nothing we can do.
+       * write: there's nothing we can do (COW pages never get here).
        */
 
       ASSERT(rw);
-      ASSERT((um->prot & PROT_WRITE) == 0);
       return false;
    }
 
-   /* The page is *not* present */
    abs_off = um->off + (vaddr - um->vaddr);
 
    if (abs_off >= (ulong)rh->inode->fsize)
       return false; /* Read/write past EOF */
 
-   if (rw) {
-      /* Create and map on-the-fly a struct ramfs_block */
-      if (!(block = ramfs_new_block((offt)(abs_off & PAGE_MASK))))
-         panic("Out-of-memory: unable to alloc a ramfs_block. No OOM killer");
-
-      ramfs_append_new_block(rh->inode, block);
-   }
+   if (um->flags & MAP_PRIVATE)
+      ok = ramfs_handle_private_fault(pi, um, vaddr, abs_off);
+   else
+      ok = ramfs_handle_shared_fault(pi, um, vaddr, abs_off, p, rw);
 
-   rc = map_page(pi->pdir,
-                 (void *)(vaddr & PAGE_MASK),
-                 rw ? LIN_VA_TO_PA(block->vaddr) : KERNEL_VA_TO_PA(&zero_page),
-                 PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
+   if (!ok)
+      return false;
 
-   if (rc)
-      panic("Out-of-memory: unable to map a ramfs_block. No OOM killer");
+   ramfs_fault_stats.faults++;
+   ramfs_fault_stats.pages +=
+      1 + ramfs_map_fault_around(pi, um, vaddr, ramfs_mmap_pg_flags(um));
 
    invalidate_page(vaddr);
    return true;
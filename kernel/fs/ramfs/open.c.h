@@ -25,7 +25,7 @@ ramfs_open_int(struct mnt_fs *fs,
       return -ENOMEM;
 
    h->inode = inode;
-   h->spec_flags = VFS_SPFL_MMAP_SUPPORTED;
+   h->spec_flags = VFS_SPFL_MMAP_SUPPORTED | VFS_SPFL_NO_USER_COPY;
    retain_obj(inode);
 
    if (inode->type == VFS_DIR) {
@@ -114,7 +114,7 @@ ramfs_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mod)
          return rc;
       }
 
-      if ((rc = ramfs_dir_add_entry(idir, p->last_comp, i))) {
+      if ((rc = ramfs_dir_add_entry(d, idir, p->last_comp, i))) {
          ramfs_destroy_inode(d, i);
          return rc;
       }
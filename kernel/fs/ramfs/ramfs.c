@@ -7,6 +7,7 @@
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/fs/ramfs.h>
 #include <tilck/kernel/test/vfs.h>
 
 #include <sys/mman.h>      // system header
@@ -14,6 +15,7 @@
 #include "ramfs_int.h"
 #include "getdents.c.h"
 #include "locking.c.h"
+#include "arena.c.h"
 #include "dir_entries.c.h"
 #include "inodes.c.h"
 #include "stat.c.h"
@@ -45,7 +47,7 @@ static int ramfs_unlink(struct vfs_path *p)
    ASSERT(rp->dir_entry != NULL);
 
    /* Remove the dir entry */
-   ramfs_dir_remove_entry(idir, rp->dir_entry);
+   ramfs_dir_remove_entry(d, idir, rp->dir_entry);
 
    /* Trucate and delete the inode, if it's not used */
    if (!i->nlink && !get_ref_count(i)) {
@@ -169,7 +171,7 @@ static int ramfs_symlink(const char *target, struct vfs_path *lp)
    if (!n)
       return -ENOSPC;
 
-   return ramfs_dir_add_entry(lp->fs_path.dir_inode, lp->last_comp, n);
+   return ramfs_dir_add_entry(d, lp->fs_path.dir_inode, lp->last_comp, n);
 }
 
 /* NOTE: `buf` is guaranteed to have room for at least MAX_PATH chars */
@@ -234,9 +236,9 @@ ramfs_rename(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
 {
    struct ramfs_path *oldp = (void *)&voldp->fs_path;
    struct ramfs_path *newp = (void *)&vnewp->fs_path;
+   struct ramfs_data *d = fs->device_data;
    int rc;
 
-   DEBUG_ONLY_UNSAFE(struct ramfs_data *d = fs->device_data);
    ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
 
    if (newp->inode != NULL) {
@@ -259,7 +261,7 @@ ramfs_rename(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
       }
    }
 
-   rc = ramfs_dir_add_entry(newp->dir_inode, vnewp->last_comp, oldp->inode);
+   rc = ramfs_dir_add_entry(d, newp->dir_inode, vnewp->last_comp, oldp->inode);
 
    if (rc) {
 
@@ -279,7 +281,7 @@ ramfs_rename(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
    }
 
    /* Finally, this operation cannot fail. */
-   ramfs_dir_remove_entry(oldp->dir_inode, oldp->dir_entry);
+   ramfs_dir_remove_entry(d, oldp->dir_inode, oldp->dir_entry);
    return 0;
 }
 
@@ -295,7 +297,10 @@ ramfs_link(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
    if (newp->inode != NULL)
       return -EEXIST;
 
-   return ramfs_dir_add_entry(newp->dir_inode, vnewp->last_comp, oldp->inode);
+   return ramfs_dir_add_entry(fs->device_data,
+                              newp->dir_inode,
+                              vnewp->last_comp,
+                              oldp->inode);
 }
 
 int ramfs_futimens(struct mnt_fs *fs,
@@ -347,7 +352,10 @@ struct mnt_fs *ramfs_create(void)
    if (!(d = kzalloc_obj(struct ramfs_data)))
       return NULL;
 
-   fs = create_fs_obj("ramfs", &static_fsops_ramfs, d, VFS_FS_RW);
+   fs = create_fs_obj("ramfs",
+                      &static_fsops_ramfs,
+                      d,
+                      VFS_FS_RW | VFS_FS_DCACHE);
 
    if (!fs) {
       kfree_obj(d, struct ramfs_data);
@@ -355,6 +363,7 @@ struct mnt_fs *ramfs_create(void)
    }
 
    rwlock_wp_init(&d->rwlock, false);
+   ramfs_arena_init(&d->entries_arena);
    d->next_inode_num = 1;
    d->root = ramfs_create_inode_dir(d, 0777, NULL);
 
@@ -20,38 +20,49 @@
 
 struct ramfs_inode;
 
-struct ramfs_block {
+/*
+ * Radix tree node of the per-inode block index (see blocks.c.h). In leaf
+ * nodes, the slots point to page-size data blocks (NULL for holes), while in
+ * the other nodes they point to the nodes below.
+ */
+#define RAMFS_RADIX_BITS                6
+#define RAMFS_RADIX_SLOTS               (1u << RAMFS_RADIX_BITS)
+#define RAMFS_RADIX_MASK                (RAMFS_RADIX_SLOTS - 1)
 
-   struct bintree_node node;
-   offt offset;                  /* MUST BE divisible by PAGE_SIZE */
-   void *vaddr;
+struct ramfs_radix_node {
+   void *slots[RAMFS_RADIX_SLOTS];
 };
 
 /*
- * Ramfs entries do not *necessarily* need to have a fixed size, as they are
- * allocated dynamically on the heap. Said that, a fixed-size entry struct is
- * simpler to manage and faster to alloc/free, in particular with Tilck's
- * current kmalloc implementation.
+ * Ramfs directory entries have a variable size, depending on the length of
+ * their name, and are allocated from the per-fs entries arena (see
+ * arena.c.h), in size classes of RAMFS_ARENA_GRANULE bytes.
  */
-#define RAMFS_ENTRY_SIZE 256
-#define RAMFS_ENTRY_MAX_LEN (                   \
-   RAMFS_ENTRY_SIZE                             \
-   - sizeof(struct bintree_node)                \
-   - sizeof(struct list_node)                   \
-   - sizeof(struct ramfs_inode *)               \
-   - sizeof(u8)                                 \
-)
+#define RAMFS_ENTRY_MAX_LEN            255   /* includes the final \0 */
 
 struct ramfs_entry {
 
-   struct bintree_node node;
+   struct ramfs_entry *hnext;       /* next entry in the same hash bucket */
    struct list_node lnode;
    struct ramfs_inode *inode;
+   u32 hash;
    u8 name_len;                     /* NOTE: includes the final \0 */
-   char name[RAMFS_ENTRY_MAX_LEN];
+   char name[];
 };
 
-STATIC_ASSERT(sizeof(struct ramfs_entry) == RAMFS_ENTRY_SIZE);
+#define RAMFS_ENTRY_SIZE(name_len) (sizeof(struct ramfs_entry) + (name_len))
+
+#define RAMFS_ARENA_GRANULE             16
+#define RAMFS_ARENA_CLASSES                                             \
+   (                                                                    \
+      (RAMFS_ENTRY_SIZE(RAMFS_ENTRY_MAX_LEN) + RAMFS_ARENA_GRANULE - 1) \
+      / RAMFS_ARENA_GRANULE                                             \
+   )
+
+struct ramfs_arena {
+   struct list partial[RAMFS_ARENA_CLASSES]; /* pages with free slots */
+   size_t pages_count;
+};
 
 struct ramfs_inode {
 
@@ -75,14 +86,16 @@ struct ramfs_inode {
       /* valid when type == VFS_FILE */
       struct {
          offt fsize;
-         struct ramfs_block *blocks_tree_root;
+         struct ramfs_radix_node *blocks_root;
+         u32 blocks_height;            /* 0 when blocks_root is NULL */
       };
 
       /* valid when type == VFS_DIR */
       struct {
          offt num_entries;
-         struct ramfs_entry *entries_tree_root;
-         struct list entries_list;
+         struct ramfs_entry **buckets;   /* hash table of the entries */
+         u32 buckets_count;              /* always a power of 2 */
+         struct list entries_list;       /* entries in creation order */
          struct list handles_list;
       };
 
@@ -121,6 +134,7 @@ struct ramfs_data {
 
    tilck_ino_t next_inode_num;
    struct ramfs_inode *root;
+   struct ramfs_arena entries_arena;
 };
 
 CREATE_FS_PATH_STRUCT(ramfs_path, struct ramfs_inode *, struct ramfs_entry *);
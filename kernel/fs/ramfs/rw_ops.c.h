@@ -151,13 +151,33 @@ static offt ramfs_seek(fs_handle h, offt off, int whence)
  * Case 3) is the same as case 2) with the exception that `voff` is just 0.
  */
 
-static void ramfs_unmap_past_eof_mappings(struct ramfs_inode *i, size_t len)
+static int ramfs_unmap_past_eof_mappings(struct ramfs_inode *i, size_t len)
 {
    const size_t rlen = pow2_round_up_at(len, PAGE_SIZE);
    struct user_mapping *um;
    ulong va;
    ASSERT(!is_preemption_enabled());
 
+   /*
+    * First, make sure that no unmap will need memory: that way, we can fail
+    * before having changed anything.
+    */
+   list_for_each_ro(um, &i->mappings_list, inode_node) {
+
+      if (um->off + um->len <= rlen)
+         continue;
+
+      const ulong voff = rlen >= um->off ? rlen - um->off : 0;
+
+      if (pdir_own_page_tables(um->pi->pdir,
+                               (void *)(um->vaddr + voff),
+                               (um->len - voff) >> PAGE_SHIFT,
+                               false))
+      {
+         return -ENOMEM;
+      }
+   }
+
    list_for_each_ro(um, &i->mappings_list, inode_node) {
 
       if (um->off + um->len <= rlen)
@@ -165,16 +185,20 @@ static void ramfs_unmap_past_eof_mappings(struct ramfs_inode *i, size_t len)
 
       const ulong voff = rlen >= um->off ? rlen - um->off : 0;
       const ulong vend = um->vaddr + um->len;
+      const bool do_free = !!(um->flags & MAP_PRIVATE); /* copies on write */
 
       for (va = um->vaddr + voff; va < vend; va += PAGE_SIZE) {
-         unmap_page_permissive(um->pi->pdir, (void *)va, false);
+         unmap_page_permissive(um->pi->pdir, (void *)va, do_free);
          invalidate_page(va);
       }
    }
+
+   return 0;
 }
 
 static int ramfs_inode_truncate(struct ramfs_inode *i, offt len)
 {
+   int rc;
    ASSERT(rwlock_wp_holding_exlock(&i->rwlock));
 
    if (len < 0 || len >= i->fsize)
@@ -193,30 +217,15 @@ static int ramfs_inode_truncate(struct ramfs_inode *i, offt len)
 
    disable_preemption();
    {
-      ramfs_unmap_past_eof_mappings(i, (size_t) len);
+      rc = ramfs_unmap_past_eof_mappings(i, (size_t) len);
    }
    enable_preemption();
 
-   while (true) {
-
-      struct ramfs_block *b =
-         bintree_get_last_obj(i->blocks_tree_root, struct ramfs_block, node);
-
-      if (!b || b->offset < len)
-         break;
-
-      /* Remove the block object from the tree */
-      bintree_remove_ptr(&i->blocks_tree_root,
-                         b,
-                         struct ramfs_block,
-                         node,
-                         offset);
-
-      ramfs_destroy_block(b);
-   }
+   if (rc)
+      return rc;
 
+   ramfs_truncate_blocks(i, (ulong)DIV_ROUND_UP(len, PAGE_SIZE));
    i->fsize = len;
-   i->blocks_count = pow2_round_up_at((ulong) len, PAGE_SIZE);
    return 0;
 }
 
@@ -248,12 +257,47 @@ static int ramfs_truncate(struct mnt_fs *fs, vfs_inode_ptr_t i, offt len)
    return ramfs_inode_truncate_safe(i, len, false);
 }
 
+/*
+ * ramfs handles have VFS_SPFL_NO_USER_COPY set: sys_read() and friends pass
+ * user buffers directly to us, after checking they're below BASE_VA. That
+ * allows us to copy data between the blocks and the user memory with a
+ * single memcpy() and without splitting large requests in IO_COPYBUF_SIZE
+ * chunks. Buffers coming from the kernel itself are always above BASE_VA.
+ */
+static ALWAYS_INLINE bool ramfs_is_user_buf(const void *buf)
+{
+#ifndef UNIT_TEST_ENVIRONMENT
+   return (ulong)buf < BASE_VA;
+#else
+   return false; /* in unit tests, all the buffers are regular host buffers */
+#endif
+}
+
+static int ramfs_copy_to_buf(char *dest, const void *src, size_t n)
+{
+   if (ramfs_is_user_buf(dest))
+      return copy_to_user(dest, src, n);
+
+   memcpy(dest, src, n);
+   return 0;
+}
+
+static int ramfs_copy_from_buf(void *dest, const char *src, size_t n)
+{
+   if (ramfs_is_user_buf(src))
+      return copy_from_user(dest, src, n);
+
+   memcpy(dest, src, n);
+   return 0;
+}
+
 static ssize_t
 ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 {
    struct ramfs_inode *inode = rh->inode;
    offt tot_read = 0;
    offt buf_rem = (offt) len;
+   void **slot = NULL;
 
    if (inode->type == VFS_DIR)
       return -EISDIR;
@@ -262,12 +306,13 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 
    while (buf_rem > 0) {
 
-      struct ramfs_block *block;
-      const offt page     = *pos & (offt)PAGE_MASK;
+      const ulong pn      = (ulong)(*pos >> PAGE_SHIFT);
       const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
       const offt page_rem = (offt)PAGE_SIZE - page_off;
       const offt file_rem = inode->fsize - *pos;
-      const offt to_read  = MIN3(page_rem, buf_rem, file_rem);
+      const offt tot_rem  = MIN(buf_rem, file_rem);
+      offt to_read        = MIN(page_rem, tot_rem);
+      const char *src     = zero_page;          /* reading a hole */
 
       if (*pos >= inode->fsize)
          break;
@@ -277,20 +322,27 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
       if (!to_read)
          break;
 
-      block = bintree_find_ptr(inode->blocks_tree_root,
-                               page,
-                               struct ramfs_block,
-                               node,
-                               offset);
+      /* Walk the leaf's slots, looking up the tree only when necessary */
+      if (slot && (pn & RAMFS_RADIX_MASK))
+         slot++;
+      else
+         slot = ramfs_get_block_slot(inode, pn);
 
-      if (block) {
-         /* reading a regular block */
-         memcpy(buf + tot_read, block->vaddr + page_off, (size_t)to_read);
-      } else {
-         /* reading a hole */
-         memset(buf + tot_read, 0, (size_t)to_read);
+      if (slot && *slot) {
+
+         /* Read in one go all the following blocks contiguous in memory */
+         const size_t n =
+            ramfs_contig_blocks(slot, pn, DIV_ROUND_UP(page_off + tot_rem,
+                                                       PAGE_SIZE));
+
+         src = (char *)*slot + page_off;
+         to_read = MIN(((offt)n << PAGE_SHIFT) - page_off, tot_rem);
+         slot += n - 1;
       }
 
+      if (ramfs_copy_to_buf(buf + tot_read, src, (size_t)to_read))
+         return tot_read > 0 ? (ssize_t)tot_read : -EFAULT;
+
       tot_read += to_read;
       *pos  += to_read;
       buf_rem  -= to_read;
@@ -318,6 +370,7 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
    struct ramfs_inode *inode = rh->inode;
    offt tot_written = 0;
    offt buf_rem = (offt)len;
+   void **slot = NULL;
 
    /* We can be sure it's a file because dirs cannot be open for writing */
    ASSERT(inode->type == VFS_FILE);
@@ -327,32 +380,63 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 
    while (buf_rem > 0) {
 
-      struct ramfs_block *block;
-      const offt page     = *pos & (offt)PAGE_MASK;
+      const ulong pn      = (ulong)(*pos >> PAGE_SHIFT);
       const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
-      const offt page_rem = (offt)PAGE_SIZE - page_off;
-      const offt to_write = MIN(page_rem, buf_rem);
+      const size_t pages  = DIV_ROUND_UP((size_t)(page_off + buf_rem),
+                                         PAGE_SIZE);
+      offt to_write;
+      char *dest;
+      size_t n;
+
+      if (slot && (pn & RAMFS_RADIX_MASK))
+         slot++;
+      else if (!(slot = ramfs_get_or_create_block_slot(inode, pn)))
+         break;
 
-      ASSERT(to_write > 0);
+      if (!*slot) {
 
-      block = bintree_find_ptr(inode->blocks_tree_root,
-                               page,
-                               struct ramfs_block,
-                               node,
-                               offset);
+         /*
+          * Allocate at once blocks for all the following pages we're going
+          * to write, as long as they don't have a block yet. Zero only the
+          * parts of the new blocks we're not going to overwrite.
+          */
 
-      /* Assert that if page_off > 0, the block is present */
-      ASSERT(!page_off || block);
+         n = 0;
 
-      if (!block) {
+         if (ramfs_covers_big_extent(pn, pages))
+            n = ramfs_alloc_big_extent(inode, pn);
 
-         if (!(block = ramfs_new_block(page)))
+         if (!n && !(n = ramfs_alloc_blocks(inode, slot, pn, pages)))
             break;
 
-         ramfs_append_new_block(inode, block);
+         dest = *slot;
+         bzero(dest, (size_t)page_off);
+
+         if ((offt)(n << PAGE_SHIFT) > page_off + buf_rem) {
+            bzero(dest + page_off + buf_rem,
+                  (n << PAGE_SHIFT) - (size_t)(page_off + buf_rem));
+         }
+      }
+
+      /* Write in one go all the following blocks contiguous in memory */
+      n = ramfs_contig_blocks(slot, pn, pages);
+      dest = (char *)*slot + page_off;
+      to_write = MIN(((offt)n << PAGE_SHIFT) - page_off, buf_rem);
+      slot += n - 1;
+
+      if (ramfs_copy_from_buf(dest, buf + tot_written, (size_t)to_write)) {
+
+         /* Don't leave garbage past EOF */
+         if (*pos + to_write > inode->fsize) {
+
+            const offt eof_off = MAX(inode->fsize - *pos, 0);
+
+            bzero(dest + eof_off, (size_t)(to_write - eof_off));
+         }
+
+         return tot_written > 0 ? (ssize_t)tot_written : -EFAULT;
       }
 
-      memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
       tot_written += to_write;
       buf_rem     -= to_write;
       *pos     += to_write;
@@ -383,24 +467,23 @@ static ssize_t ramfs_write(fs_handle h, char *buf, size_t len, offt *pos)
 static ssize_t
 ramfs_readv_nolock(struct ramfs_handle *rh, const struct iovec *iov, int iovcnt)
 {
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
-      rc = ramfs_read_nolock(rh, curr->io_copybuf, len, &rh->h_fpos);
+      if (user_out_of_range(iov[i].iov_base, iov[i].iov_len)) {
+         ret = ret > 0 ? ret : -EFAULT;
+         break;
+      }
+
+      rc = ramfs_read_nolock(rh, iov[i].iov_base, iov[i].iov_len, &rh->h_fpos);
 
       if (rc < 0) {
-         ret = rc;
+         ret = ret > 0 ? ret : rc;
          break;
       }
 
-      if (copy_to_user(iov[i].iov_base, curr->io_copybuf, len))
-         return -EFAULT;
-
       ret += rc;
 
       if (rc < (ssize_t)iov[i].iov_len)
@@ -427,22 +510,20 @@ ramfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
 static ssize_t
 ramfs_writev_nolock(struct ramfs_handle *h, const struct iovec *iov, int iovcnt)
 {
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
-
-      if (copy_from_user(curr->io_copybuf, iov[i].iov_base, len))
-         return -EFAULT;
+      if (user_out_of_range(iov[i].iov_base, iov[i].iov_len)) {
+         ret = ret > 0 ? ret : -EFAULT;
+         break;
+      }
 
-      rc = ramfs_write_nolock(h, curr->io_copybuf, len, &h->h_fpos);
+      rc = ramfs_write_nolock(h, iov[i].iov_base, iov[i].iov_len, &h->h_fpos);
 
       if (rc < 0) {
-         ret = rc;
+         ret = ret > 0 ? ret : rc;
          break;
       }
 
@@ -11,10 +11,12 @@
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/epoll.h>
 
 #include <dirent.h> // system header
 
 #include "../fs_int.h"
+#include "vfs_dcache.c.h"
 #include "vfs_mp.c.h"
 #include "vfs_locking.c.h"
 #include "vfs_resolve.c.h"
@@ -39,6 +41,9 @@ void vfs_close(fs_handle h)
    if (!pi->vforked)
       remove_all_mappings_of_handle(pi, h);
 
+   if (hb->spec_flags & VFS_SPFL_EPOLL_WATCHED)
+      epoll_on_handle_close(h);
+
    if (fsops->on_close)
       fsops->on_close(h);
 
@@ -97,6 +102,9 @@ int vfs_dup(fs_handle h, fs_handle *dup_h)
    /* The new file descriptor does NOT share old file descriptor's fd_flags */
    new_handle->fd_flags = 0;
 
+   /* Nor it's watched by the epoll instances watching the old one */
+   new_handle->spec_flags &= (u16)~VFS_SPFL_EPOLL_WATCHED;
+
    /* Check that the locked_file object (if any) is still the same */
    ASSERT(new_handle->lf == hb->lf);
 
@@ -927,6 +935,7 @@ create_fs_obj(const char *type,
 void destory_fs_obj(struct mnt_fs *fs)
 {
    ASSERT(!fs->pss_lock_root);
+   vfs_dcache_flush(fs);
    kfree_obj(fs, struct mnt_fs);
 }
 
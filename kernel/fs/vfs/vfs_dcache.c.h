@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Dentry cache
+ * ---------------
+ *
+ * Kernel-wide cache of the get_entry() results used by the path resolver,
+ * keyed by (fs, dir inode, name). It stores both positive entries and
+ * negative ones (inode == NULL), plus a flag telling whether the inode is
+ * the host of a mountpoint, so that a hit saves both the get_entry() call and
+ * the mountpoint lookup.
+ *
+ * Only filesystems having the VFS_FS_DCACHE flag are cached: each of them
+ * must call vfs_dcache_invalidate() every time an entry is added to or
+ * removed from a directory, and vfs_dcache_invalidate_dir() before destroying
+ * a directory inode. The "." and ".." entries are never cached, as they
+ * depend on the place of a directory in the tree.
+ *
+ * The entries are allocated from a static pool and recycled in LRU order.
+ * The cache is protected by disabling the preemption, as all the operations
+ * are short and never sleep. Lookups and insertions always run while holding
+ * at least a shared lock on the fs, while the invalidations from the fs run
+ * with the exclusive lock: therefore, they cannot race. Mountpoint changes,
+ * instead, are not serialized with the resolver: that's why an insertion is
+ * discarded when the cache has been flushed after its get_entry() call.
+ */
+
+#define VFS_DCACHE_ENTRIES             512
+#define VFS_DCACHE_BUCKETS             256
+#define VFS_DCACHE_NAME_LEN             32
+
+struct vfs_dentry {
+
+   struct list_node hnode;          /* node in the hash bucket */
+   struct list_node lru_node;       /* node in dcache_lru */
+
+   struct mnt_fs *fs;               /* NULL for unused entries */
+   vfs_inode_ptr_t dir;
+   struct fs_path fs_path;
+   u32 hash;
+   u8 name_len;
+   bool mp;                         /* fs_path.inode hosts a mountpoint */
+   char name[VFS_DCACHE_NAME_LEN];
+};
+
+static struct vfs_dentry dcache_entries[VFS_DCACHE_ENTRIES];
+static struct list dcache_buckets[VFS_DCACHE_BUCKETS];
+static struct list dcache_lru;  /* least recently used entries first */
+static u32 dcache_gen;          /* incremented on each flush, 0 before init */
+
+static u32
+vfs_dcache_hash(vfs_inode_ptr_t dir, const char *name, size_t len)
+{
+   u32 h = 2166136261u ^ (u32)((ulong)dir >> 3);   /* FNV-1a */
+
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ (u8)name[i]) * 16777619u;
+
+   return h;
+}
+
+static inline struct list *vfs_dcache_bucket(u32 hash)
+{
+   return &dcache_buckets[hash & (VFS_DCACHE_BUCKETS - 1)];
+}
+
+static inline bool
+vfs_dcache_is_cacheable(struct mnt_fs *fs, const char *name, size_t len)
+{
+   if (~fs->flags & VFS_FS_DCACHE)
+      return false;
+
+   if (len > VFS_DCACHE_NAME_LEN)
+      return false;
+
+   return !is_dot_or_dotdot(name, (int)len);
+}
+
+static inline bool
+vfs_dentry_match(struct vfs_dentry *e,
+                 vfs_inode_ptr_t dir,
+                 const char *name,
+                 size_t len,
+                 u32 hash)
+{
+   return e->hash == hash &&
+          e->dir == dir &&
+          e->name_len == len &&
+          !memcmp(e->name, name, len);
+}
+
+/* Drops the entry and makes it the first one to be recycled */
+static void vfs_dcache_drop(struct vfs_dentry *e)
+{
+   ASSERT(e->fs != NULL);
+
+   list_remove(&e->hnode);
+   list_remove(&e->lru_node);
+   list_add_head(&dcache_lru, &e->lru_node);
+   e->fs = NULL;
+}
+
+/*
+ * Looks for the entry `name` in the dir `dir`. In case of hit, it fills
+ * `fs_path` and `mp` and returns true.
+ */
+static bool
+vfs_dcache_lookup(struct mnt_fs *fs,
+                  vfs_inode_ptr_t dir,
+                  const char *name,
+                  size_t len,
+                  struct fs_path *fs_path,
+                  bool *mp)
+{
+   struct vfs_dentry *e;
+   bool found = false;
+   u32 hash;
+
+   if (!vfs_dcache_is_cacheable(fs, name, len))
+      return false;
+
+   hash = vfs_dcache_hash(dir, name, len);
+   disable_preemption();
+   {
+      list_for_each_ro(e, vfs_dcache_bucket(hash), hnode) {
+
+         if (e->fs == fs && vfs_dentry_match(e, dir, name, len, hash)) {
+
+            *fs_path = e->fs_path;
+            *mp = e->mp;
+            list_remove(&e->lru_node);
+            list_add_tail(&dcache_lru, &e->lru_node);
+            found = true;
+            break;
+         }
+      }
+   }
+   enable_preemption();
+   return found;
+}
+
+static inline u32 vfs_dcache_get_gen(void)
+{
+   return dcache_gen;
+}
+
+/*
+ * Caches the result of a get_entry() call made after reading `gen` with
+ * vfs_dcache_get_gen(). The caller must have checked the cache before, so
+ * the entry is assumed to be missing.
+ */
+static void
+vfs_dcache_insert(struct mnt_fs *fs,
+                  vfs_inode_ptr_t dir,
+                  const char *name,
+                  size_t len,
+                  struct fs_path *fs_path,
+                  bool mp,
+                  u32 gen)
+{
+   struct vfs_dentry *e;
+   u32 hash;
+
+   if (!vfs_dcache_is_cacheable(fs, name, len))
+      return;
+
+   hash = vfs_dcache_hash(dir, name, len);
+   disable_preemption();
+
+   /* Skip the insert if the cache has been flushed after get_entry() */
+   if (gen == dcache_gen) {
+
+      /* Recycle the least recently used entry */
+      e = list_first_obj(&dcache_lru, struct vfs_dentry, lru_node);
+
+      if (e->fs)
+         list_remove(&e->hnode);
+
+      e->fs = fs;
+      e->dir = dir;
+      e->fs_path = *fs_path;
+      e->hash = hash;
+      e->name_len = (u8)len;
+      e->mp = mp;
+      memcpy(e->name, name, len);
+
+      list_add_tail(vfs_dcache_bucket(hash), &e->hnode);
+      list_remove(&e->lru_node);
+      list_add_tail(&dcache_lru, &e->lru_node);
+   }
+
+   enable_preemption();
+}
+
+void vfs_dcache_invalidate(vfs_inode_ptr_t dir, const char *name, size_t len)
+{
+   struct vfs_dentry *e, *temp;
+   const u32 hash = vfs_dcache_hash(dir, name, len);
+
+   if (UNLIKELY(!dcache_gen))
+      return; /* vfs_dcache_init() has not been called yet */
+
+   disable_preemption();
+   {
+      list_for_each(e, temp, vfs_dcache_bucket(hash), hnode) {
+         if (vfs_dentry_match(e, dir, name, len, hash))
+            vfs_dcache_drop(e);
+      }
+   }
+   enable_preemption();
+}
+
+void vfs_dcache_invalidate_dir(vfs_inode_ptr_t dir)
+{
+   disable_preemption();
+   {
+      for (int i = 0; i < VFS_DCACHE_ENTRIES; i++) {
+
+         struct vfs_dentry *e = &dcache_entries[i];
+
+         if (e->fs && e->dir == dir)
+            vfs_dcache_drop(e);
+      }
+   }
+   enable_preemption();
+}
+
+/* Drops all the entries of `fs` or, when `fs` is NULL, the whole cache */
+void vfs_dcache_flush(struct mnt_fs *fs)
+{
+   disable_preemption();
+   {
+      dcache_gen++;
+
+      for (int i = 0; i < VFS_DCACHE_ENTRIES; i++) {
+
+         struct vfs_dentry *e = &dcache_entries[i];
+
+         if (e->fs && (!fs || e->fs == fs))
+            vfs_dcache_drop(e);
+      }
+   }
+   enable_preemption();
+}
+
+static void vfs_dcache_init(void)
+{
+   list_init(&dcache_lru);
+
+   for (int i = 0; i < VFS_DCACHE_BUCKETS; i++)
+      list_init(&dcache_buckets[i]);
+
+   for (int i = 0; i < VFS_DCACHE_ENTRIES; i++) {
+
+      struct vfs_dentry *e = &dcache_entries[i];
+
+      e->fs = NULL;
+      list_node_init(&e->hnode);
+      list_add_tail(&dcache_lru, &e->lru_node);
+   }
+
+   dcache_gen++;
+}
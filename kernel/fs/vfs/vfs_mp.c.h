@@ -13,6 +13,7 @@ int mp_init(struct mnt_fs *root_fs)
    bzero(mps2, sizeof(mps2));
 #endif
 
+   vfs_dcache_init();
    mp_root = root_fs;
    retain_obj(mp_root);
    return 0;
@@ -133,6 +134,9 @@ int mp_add(struct mnt_fs *target_fs, const char *target_path)
       /* Now that we've succeeded, we must retain the target_fs as well */
       retain_obj(target_fs);
 
+      /* The dcache entries of the host fs might hide the new mountpoint */
+      vfs_dcache_flush(p.fs);
+
    } else {
 
       /* no free slot, sorry */
@@ -68,10 +68,25 @@ __vfs_resolve_get_entry(vfs_inode_ptr_t idir,
                         struct vfs_path *rp,
                         bool exlock)
 {
-   vfs_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
-   rp->last_comp = pc;
+   const size_t len = (size_t)(path - pc);
+   struct mnt_fs *target_fs = NULL;
+   bool mp = false;
+   u32 gen;
+
+   if (!vfs_dcache_lookup(rp->fs, idir, pc, len, &rp->fs_path, &mp)) {
+
+      gen = vfs_dcache_get_gen();
+      vfs_get_entry(rp->fs, idir, pc, (ssize_t)len, &rp->fs_path);
+      target_fs = mp_get_retained_at(rp->fs, rp->fs_path.inode);
+      vfs_dcache_insert(rp->fs, idir, pc, len, &rp->fs_path, !!target_fs, gen);
+
+   } else if (mp) {
 
-   struct mnt_fs *target_fs = mp_get_retained_at(rp->fs, rp->fs_path.inode);
+      /* Cache hit on a mountpoint: we still need the target fs */
+      target_fs = mp_get_retained_at(rp->fs, rp->fs_path.inode);
+   }
+
+   rp->last_comp = pc;
 
    if (target_fs) {
 
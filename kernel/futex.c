@@ -0,0 +1,368 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/futex.h>
+
+#include <linux/futex.h> // system header
+
+/*
+ * futex
+ * ---------
+ *
+ * A futex is just an aligned u32 in user space: the user code takes the fast
+ * path with atomic operations on it and enters the kernel only when it has
+ * to sleep (FUTEX_WAIT) or to wake up someone else (FUTEX_WAKE). Therefore,
+ * the kernel keeps a state only for the futexes having at least one waiter:
+ * a `struct futex` object, keyed by (pdir, user vaddr), holding the kcond
+ * the waiters sleep on. The objects live in a small hash table and are freed
+ * as soon as their wait list gets empty.
+ *
+ * The waiters store their bitset in the `extra` field of their wait object:
+ * that's how FUTEX_WAKE_BITSET can wake up only some of them. FUTEX_WAIT and
+ * FUTEX_WAKE use FUTEX_BITSET_MATCH_ANY.
+ *
+ * All of that is protected by the global `futex_lock`. Since FUTEX_WAIT
+ * checks the user value and then enqueues the current task while holding
+ * it, and FUTEX_WAKE takes it too, no wake-up can get lost in between.
+ */
+
+#define FUTEX_HASH_BITS                  6
+#define FUTEX_HASH_SIZE                  (1 << FUTEX_HASH_BITS)
+
+struct futex {
+
+   struct list_node node;              /* node in futex_table[] */
+   pdir_t *pdir;
+   ulong uaddr;
+   struct kcond cond;
+};
+
+static struct kmutex futex_lock = STATIC_KMUTEX_INIT(futex_lock, 0);
+static struct list futex_table[FUTEX_HASH_SIZE];
+static bool futex_table_initialized;
+
+static ALWAYS_INLINE struct list *futex_bucket(pdir_t *pdir, ulong uaddr)
+{
+   const ulong h = (uaddr >> 2) ^ ((ulong)pdir >> PAGE_SHIFT);
+   return &futex_table[h & (FUTEX_HASH_SIZE - 1)];
+}
+
+/* Free `f` when nobody is waiting on it anymore */
+static void futex_put(struct futex *f)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&futex_lock));
+
+   if (kcond_is_anyone_waiting(&f->cond))
+      return;
+
+   list_remove(&f->node);
+   kcond_destory(&f->cond);
+   kfree_obj(f, struct futex);
+}
+
+static struct futex *futex_lookup(pdir_t *pdir, ulong uaddr, bool create)
+{
+   struct list *bucket;
+   struct futex *pos, *temp, *f = NULL;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&futex_lock));
+
+   if (UNLIKELY(!futex_table_initialized)) {
+
+      for (int i = 0; i < FUTEX_HASH_SIZE; i++)
+         list_init(&futex_table[i]);
+
+      futex_table_initialized = true;
+   }
+
+   bucket = futex_bucket(pdir, uaddr);
+
+   list_for_each(pos, temp, bucket, node) {
+
+      if (pos->pdir == pdir && pos->uaddr == uaddr) {
+         f = pos;
+         continue;
+      }
+
+      /*
+       * Objects left with no waiters by tasks killed while sleeping on them:
+       * free them here, while we're walking the bucket anyway.
+       */
+      futex_put(pos);
+   }
+
+   if (f || !create)
+      return f;
+
+   if (!(f = kzalloc_obj(struct futex)))
+      return NULL;
+
+   f->pdir = pdir;
+   f->uaddr = uaddr;
+   list_node_init(&f->node);
+   kcond_init(&f->cond);
+   list_add_tail(bucket, &f->node);
+   return f;
+}
+
+static int
+futex_wait(u32 *uaddr, u32 val, u32 bitset, bool has_timeout, u64 ticks)
+{
+   struct task *curr = get_curr_task();
+   struct kcond *c;
+   struct futex *f;
+   u32 uval;
+   int rc = 0;
+
+   kmutex_lock(&futex_lock);
+
+   if (copy_from_user(&uval, uaddr, sizeof(uval))) {
+      rc = -EFAULT;
+      goto out;
+   }
+
+   if (uval != val) {
+      rc = -EAGAIN;
+      goto out;
+   }
+
+   if (has_timeout && !ticks) {
+      rc = -ETIMEDOUT;
+      goto out;
+   }
+
+   if (!(f = futex_lookup(get_curr_proc()->pdir, (ulong)uaddr, true))) {
+      rc = -ENOMEM;
+      goto out;
+   }
+
+   disable_preemption();
+   prepare_to_wait_on(WOBJ_KCOND, &f->cond, bitset, &f->cond.wait_list);
+
+   if (has_timeout)
+      task_set_wakeup_timer(curr, (u32)MIN(ticks, (u64)0xffffffff));
+
+   kmutex_unlock(&futex_lock);
+   enter_sleep_wait_state();
+
+   /* ------------------- We've been woken up ------------------- */
+
+   kmutex_lock(&futex_lock);
+
+   /*
+    * Reset the wait object only now that we hold the lock: in case of
+    * timeout or signal, we're still in the wait list of a futex (maybe a
+    * different one, because of FUTEX_REQUEUE) which cannot be freed by
+    * anybody else until we leave it, below.
+    */
+   if ((c = wait_obj_reset(&curr->wobj))) {
+
+      if (has_timeout)
+         task_cancel_wakeup_timer(curr);
+
+      futex_put(CONTAINER_OF(c, struct futex, cond));
+      rc = pending_signals() ? -EINTR : -ETIMEDOUT;
+   }
+
+out:
+   kmutex_unlock(&futex_lock);
+   return rc;
+}
+
+int futex_wake(u32 *uaddr, int nr, u32 bitset)
+{
+   struct futex *f;
+   int rc = 0;
+
+   kmutex_lock(&futex_lock);
+
+   if ((f = futex_lookup(get_curr_proc()->pdir, (ulong)uaddr, false))) {
+      rc = kcond_signal_extra(&f->cond, bitset, nr);
+      futex_put(f);
+   }
+
+   kmutex_unlock(&futex_lock);
+   return rc;
+}
+
+static int
+futex_requeue(u32 *uaddr, int nr_wake, int nr_requeue,
+              u32 *uaddr2, bool cmp, u32 cmpval)
+{
+   pdir_t *pdir = get_curr_proc()->pdir;
+   struct futex *f, *f2;
+   u32 uval;
+   int rc = 0;
+
+   kmutex_lock(&futex_lock);
+
+   if (cmp) {
+
+      if (copy_from_user(&uval, uaddr, sizeof(uval))) {
+         rc = -EFAULT;
+         goto out;
+      }
+
+      if (uval != cmpval) {
+         rc = -EAGAIN;
+         goto out;
+      }
+   }
+
+   if (!(f = futex_lookup(pdir, (ulong)uaddr, false)))
+      goto out;
+
+   rc = kcond_signal_extra(&f->cond, FUTEX_BITSET_MATCH_ANY, nr_wake);
+
+   if (nr_requeue > 0 && uaddr2 != uaddr && kcond_is_anyone_waiting(&f->cond))
+   {
+      if (!(f2 = futex_lookup(pdir, (ulong)uaddr2, true))) {
+         rc = -ENOMEM;
+      } else {
+         rc += kcond_requeue(&f->cond, &f2->cond, nr_requeue);
+         futex_put(f2);
+      }
+   }
+
+   futex_put(f);
+
+out:
+   kmutex_unlock(&futex_lock);
+   return rc;
+}
+
+static int
+do_futex(u32 *uaddr, int op, u32 val,
+         const struct k_timespec64 *timeout,
+         ulong val2, u32 *uaddr2, u32 val3)
+{
+   const int cmd = op & FUTEX_CMD_MASK;
+   u64 ticks = 0;
+
+   if ((ulong)uaddr & (sizeof(u32) - 1))
+      return -EINVAL;
+
+   if ((op & FUTEX_CLOCK_REALTIME) &&
+       cmd != FUTEX_WAIT && cmd != FUTEX_WAIT_BITSET)
+   {
+      return -ENOSYS;
+   }
+
+   if (timeout) {
+
+      if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+          timeout->tv_nsec >= BILLION)
+      {
+         return -EINVAL;
+      }
+
+      if (cmd == FUTEX_WAIT_BITSET) {
+
+         /* FUTEX_WAIT_BITSET uses an absolute timeout */
+         ticks = abs_timespec_to_ticks(
+            (op & FUTEX_CLOCK_REALTIME) ? CLOCK_REALTIME : CLOCK_MONOTONIC,
+            timeout
+         );
+
+      } else {
+
+         ticks = timespec_to_ticks(timeout);
+      }
+   }
+
+   switch (cmd) {
+
+      case FUTEX_WAIT:
+         return futex_wait(uaddr, val,
+                           FUTEX_BITSET_MATCH_ANY, !!timeout, ticks);
+
+      case FUTEX_WAIT_BITSET:
+
+         if (!val3)
+            return -EINVAL;
+
+         return futex_wait(uaddr, val, val3, !!timeout, ticks);
+
+      case FUTEX_WAKE:
+         return futex_wake(uaddr, (int)MIN(val, (u32)INT32_MAX),
+                           FUTEX_BITSET_MATCH_ANY);
+
+      case FUTEX_WAKE_BITSET:
+
+         if (!val3)
+            return -EINVAL;
+
+         return futex_wake(uaddr, (int)MIN(val, (u32)INT32_MAX), val3);
+
+      case FUTEX_REQUEUE:
+      case FUTEX_CMP_REQUEUE:
+
+         if ((int)val < 0 || (long)val2 < 0)
+            return -EINVAL;
+
+         return futex_requeue(uaddr, (int)val, (int)MIN(val2, (ulong)INT32_MAX),
+                              uaddr2, cmd == FUTEX_CMP_REQUEUE, val3);
+
+      default:
+         return -ENOSYS;
+   }
+}
+
+static ALWAYS_INLINE bool futex_cmd_has_timeout(int op)
+{
+   const int cmd = op & FUTEX_CMD_MASK;
+   return cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_BITSET;
+}
+
+int sys_futex(u32 *uaddr, int op, u32 val,
+              const struct k_timespec64 *u_timeout, u32 *uaddr2, u32 val3)
+{
+   struct k_timespec64 timeout;
+
+   if (!futex_cmd_has_timeout(op))
+      return do_futex(uaddr, op, val, NULL, (ulong)u_timeout, uaddr2, val3);
+
+   if (u_timeout) {
+
+      if (copy_from_user(&timeout, u_timeout, sizeof(timeout)))
+         return -EFAULT;
+
+      return do_futex(uaddr, op, val, &timeout, 0, uaddr2, val3);
+   }
+
+   return do_futex(uaddr, op, val, NULL, 0, uaddr2, val3);
+}
+
+int sys_futex_time32(u32 *uaddr, int op, u32 val,
+                     const struct k_timespec32 *u_timeout,
+                     u32 *uaddr2, u32 val3)
+{
+   struct k_timespec32 ts32;
+   struct k_timespec64 timeout;
+
+   if (!futex_cmd_has_timeout(op))
+      return do_futex(uaddr, op, val, NULL, (ulong)u_timeout, uaddr2, val3);
+
+   if (u_timeout) {
+
+      if (copy_from_user(&ts32, u_timeout, sizeof(ts32)))
+         return -EFAULT;
+
+      timeout = (struct k_timespec64) {
+         .tv_sec = ts32.tv_sec,
+         .tv_nsec = ts32.tv_nsec,
+      };
+
+      return do_futex(uaddr, op, val, &timeout, 0, uaddr2, val3);
+   }
+
+   return do_futex(uaddr, op, val, NULL, 0, uaddr2, val3);
+}
@@ -11,6 +11,7 @@ void kcond_init(struct kcond *c)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
    list_init(&c->wait_list);
+   c->watchers = 0;
 }
 
 bool kcond_is_anyone_waiting(struct kcond *c)
@@ -102,7 +103,7 @@ panic_retry_hack:
    return ret;
 }
 
-static void
+static bool
 kcond_signal_int(struct kcond *c, struct wait_obj *wo)
 {
    ASSERT(!is_preemption_enabled());
@@ -123,7 +124,7 @@ kcond_signal_int(struct kcond *c, struct wait_obj *wo)
        * See the comments above in kcond_wait() for more context.
        */
       wait_obj_reset(wo);
-      return;
+      return true;
    }
 
    if (!ti || ti->state != TASK_STATE_SLEEPING) {
@@ -133,7 +134,7 @@ kcond_signal_int(struct kcond *c, struct wait_obj *wo)
       if (wo->type == WOBJ_MWO_ELEM)
          wait_obj_reset(wo);
 
-      return;
+      return false;
    }
 
    if (wo->type != WOBJ_MWO_ELEM) {
@@ -145,6 +146,33 @@ kcond_signal_int(struct kcond *c, struct wait_obj *wo)
 
    wait_obj_reset(wo);
    wake_up(ti);
+   return true;
+}
+
+static ALWAYS_INLINE void kcond_notify_watcher(struct wait_obj *wo)
+{
+   struct kcond_watcher *w = CONTAINER_OF(wo, struct kcond_watcher, wobj);
+   w->cb(w);
+}
+
+/*
+ * With watchers, signal one means: notify all the watchers and wake up the
+ * first task actually waiting (if any).
+ */
+static void kcond_signal_one_with_watchers(struct kcond *c)
+{
+   struct wait_obj *wo_pos, *temp;
+   bool signaled = false;
+
+   list_for_each(wo_pos, temp, &c->wait_list, wait_list_node) {
+
+      if (wo_pos->type == WOBJ_KCOND_WATCHER) {
+         kcond_notify_watcher(wo_pos);
+      } else if (!signaled) {
+         kcond_signal_int(c, wo_pos);
+         signaled = true;
+      }
+   }
 }
 
 void kcond_signal_one(struct kcond *c)
@@ -153,7 +181,11 @@ void kcond_signal_one(struct kcond *c)
    {
       DEBUG_ONLY(check_not_in_irq_handler());
 
-      if (!list_is_empty(&c->wait_list)) {
+      if (c->watchers) {
+
+         kcond_signal_one_with_watchers(c);
+
+      } else if (!list_is_empty(&c->wait_list)) {
 
          struct wait_obj *wobj =
             list_first_obj(&c->wait_list, struct wait_obj, wait_list_node);
@@ -172,7 +204,96 @@ void kcond_signal_all(struct kcond *c)
       DEBUG_ONLY(check_not_in_irq_handler());
 
       list_for_each(wo_pos, temp, &c->wait_list, wait_list_node) {
-         kcond_signal_int(c, wo_pos);
+
+         if (wo_pos->type == WOBJ_KCOND_WATCHER)
+            kcond_notify_watcher(wo_pos);
+         else
+            kcond_signal_int(c, wo_pos);
+      }
+   }
+   enable_preemption();
+}
+
+int kcond_signal_extra(struct kcond *c, u32 mask, int max)
+{
+   struct wait_obj *wo_pos, *temp;
+   int cnt = 0;
+
+   disable_preemption();
+   {
+      DEBUG_ONLY(check_not_in_irq_handler());
+
+      list_for_each(wo_pos, temp, &c->wait_list, wait_list_node) {
+
+         if (cnt == max)
+            break;
+
+         if (wo_pos->type != WOBJ_KCOND || !(wo_pos->extra & mask))
+            continue;
+
+         if (kcond_signal_int(c, wo_pos))
+            cnt++;
+      }
+   }
+   enable_preemption();
+   return cnt;
+}
+
+int kcond_requeue(struct kcond *src, struct kcond *dst, int max)
+{
+   struct wait_obj *wo_pos, *temp;
+   int cnt = 0;
+   u32 extra;
+
+   disable_preemption();
+   {
+      DEBUG_ONLY(check_not_in_irq_handler());
+
+      list_for_each(wo_pos, temp, &src->wait_list, wait_list_node) {
+
+         if (cnt == max)
+            break;
+
+         if (wo_pos->type != WOBJ_KCOND)
+            continue;
+
+         extra = wo_pos->extra;
+         wait_obj_reset(wo_pos);
+         wait_obj_set(wo_pos, WOBJ_KCOND, dst, extra, &dst->wait_list);
+         cnt++;
+      }
+   }
+   enable_preemption();
+   return cnt;
+}
+
+void kcond_watch(struct kcond *c,
+                 struct kcond_watcher *w,
+                 kcond_watcher_cb cb,
+                 void *arg)
+{
+   DEBUG_ONLY(check_not_in_irq_handler());
+
+   w->cb = cb;
+   w->arg = arg;
+
+   disable_preemption();
+   {
+      wait_obj_set(&w->wobj, WOBJ_KCOND_WATCHER, c, NO_EXTRA, &c->wait_list);
+      c->watchers++;
+   }
+   enable_preemption();
+}
+
+void kcond_unwatch(struct kcond_watcher *w)
+{
+   struct kcond *c;
+
+   disable_preemption();
+   {
+      if ((c = wait_obj_reset(&w->wobj))) {
+         ASSERT(c->watchers > 0);
+         c->watchers--;
       }
    }
    enable_preemption();
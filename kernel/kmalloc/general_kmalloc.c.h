@@ -54,22 +54,11 @@ main_heaps_kmalloc(size_t *size, u32 flags)
 static int
 main_heaps_kfree(void *ptr, size_t *size, u32 flags)
 {
-   struct kmalloc_heap *h = NULL;
    const ulong vaddr = (ulong) ptr;
+   struct kmalloc_heap *h;
    ASSERT(kmalloc_initialized);
 
-   for (int i = used_heaps - 1; i >= 0; i--) {
-
-      const ulong hva = heaps[i]->vaddr;
-      const ulong hend = heaps[i]->heap_last_byte-heaps[i]->min_block_size+1;
-
-      if (IN_RANGE_INC(vaddr, hva, hend)) {
-         h = heaps[i];
-         break;
-      }
-   }
-
-   if (!h)
+   if (!(h = main_heaps_find(vaddr)))
       return -ENOENT;
 
    /*
@@ -103,8 +92,15 @@ void *general_kmalloc(size_t *size, u32 flags)
    {
       const size_t orig_size = *size;
 
-      if (*size <= SMALL_HEAP_MAX_ALLOC ||
-          UNLIKELY(sub_block_sz && sub_block_sz <= SMALL_HEAP_MAX_ALLOC))
+      /* Regular small allocations go through the object caches first */
+      res = !flags ? kmalloc_caches_alloc(size) : NULL;
+
+      if (res) {
+
+         /* Cache hit: nothing else to do */
+
+      } else if (*size <= SMALL_HEAP_MAX_ALLOC ||
+                 UNLIKELY(sub_block_sz && sub_block_sz <= SMALL_HEAP_MAX_ALLOC))
       {
          /* Small DMA allocations are not allowed */
          ASSERT(~flags & KMALLOC_FL_DMA);
@@ -143,7 +139,12 @@ void general_kfree(void *ptr, size_t *size, u32 flags)
 
    disable_preemption();
    {
-      if (*size) {
+      if (!flags && kmalloc_caches_free(ptr, size)) {
+
+         /* The chunk went in the magazine of its size class */
+         rc = 0;
+
+      } else if (*size) {
 
          /* We know which heap set contains our chunk */
 
@@ -15,6 +15,7 @@
 #include <tilck/kernel/sort.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/interrupts.h>
 
 #include <tilck_gen_headers/config_kmalloc.h>
 
@@ -210,6 +211,25 @@ actual_allocate_node(struct kmalloc_heap *h,
    return !alloc_failed;
 }
 
+/*
+ * Returns the size of the biggest block starting at `vaddr` (aligned at its
+ * size) which is not bigger than `rem`. Used to split a range of the heap,
+ * not necessarily corresponding to a single allocation, in blocks.
+ */
+static size_t
+calculate_range_block_size(struct kmalloc_heap *h, ulong vaddr, size_t rem)
+{
+   const ulong offset = vaddr - h->vaddr;
+   size_t size = h->min_block_size;
+
+   ASSERT(rem >= size);
+
+   while (size < h->size && !(offset & size) && TWICE(size) <= rem)
+      size = TWICE(size);
+
+   return size;
+}
+
 static size_t calculate_node_size(struct kmalloc_heap *h, int node)
 {
    size_t size = h->size;
@@ -626,6 +646,157 @@ per_heap_kmalloc(struct kmalloc_heap *h, size_t *size, u32 flags)
    return res;
 }
 
+/* Returns true if the whole block [vaddr, vaddr + size) is free */
+static bool is_block_free_at(struct kmalloc_heap *h, ulong vaddr, size_t size)
+{
+   struct block_node *nodes = h->metadata_nodes;
+   const int node = ptr_to_node(h, (void *)vaddr, size);
+   ulong va = h->vaddr;
+   size_t s = h->size;
+   int n = 0;
+
+   while (n != node) {
+
+      if (!nodes[n].split)
+         return !nodes[n].full; /* `n` is a whole block containing ours */
+
+      s = HALF(s);
+
+      if (vaddr >= va + s) {
+         va += s;
+         n = NODE_RIGHT(n);
+      } else {
+         n = NODE_LEFT(n);
+      }
+   }
+
+   return is_block_node_free(nodes[n]);
+}
+
+/*
+ * Allocates the free block [vaddr, vaddr + size), splitting its ancestors,
+ * exactly like internal_kmalloc() does when it finds the block by itself.
+ * Returns false if h->valloc_and_map() failed: in that case, the node has to
+ * be freed by the caller.
+ */
+static bool
+internal_kmalloc_at(struct kmalloc_heap *h,
+                    ulong vaddr,
+                    size_t size,
+                    bool do_actual_alloc)
+{
+   struct block_node *nodes = h->metadata_nodes;
+   const int node = ptr_to_node(h, (void *)vaddr, size);
+   ulong va = h->vaddr;
+   size_t s = h->size;
+   void *ptr;
+   int n = 0;
+
+   while (n != node) {
+
+      nodes[n].split = true;
+      s = HALF(s);
+
+      if (vaddr >= va + s) {
+         va += s;
+         n = NODE_RIGHT(n);
+      } else {
+         n = NODE_LEFT(n);
+      }
+   }
+
+   /* Account the block before: internal_kfree() will un-account it on OOM */
+   if (do_actual_alloc)
+      h->mem_allocated += size;
+
+   if (!actual_allocate_node(h, size, node, &ptr, do_actual_alloc))
+      return false;
+
+   ASSERT(ptr == (void *)vaddr);
+
+   /* Mark the parent nodes as 'full', when necessary */
+   while (n != 0) {
+
+      n = NODE_PARENT(n);
+
+      if (!nodes[NODE_LEFT(n)].full || !nodes[NODE_RIGHT(n)].full)
+         break;
+
+      nodes[n].full = true;
+   }
+
+   return true;
+}
+
+/*
+ * Allocates exactly the range [ptr, ptr + size), if it's completely free.
+ * Useful to grow in-place a multi-step allocation, which can be later freed
+ * along with the new range, as a single chunk. The flags are the same as
+ * the ones of per_heap_kmalloc(), except that KMALLOC_FL_MULTI_STEP is
+ * implied. Both `ptr` and `size` must be multiples of h->min_block_size.
+ */
+bool
+per_heap_kmalloc_at(struct kmalloc_heap *h, void *ptr, size_t size, u32 flags)
+{
+   const bool do_actual_alloc = !(flags & KMALLOC_FL_NO_ACTUAL_ALLOC);
+   const u32 sub_blocks_min_size = flags & KMALLOC_FL_SUB_BLOCK_MIN_SIZE_MASK;
+   const ulong vaddr = (ulong)ptr;
+   bool expected = false;
+   bool success = true;
+   size_t off, bs;
+
+   ASSERT(size > 0);
+   ASSERT(!((vaddr - h->vaddr) & (h->min_block_size - 1)));
+   ASSERT(!(size & (h->min_block_size - 1)));
+
+   if (vaddr < h->vaddr || size > h->size || vaddr - h->vaddr > h->size - size)
+      return false;
+
+   if (!atomic_cas_strong(&h->in_use, &expected, true, mo_relaxed, mo_relaxed))
+      return false; /* heap already in use (we're in IRQ context) */
+
+   for (off = 0; off < size; off += bs) {
+
+      bs = calculate_range_block_size(h, vaddr + off, size - off);
+
+      if (!is_block_free_at(h, vaddr + off, bs)) {
+         success = false;
+         break;
+      }
+   }
+
+   for (off = 0; success && off < size; off += bs) {
+
+      bs = calculate_range_block_size(h, vaddr + off, size - off);
+
+      if (!internal_kmalloc_at(h, vaddr + off, bs, do_actual_alloc)) {
+
+         /* Roll-back, like per_heap_kmalloc_unsafe() does */
+         internal_kfree(h, (void *)(vaddr + off), bs, false, true);
+
+         if (off) {
+            per_heap_kfree_unsafe(h,
+                                  ptr,
+                                  &off,
+                                  KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+         }
+
+         success = false;
+         break;
+      }
+
+      if (sub_blocks_min_size) {
+         internal_kmalloc_split_block(h,
+                                      (void *)(vaddr + off),
+                                      bs,
+                                      sub_blocks_min_size);
+      }
+   }
+
+   atomic_store_explicit(&h->in_use, false, mo_relaxed);
+   return success;
+}
+
 static void
 internal_kfree(struct kmalloc_heap *h,
                void *ptr,
@@ -799,20 +970,19 @@ per_heap_kfree_unsafe(struct kmalloc_heap *h,
    ASSERT(vaddr + size - 1 <= h->heap_last_byte);
    ASSERT(pow2_round_up_at(size, h->min_block_size) == size);
 
-   size_t tot = 0;
-
-   for (int i = (int)h->heap_data_size_log2 - 1; i >= 0 && tot < size; i--) {
-
-      const size_t sub_block_size = (1 << i);
-
-      if (!(size & sub_block_size))
-         continue;
+   /*
+    * Free the chunk one block at a time, each one being the biggest aligned
+    * block fitting in the rest of the chunk. For the chunks returned by
+    * per_heap_kmalloc(), that matches exactly the power-of-two sub-blocks it
+    * allocated, in decreasing order. For arbitrary ranges (e.g. partial
+    * frees or chunks grown with per_heap_kmalloc_at()), that's the only way
+    * to get blocks aligned at their size.
+    */
+   for (size_t tot = 0, sub_block_size; tot < size; tot += sub_block_size) {
 
+      sub_block_size = calculate_range_block_size(h, vaddr + tot, size - tot);
       internal_kfree(h, ptr + tot, sub_block_size, allow_split, do_actual_free);
-      tot += sub_block_size;
    }
-
-   ASSERT(tot == size);
 }
 
 struct deferred_kfree_ctx {
@@ -1013,6 +1183,7 @@ void vfree2(void *ptr, size_t size)
 /* Natural continuation of this source file. Purpose: make this file shorter. */
 #include "kmalloc_stats.c.h"
 #include "kmalloc_small_heaps.c.h"
+#include "kmalloc_caches.c.h"
 #include "kmalloc_heaps.c.h"
 #include "general_kmalloc.c.h"
 #include "kmalloc_accelerator.c.h"
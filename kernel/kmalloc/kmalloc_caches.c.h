@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef _KMALLOC_C_
+
+   #error This is NOT a header file and it is not meant to be included
+
+   /*
+    * The only purpose of this file is to keep kmalloc.c shorter.
+    * Yes, this file could be turned into a regular C source file, but at the
+    * price of making several static functions and variables in kmalloc.c to be
+    * just non-static. We don't want that. Code isolation is a GOOD thing.
+    */
+
+#endif
+
+/*
+ * Object caches
+ * ---------------
+ *
+ * Small allocations (the ones served by the small heaps) are rounded-up to a
+ * power of two, therefore all the kernel objects having the same rounded-up
+ * size (struct task, user_mapping, fs handles, ramfs inodes etc.) can share
+ * the same free chunks. Each size class has a magazine: a LIFO stack of
+ * recently freed chunks, still allocated from the point of view of the
+ * heaps. Allocations and frees without flags hit the magazine first and go
+ * to the heaps only when it's empty or, respectively, full. That saves the
+ * small heaps' linear lookup and the buddy allocator's tree walk for the
+ * vast majority of the kmalloc_obj()/kfree_obj() calls.
+ *
+ * The magazines are protected by disabling the preemption. They are bypassed
+ * in IRQ context, where the heaps have their own special handling.
+ */
+
+#define KMALLOC_CACHES_MIN_SHIFT    5     /* log2(SMALL_HEAP_MBS) */
+#define KMALLOC_CACHE_MAX_DEPTH    32     /* max objects per magazine */
+#define KMALLOC_CACHE_MAX_BYTES  (8 * KB) /* max bytes per magazine */
+
+STATIC_ASSERT((1 << KMALLOC_CACHES_MIN_SHIFT) == SMALL_HEAP_MBS);
+STATIC_ASSERT(
+   (1 << (KMALLOC_CACHES_MIN_SHIFT + KMALLOC_CACHES_COUNT - 1))
+      == SMALL_HEAP_MAX_ALLOC + 1
+);
+
+struct kmalloc_magazine {
+   u32 count;
+   void *objs[KMALLOC_CACHE_MAX_DEPTH];
+};
+
+static struct kmalloc_magazine magazines[KMALLOC_CACHES_COUNT];
+static struct kmalloc_cache_stats caches_stats[KMALLOC_CACHES_COUNT];
+static bool caches_enabled;
+
+static inline u32 kmalloc_cache_obj_size(int cl)
+{
+   return 1u << (cl + KMALLOC_CACHES_MIN_SHIFT);
+}
+
+static inline u32 kmalloc_cache_depth(int cl)
+{
+   return MIN(KMALLOC_CACHE_MAX_BYTES / kmalloc_cache_obj_size(cl),
+              (u32)KMALLOC_CACHE_MAX_DEPTH);
+}
+
+/* Returns the cache index for the given size or -1 if it's not cacheable */
+static inline int kmalloc_cache_class(size_t size)
+{
+   if (!caches_enabled || !size || size > SMALL_HEAP_MAX_ALLOC || in_irq())
+      return -1;
+
+   if (size <= SMALL_HEAP_MBS)
+      return 0;
+
+   return (int)log2_for_power_of_2(roundup_next_power_of_2(size))
+            - KMALLOC_CACHES_MIN_SHIFT;
+}
+
+static void *kmalloc_caches_alloc(size_t *size)
+{
+   const int cl = kmalloc_cache_class(*size);
+   struct kmalloc_magazine *m;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (cl < 0)
+      return NULL;
+
+   m = &magazines[cl];
+
+   if (!m->count) {
+      caches_stats[cl].misses++;
+      return NULL;
+   }
+
+   caches_stats[cl].hits++;
+   *size = kmalloc_cache_obj_size(cl);
+   return m->objs[--m->count];
+}
+
+static bool kmalloc_caches_free(void *ptr, size_t *size)
+{
+   const int cl = kmalloc_cache_class(*size);
+   struct kmalloc_magazine *m;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (cl < 0)
+      return false;
+
+   m = &magazines[cl];
+
+   if (m->count == kmalloc_cache_depth(cl)) {
+      caches_stats[cl].frees_to_heap++;
+      return false;
+   }
+
+   caches_stats[cl].frees_cached++;
+   m->objs[m->count++] = ptr;
+   return true;
+}
+
+/* Give back to the small heaps all the chunks in the magazines */
+static void kmalloc_caches_flush(void)
+{
+   ASSERT(!is_preemption_enabled());
+
+   for (int cl = 0; cl < KMALLOC_CACHES_COUNT; cl++) {
+
+      struct kmalloc_magazine *m = &magazines[cl];
+
+      while (m->count) {
+
+         size_t size = kmalloc_cache_obj_size(cl);
+         DEBUG_ONLY_UNSAFE(int rc =)
+            small_heaps_kfree(m->objs[--m->count], &size, 0);
+
+         ASSERT(rc == 0);
+      }
+   }
+}
+
+static void kmalloc_caches_reset(void)
+{
+   bzero(magazines, sizeof(magazines));
+   bzero(caches_stats, sizeof(caches_stats));
+
+   /* The unit tests check the exact state of the heaps: no caches there */
+   caches_enabled = !KERNEL_TEST_INT;
+}
+
+/* Returns the previous state of the caches */
+bool debug_kmalloc_set_caches_enabled(bool enabled)
+{
+   bool old;
+   disable_preemption();
+   {
+      old = caches_enabled;
+
+      if (!enabled)
+         kmalloc_caches_flush();
+
+      caches_enabled = enabled;
+   }
+   enable_preemption();
+   return old;
+}
+
+static void kmalloc_caches_get_stats(struct kmalloc_cache_stats *stats)
+{
+   for (int cl = 0; cl < KMALLOC_CACHES_COUNT; cl++) {
+      stats[cl] = caches_stats[cl];
+      stats[cl].obj_size = kmalloc_cache_obj_size(cl);
+      stats[cl].depth = kmalloc_cache_depth(cl);
+      stats[cl].cached = magazines[cl].count;
+   }
+}
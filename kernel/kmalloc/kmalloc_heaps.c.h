@@ -22,6 +22,52 @@ STATIC struct kmalloc_heap *heaps[KMALLOC_HEAPS_COUNT];
 STATIC int used_heaps;
 STATIC size_t max_tot_heap_mem_free;
 
+/*
+ * The same heaps as in heaps[], but sorted by address: used by kfree() to find
+ * the heap containing a given chunk with a binary search. Note: heaps[] is
+ * sorted by size instead, for kmalloc().
+ */
+static struct kmalloc_heap *heaps_by_addr[KMALLOC_HEAPS_COUNT];
+
+static void heaps_by_addr_insert(struct kmalloc_heap *h)
+{
+   int i;
+
+   for (i = used_heaps; i > 0 && heaps_by_addr[i-1]->vaddr > h->vaddr; i--)
+      heaps_by_addr[i] = heaps_by_addr[i - 1];
+
+   heaps_by_addr[i] = h;
+}
+
+/* Returns the main heap containing `vaddr` or NULL */
+static struct kmalloc_heap *main_heaps_find(ulong vaddr)
+{
+   struct kmalloc_heap *h;
+   int lo = 0, hi = used_heaps;
+
+   /* Find the first heap starting after `vaddr` */
+   while (lo < hi) {
+
+      const int mid = (lo + hi) / 2;
+
+      if (heaps_by_addr[mid]->vaddr <= vaddr)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   if (!lo)
+      return NULL;
+
+   /* The one before it is the only candidate */
+   h = heaps_by_addr[lo - 1];
+
+   if (vaddr > h->heap_last_byte - h->min_block_size + 1)
+      return NULL;
+
+   return h;
+}
+
 void *kmalloc_get_first_heap(size_t *size)
 {
    static char buf[KMALLOC_FIRST_HEAP_SIZE] ALIGNED_AT(KMALLOC_MAX_ALIGN);
@@ -267,6 +313,7 @@ static int kmalloc_internal_add_heap(void *vaddr, size_t heap_size)
 
    VERIFY(success);
    VERIFY(heaps[used_heaps] != NULL);
+   heaps_by_addr_insert(heaps[used_heaps]);
 
    /*
     * We passed to kmalloc_create_heap() the begining of the heap as 'metadata'
@@ -349,9 +396,11 @@ void early_init_kmalloc(void)
    ASSERT(!kmalloc_initialized);
    list_init(&small_heaps_list);
    list_init(&avail_small_heaps_list);
+   kmalloc_caches_reset();
 
    used_heaps = 0;
    bzero(heaps, sizeof(heaps));
+   bzero(heaps_by_addr, sizeof(heaps_by_addr));
 
    {
       size_t first_heap_size;
@@ -454,4 +503,10 @@ debug_kmalloc_get_stats(struct debug_kmalloc_stats *stats)
       .chunk_sizes_count =
          KMALLOC_HEAVY_STATS ? alloc_arr_used : 0,
    };
+
+   disable_preemption();
+   {
+      kmalloc_caches_get_stats(stats->caches);
+   }
+   enable_preemption();
 }
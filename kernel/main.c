@@ -374,6 +374,7 @@ kmain(u32 multiboot_magic, u32 mbi_addr)
    init_fpu_memcpy();
    init_kmalloc();
    init_paging();
+   init_kernel_symbols_index();
 
    setup_uefi_runtime_services();
    acpi_mod_init_tables();
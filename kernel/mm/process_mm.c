@@ -15,6 +15,10 @@
 
 #include <sys/mman.h>      // system header
 
+#ifndef MREMAP_MAYMOVE
+   #define MREMAP_MAYMOVE  1  /* defined by <sys/mman.h> only for _GNU_SOURCE */
+#endif
+
 char page_size_buf[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
 
 static void
@@ -25,11 +29,12 @@ brk_syscall_int(struct process *pi, void *new_brk)
    if (new_brk < pi->brk) {
 
       /* we have to free pages */
+      const size_t count = (size_t)(pi->brk - new_brk) >> PAGE_SHIFT;
 
-      for (void *vaddr = new_brk; vaddr < pi->brk; vaddr += PAGE_SIZE) {
-         unmap_page(pi->pdir, vaddr, true);
-      }
+      if (pdir_own_page_tables(pi->pdir, new_brk, count, true))
+         return; /* out-of-memory: brk() will return the old value */
 
+      unmap_pages(pi->pdir, new_brk, count, true);
       pi->brk = new_brk;
       return;
    }
@@ -46,6 +51,23 @@ brk_syscall_int(struct process *pi, void *new_brk)
 
    /* OK, everything looks good here */
 
+   if (!MMAP_NO_COW) {
+
+      /*
+       * Map the zero page, copy-on-write: the actual pages will be allocated
+       * on the first write, like for the anonymous mmap() memory. In case of
+       * OOM, keep the part we've been able to map.
+       */
+      const size_t page_count = (size_t)(new_brk - pi->brk) >> PAGE_SHIFT;
+      const size_t count = map_zero_pages(pi->pdir,
+                                          pi->brk,
+                                          page_count,
+                                          PAGING_FL_US | PAGING_FL_RW);
+
+      pi->brk += count << PAGE_SHIFT;
+      return;
+   }
+
    vaddr = pi->brk;
 
    while (vaddr < new_brk) {
@@ -122,6 +144,7 @@ create_process_mmap_heap(struct process *pi)
    }
 
    list_init(&pi->mi->mappings);
+   pi->mi->mappings_tree = NULL;
    pi->mi->mmap_heap = mmap_heap;
    pi->mi->mmap_heap_size = USER_MMAP_MIN_SZ;
 
@@ -161,45 +184,62 @@ mmap_err_case_free(struct process *pi, void *ptr, size_t actual_len)
                   KFREE_FL_NO_ACTUAL_FREE);
 }
 
+/* Doubles the size of the mmap heap of `pi`, if possible */
+static bool
+mmap_heap_expand(struct process *pi)
+{
+   struct kmalloc_heap *new_heap;
+   struct kmalloc_heap *h = pi->mi->mmap_heap;
+   size_t heap_sz = pi->mi->mmap_heap_size;
+
+   if (heap_sz == USER_MMAP_MAX_SZ)
+      return false; /* cannot expand the heap more than that */
+
+   new_heap = kmalloc_heap_dup_expanded(h, heap_sz * 2);
+
+   if (!new_heap)
+      return false; /* no enough memory */
+
+   pi->mi->mmap_heap_size = heap_sz * 2;
+   pi->mi->mmap_heap = new_heap;
+   kmalloc_destroy_heap(h);
+   return true;
+}
+
 static struct user_mapping *
 mmap_on_user_heap(struct process *pi,
                   size_t *actual_len_ref,
                   fs_handle handle,
                   u32 per_heap_kmalloc_flags,
                   size_t off,
-                  int prot)
+                  int prot,
+                  int flags)
 {
    void *res;
    struct user_mapping *um;
 
    while (true) {
 
-      struct kmalloc_heap *new_heap;
-      struct kmalloc_heap *h = pi->mi->mmap_heap;
-      size_t heap_sz = pi->mi->mmap_heap_size;
-
-      res = per_heap_kmalloc(h,
+      res = per_heap_kmalloc(pi->mi->mmap_heap,
                              actual_len_ref,
                              per_heap_kmalloc_flags);
 
       if (LIKELY(res != NULL))
          break;        /* great! */
 
-      if (heap_sz == USER_MMAP_MAX_SZ)
-         return NULL; /* cannot expand the heap more than that */
-
-      new_heap = kmalloc_heap_dup_expanded(h, heap_sz * 2);
-
-      if (!new_heap)
-         return NULL; /* no enough memory */
-
-      pi->mi->mmap_heap_size = heap_sz * 2;
-      pi->mi->mmap_heap = new_heap;
-      kmalloc_destroy_heap(h);
+      if (!mmap_heap_expand(pi))
+         return NULL;
    }
 
    /* NOTE: here `handle` might be NULL (zero-map case) and that's OK */
-   um = process_add_user_mapping(handle, res, *actual_len_ref, off, prot);
+   um = process_add_user_mapping(handle,
+                                 res,
+                                 *actual_len_ref,
+                                 off,
+                                 prot,
+                                 flags & (MAP_SHARED  |
+                                          MAP_PRIVATE |
+                                          MAP_HUGETLB));
 
    if (!um) {
       mmap_err_case_free(pi, res, *actual_len_ref);
@@ -209,6 +249,42 @@ mmap_on_user_heap(struct process *pi,
    return um;
 }
 
+/*
+ * Replaces with big pages the zero pages mapped in the USER_BIG_PAGE_SIZE
+ * aligned parts of the anonymous mapping `um`. That's just best-effort: the
+ * parts for which there's no aligned physical memory keep the regular pages.
+ */
+static void
+mmap_use_big_pages(struct process *pi, struct user_mapping *um)
+{
+   const ulong end = um->vaddr + um->len;
+   ulong va = pow2_round_up_at(um->vaddr, USER_BIG_PAGE_SIZE);
+   int rc;
+
+   for (; va + USER_BIG_PAGE_SIZE <= end; va += USER_BIG_PAGE_SIZE) {
+
+      size_t size = USER_BIG_PAGE_SIZE;
+      void *p = general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE);
+
+      if (!p)
+         break;
+
+      if (LIN_VA_TO_PA(p) & (USER_BIG_PAGE_SIZE - 1)) {
+
+         /* The heaps give no guarantee about the physical alignment */
+         general_kfree(p, &size, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+         break;
+      }
+
+      bzero(p, USER_BIG_PAGE_SIZE);
+      unmap_pages(pi->pdir, (void *)va, USER_BIG_PAGE_SIZE >> PAGE_SHIFT, true);
+
+      /* Cannot fail: the whole range has just been unmapped */
+      rc = map_big_page(pi->pdir, (void *)va, LIN_VA_TO_PA(p), PAGING_FL_RWUS);
+      VERIFY(rc == 0);
+   }
+}
+
 long
 sys_mmap_pgoff(void *addr, size_t len, int prot,
                int flags, int fd, size_t pgoffset)
@@ -254,7 +330,7 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
 
    } else {
 
-      if (!(flags & MAP_SHARED))
+      if (!(flags & (MAP_SHARED | MAP_PRIVATE)))
          return -EINVAL;
 
       handle = get_fs_handle(fd);
@@ -270,7 +346,11 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
       if ((prot & (PROT_READ | PROT_WRITE)) == PROT_WRITE)
          return -EINVAL; /* disallow write-only mappings */
 
-      if (prot & PROT_WRITE) {
+      /*
+       * Writing to a private mapping never touches the file, because the
+       * pages are copied on write: no need for a writable handle.
+       */
+      if ((prot & PROT_WRITE) && (flags & MAP_SHARED)) {
          if (!(fl & O_WRONLY) && (fl & O_RDWR) != O_RDWR)
             return -EACCES;
       }
@@ -291,7 +371,8 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
                              handle,
                              per_heap_kmalloc_flags,
                              pgoffset << PAGE_SHIFT,
-                             prot);
+                             prot,
+                             flags);
    }
    enable_preemption();
 
@@ -313,7 +394,7 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
          disable_preemption();
          {
             mmap_err_case_free(pi, um->vaddrp, actual_len);
-            process_remove_user_mapping(um);
+            process_remove_user_mapping(pi, um);
          }
          enable_preemption();
          return rc;
@@ -324,6 +405,14 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
 
       if (MMAP_NO_COW)
          bzero(um->vaddrp, actual_len);
+
+      if (USER_BIG_PAGE_SIZE && (flags & MAP_HUGETLB)) {
+         disable_preemption();
+         {
+            mmap_use_big_pages(pi, um);
+         }
+         enable_preemption();
+      }
    }
 
    return (long)um->vaddr;
@@ -344,6 +433,7 @@ static int munmap_int(struct process *pi, void *vaddrp, size_t len)
    u32 kfree_flags = KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP;
    struct user_mapping *um = NULL, *um2 = NULL;
    ulong vaddr = (ulong) vaddrp;
+   bool remove_um = false;
    size_t actual_len;
    int rc;
 
@@ -364,11 +454,25 @@ static int munmap_int(struct process *pi, void *vaddrp, size_t len)
       return 0;
    }
 
+   /*
+    * Unmapping pages cannot fail: get our own copy of the page tables shared
+    * after fork(), if any, before changing anything. Only vfs_munmap() can
+    * drop whole 4-MB entries: the anonymous pages are released one by one by
+    * the vfree function of the mmap_heap, which needs regular page tables.
+    */
+   if (pdir_own_page_tables(pi->pdir,
+                            vaddrp,
+                            actual_len >> PAGE_SHIFT,
+                            um->h != NULL))
+   {
+      return -ENOMEM;
+   }
+
    const ulong um_vend = um->vaddr + um->len;
 
    if (actual_len == um->len) {
 
-      process_remove_user_mapping(um);
+      remove_um = true; /* at the end: vfs_munmap() needs `um` */
 
    } else {
 
@@ -399,7 +503,8 @@ static int munmap_int(struct process *pi, void *vaddrp, size_t len)
             (void *)(vaddr + actual_len),
             (um_vend - (vaddr + actual_len)),
             um->off + um->len + actual_len,
-            um->prot
+            um->prot,
+            um->flags
          );
 
          if (!um2) {
@@ -411,6 +516,8 @@ static int munmap_int(struct process *pi, void *vaddrp, size_t len)
             um->len = um_vend - um->vaddr;
             return -ENOMEM;
          }
+
+         um2->advice = um->advice;
       }
    }
 
@@ -432,6 +539,9 @@ static int munmap_int(struct process *pi, void *vaddrp, size_t len)
          vfs_mmap(um2, pi->pdir, VFS_MM_DONT_MMAP);
    }
 
+   if (remove_um)
+      process_remove_user_mapping(pi, um);
+
    per_heap_kfree(pi->mi->mmap_heap,
                   vaddrp,
                   &actual_len,
@@ -466,3 +576,359 @@ int sys_munmap(void *vaddrp, size_t len)
    return rc;
 }
 
+
+/*
+ * mremap()
+ * ----------
+ *
+ * Shrinking a mapping is just a munmap() of its tail, while only anonymous
+ * mappings can grow. When the range after the mapping is free in the mmap
+ * heap, it's just added to the mapping. Otherwise, with MREMAP_MAYMOVE, a new
+ * anonymous mapping is created and its pages (zero pages) are swapped with
+ * the ones of the old range, which is finally unmapped: no page is copied.
+ */
+
+static bool
+mremap_grow_in_place(struct process *pi, struct user_mapping *um, size_t len)
+{
+   const ulong end = um->vaddr + um->len;
+   const size_t extra = len - um->len;
+
+   while (end + extra > USER_MMAP_BEGIN + pi->mi->mmap_heap_size) {
+      if (!mmap_heap_expand(pi))
+         return false;
+   }
+
+   if (!per_heap_kmalloc_at(pi->mi->mmap_heap,
+                            (void *)end,
+                            extra,
+                            KMALLOC_FL_MULTI_STEP | PAGE_SIZE))
+   {
+      return false;
+   }
+
+   if (MMAP_NO_COW)
+      bzero((void *)end, extra);
+
+   um->len = len;
+   return true;
+}
+
+static long
+mremap_move(struct process *pi,
+            struct user_mapping *um,
+            ulong old_addr,
+            size_t old_len,
+            size_t new_len)
+{
+   const int advice = um->advice;
+   const size_t pg_count = old_len >> PAGE_SHIFT;
+   struct user_mapping *new_um;
+   size_t actual_len = new_len;
+   int rc;
+
+   new_um = mmap_on_user_heap(pi,
+                              &actual_len,
+                              NULL,
+                              KMALLOC_FL_MULTI_STEP | PAGE_SIZE,
+                              0,
+                              um->prot,
+                              um->flags);
+
+   if (!new_um)
+      return -ENOMEM;
+
+   ASSERT(actual_len == new_len);
+   new_um->advice = advice;
+
+   if (MMAP_NO_COW)
+      bzero(new_um->vaddrp + old_len, new_len - old_len);
+
+   /* swap_pages() cannot fail: it has to own the page tables of both ranges */
+   if (pdir_own_page_tables(pi->pdir, (void *)old_addr, pg_count, false) ||
+       pdir_own_page_tables(pi->pdir, new_um->vaddrp, pg_count, false))
+   {
+      munmap_int(pi, new_um->vaddrp, new_len);
+      return -ENOMEM;
+   }
+
+   swap_pages(pi->pdir, (void *)old_addr, new_um->vaddrp, pg_count);
+
+   if ((rc = munmap_int(pi, (void *)old_addr, old_len))) {
+
+      /* OOM while splitting `um`: roll-back */
+      swap_pages(pi->pdir, (void *)old_addr, new_um->vaddrp, pg_count);
+
+      munmap_int(pi, new_um->vaddrp, new_len);
+      return rc;
+   }
+
+   return (long)new_um->vaddr;
+}
+
+static long
+mremap_int(struct process *pi,
+           ulong old_addr,
+           size_t old_len,
+           size_t new_len,
+           int flags)
+{
+   struct user_mapping *um = process_get_user_mapping((void *)old_addr);
+
+   ASSERT(!is_preemption_enabled());
+
+   if (!um || old_addr + old_len > um->vaddr + um->len)
+      return -EFAULT; /* the old range is not a single mapping */
+
+   if (new_len <= old_len) {
+
+      int rc = 0;
+
+      if (new_len < old_len)
+         rc = munmap_int(pi, (void *)(old_addr + new_len), old_len - new_len);
+
+      return rc ? rc : (long)old_addr;
+   }
+
+   if (um->h)
+      return -EINVAL; /* growing file mappings is not supported */
+
+   if (old_addr + old_len == um->vaddr + um->len &&
+       mremap_grow_in_place(pi, um, um->len + new_len - old_len))
+   {
+      return (long)old_addr;
+   }
+
+   if (!(flags & MREMAP_MAYMOVE))
+      return -ENOMEM;
+
+   return mremap_move(pi, um, old_addr, old_len, new_len);
+}
+
+long sys_mremap(void *old_addr, size_t old_len, size_t new_len,
+                int flags, void *new_addr)
+{
+   struct process *pi = get_curr_proc();
+   const ulong vaddr = (ulong)old_addr;
+   long rc;
+
+   if (vaddr & OFFSET_IN_PAGE_MASK)
+      return -EINVAL;
+
+   if (flags & ~MREMAP_MAYMOVE)
+      return -EINVAL; /* MREMAP_FIXED and MREMAP_DONTUNMAP not supported */
+
+   if (!old_len || !new_len)
+      return -EINVAL;
+
+   old_len = pow2_round_up_at(old_len, PAGE_SIZE);
+   new_len = pow2_round_up_at(new_len, PAGE_SIZE);
+
+   if (!old_len || !new_len)
+      return -ENOMEM; /* overflow */
+
+   if (!pi->mi)
+      return -EFAULT;
+
+   if (!IN_RANGE(vaddr,
+                 USER_MMAP_BEGIN,
+                 USER_MMAP_BEGIN + pi->mi->mmap_heap_size))
+   {
+      return -EFAULT;
+   }
+
+   disable_preemption();
+   {
+      rc = mremap_int(pi, vaddr, old_len, new_len, flags);
+   }
+   enable_preemption();
+   return rc;
+}
+
+/*
+ * madvise()
+ * -----------
+ *
+ * MADV_DONTNEED (and MADV_FREE, which is allowed to behave the same way)
+ * drops the pages of the private memory: the anonymous mappings and the brk
+ * heap get the zero page back, while the private file mappings get back the
+ * pages of the file, discarding the copies made on write. The big pages are
+ * split first, so their pageframes are released one by one: unmap_page() frees
+ * them as pages of their multi-step chunk. Shared mappings are left alone, as
+ * their pages are the file's ones. MADV_WILLNEED prefaults the file mappings,
+ * while MADV_SEQUENTIAL, MADV_RANDOM and MADV_NORMAL are just stored in the
+ * mappings containing the range (without splitting them) for the fault
+ * handlers of the filesystems. All the other advices are ignored.
+ */
+
+static void
+madvise_dontneed_anon(struct process *pi, ulong va, ulong end)
+{
+   ulong pa;
+   int rc;
+
+   for (; va < end; va += PAGE_SIZE) {
+
+      if (get_mapping2(pi->pdir, (void *)va, &pa) < 0)
+         continue;
+
+      if (pa == KERNEL_VA_TO_PA(&zero_page))
+         continue; /* never written: nothing to drop */
+
+      if (MMAP_NO_COW) {
+         bzero(PA_TO_LIN_VA(pa), PAGE_SIZE);
+         continue;
+      }
+
+      unmap_page(pi->pdir, (void *)va, true);
+
+      /* Cannot fail: the page table is there and it's not shared anymore */
+      rc = map_zero_page(pi->pdir, (void *)va, PAGING_FL_RWUS);
+      VERIFY(rc == 0);
+   }
+}
+
+static int
+madvise_dontneed_file(struct process *pi,
+                      struct user_mapping *um,
+                      ulong va,
+                      ulong end)
+{
+   struct user_mapping tmp = *um;
+
+   if (um->flags & MAP_SHARED)
+      return 0; /* the pages are the file's ones: nothing to drop */
+
+   unmap_pages_permissive(pi->pdir,
+                          (void *)va,
+                          (end - va) >> PAGE_SHIFT,
+                          true);
+
+   /*
+    * Map again the pages of the file, copy-on-write, exactly like mmap() did.
+    * That's necessary because not all the filesystems handle the faults.
+    */
+   tmp.vaddr = va;
+   tmp.len = end - va;
+   tmp.off = um->off + (va - um->vaddr);
+   return vfs_mmap(&tmp, pi->pdir, VFS_MM_DONT_REGISTER);
+}
+
+static void
+madvise_willneed(struct process *pi,
+                 struct user_mapping *um,
+                 ulong va,
+                 ulong end)
+{
+   for (; va < end; va += PAGE_SIZE) {
+
+      if (is_mapped(pi->pdir, (void *)va))
+         continue;
+
+      /*
+       * Pretend that the user code read the page. The filesystems mapping
+       * everything in mmap() don't handle faults: nothing to do for them.
+       */
+      vfs_handle_fault(um, (void *)va, false, false);
+   }
+}
+
+static int
+madvise_int(struct process *pi, ulong va, ulong end, int advice)
+{
+   const ulong brk_begin = (ulong)pi->initial_brk;
+   const ulong brk_end = (ulong)pi->brk;
+   struct user_mapping *um;
+   ulong seg_end;
+   int rc;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (advice == MADV_DONTNEED) {
+
+      /* Dropping the pages cannot fail: see pdir_own_page_tables() */
+      if (pdir_own_page_tables(pi->pdir, (void *)va, (end - va) >> PAGE_SHIFT,
+                               false))
+      {
+         return -ENOMEM;
+      }
+   }
+
+   if (advice == MADV_DONTNEED && va < brk_end && end > brk_begin)
+      madvise_dontneed_anon(pi, MAX(va, brk_begin), MIN(end, brk_end));
+
+   while (va < end) {
+
+      if (!(um = process_get_user_mapping((void *)va))) {
+         va += PAGE_SIZE;
+         continue;
+      }
+
+      seg_end = MIN(end, um->vaddr + um->len);
+
+      switch (advice) {
+
+         case MADV_DONTNEED:
+
+            if (!um->h) {
+               madvise_dontneed_anon(pi, va, seg_end);
+            } else if ((rc = madvise_dontneed_file(pi, um, va, seg_end))) {
+               return rc;
+            }
+
+            break;
+
+         case MADV_WILLNEED:
+
+            if (um->h)
+               madvise_willneed(pi, um, va, seg_end);
+
+            break;
+
+         default:
+            um->advice = advice;
+      }
+
+      va = seg_end;
+   }
+
+   return 0;
+}
+
+int sys_madvise(void *addr, size_t len, int advice)
+{
+   struct process *pi = get_curr_proc();
+   const ulong va = (ulong)addr;
+   const ulong end = va + pow2_round_up_at(len, PAGE_SIZE);
+   int rc;
+
+   if (va & OFFSET_IN_PAGE_MASK)
+      return -EINVAL;
+
+   if (end < va || end > BASE_VA)
+      return -EINVAL;
+
+   switch (advice) {
+
+      case MADV_FREE:
+         advice = MADV_DONTNEED;
+         break;
+
+      case MADV_NORMAL:
+      case MADV_RANDOM:
+      case MADV_SEQUENTIAL:
+      case MADV_WILLNEED:
+      case MADV_DONTNEED:
+         break;
+
+      default:
+         return 0; /* just a hint: ignore it */
+   }
+
+   disable_preemption();
+   {
+      rc = madvise_int(pi, va, end, advice);
+   }
+   enable_preemption();
+   return rc;
+}
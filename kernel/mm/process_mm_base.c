@@ -4,12 +4,71 @@
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/paging_hw.h>
 
+#include <sys/mman.h>      // system header
+
+/*
+ * The user mappings of each process are both in the `mappings` list, used when
+ * all of them need to be visited, and in the `mappings_tree` AVL tree, sorted
+ * by address and used for the lookups. Because the mappings never overlap,
+ * the tree can be searched with a range compare function.
+ */
+
+static long um_insert_cmp(const void *a, const void *b)
+{
+   const struct user_mapping *um1 = a;
+   const struct user_mapping *um2 = b;
+
+   if (um1->vaddr == um2->vaddr)
+      return 0;
+
+   return um1->vaddr < um2->vaddr ? -1 : 1;
+}
+
+/* Compares the range of the mapping `obj` with the address `*val` */
+static long um_range_cmp(const void *obj, const void *val)
+{
+   const struct user_mapping *um = obj;
+   const ulong vaddr = *(const ulong *)val;
+
+   if (vaddr < um->vaddr)
+      return 1;
+
+   if (vaddr >= um->vaddr + um->len)
+      return -1;
+
+   return 0;
+}
+
+static void
+mappings_tree_add(struct mappings_info *mi, struct user_mapping *um)
+{
+   DEBUG_ONLY_UNSAFE(bool success =)
+      bintree_insert(&mi->mappings_tree,
+                     um,
+                     um_insert_cmp,
+                     struct user_mapping,
+                     tree_node);
+
+   ASSERT(success);
+}
+
+static struct user_mapping *
+mappings_tree_find(struct mappings_info *mi, ulong vaddr)
+{
+   return bintree_find(mi->mappings_tree,
+                       &vaddr,
+                       um_range_cmp,
+                       struct user_mapping,
+                       tree_node);
+}
+
 struct user_mapping *
 process_add_user_mapping(fs_handle h,
                          void *vaddr,
                          size_t len,
                          size_t off,
-                         int prot)
+                         int prot,
+                         int flags)
 {
    struct process *pi = get_curr_proc();
    struct user_mapping *um;
@@ -24,6 +83,7 @@ process_add_user_mapping(fs_handle h,
 
    list_node_init(&um->pi_node);
    list_node_init(&um->inode_node);
+   bintree_node_init(&um->tree_node);
 
    um->pi = pi;
    um->h = h;
@@ -31,15 +91,26 @@ process_add_user_mapping(fs_handle h,
    um->vaddrp = vaddr;
    um->off = off;
    um->prot = prot;
+   um->flags = flags;
 
    list_add_tail(&pi->mi->mappings, &um->pi_node);
+   mappings_tree_add(pi->mi, um);
    return um;
 }
 
-void process_remove_user_mapping(struct user_mapping *um)
+void process_remove_user_mapping(struct process *pi, struct user_mapping *um)
 {
+   ulong vaddr = um->vaddr;
    ASSERT(!is_preemption_enabled());
 
+   DEBUG_ONLY_UNSAFE(void *removed =)
+      bintree_remove(&pi->mi->mappings_tree,
+                     &vaddr,
+                     um_range_cmp,
+                     struct user_mapping,
+                     tree_node);
+
+   ASSERT(removed == um);
    list_remove(&um->pi_node);
    list_remove(&um->inode_node);
    kfree_obj(um, struct user_mapping);
@@ -47,34 +118,19 @@ void process_remove_user_mapping(struct user_mapping *um)
 
 struct user_mapping *process_get_user_mapping(void *vaddrp)
 {
-   const ulong vaddr = (ulong)vaddrp;
    struct process *pi = get_curr_proc();
-   struct user_mapping *pos;
-
    ASSERT(!is_preemption_enabled());
 
-   if (pi->mi) {
-
-      /*
-       * Given that pi->mi->mappings contains at the moment only the memory
-       * mappings done with mmap(), some small processes that don't use dynamic
-       * memory allocation will not even have this field (pi->mi == NULL).
-       *
-       * For the rest, the list is supposed to be *short*, so a linear scan
-       * is acceptable for the moment. If in the future we start to put
-       * there also the mappings for program's text and data and expect to have
-       * more than a few elements, it will be necessary to use a BST to perform
-       * the lookup here below.
-       */
-
-      list_for_each_ro(pos, &pi->mi->mappings, pi_node) {
+   /*
+    * Given that pi->mi->mappings contains at the moment only the memory
+    * mappings done with mmap(), some small processes that don't use dynamic
+    * memory allocation will not even have this field (pi->mi == NULL).
+    */
 
-         if (IN_RANGE(vaddr, pos->vaddr, pos->vaddr + pos->len))
-            return pos;
-      }
-   }
+   if (!pi->mi)
+      return NULL;
 
-   return NULL;
+   return mappings_tree_find(pi->mi, (ulong)vaddrp);
 }
 
 void remove_all_user_zero_mem_mappings(struct process *pi)
@@ -124,8 +180,20 @@ void full_remove_user_mapping(struct process *pi, struct user_mapping *um)
    ASSERT(mi);
    ASSERT(mi->mmap_heap);
 
-   if (um->h)
+   if (um->h) {
+
+      /*
+       * We get here from close() and from the teardown of the address space,
+       * which have no way to report an error.
+       */
+      if (pdir_own_page_tables(pi->pdir, um->vaddrp, um->len >> PAGE_SHIFT,
+                               true))
+      {
+         panic("Out-of-memory: unable to unshare a page table. No OOM killer");
+      }
+
       vfs_munmap(um, um->vaddrp, actual_len);
+   }
 
    per_heap_kfree(mi->mmap_heap,
                   um->vaddrp,
@@ -134,20 +202,15 @@ void full_remove_user_mapping(struct process *pi, struct user_mapping *um)
                   KFREE_FL_MULTI_STEP  |
                   KFREE_FL_NO_ACTUAL_FREE);
 
-   process_remove_user_mapping(um);
+   process_remove_user_mapping(pi, um);
 }
 
 void remove_all_file_mappings(struct process *pi)
 {
-   fs_handle *h;
-
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   int fd;
 
-      if (!(h = pi->handles[i]))
-         continue;
-
-      remove_all_mappings_of_handle(pi, h);
-   }
+   fd_table_for_each_open(&pi->fdt, fd)
+      remove_all_mappings_of_handle(pi, fd_table_get(&pi->fdt, fd));
 }
 
 struct mappings_info *
@@ -160,6 +223,7 @@ duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi)
       goto oom_case;
 
    list_init(&new_mi->mappings);
+   new_mi->mappings_tree = NULL;
 
    if (!(new_mi->mmap_heap = kmalloc_heap_dup(mi->mmap_heap)))
       goto oom_case;
@@ -180,9 +244,11 @@ duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi)
       /* Re-init the new nodes */
       list_node_init(&um2->pi_node);
       list_node_init(&um2->inode_node);
+      bintree_node_init(&um2->tree_node);
 
-      /* Add the pi_node to new process's mappings list */
+      /* Add the new mapping to new process's mappings list and tree */
       list_add_tail(&new_mi->mappings, &um2->pi_node);
+      mappings_tree_add(new_mi, um2);
 
       /*
        * If the inode_node belongs to a list (mappings per inode)
@@ -217,15 +283,7 @@ oom_case:
 void user_vfree_and_unmap(ulong user_vaddr, size_t page_count)
 {
    pdir_t *pdir = get_curr_pdir();
-   ulong va = user_vaddr;
-
-   for (size_t i = 0; i < page_count; i++, va += PAGE_SIZE) {
-
-      if (!is_mapped(pdir, (void *)va))
-         continue;
-
-      unmap_page(pdir, (void *)va, true);
-   }
+   unmap_pages_permissive(pdir, (void *)user_vaddr, page_count, true);
 }
 
 bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
@@ -314,13 +372,15 @@ int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
 {
    struct fs_handle_base *hb = um->h;
    struct process *pi = hb->pi;
-   ulong vaddr = (ulong)vaddrp;
-   ulong vend = vaddr + len;
    ASSERT(IS_PAGE_ALIGNED(len));
 
-   for (; vaddr < vend; vaddr += PAGE_SIZE) {
-      unmap_page_permissive(pi->pdir, (void *)vaddr, false);
-   }
+   /*
+    * The pages of a private mapping might be copies made on write: free them.
+    * The file's own pages are never freed here, as the fs holds a reference
+    * to them.
+    */
+   const bool do_free = !!(um->flags & MAP_PRIVATE);
 
+   unmap_pages_permissive(pi->pdir, vaddrp, len >> PAGE_SHIFT, do_free);
    return 0;
 }
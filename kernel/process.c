@@ -150,7 +150,10 @@ void process_free_mappings_info(struct process *pi)
 void free_common_task_allocs(struct task *ti)
 {
    struct process *pi = ti->pi;
-   process_free_mappings_info(pi);
+
+   /* The mappings info belongs to the process, not to its threads */
+   if (is_main_thread(ti))
+      process_free_mappings_info(pi);
 
    free_kernel_stack(ti);
    kfree2(ti->io_copybuf, IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
@@ -174,10 +177,11 @@ void free_mem_for_zombie_task(struct task *ti)
 
    free_common_task_allocs(ti);
 
-   if (ti->pi->automatic_reaping || is_kernel_thread(ti)) {
+   if (ti->pi->automatic_reaping || !is_main_thread(ti)) {
       /*
        * The SIGCHLD signal has been EXPLICITLY ignored by the parent or this
-       * is a kernel thread and we don't do any reaping.
+       * is a kernel thread or a user thread other than the main one: nobody
+       * can wait for them with waitpid(), therefore we don't do any reaping.
        */
       remove_task(ti);
    }
@@ -186,6 +190,7 @@ void free_mem_for_zombie_task(struct task *ti)
 void init_task_lists(struct task *ti)
 {
    bintree_node_init(&ti->tree_by_tid_node);
+   bintree_node_init(&ti->runnable_tree_node);
    list_node_init(&ti->runnable_node);
    list_node_init(&ti->wakeup_timer_node);
    list_node_init(&ti->siblings_node);
@@ -198,6 +203,8 @@ void init_task_lists(struct task *ti)
 void init_process_lists(struct process *pi)
 {
    list_init(&pi->children);
+   list_init(&pi->threads);
+   list_node_init(&pi->pgrp_node);
    kmutex_init(&pi->fslock, KMUTEX_FL_RECURSIVE);
 }
 
@@ -221,6 +228,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
 
    memcpy(ti, parent, sizeof(struct task));
    memcpy(pi, parent_pi, sizeof(struct process));
+   fd_table_init(&pi->fdt);      /* copied below, after the debug allocs */
 
    if (MOD_debugpanel) {
 
@@ -234,6 +242,9 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
       }
    }
 
+   if (UNLIKELY(fd_table_copy(&pi->fdt, &parent_pi->fdt)))
+      goto oom_case;
+
    pi->parent_pid = parent_pi->pid;
    pi->pdir = new_pdir;
    pi->ref_count = 1;
@@ -243,6 +254,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    pi->cwd.fs = NULL;
    pi->vforked = false;
    pi->inherited_mmap_heap = false;
+   pi->group_exit = false;
 
    if (new_pdir != parent_pi->pdir) {
 
@@ -263,6 +275,8 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    ti->tid = pid;
    ti->is_main_thread = true;
    ti->timer_ready = false;
+   ti->wakeup_tick = 0;
+   ti->clear_child_tid = NULL;
 
    /*
     * From fork(2):
@@ -310,6 +324,7 @@ oom_case:
       }
 
       process_free_mappings_info(ti->pi);
+      fd_table_destroy(&pi->fdt);
 
       if (MOD_debugpanel && pi->debug_cmdline)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
@@ -339,7 +354,13 @@ struct task *allocate_new_thread(struct process *pi, int tid, bool alloc_bufs)
    ti->is_main_thread = false;
 
    init_task_lists(ti);
-   arch_specific_new_task_setup(ti, process_task);
+
+   if (!arch_specific_new_task_setup(ti, process_task)) {
+      free_common_task_allocs(ti);
+      kfree_obj(ti, struct task);
+      return NULL;
+   }
+
    return ti;
 }
 
@@ -365,6 +386,7 @@ static void free_process_int(struct process *pi)
       if (MOD_debugpanel)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
 
+      fd_table_destroy(&pi->fdt);
       arch_specific_free_proc(pi);
       kfree_obj((void *)get_process_task(pi), struct task_and_process);
    }
@@ -381,10 +403,15 @@ void free_task(struct task *ti)
 
    list_remove(&ti->siblings_node);
 
-   if (is_main_thread(ti))
+   if (is_main_thread(ti)) {
       free_process_int(ti->pi);
-   else
+   } else {
+
+      if (!is_kernel_thread(ti))
+         arch_specific_free_thread_tls(ti);
+
       kfree_obj(ti, struct task);
+   }
 }
 
 void *task_temp_kernel_alloc(size_t size)
@@ -618,10 +645,11 @@ int sys_setsid(void)
    disable_preemption();
 
    if (!sched_count_proc_in_group(pi->pid)) {
-      pi->pgid = pi->pid;
-      pi->sid = pi->pid;
-      pi->proc_tty = NULL;
-      rc = pi->sid;
+
+      if (!(rc = sched_set_process_group(pi, pi->pid, pi->pid))) {
+         pi->proc_tty = NULL;
+         rc = pi->sid;
+      }
    }
 
    enable_preemption();
@@ -685,12 +713,12 @@ int sys_setpgid(int pid, int pgid)
       }
 
       /* Set process' pgid to `pgid` */
-      pi->pgid = pgid;
+      rc = sched_set_process_group(pi, pgid, pi->sid);
 
    } else {
 
       /* pgid is 0: make the process a group leader */
-      pi->pgid = pi->pid;
+      rc = sched_set_process_group(pi, pi->pid, pi->sid);
    }
 
 out:
@@ -757,8 +785,12 @@ setup_first_process(pdir_t *pdir, struct task **ti_ref)
       return -ENOMEM;
 
    pi = ti->pi;
-   pi->pgid = 1;
-   pi->sid = 1;
+
+   if (sched_set_process_group(pi, 1, 1)) {
+      free_task(ti);
+      return -ENOMEM;
+   }
+
    pi->umask = 0022;
    ti->state = TASK_STATE_RUNNING;
    add_task(ti);
@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/process_int.h>
@@ -20,15 +21,28 @@ ATOMIC(int) __need_resched;               /* see docs/atomics.md */
 struct task *kernel_process;
 struct process *kernel_process_pi;
 
-/* Task lists */
-struct list runnable_tasks_list;
+/*
+ * Runnable tasks
+ * ------------------
+ *
+ * The runnable tasks are kept in a AVL tree ordered by (vruntime, tid), with
+ * a cached pointer to its leftmost node (the task with the lowest vruntime).
+ * Tasks woken up by their timer (timer_ready = true) have to be picked before
+ * any other runnable task: for that reason, they're not kept in the tree, but
+ * in a dedicated FIFO list, using their `runnable_node`. The idle task is not
+ * in any of those containers: it's the fall-back, when nothing else is ready.
+ *
+ * NOTE: the vruntime of a task must not change while it's in the tree.
+ * See sched_account_ticks().
+ */
+static struct task *runnable_tree_root;
+static struct task *runnable_leftmost;
+static struct list runnable_timer_ready_list;
 
 /* Static variables */
 static struct task *tree_by_tid_root;
 static u64 idle_ticks;
 static volatile int runnable_tasks_count;
-static int current_max_pid = -1;
-static int current_max_kernel_tid = -1;
 struct task *idle_task;
 
 const char *const task_state_str[5] = {
@@ -102,23 +116,13 @@ get_traced_tasks_count(void)
 
 int sched_count_proc_in_group(int pgid)
 {
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process_group *g;
    int count = 0;
 
    disable_preemption();
    {
-      bintree_in_order_visit_start(&ctx,
-                                   tree_by_tid_root,
-                                   struct task,
-                                   tree_by_tid_node,
-                                   false);
-
-      while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-         if (ti->pi->pgid == pgid)
-            count++;
-      }
+      if ((g = sched_get_process_group(pgid)))
+         count = get_ref_count(g);
    }
    enable_preemption();
    return count;
@@ -126,25 +130,13 @@ int sched_count_proc_in_group(int pgid)
 
 int sched_get_session_of_group(int pgid)
 {
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process_group *g;
    int sid = -ESRCH;
 
    disable_preemption();
    {
-      bintree_in_order_visit_start(&ctx,
-                                   tree_by_tid_root,
-                                   struct task,
-                                   tree_by_tid_node,
-                                   false);
-
-      while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-         if (ti->pi->pgid == pgid) {
-            sid = ti->pi->sid;
-            break;
-         }
-      }
+      if ((g = sched_get_process_group(pgid)))
+         sid = g->session->sid;
    }
    enable_preemption();
    return sid;
@@ -162,202 +154,330 @@ int get_curr_pid(void)
    return c ? c->pi->pid : 0;
 }
 
-struct create_pid_visit_ctx {
+/*
+ * ID allocation
+ * ----------------
+ *
+ * User PIDs and kernel TIDs are allocated using two bitmaps, each one with a
+ * `last` hint: the search for a free ID starts right after the last allocated
+ * one and wraps around when the max ID is reached, exactly like Linux does.
+ *
+ * A bit is set in the user bitmap as long as its ID is either the PID of a
+ * task or the ID of an existing process group or session (see below). That
+ * guarantees that a new process will never get the ID of an orphaned process
+ * group or session, which would accidentally make it the leader of that group
+ * or session. To support that, pid_refs[] counts the users of each ID: the
+ * task itself plus the process group and the session with that ID.
+ *
+ * The bits are updated when tasks are added/removed from the tree and when
+ * groups and sessions are created/destroyed: create_new_pid() just looks for
+ * a free ID. That's safe because callers keep the preemption disabled from
+ * the allocation of the ID until add_task().
+ */
+
+#define PID_BMAP_WORDS        DIV_ROUND_UP(MAX_PID + 1, NBITS)
+#define KTID_BMAP_WORDS       DIV_ROUND_UP(KERNEL_MAX_TID + 1, NBITS)
+
+struct id_bitmap {
+   ulong *words;
+   int max_id;
+   int last;
+};
+
+static ulong pid_bmap_words[PID_BMAP_WORDS] = {
+   1                                /* PID 0 (kernel process) always in use */
+};
+
+static ulong ktid_bmap_words[KTID_BMAP_WORDS];
+static u16 pid_refs[MAX_PID + 1];
+
+static struct id_bitmap pid_bmap = {
+   .words = pid_bmap_words,
+   .max_id = MAX_PID,
+   .last = 0,
+};
 
-   bool kernel_tid;
-   bool lowest_avail_invalid;
-   int id_off;
-   int lowest_available;
-   int lowest_after_current_max;
+static struct id_bitmap ktid_bmap = {
+   .words = ktid_bmap_words,
+   .max_id = KERNEL_MAX_TID,
+   .last = -1,
 };
 
-static inline int inc_candicate_if_matches(int *cand, int id, int val)
+static ALWAYS_INLINE void id_bmap_set(struct id_bitmap *b, int id)
 {
-   if (*cand != val)
-      return 0; /* Everything is OK */
+   b->words[id / NBITS] |= (1UL << (id % NBITS));
+}
 
-   /* The lowest_<something> candicate cannot be > id */
-   ASSERT(*cand <= val);
+static ALWAYS_INLINE void id_bmap_clear(struct id_bitmap *b, int id)
+{
+   b->words[id / NBITS] &= ~(1UL << (id % NBITS));
+}
 
-   /*
-    * We've found a case where the candicate is equal to current task's pgid/sid
-    * and that might be a problem.
-    *
-    * Two cases:
-    *
-    *    1) Candidate == id. This means: candidate == pgid/sid == id.
-    *       That's fine: we just hit a group/session leader. By default we'll
-    *       skip this candiate (see the impl. below).
-    *
-    *    2) Candidate < id. This means that the pgid/sid is < id and we didn't
-    *       hit it before (note: we're doing an in-order visit). For example:
-    *
-    *    pid | sid | what
-    *    ----+-----+-----------
-    *     1  |  1  | init
-    *     2  |  1  | ash
-    *     8  |  3  | prog1
-    *
-    *    lowest_available = 3   [our candidate]
-    *
-    *    We don't want this to happen because 3 is the ID of a session, with
-    *    a dead leader. In order to handle this case, we have to increment
-    *    lowest_available and restart the whole iteration. We must end up with
-    *    lowest_available = 4. Actually, if lowest_after_current_max is a good
-    *    value, we're going to use it without restarting the iteration.
-    */
+static int id_bmap_find_free(struct id_bitmap *b, int from, int to)
+{
+   int id = from;
 
-   if (*cand == id)
-      return 0; /* We just hit a group/session leader. That's fine */
+   while (id <= to) {
 
-   (*cand)++;
-   return 1;
+      const int w = id / NBITS;
+      const u32 bit = id % NBITS;
+      const ulong val = b->words[w] | (bit ? make_bitmask(bit) : 0);
+
+      if (val != ~0UL) {
+         id = w * NBITS + (int)get_first_zero_bit_index_l(val);
+         return id <= to ? id : -1;
+      }
+
+      id = (w + 1) * NBITS;
+   }
+
+   return -1;
 }
 
-static int create_new_pid_visit_cb(void *obj, void *arg)
+static int id_bmap_alloc(struct id_bitmap *b)
 {
-   struct task *ti = obj;
-   struct create_pid_visit_ctx *ctx = arg;
-   const int tid = ti->tid - ctx->id_off;
+   int id = id_bmap_find_free(b, b->last + 1, b->max_id);
 
-   if (ctx->kernel_tid) {
+   if (id < 0)
+      id = id_bmap_find_free(b, 0, b->last);
 
-      if (!is_kernel_thread(ti))
-         return 0; /* skip non-kernel tasks */
+   if (id >= 0)
+      b->last = id;
 
-      ASSERT(tid >= 0);
+   return id;
+}
 
+static void pid_ref(int id)
+{
+   if (id <= 0 || id > MAX_PID)
+      return; /* Not an ID we could ever allocate: nothing to track */
 
-   } else {
+   if (!pid_refs[id]++)
+      id_bmap_set(&pid_bmap, id);
+}
 
-      if (!is_main_thread(ti))
-         return 0; /* skip threads */
+static void pid_unref(int id)
+{
+   if (id <= 0 || id > MAX_PID)
+      return;
 
-      ASSERT(tid >= 0);
+   ASSERT(pid_refs[id] > 0);
 
-      if (tid < ctx->lowest_available)
-         return 0;
+   if (!--pid_refs[id])
+      id_bmap_clear(&pid_bmap, id);
+}
 
-      /*
-       * Both ctx->lowest_available and ctx->lowest_after_current_max are
-       * candidates for the next tid. If one of them gets equal to a sid
-       * without a session leader process or to a pgid without a group leader,
-       * the new process could accidentally become leader of a group/session:
-       * we have to ensure that could never happen.
-       */
+static void task_ref_ids(struct task *ti)
+{
+   if (is_kernel_thread(ti)) {
+      id_bmap_set(&ktid_bmap, ti->tid - KERNEL_TID_START);
+      return;
+   }
 
-      const int pgid = ti->pi->pgid;
-      const int sid = ti->pi->sid;
-      const int should_restart =
-         inc_candicate_if_matches(&ctx->lowest_available, tid, pgid) +
-         inc_candicate_if_matches(&ctx->lowest_available, tid, sid) +
-         inc_candicate_if_matches(&ctx->lowest_after_current_max, tid, pgid) +
-         inc_candicate_if_matches(&ctx->lowest_after_current_max, tid, sid);
+   pid_ref(ti->tid);
+}
 
-      if (should_restart) {
-         ctx->lowest_avail_invalid = true;
-      }
+static void task_unref_ids(struct task *ti)
+{
+   if (is_kernel_thread(ti)) {
+      id_bmap_clear(&ktid_bmap, ti->tid - KERNEL_TID_START);
+      return;
    }
 
+   pid_unref(ti->tid);
+}
 
-   /*
-    * Algorithm: we start with lowest_available (L) == 0. When we hit
-    * tid == L, that means L is not really the lowest, therefore, we guess
-    * the right value of L is L + 1. The first time tid skips one, for example
-    * jumping from 3 to 5, the value of L set by the iteration with tid == 3,
-    * will stuck. That value will be clearly 4.
-    */
+/*
+ * Process groups and sessions
+ * -----------------------------
+ *
+ * Each user process belongs to exactly one process group, which in turn
+ * belongs to exactly one session. Groups and sessions are ref-counted objects
+ * indexed by ID in two trees: a group's ref-count is its number of members,
+ * while a session's ref-count is its number of groups. A group is destroyed as
+ * soon as its last member is reaped or moves to another group, and a session
+ * is destroyed when it loses its last group. While a group or a session
+ * exists, its ID is reserved in the PID bitmap.
+ *
+ * A process joins its group in add_task() (forked children inherit parent's
+ * group) and leaves it in remove_task(). Everything here requires preemption
+ * to be disabled.
+ */
+
+static struct process_group *pgrp_tree_root;
+static struct session *session_tree_root;
+
+struct process_group *sched_get_process_group(int pgid)
+{
+   ASSERT(!is_preemption_enabled());
 
-   if (ctx->lowest_available == tid)
-      ctx->lowest_available++;
+   return bintree_find_ptr(pgrp_tree_root,
+                           pgid,
+                           struct process_group,
+                           node,
+                           pgid);
+}
 
-   /*
-    * For lowest_after_current_max (A) the logic is similar.
-    * We start with A = current_max_pid + 1. The first time A is == tid, will
-    * be when tid is current_max_pid + 1. We continue to update A, until the
-    * first hole is found. In case tid never reaches current_max_pid + 1, `A`
-    * will be just be current_max_pid + 1, as expected.
-    */
+static struct session *get_session(int sid)
+{
+   return bintree_find_ptr(session_tree_root,
+                           sid,
+                           struct session,
+                           node,
+                           sid);
+}
+
+static struct session *create_session(int sid)
+{
+   struct session *s;
 
-   if (ctx->lowest_after_current_max == tid)
-      ctx->lowest_after_current_max++;
+   if (!(s = kzalloc_obj(struct session)))
+      return NULL;
 
-   return 0;
+   s->sid = sid;
+   bintree_node_init(&s->node);
+   list_init(&s->groups);
+
+   bintree_insert_ptr(&session_tree_root, s, struct session, node, sid);
+   pid_ref(sid);
+   return s;
 }
 
-static int
-create_id_common(struct create_pid_visit_ctx *ctx, int max_id)
+static void destroy_session(struct session *s)
 {
-   int r;
+   ASSERT(get_ref_count(s) == 0);
+   ASSERT(list_is_empty(&s->groups));
+
+   bintree_remove_ptr(&session_tree_root, s, struct session, node, sid);
+   pid_unref(s->sid);
+   kfree_obj(s, struct session);
+}
 
-   do {
+static struct process_group *create_pgrp(int pgid, struct session *s)
+{
+   struct process_group *g;
+
+   if (!(g = kzalloc_obj(struct process_group)))
+      return NULL;
+
+   g->pgid = pgid;
+   g->session = s;
+   bintree_node_init(&g->node);
+   list_node_init(&g->session_node);
+   list_init(&g->members);
+
+   retain_obj(s);
+   list_add_tail(&s->groups, &g->session_node);
+   bintree_insert_ptr(&pgrp_tree_root, g, struct process_group, node, pgid);
+   pid_ref(pgid);
+   return g;
+}
 
-      ctx->lowest_avail_invalid = false;
-      iterate_over_tasks(&create_new_pid_visit_cb, ctx);
+static void destroy_pgrp(struct process_group *g)
+{
+   struct session *s = g->session;
 
-      r = ctx->lowest_after_current_max <= max_id
-            ? ctx->lowest_after_current_max
-            : ctx->lowest_available <= max_id
-               ? ctx->lowest_available
-               : -1;
+   ASSERT(get_ref_count(g) == 0);
+   ASSERT(list_is_empty(&g->members));
 
-      /*
-       * Typically, ctx->lowest_avail_invalid is not a problem because the new
-       * id will be ctx->lowest_after_current_max. But, in the case we've
-       * finished the IDs, we have to pick the absolutely lowest ID available,
-       * which might be invalid we it matched with a process' pgid/sid. This
-       * can happen only in case of orphaned sessions/process groups.
-       *
-       * NOTE: in case we're going to repeat the loop, lowest_avail_invalid is
-       * reset, but all the rest of the context is unchanged: that's because
-       * ctx->lowest_available has actually a meaningful value: the lowest ID
-       * after pgid/sid we hit. It doesn't mean we can use this value, but it
-       * means we cannot pick consider IDs smaller than it.
-       */
+   bintree_remove_ptr(&pgrp_tree_root, g, struct process_group, node, pgid);
+   pid_unref(g->pgid);
+   list_remove(&g->session_node);
+   kfree_obj(g, struct process_group);
 
-   } while (r == ctx->lowest_available && ctx->lowest_avail_invalid);
+   if (release_obj(s) == 0)
+      destroy_session(s);
+}
 
-   return r;
+static void pgrp_add_process(struct process_group *g, struct process *pi)
+{
+   retain_obj(g);
+   list_add_tail(&g->members, &pi->pgrp_node);
+   pi->pgrp = g;
+   pi->pgid = g->pgid;
+   pi->sid = g->session->sid;
 }
 
-int create_new_pid(void)
+static void pgrp_remove_process(struct process_group *g, struct process *pi)
 {
+   list_remove(&pi->pgrp_node);
+   list_node_init(&pi->pgrp_node);
+
+   if (release_obj(g) == 0)
+      destroy_pgrp(g);
+}
+
+/*
+ * Move `pi` to the group `pgid` of the session `sid`, creating both the group
+ * and the session, if necessary. If the group already exists, it must belong
+ * to the session `sid`: it's up to the caller to check that.
+ */
+int sched_set_process_group(struct process *pi, int pgid, int sid)
+{
+   struct process_group *old = pi->pgrp;
+   struct process_group *g;
+   struct session *s = NULL;
+
    ASSERT(!is_preemption_enabled());
 
-   struct create_pid_visit_ctx ctx = {
-      .kernel_tid = false,
-      .id_off = 0,
-      .lowest_available = 0,
-      .lowest_after_current_max = current_max_pid + 1,
-   };
+   if ((g = sched_get_process_group(pgid))) {
 
-   int r = create_id_common(&ctx, MAX_PID);
+      ASSERT(g->session->sid == sid);
 
-   if (r >= 0)
-      current_max_pid = r;
+      if (g == old)
+         return 0;
+
+   } else {
+
+      if (!(s = get_session(sid)))
+         if (!(s = create_session(sid)))
+            return -ENOMEM;
 
-   return r;
+      if (!(g = create_pgrp(pgid, s))) {
+
+         if (get_ref_count(s) == 0)
+            destroy_session(s);
+
+         return -ENOMEM;
+      }
+   }
+
+   /*
+    * Leave the old group before joining the new one, as both use the same
+    * `pgrp_node`. That's safe even when `old` is the last group of the session
+    * of `g`, because `g` holds a reference to its session.
+    */
+   if (old)
+      pgrp_remove_process(old, pi);
+
+   pgrp_add_process(g, pi);
+   return 0;
 }
 
-int create_new_kernel_tid(void)
+void sched_leave_process_group(struct process *pi)
 {
    ASSERT(!is_preemption_enabled());
+   ASSERT(pi->pgrp != NULL);
 
-   struct create_pid_visit_ctx ctx = {
-      .kernel_tid = true,
-      .id_off = KERNEL_TID_START,
-      .lowest_available = 0,
-      .lowest_after_current_max = current_max_kernel_tid + 1,
-   };
+   pgrp_remove_process(pi->pgrp, pi);
+   pi->pgrp = NULL;
+}
 
-   int r = create_id_common(&ctx, KERNEL_MAX_TID);
+int create_new_pid(void)
+{
+   ASSERT(!is_preemption_enabled());
+   return id_bmap_alloc(&pid_bmap);
+}
 
-   if (r >= 0) {
-      current_max_kernel_tid = r;
-      return r + KERNEL_TID_START;
-   }
+int create_new_kernel_tid(void)
+{
+   int r;
+   ASSERT(!is_preemption_enabled());
 
-   return -1;
+   if ((r = id_bmap_alloc(&ktid_bmap)) < 0)
+      return -1;
+
+   return r + KERNEL_TID_START;
 }
 
 int iterate_over_tasks(bintree_visit_cb func, void *arg)
@@ -401,13 +521,14 @@ static void create_kernel_process(void)
    struct task *s_kernel_ti = &tp.main_task_obj;
    struct process *s_kernel_pi = &tp.process_obj;
 
-   list_init(&runnable_tasks_list);
-   s_kernel_pi->pid = create_new_pid();
+   list_init(&runnable_timer_ready_list);
+   s_kernel_pi->pid = 0;               /* always reserved in pid_bmap */
    s_kernel_ti->tid = create_new_kernel_tid();
    s_kernel_pi->ref_count = 1;
    s_kernel_ti->pi = s_kernel_pi;
    init_task_lists(s_kernel_ti);
    init_process_lists(s_kernel_pi);
+   fd_table_init(&s_kernel_pi->fdt);
 
    s_kernel_ti->is_main_thread = true;
    s_kernel_ti->running_in_kernel = IN_SYSCALL_FLAG;
@@ -442,6 +563,9 @@ void process_set_tty(struct process *pi, void *t)
    pi->proc_tty = t;
 }
 
+static void task_add_to_state_list(struct task *ti);
+static void task_remove_from_state_list(struct task *ti);
+
 void init_sched(void)
 {
    int tid;
@@ -455,7 +579,19 @@ void init_sched(void)
    if (tid < 0)
       panic("Unable to create the idle_task!");
 
-   idle_task = get_task(tid);
+   /*
+    * The idle task has been already added as a regular runnable task by
+    * kthread_create(): re-add it after setting `idle_task`, in order to keep
+    * it out of the runnable tree.
+    */
+   disable_interrupts_forced();
+   {
+      struct task *ti = get_task(tid);
+      task_remove_from_state_list(ti);
+      idle_task = ti;
+      task_add_to_state_list(ti);
+   }
+   enable_interrupts_forced();
 }
 
 void set_current_task_in_kernel(void)
@@ -464,6 +600,80 @@ void set_current_task_in_kernel(void)
    get_curr_task()->running_in_kernel |= IN_SYSCALL_FLAG;
 }
 
+static long runnable_tree_cmp(const void *a, const void *b)
+{
+   const struct task *t1 = a;
+   const struct task *t2 = b;
+
+   if (t1->ticks.vruntime != t2->ticks.vruntime)
+      return t1->ticks.vruntime < t2->ticks.vruntime ? -1 : 1;
+
+   return (long)t1->tid - (long)t2->tid;
+}
+
+static void runnable_tree_add(struct task *ti)
+{
+   DEBUG_ONLY_UNSAFE(bool success =)
+      bintree_insert(&runnable_tree_root,
+                     ti,
+                     runnable_tree_cmp,
+                     struct task,
+                     runnable_tree_node);
+
+   ASSERT(success);
+
+   if (!runnable_leftmost || runnable_tree_cmp(ti, runnable_leftmost) < 0)
+      runnable_leftmost = ti;
+}
+
+static void runnable_tree_remove(struct task *ti)
+{
+   DEBUG_ONLY_UNSAFE(void *removed =)
+      bintree_remove(&runnable_tree_root,
+                     ti,
+                     runnable_tree_cmp,
+                     struct task,
+                     runnable_tree_node);
+
+   ASSERT(removed == ti);
+   bintree_node_init(&ti->runnable_tree_node);
+
+   if (ti == runnable_leftmost) {
+      runnable_leftmost = bintree_get_first_obj(runnable_tree_root,
+                                                struct task,
+                                                runnable_tree_node);
+   }
+}
+
+static void task_add_to_runnable_set(struct task *ti)
+{
+   runnable_tasks_count++;
+
+   if (ti == idle_task)
+      return;
+
+   if (ti->timer_ready)
+      list_add_tail(&runnable_timer_ready_list, &ti->runnable_node);
+   else
+      runnable_tree_add(ti);
+}
+
+static void task_remove_from_runnable_set(struct task *ti)
+{
+   runnable_tasks_count--;
+   ASSERT(runnable_tasks_count >= 0);
+
+   if (ti == idle_task)
+      return;
+
+   if (list_is_node_in_list(&ti->runnable_node)) {
+      list_remove(&ti->runnable_node);
+      list_node_init(&ti->runnable_node);
+   } else {
+      runnable_tree_remove(ti);
+   }
+}
+
 static void task_add_to_state_list(struct task *ti)
 {
    if (is_worker_thread(ti))
@@ -472,8 +682,7 @@ static void task_add_to_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_add_tail(&runnable_tasks_list, &ti->runnable_node);
-         runnable_tasks_count++;
+         task_add_to_runnable_set(ti);
          break;
 
       case TASK_STATE_SLEEPING:
@@ -501,9 +710,7 @@ static void task_remove_from_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_remove(&ti->runnable_node);
-         runnable_tasks_count--;
-         ASSERT(runnable_tasks_count >= 0);
+         task_remove_from_runnable_set(ti);
          break;
 
       case TASK_STATE_SLEEPING:
@@ -523,6 +730,25 @@ static void task_remove_from_state_list(struct task *ti)
    }
 }
 
+/*
+ * Called by the timer code when the timer of an already runnable task fires:
+ * move the task in the timer_ready list, in order to pick it first.
+ */
+void sched_requeue_timer_ready_task(struct task *ti)
+{
+   ulong var;
+   ASSERT(ti->timer_ready);
+
+   disable_interrupts(&var);
+   {
+      if (ti->state == TASK_STATE_RUNNABLE && !is_worker_thread(ti)) {
+         task_remove_from_state_list(ti);
+         task_add_to_state_list(ti);
+      }
+   }
+   enable_interrupts(&var);
+}
+
 void task_change_state(struct task *ti, enum task_state new_state)
 {
    ulong var;
@@ -555,6 +781,14 @@ void add_task(struct task *ti)
    disable_preemption();
    {
       task_add_to_state_list(ti);
+      task_ref_ids(ti);
+
+      if (!is_kernel_thread(ti) && is_main_thread(ti)) {
+
+         /* Forked children inherit parent's group, but aren't members yet */
+         if (!list_is_node_in_list(&ti->pi->pgrp_node))
+            pgrp_add_process(ti->pi->pgrp, ti->pi);
+      }
 
       bintree_insert_ptr(&tree_by_tid_root,
                          ti,
@@ -579,6 +813,10 @@ void remove_task(struct task *ti)
                          tree_by_tid_node,
                          tid);
 
+      if (!is_kernel_thread(ti) && is_main_thread(ti))
+         sched_leave_process_group(ti->pi);
+
+      task_unref_ids(ti);
       free_task(ti);
    }
    enable_preemption();
@@ -603,6 +841,8 @@ void sched_account_ticks(void)
 
    if (curr != idle_task) {
 
+      ulong var;
+
       /*
        * The more currently runnable tasks are, the higher vruntime has to
        * grow: if case of just 1 runnable task (+1 for idle ignored), vruntime
@@ -617,8 +857,25 @@ void sched_account_ticks(void)
        * picking the task with the lowest `total` number of ticks, because
        * tasks that that consumed 100% of the CPU when no other task was
        * runnable won't be so much penalized.
+       *
+       * NOTE: the current task might be already in the runnable set (e.g. it
+       * has just been woken up by an IRQ handler, right before going to sleep)
+       * and, in that case, its position in the runnable tree depends on its
+       * vruntime: it has to be removed and re-added in order to update it.
        */
-      t->vruntime += (u64)(runnable_tasks_count - 1);
+      disable_interrupts(&var);
+      {
+         const bool in_runnable_set = state == TASK_STATE_RUNNABLE;
+
+         if (in_runnable_set)
+            task_remove_from_state_list(curr);
+
+         t->vruntime += (u64)(runnable_tasks_count - 1);
+
+         if (in_runnable_set)
+            task_add_to_state_list(curr);
+      }
+      enable_interrupts(&var);
    }
 
    /*
@@ -668,28 +925,50 @@ sched_should_return_immediately(struct task *curr, enum task_state curr_state)
 }
 
 static struct task *
-sched_do_select_runnable_task(enum task_state curr_state, bool resched)
+sched_get_first_runnable_task(void)
 {
-   struct task *curr = get_curr_task();
-   struct task *selected = NULL;
+   struct bintree_walk_ctx ctx;
    struct task *pos;
 
-   list_for_each_ro(pos, &runnable_tasks_list, runnable_node) {
+   /* Tasks woken up by their timer have the precedence */
+   list_for_each_ro(pos, &runnable_timer_ready_list, runnable_node) {
 
       ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
 
-      if (pos->stopped || pos == idle_task)
-         continue;
+      if (!pos->stopped)
+         return pos;
+   }
 
-      if (pos->timer_ready) {
-         selected = pos;
-         break;
-      }
+   /* Common case: O(1) */
+   if (runnable_leftmost && !runnable_leftmost->stopped)
+      return runnable_leftmost;
+
+   /* The leftmost task is stopped: look for the next one in order */
+   bintree_in_order_visit_start(&ctx,
+                                runnable_tree_root,
+                                struct task,
+                                runnable_tree_node,
+                                false);
+
+   while ((pos = bintree_in_order_visit_next(&ctx))) {
+
+      ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
 
-      if (!selected || pos->ticks.vruntime < selected->ticks.vruntime)
-         selected = pos;
+      if (!pos->stopped)
+         return pos;
    }
 
+   return NULL;
+}
+
+static struct task *
+sched_do_select_runnable_task(enum task_state curr_state, bool resched)
+{
+   struct task *curr = get_curr_task();
+   struct task *selected;
+
+   selected = sched_get_first_runnable_task();
+
    /* If there is still no selected task, check for current task */
    if (!selected) {
 
@@ -803,40 +1082,48 @@ bool in_currently_dying_task(void)
    return get_curr_task_state() == TASK_STATE_ZOMBIE;
 }
 
-int send_signal_to_group(int pgid, int sig)
+/*
+ * Send `sig` to all the members of `g`, except the current process and init.
+ * The group leader, if any, is signaled last. Returns the number of processes
+ * signaled.
+ */
+static int send_signal_to_pgrp_members(struct process_group *g,
+                                       struct process *curr_pi,
+                                       int sig)
 {
-   struct process *curr_pi = get_curr_proc();
-   struct process *leader = NULL;
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process *pi, *temp, *leader = NULL;
    int count = 0;
 
-   disable_preemption();
+   list_for_each(pi, temp, &g->members, pgrp_node) {
 
-   bintree_in_order_visit_start(&ctx,
-                                tree_by_tid_root,
-                                struct task,
-                                tree_by_tid_node,
-                                false);
-
-   while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-      struct process *pi = ti->pi;
-
-      if (pi->pgid == pgid && pi != curr_pi && pi->pid != 1) {
+      if (pi == curr_pi || pi->pid == 1)
+         continue;
 
-         if (pi->pid != pgid)
-            send_signal(pi->pid, sig, true);
-         else
-            leader = pi;
+      if (pi->pid != g->pgid)
+         send_signal(pi->pid, sig, true);
+      else
+         leader = pi;
 
-         count++;
-      }
+      count++;
    }
 
    if (leader)
       send_signal(leader->pid, sig, true); /* kill the leader last */
 
+   return count;
+}
+
+int send_signal_to_group(int pgid, int sig)
+{
+   struct process *curr_pi = get_curr_proc();
+   struct process_group *g;
+   int count = 0;
+
+   disable_preemption();
+   {
+      if ((g = sched_get_process_group(pgid)))
+         count = send_signal_to_pgrp_members(g, curr_pi, sig);
+   }
    enable_preemption();
 
    if (curr_pi->pgid == pgid) {
@@ -852,41 +1139,22 @@ int send_signal_to_group(int pgid, int sig)
 int send_signal_to_session(int sid, int sig)
 {
    struct process *curr_pi = get_curr_proc();
-   struct process *leader = NULL;
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process_group *g, *temp;
+   struct session *s;
    int count = 0;
 
    disable_preemption();
-
-   bintree_in_order_visit_start(&ctx,
-                                tree_by_tid_root,
-                                struct task,
-                                tree_by_tid_node,
-                                false);
-
-   while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-      struct process *pi = ti->pi;
-
-      if (pi->pgid == sid && pi != curr_pi && pi->pid != 1) {
-
-         if (pi->pid != sid)
-            send_signal(pi->pid, sig, true);
-         else
-            leader = pi;
-
-         count++;
+   {
+      if ((s = get_session(sid))) {
+         list_for_each(g, temp, &s->groups, session_node) {
+            count += send_signal_to_pgrp_members(g, curr_pi, sig);
+         }
       }
    }
-
-   if (leader)
-      send_signal(leader->pid, sig, true); /* kill the leader last */
-
    enable_preemption();
 
    /* kill the current process, as _very_ last */
-   if (curr_pi->pgid == sid) {
+   if (curr_pi->sid == sid) {
       send_signal(curr_pi->pid, sig, true);
       count++;
    }
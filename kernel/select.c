@@ -9,6 +9,9 @@
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/timer.h>
 
+/* The fd_set struct has a fixed size: fds past that cannot be selected */
+#define SELECT_MAX_FDS                       ((int)sizeof(fd_set) * 8)
+
 struct select_ctx {
    int nfds;
    fd_set *sets[3];
@@ -338,7 +341,7 @@ int sys_select(int user_nfds,
 
    int rc;
 
-   if (user_nfds < 0 || user_nfds > MAX_HANDLES)
+   if (user_nfds < 0 || user_nfds > MIN(MAX_HANDLES, SELECT_MAX_FDS))
       return -EINVAL;
 
    if ((rc = select_read_user_sets(ctx.sets, ctx.u_sets)))
@@ -413,7 +413,8 @@ int send_signal2(int pid, int tid, int signum, int flags)
    if ((flags & SIG_FL_PROCESS) && ti->pi->pid != tid)
       goto err_end;
 
-   if (ti->pi->pid != pid)
+   /* pid = 0 means: the task `tid` can belong to any process */
+   if (pid && ti->pi->pid != pid)
       goto err_end;
 
    if (signum == 0)
@@ -422,7 +423,6 @@ int send_signal2(int pid, int tid, int signum, int flags)
    if (ti->state == TASK_STATE_ZOMBIE)
       goto end; /* do nothing */
 
-   /* TODO: update this code when thread support is added */
    do_send_signal(ti, signum, flags);
 
 end:
@@ -479,11 +479,6 @@ int sys_tkill(int tid, int sig)
 
 int sys_tgkill(int pid /* linux: tgid */, int tid, int sig)
 {
-   if (pid != tid) {
-      printk("sys_tgkill: pid != tid NOT SUPPORTED yet.\n");
-      return -EINVAL;
-   }
-
    if (!IN_RANGE(sig, 0, _NSIG) || pid <= 0 || tid <= 0)
       return -EINVAL;
 
@@ -495,7 +490,7 @@ static int kill_each_task(void *obj, void *arg)
    struct task *ti = obj;
    int sig = *(int *)arg;
 
-   if (ti != get_curr_task() && !is_kernel_thread(ti)) {
+   if (ti != get_curr_task() && !is_kernel_thread(ti) && is_main_thread(ti)) {
       send_signal(ti->tid, sig, false);
    }
 
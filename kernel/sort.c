@@ -51,6 +51,58 @@ insertion_sort_generic(void *a, ulong elem_size, u32 elem_count, cmpfun_ptr cmp)
    }
 }
 
+static void
+swap_elems(void *a, void *b, ulong elem_size)
+{
+   char *x = a, *y = b, tmp;
+
+   for (ulong i = 0; i < elem_size; i++) {
+      tmp = x[i];
+      x[i] = y[i];
+      y[i] = tmp;
+   }
+}
+
+static void
+heap_sort_sift_down(void *a, ulong elem_size, u32 root, u32 end, cmpfun_ptr cmp)
+{
+   u32 child;
+
+   while ((child = 2 * root + 1) < end) {
+
+      if (child + 1 < end &&
+          cmp(a + child * elem_size, a + (child + 1) * elem_size) < 0)
+      {
+         child++; /* pick the biggest child */
+      }
+
+      if (cmp(a + root * elem_size, a + child * elem_size) >= 0)
+         break;
+
+      swap_elems(a + root * elem_size, a + child * elem_size, elem_size);
+      root = child;
+   }
+}
+
+/*
+ * Generic heap sort implementation for objects of size 'elem_size'. Unlike
+ * insertion sort, it's O(N log N) also in the worst case, but it's not stable.
+ */
+
+void
+heap_sort_generic(void *a, ulong elem_size, u32 elem_count, cmpfun_ptr cmp)
+{
+   /* Build a max-heap */
+   for (u32 i = elem_count / 2; i > 0; i--)
+      heap_sort_sift_down(a, elem_size, i - 1, elem_count, cmp);
+
+   /* Move the max at the end, one element at a time */
+   for (u32 end = elem_count; end > 1; end--) {
+      swap_elems(a, a + (end - 1) * elem_size, elem_size);
+      heap_sort_sift_down(a, elem_size, 0, end - 1, cmp);
+   }
+}
+
 /* Reverse an array of pointer-sized elements */
 
 void
@@ -29,12 +29,6 @@
 #define LINUX_REBOOT_CMD_HALT       0xcdef0123
 #define LINUX_REBOOT_CMD_POWER_OFF  0x4321fedc
 
-int sys_madvise(void *addr, size_t len, int advice)
-{
-   // TODO (future): consider implementing at least part of sys_madvice().
-   return 0;
-}
-
 int
 do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
 {
@@ -135,8 +129,16 @@ int sys_newuname(struct utsname *user_buf)
    return 0;
 }
 
+/*
+ * NOTE: unlike Linux, exit() called by the main thread terminates the whole
+ * process, exactly like exit_group(): the main thread cannot become a zombie
+ * while the other threads are still running.
+ */
 NORETURN int sys_exit(int exit_status)
 {
+   if (!is_main_thread(get_curr_task()))
+      terminate_thread();
+
    terminate_process(exit_status, 0 /* term_sig */);
 
    /* Necessary to guarantee to the compiler that we won't return. */
@@ -145,8 +147,8 @@ NORETURN int sys_exit(int exit_status)
 
 NORETURN int sys_exit_group(int status)
 {
-   // TODO: update when user threads are supported
-   sys_exit(status);
+   terminate_process(status, 0 /* term_sig */);
+   NOT_REACHED();
 }
 
 ulong sys_times(struct tms *user_buf)
@@ -184,6 +186,7 @@ int sys_getrusage(int who, struct k_rusage *user_buf)
    u64 stime_ticks;
    struct k_timespec64 utime;
    struct k_timespec64 stime;
+   size_t rss_pages;
 
    /*
     * Of course in the syscall entry point
@@ -202,16 +205,35 @@ int sys_getrusage(int who, struct k_rusage *user_buf)
       return -EINVAL;
 
    /*
-    * Since there can only be one thread per process,
-    * RUSAGE_SELF and RUSAGE_THREAD have the same meaning.
+    * RUSAGE_THREAD reports just the current thread, while RUSAGE_SELF sums
+    * the main thread and all the others in pi->threads. NOTE: the ticks of
+    * the threads already exited are not accounted.
     */
    disable_interrupts_forced();
    {
-      stime_ticks = curr->ticks.total_kernel;
-      utime_ticks = curr->ticks.total - curr->ticks.total_kernel;
+      struct task *ti = who == RUSAGE_SELF
+         ? get_process_task(curr->pi)
+         : curr;
+
+      stime_ticks = ti->ticks.total_kernel;
+      utime_ticks = ti->ticks.total - ti->ticks.total_kernel;
+
+      if (who == RUSAGE_SELF) {
+         list_for_each_ro(ti, &curr->pi->threads, siblings_node) {
+            stime_ticks += ti->ticks.total_kernel;
+            utime_ticks += ti->ticks.total - ti->ticks.total_kernel;
+         }
+      }
    }
    enable_interrupts_forced();
 
+   /* NOTE: Tilck does not track the peak RSS: report the current one */
+   disable_preemption();
+   {
+      rss_pages = pdir_get_user_rss(curr->pi->pdir);
+   }
+   enable_preemption();
+
    ticks_to_timespec(utime_ticks, &utime);
    ticks_to_timespec(stime_ticks, &stime);
 
@@ -221,7 +243,7 @@ int sys_getrusage(int who, struct k_rusage *user_buf)
       .ru_stime = k_ts64_to_k_timeval(stime),
 
       /* linux extentions */
-      .ru_maxrss = 0,
+      .ru_maxrss = (long)(rss_pages * (PAGE_SIZE / KB)),
       .ru_ixrss  = 0,
       .ru_idrss  = 0,
       .ru_isrss  = 0,
@@ -253,17 +275,29 @@ int sys_vfork(void *u_regs)
    return do_fork(u_regs, true);
 }
 
+/* The flags required for creating a thread (what pthread_create() uses) */
+#define CLONE_THREAD_FLAGS                                                 \
+   (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD)
+
+/* The flags that can be optionally used along with CLONE_THREAD_FLAGS */
+#define CLONE_THREAD_OPT_FLAGS                                             \
+   (CLONE_SYSVSEM | CLONE_SETTLS | CLONE_PARENT_SETTID |                   \
+    CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID | CLONE_DETACHED)
+
 long sys_clone(regs_t *u_regs, ulong clone_flags, ulong newsp,
                int *u_parent_tidptr, int *u_child_tidptr, ulong tls)
 {
-   // TODO: Add full support for clone()
-
    if (clone_flags == SIGCHLD)
       return sys_fork(u_regs);
-   else if (clone_flags == (CLONE_VFORK | CLONE_VM | SIGCHLD))
+
+   if (clone_flags == (CLONE_VFORK | CLONE_VM | SIGCHLD))
       return sys_vfork(u_regs);
-   else
-      return -ENOSYS;
+
+   if ((clone_flags & ~CLONE_THREAD_OPT_FLAGS) == CLONE_THREAD_FLAGS)
+      return do_clone_thread(u_regs, clone_flags, newsp,
+                             u_parent_tidptr, u_child_tidptr, tls);
+
+   return -ENOSYS;
 }
 
 static int
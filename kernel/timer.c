@@ -32,7 +32,7 @@ u32 slow_timer_irq_handler_count;
 volatile ATOMIC(u32) __bogo_loops;
 
 /* Static variables */
-static struct list timer_wakeup_list = STATIC_LIST_INIT(timer_wakeup_list);
+static struct timer_wheel timer_wheel;
 static u32 loops_per_tick;         /* Tilck bogoMips as loops/tick    */
 static u32 loops_per_ms = 5000000; /* loops/millisecond (initial val)  */
 static u32 loops_per_us = 5000;    /* loops/microsecond (initial val) */
@@ -50,6 +50,122 @@ u64 get_ticks(void)
    return curr_ticks;
 }
 
+/*
+ * Returns the shift for the given upper level of the timer wheel. Level `l`
+ * contains timers expiring in the range [2^shift(l), 2^shift(l+1)) ticks from
+ * the current tick and its slots are indexed by `expiry >> shift(l)`.
+ */
+#define TW_LVL_SHIFT(l)            (TW_ROOT_BITS + (l) * TW_LVL_BITS)
+
+void timer_wheel_init(struct timer_wheel *tw)
+{
+   /*
+    * Start from tick 1, so that any armed timer has wakeup_tick > 0. That's
+    * necessary because wakeup_tick == 0 means "no timer" for a task.
+    */
+   tw->next_tick = 1;
+
+   for (int i = 0; i < TW_ROOT_SIZE; i++)
+      list_init(&tw->root[i]);
+
+   for (int l = 0; l < TW_LEVELS; l++)
+      for (int i = 0; i < TW_LVL_SIZE; i++)
+         list_init(&tw->lvl[l][i]);
+}
+
+static void tw_insert(struct timer_wheel *tw, struct task *ti)
+{
+   const u64 expiry = ti->wakeup_tick;
+   const u64 delta = expiry - tw->next_tick;
+   struct list *slot;
+   int l;
+
+   if ((s64)delta < 0) {
+
+      /* Already expired: just fire it on the next tick */
+      slot = &tw->root[tw->next_tick & TW_ROOT_MASK];
+
+   } else if (delta < TW_ROOT_SIZE) {
+
+      slot = &tw->root[expiry & TW_ROOT_MASK];
+
+   } else {
+
+      for (l = 0; l < TW_LEVELS - 1; l++)
+         if (delta < (1ull << TW_LVL_SHIFT(l + 1)))
+            break;
+
+      ASSERT(delta < (1ull << TW_LVL_SHIFT(TW_LEVELS)));
+      slot = &tw->lvl[l][(expiry >> TW_LVL_SHIFT(l)) & TW_LVL_MASK];
+   }
+
+   list_add_tail(slot, &ti->wakeup_timer_node);
+}
+
+/*
+ * Move all the timers in the current slot of the upper level `l` to the lower
+ * levels. Returns the index of the slot: when that's 0, the caller has to
+ * cascade the level above too, exactly like with the digits of a counter.
+ */
+static u32 tw_cascade(struct timer_wheel *tw, int l)
+{
+   const u32 idx = (tw->next_tick >> TW_LVL_SHIFT(l)) & TW_LVL_MASK;
+   struct list *slot = &tw->lvl[l][idx];
+   struct task *pos, *temp;
+
+   /*
+    * All the timers in this slot expire in less than 2^TW_LVL_SHIFT(l) ticks
+    * from now, therefore tw_insert() will always put them in a lower level:
+    * it's safe to iterate and re-insert them without a temporary list.
+    */
+   list_for_each(pos, temp, slot, wakeup_timer_node) {
+      list_remove(&pos->wakeup_timer_node);
+      tw_insert(tw, pos);
+   }
+
+   return idx;
+}
+
+void timer_wheel_add(struct timer_wheel *tw, struct task *ti, u32 ticks)
+{
+   ASSERT(ticks > 0);
+   ASSERT(ti->wakeup_tick == 0);
+
+   ti->wakeup_tick = tw->next_tick - 1 + ticks;
+   tw_insert(tw, ti);
+}
+
+u32 timer_wheel_del(struct timer_wheel *tw, struct task *ti)
+{
+   u32 rem;
+   ASSERT(ti->wakeup_tick >= tw->next_tick);
+   ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
+
+   rem = (u32)(ti->wakeup_tick - (tw->next_tick - 1));
+   list_remove(&ti->wakeup_timer_node);
+   ti->wakeup_tick = 0;
+   return rem;
+}
+
+/*
+ * Advance the timer wheel by one tick and return the list of the timers
+ * expiring exactly on that tick. The caller is expected to remove them from
+ * the list (typically, via list_remove()) and to reset their `wakeup_tick`.
+ */
+struct list *timer_wheel_advance(struct timer_wheel *tw)
+{
+   const u32 idx = tw->next_tick & TW_ROOT_MASK;
+
+   if (!idx) {
+      for (int l = 0; l < TW_LEVELS; l++)
+         if (tw_cascade(tw, l))
+            break;
+   }
+
+   tw->next_tick++;
+   return &tw->root[idx];
+}
+
 void task_set_wakeup_timer(struct task *ti, u32 ticks)
 {
    ulong var;
@@ -57,14 +173,10 @@ void task_set_wakeup_timer(struct task *ti, u32 ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up == 0) {
-         ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
-         list_add_tail(&timer_wakeup_list, &ti->wakeup_timer_node);
-      } else {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-      }
+      if (ti->wakeup_tick)
+         timer_wheel_del(&timer_wheel, ti);
 
-      ti->ticks_before_wake_up = ticks;
+      timer_wheel_add(&timer_wheel, ti, ticks);
    }
    enable_interrupts(&var);
 }
@@ -76,9 +188,9 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up > 0) {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-         ti->ticks_before_wake_up = new_ticks;
+      if (ti->wakeup_tick) {
+         timer_wheel_del(&timer_wheel, ti);
+         timer_wheel_add(&timer_wheel, ti, new_ticks);
       }
    }
    enable_interrupts(&var);
@@ -87,15 +199,12 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
 u32 task_cancel_wakeup_timer(struct task *ti)
 {
    ulong var;
-   u32 old;
+   u32 old = 0;
    disable_interrupts(&var);
    {
-      old = ti->ticks_before_wake_up;
-
-      if (old > 0) {
+      if (ti->wakeup_tick) {
          ti->timer_ready = false;
-         ti->ticks_before_wake_up = 0;
-         list_remove(&ti->wakeup_timer_node);
+         old = timer_wheel_del(&timer_wheel, ti);
       }
    }
    enable_interrupts(&var);
@@ -105,66 +214,33 @@ u32 task_cancel_wakeup_timer(struct task *ti)
 static void tick_all_timers(void)
 {
    struct task *pos, *temp;
+   struct list *expired;
    bool any_woken_up_task = false;
    ulong var;
 
    /*
-    * This is *NOT* the best we can do. In particular, it's terrible to keep
-    * the interrupts disabled while iterating the _whole_ timer_wakeup_list.
-    *
-    * Possible better solutions
-    * -----------------------------
-    * 1. Keep the tasks to wake-up in a sort of ordered list and then use
-    * relative timers. This way, at each tick we'll have to decrement just one
-    * single counter. We'll start decrement the next counter only when the first
-    * counter reaches 0 and its list node is removed. Of course, if we cannot
-    * use kmalloc() in case of sleep, it gets much harder to create such an
-    * ordered list and make it live inside a member of struct task. Maybe a BST
-    * will do the job, but that would require paying O(logN) per tick for
-    * finding the earliest timer. Not sure how better would be now for N < 50
-    * (typical), given the huge added constant for the BST functions. Also, the
-    * cancellation of a timer would require some extra effort in order to
-    * re-calculate the relative timer values, while we want the cancellation to
-    * be light-fast because it's run by IRQ handlers.
-    *
-    * 2. Use a fixed number of wakeup lists like: short-term, mid-term and
-    * long-term. Current task's wakeup list node will be placed in one those
-    * lists, depending on far in the future the task is supposted to be woke up.
-    * On every tick, here in tick_all_timers(), ONLY the short-term list will be
-    * iterated. That's a considerable improvement. In a system, there might be
-    * even 1,000 active timers, but how many of them will expire in the next
-    * second? Only a small percentage of them. To further improve the
-    * scalability, it's possible to have even more than 3 lists, or to further
-    * reduce the time-horizon of the short-term list. Periodically, but NOT on
-    * every tick, the `ticks_before_wake_up` field belonging to tasks in the
-    * other wakeup lists will adjusted with bigger decrements and tasks will be
-    * moved from one list to another. That will also happen in case the wakeup
-    * timer is changed for task with an already active timer. This solution
-    * looks much better than solution 1.
-    *
-    * Conclusion
-    * ---------------------
-    * For the moment, given the very limited scale of Tilck (tens of tasks at
-    * most running on the whole system), the current solution is safe and
-    * good-enough but, at some point, a smarter ad-hoc solution should be
-    * devised. Probably solution 2 is the right candidate.
+    * Thanks to the timer wheel, here we have to visit only the timers expiring
+    * on this tick instead of decrementing a counter for every armed timer
+    * in the system. See the comment above struct timer_wheel.
     */
    disable_interrupts(&var);
 
-   list_for_each(pos, temp, &timer_wakeup_list, wakeup_timer_node) {
+   expired = timer_wheel_advance(&timer_wheel);
 
-      /* If task is part of this list, it's counter must be > 0 */
-      ASSERT(pos->ticks_before_wake_up > 0);
+   list_for_each(pos, temp, expired, wakeup_timer_node) {
 
-      if (UNLIKELY(--pos->ticks_before_wake_up == 0)) {
+      /* All the timers in the expired slot must expire exactly now */
+      ASSERT(pos->wakeup_tick == timer_wheel.next_tick - 1);
 
-         pos->timer_ready = true;
-         list_remove(&pos->wakeup_timer_node);
+      pos->wakeup_tick = 0;
+      pos->timer_ready = true;
+      list_remove(&pos->wakeup_timer_node);
 
-         if (pos->state == TASK_STATE_SLEEPING) {
-            task_change_state(pos, TASK_STATE_RUNNABLE);
-            any_woken_up_task = true;
-         }
+      if (pos->state == TASK_STATE_SLEEPING) {
+         task_change_state(pos, TASK_STATE_RUNNABLE);
+         any_woken_up_task = true;
+      } else if (pos->state == TASK_STATE_RUNNABLE) {
+         sched_requeue_timer_ready_task(pos);
       }
    }
 
@@ -213,23 +289,23 @@ void kernel_sleep(u64 ticks)
     *    }
     *    kernel_yield();
     *
-    * But that would require task->ticks_before_wake_up to be actually 64-bit,
-    * wide and that's bad on 32-bit systems because:
+    * But that would require the `ticks` parameter of task_set_wakeup_timer()
+    * to be actually 64-bit wide and that's bad on 32-bit systems because:
     *
     *    - it would require using the soft 64-bit integers (slow)
-    *    - it would make impossible, in the case we wanted that, the counter
-    *      to be atomic.
+    *    - it would require the timer wheel to have more levels, while with
+    *      a 32-bit value, TW_LEVELS levels are enough to cover any timer.
     *
-    * Therefore, in order to use a 32-bit value for 'ticks_before_wake_up' and,
-    * at the same time being able to sleep for more than 2^32-1 ticks, we need
-    * a more tricky implementation (below), and the little extra runtime price
-    * for it is totally fine, since we're going to sleep anyways!
+    * Therefore, in order to use a 32-bit value for 'ticks' and, at the same
+    * time being able to sleep for more than 2^32-1 ticks, we need a more
+    * tricky implementation (below), and the little extra runtime price for it
+    * is totally fine, since we're going to sleep anyways!
     *
     * Implementation: how
     * ----------------------
     *
     * The simpler way to explain the algorithm is to just assume everything
-    * is in base 10 and that ticks_before_wake_up has 2 digits, while we want
+    * is in base 10 and that the `ticks` value has 2 digits, while we want
     * to support 4 digits sleep time. For example, we want to sleep for 234
     * ticks. The algorithm first computes 534 % 100 = 34 and then 534 / 100 = 5.
     * After that, it sleeps q (= 5) times for 99 ticks (max allowed). Clearly,
@@ -408,6 +484,7 @@ void init_timer(void)
 {
    static struct bogo_measure_ctx ctx;
    measure_bogomips.context = &ctx;
+   timer_wheel_init(&timer_wheel);
 
    __tick_duration = hw_timer_setup(TS_SCALE / TIMER_HZ);
 
@@ -0,0 +1,474 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+
+/*
+ * timerfd
+ * -----------
+ *
+ * The state of a timerfd is just the tick of its next expiration and its
+ * interval: the number of expirations since the last read() is computed
+ * lazily, from the current tick, by timerfd_account(). That's enough for
+ * read() and for the *_ready() checks, but not for waking up the tasks
+ * sleeping in read(), poll() or epoll_wait(): someone has to signal
+ * `rready_cond` when the timer expires.
+ *
+ * That's the job of `timerfd_thread`, a kernel thread created with the first
+ * timerfd. It keeps sleeping, through the regular task timer, until the
+ * earliest expiration among all the armed timerfds; then it signals the
+ * expired ones. timerfd_settime() wakes it up, to make it re-compute the
+ * sleep time.
+ *
+ * All the timerfd objects are protected by the global `timerfd_lock`.
+ */
+
+struct timerfd {
+
+   KOBJ_BASE_FIELDS
+
+   clockid_t clockid;
+   u64 expire_tick;              /* tick of the next expiration, 0 = disarmed */
+   u64 interval;                 /* in ticks, 0 = one-shot timer */
+   u64 expirations;              /* expirations not read yet */
+   struct kcond rready_cond;     /* signaled when the timer expires */
+   struct list_node armed_node;  /* node in `timerfd_armed_list` */
+};
+
+static struct kmutex timerfd_lock = STATIC_KMUTEX_INIT(timerfd_lock, 0);
+static struct list timerfd_armed_list = STATIC_LIST_INIT(timerfd_armed_list);
+static struct kcond timerfd_thread_cond =
+   STATIC_KCOND_INIT(timerfd_thread_cond);
+static bool timerfd_thread_created;
+
+static void timerfd_disarm(struct timerfd *t)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&timerfd_lock));
+
+   if (t->expire_tick) {
+      t->expire_tick = 0;
+      list_remove(&t->armed_node);
+   }
+}
+
+/* Account the expirations of `t` occurred until the tick `now` */
+static void timerfd_account(struct timerfd *t, u64 now)
+{
+   u64 n = 1;
+   ASSERT(kmutex_is_curr_task_holding_lock(&timerfd_lock));
+
+   if (!t->expire_tick || now < t->expire_tick)
+      return;
+
+   if (t->interval) {
+      n += (now - t->expire_tick) / t->interval;
+      t->expire_tick += n * t->interval;
+   } else {
+      timerfd_disarm(t);
+   }
+
+   t->expirations += n;
+}
+
+static void timerfd_thread()
+{
+   struct timerfd *pos, *temp;
+   u64 now, next;
+   u32 ticks;
+
+   kmutex_lock(&timerfd_lock);
+
+   while (true) {
+
+      now = get_ticks();
+      next = 0;
+
+      list_for_each(pos, temp, &timerfd_armed_list, armed_node) {
+
+         if (now >= pos->expire_tick) {
+            timerfd_account(pos, now);
+            kcond_signal_all(&pos->rready_cond);
+         }
+
+         if (pos->expire_tick && (!next || pos->expire_tick < next))
+            next = pos->expire_tick;
+      }
+
+      ticks = next
+         ? (u32)MIN(next - now, (u64)UINT32_MAX)
+         : KCOND_WAIT_FOREVER;
+
+      kcond_wait(&timerfd_thread_cond, &timerfd_lock, ticks);
+   }
+}
+
+static ssize_t timerfd_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   ssize_t rc = sizeof(u64);
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   kmutex_lock(&timerfd_lock);
+
+   while (true) {
+
+      timerfd_account(t, get_ticks());
+
+      if (t->expirations)
+         break;
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         rc = -EAGAIN;
+         goto out;
+      }
+
+      kcond_wait(&t->rready_cond, &timerfd_lock, KCOND_WAIT_FOREVER);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         goto out;
+      }
+   }
+
+   memcpy(buf, &t->expirations, sizeof(u64));
+   t->expirations = 0;
+
+out:
+   kmutex_unlock(&timerfd_lock);
+   return rc;
+}
+
+static int timerfd_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   bool ret;
+
+   kmutex_lock(&timerfd_lock);
+   {
+      timerfd_account(t, get_ticks());
+      ret = t->expirations > 0;
+   }
+   kmutex_unlock(&timerfd_lock);
+   return ret;
+}
+
+static struct kcond *timerfd_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   return &t->rready_cond;
+}
+
+static const struct file_ops static_ops_timerfd =
+{
+   .read = timerfd_read,
+   .read_ready = timerfd_read_ready,
+   .get_rready_cond = timerfd_get_rready_cond,
+};
+
+static void destroy_timerfd(struct timerfd *t)
+{
+   kmutex_lock(&timerfd_lock);
+   {
+      timerfd_disarm(t);
+   }
+   kmutex_unlock(&timerfd_lock);
+
+   kcond_destory(&t->rready_cond);
+   kfree_obj(t, struct timerfd);
+}
+
+static struct timerfd *create_timerfd(clockid_t clockid)
+{
+   struct timerfd *t;
+
+   if (!(t = kzalloc_obj(struct timerfd)))
+      return NULL;
+
+   t->destory_obj = (void *)&destroy_timerfd;
+   t->clockid = clockid;
+   kcond_init(&t->rready_cond);
+   list_node_init(&t->armed_node);
+   return t;
+}
+
+static int timerfd_start_thread_if_needed(void)
+{
+   int rc = 0;
+
+   kmutex_lock(&timerfd_lock);
+
+   if (!timerfd_thread_created) {
+
+      if (kthread_create(&timerfd_thread, 0, NULL) < 0)
+         rc = -ENOMEM;
+      else
+         timerfd_thread_created = true;
+   }
+
+   kmutex_unlock(&timerfd_lock);
+   return rc;
+}
+
+int sys_timerfd_create(int clockid, int flags)
+{
+   struct kfs_handle *h;
+   struct timerfd *t;
+   int fd;
+
+   if (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC)
+      return -EINVAL;
+
+   if (flags & ~(TFD_CLOEXEC | TFD_NONBLOCK))
+      return -EINVAL;
+
+   if ((fd = timerfd_start_thread_if_needed()))
+      return fd;
+
+   if (!(t = create_timerfd(clockid)))
+      return -ENOMEM;
+
+   h = kfs_create_new_handle(&static_ops_timerfd,
+                             (void *)t,
+                             O_RDONLY | (flags & TFD_NONBLOCK));
+
+   if (!h) {
+      destroy_timerfd(t);
+      return -ENOMEM;
+   }
+
+   if ((fd = install_fs_handle(h, !!(flags & TFD_CLOEXEC))) < 0) {
+      kfs_destroy_handle(h);
+      destroy_timerfd(t);
+   }
+
+   return fd;
+}
+
+/*
+ * Get and retain the timerfd object at `fd`, or NULL in case of error (`rc`).
+ * Retaining it keeps the object alive after releasing `fslock`: we cannot
+ * take `timerfd_lock` while holding it, because close() takes `fslock` first
+ * and then `timerfd_lock` in destroy_timerfd().
+ */
+static struct timerfd *get_timerfd(int fd, int *rc)
+{
+   struct process *pi = get_curr_proc();
+   struct kfs_handle *kh;
+   struct timerfd *t = NULL;
+
+   kmutex_lock(&pi->fslock);
+   {
+      if (!(kh = get_fs_handle(fd))) {
+         *rc = -EBADF;
+      } else if (kh->fops != &static_ops_timerfd) {
+         *rc = -EINVAL;
+      } else {
+         t = (void *)kh->kobj;
+         retain_obj(t);
+      }
+   }
+   kmutex_unlock(&pi->fslock);
+   return t;
+}
+
+static void put_timerfd(struct timerfd *t)
+{
+   if (release_obj(t) == 0)
+      destroy_timerfd(t);
+}
+
+static bool is_timespec_valid(const struct k_timespec64 *tp)
+{
+   return tp->tv_sec >= 0 && tp->tv_nsec >= 0 && tp->tv_nsec < BILLION;
+}
+
+static void timerfd_get_value(struct timerfd *t, struct k_itimerspec64 *val)
+{
+   const u64 now = get_ticks();
+
+   timerfd_account(t, now);
+   ticks_to_timespec(t->interval, &val->it_interval);
+   ticks_to_timespec(t->expire_tick ? t->expire_tick - now : 0, &val->it_value);
+}
+
+static int
+timerfd_settime_int(int fd,
+                    int flags,
+                    struct k_itimerspec64 *new_val,
+                    struct k_itimerspec64 *old_val)
+{
+   struct timerfd *t;
+   u64 now, ticks;
+   int rc = 0;
+
+   if (flags & ~TFD_TIMER_ABSTIME)
+      return -EINVAL;
+
+   if (!is_timespec_valid(&new_val->it_value) ||
+       !is_timespec_valid(&new_val->it_interval))
+   {
+      return -EINVAL;
+   }
+
+   if (!(t = get_timerfd(fd, &rc)))
+      return rc;
+
+   kmutex_lock(&timerfd_lock);
+   timerfd_get_value(t, old_val);
+   timerfd_disarm(t);
+   t->interval = 0;
+   t->expirations = 0;
+
+   if (!new_val->it_value.tv_sec && !new_val->it_value.tv_nsec)
+      goto out; /* just disarm the timer */
+
+   if (flags & TFD_TIMER_ABSTIME)
+      ticks = abs_timespec_to_ticks(t->clockid, &new_val->it_value);
+   else
+      ticks = timespec_to_ticks(&new_val->it_value);
+
+   now = get_ticks();
+   t->interval = timespec_to_ticks(&new_val->it_interval);
+
+   if (!t->interval &&
+       (new_val->it_interval.tv_sec || new_val->it_interval.tv_nsec))
+   {
+      t->interval = 1; /* sub-tick periods get rounded up to one tick */
+   }
+
+   t->expire_tick = MAX(now + ticks, (u64)1);
+   list_add_tail(&timerfd_armed_list, &t->armed_node);
+
+   /* Make timerfd_thread re-compute its sleep time */
+   kcond_signal_one(&timerfd_thread_cond);
+
+out:
+   kmutex_unlock(&timerfd_lock);
+   put_timerfd(t);
+   return rc;
+}
+
+static int timerfd_gettime_int(int fd, struct k_itimerspec64 *val)
+{
+   struct timerfd *t;
+   int rc;
+
+   if (!(t = get_timerfd(fd, &rc)))
+      return rc;
+
+   kmutex_lock(&timerfd_lock);
+   {
+      timerfd_get_value(t, val);
+   }
+   kmutex_unlock(&timerfd_lock);
+   put_timerfd(t);
+   return 0;
+}
+
+static struct k_itimerspec64 to_k_itimerspec64(struct k_itimerspec32 v)
+{
+   return (struct k_itimerspec64) {
+      .it_interval = { v.it_interval.tv_sec, v.it_interval.tv_nsec },
+      .it_value = { v.it_value.tv_sec, v.it_value.tv_nsec },
+   };
+}
+
+static struct k_itimerspec32 to_k_itimerspec32(struct k_itimerspec64 v)
+{
+   return (struct k_itimerspec32) {
+      .it_interval = to_k_timespec32(v.it_interval),
+      .it_value = to_k_timespec32(v.it_value),
+   };
+}
+
+int sys_timerfd_settime(int fd, int flags,
+                        const struct k_itimerspec64 *u_new,
+                        struct k_itimerspec64 *u_old)
+{
+   struct k_itimerspec64 new_val, old_val;
+   int rc;
+
+   if (copy_from_user(&new_val, u_new, sizeof(new_val)))
+      return -EFAULT;
+
+   if ((rc = timerfd_settime_int(fd, flags, &new_val, &old_val)))
+      return rc;
+
+   if (u_old && copy_to_user(u_old, &old_val, sizeof(old_val)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_gettime(int fd, struct k_itimerspec64 *u_curr)
+{
+   struct k_itimerspec64 val;
+   int rc;
+
+   if ((rc = timerfd_gettime_int(fd, &val)))
+      return rc;
+
+   if (copy_to_user(u_curr, &val, sizeof(val)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_settime32(int fd, int flags,
+                          const struct k_itimerspec32 *u_new,
+                          struct k_itimerspec32 *u_old)
+{
+   struct k_itimerspec32 new32, old32;
+   struct k_itimerspec64 new_val, old_val;
+   int rc;
+
+   if (copy_from_user(&new32, u_new, sizeof(new32)))
+      return -EFAULT;
+
+   new_val = to_k_itimerspec64(new32);
+
+   if ((rc = timerfd_settime_int(fd, flags, &new_val, &old_val)))
+      return rc;
+
+   old32 = to_k_itimerspec32(old_val);
+
+   if (u_old && copy_to_user(u_old, &old32, sizeof(old32)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_gettime32(int fd, struct k_itimerspec32 *u_curr)
+{
+   struct k_itimerspec64 val;
+   struct k_itimerspec32 val32;
+   int rc;
+
+   if ((rc = timerfd_gettime_int(fd, &val)))
+      return rc;
+
+   val32 = to_k_itimerspec32(val);
+
+   if (copy_to_user(u_curr, &val32, sizeof(val32)))
+      return -EFAULT;
+
+   return 0;
+}
@@ -154,7 +154,7 @@ void wake_up_tasks_waiting_on(struct task *ti, enum wakeup_reason r)
          wake_up(task_to_wake_up);
    }
 
-   if (LIKELY(pi->parent_pid > 0)) {
+   if (LIKELY(pi->parent_pid > 0) && is_main_thread(ti)) {
 
       struct task *parent_task = get_task(pi->parent_pid);
       int tid;
@@ -204,7 +204,10 @@ int sys_wait4(int tid, int *user_wstatus, int options, void *user_rusage)
 
          struct task *waited_task = get_task(tid);
 
-         if (!waited_task || !task_is_parent(curr, waited_task)) {
+         if (!waited_task                     ||
+             !is_main_thread(waited_task)     ||
+             !task_is_parent(curr, waited_task))
+         {
             enable_preemption();
             return -ECHILD;
          }
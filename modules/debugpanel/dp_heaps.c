@@ -42,6 +42,51 @@ static void dp_heaps_on_enter(void)
    debug_kmalloc_get_stats(&stats);
 }
 
+static void dp_show_kmalloc_caches(int *row_ref)
+{
+   int row = *row_ref;
+
+   dp_writeln(
+      "  size "
+      TERM_VLINE " cached "
+      TERM_VLINE "    hits    "
+      TERM_VLINE "   misses   "
+      TERM_VLINE " to heap  "
+      TERM_VLINE " hit rate "
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqnqqqqqqqqnqqqqqqqqqqqqnqqqqqqqqqqqqnqqqqqqqqqqnqqqqqqqqqq"
+      GFX_OFF
+   );
+
+   for (int i = 0; i < KMALLOC_CACHES_COUNT; i++) {
+
+      const struct kmalloc_cache_stats *c = &stats.caches[i];
+      const u64 tot = c->hits + c->misses;
+      const u32 rate = tot ? (u32)(c->hits * 1000 / tot) : 0;
+
+      dp_writeln(
+         " %4u "
+         TERM_VLINE " %2u/%2u  "
+         TERM_VLINE " %10llu "
+         TERM_VLINE " %10llu "
+         TERM_VLINE " %8llu "
+         TERM_VLINE "  %3u.%u%% ",
+         c->obj_size,
+         c->cached, c->depth,
+         c->hits,
+         c->misses,
+         c->frees_to_heap,
+         rate / 10, rate % 10
+      );
+   }
+
+   dp_writeln("");
+   *row_ref = row;
+}
+
 static void dp_show_kmalloc_heaps(void)
 {
    int row = dp_screen_start_row;
@@ -121,6 +166,7 @@ static void dp_show_kmalloc_heaps(void)
    }
 
    dp_writeln("");
+   dp_show_kmalloc_caches(&row);
 }
 
 static void dp_heaps_on_exit(void)
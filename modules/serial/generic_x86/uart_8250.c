@@ -31,6 +31,11 @@
 #define IER_SLEEP_MODE_INTR        0b00010000
 #define IER_LOW_PWR_INTR           0b00100000
 
+/* Interrupt Identification Register (IIR) */
+#define IIR_FIFO_MASK              0b11000000
+#define IIR_FIFO_ENABLED           0b11000000
+#define IIR_64_BYTE_FIFO           0b00100000
+
 /* Line Status Register (LSR) */
 #define LSR_DATA_READY             0b00000001
 #define LSR_OVERRUN_ERROR          0b00000010
@@ -160,3 +165,44 @@ void serial_write(u16 port, char c)
    serial_wait_for_write(port);
    outb(port, (u8)c);
 }
+
+/* Write a byte without waiting: the caller must know there's room for it */
+void serial_write_nowait(u16 port, char c)
+{
+   outb(port, (u8)c);
+}
+
+/*
+ * Returns the number of bytes that can be written to the TX FIFO each time it
+ * becomes empty (1 for UARTs without FIFOs) or 0, if there's no UART at all.
+ * NOTE: reading IIR clears a pending THR empty interrupt.
+ */
+u32 serial_get_tx_fifo_size(u16 port)
+{
+   u8 iir;
+
+   /* Check that the scratch register retains its value */
+   outb(port + UART_SR, 0x5a);
+
+   if (inb(port + UART_SR) != 0x5a)
+      return 0;
+
+   iir = inb(port + UART_IIR);
+
+   if ((iir & IIR_FIFO_MASK) != IIR_FIFO_ENABLED)
+      return 1;
+
+   return (iir & IIR_64_BYTE_FIFO) ? 64 : 16;
+}
+
+void serial_set_tx_intr(u16 port, bool enabled)
+{
+   u8 ier = inb(port + UART_IER);
+
+   if (enabled)
+      ier |= IER_TR_EMPTY_INTR;
+   else
+      ier &= (u8)~IER_TR_EMPTY_INTR;
+
+   outb(port + UART_IER, ier);
+}
@@ -110,6 +110,22 @@ void serial_write(u16 port, char c)
       uart->ops->tx_c(uart->priv, c);
 }
 
+void serial_write_nowait(u16 port, char c)
+{
+   serial_write(port, c);
+}
+
+u32 serial_get_tx_fifo_size(u16 port)
+{
+   /* TX interrupts are not supported by the fdt drivers: always poll */
+   return 0;
+}
+
+void serial_set_tx_intr(u16 port, bool enabled)
+{
+   /* do nothing */
+}
+
 enum irq_action fdt_serial_generic_irq_handler(void *ctx)
 {
    struct fdt_serial_dev *serial = ctx;
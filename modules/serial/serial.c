@@ -11,11 +11,16 @@
 #include <tilck/kernel/cmdline.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/interrupts.h>
 
 #include <tilck/mods/serial.h>
 
 /* NOTE: hw-specific stuff in generic code. TODO: fix that. */
 
+#define SERIAL_TX_BUF_SIZE                   (4 * KB)
+
 struct serial_device {
 
    const char *name;
@@ -23,6 +28,19 @@ struct serial_device {
    struct tty *tty;
    ATOMIC(int) jobs_cnt;
    struct worker_thread *wth;
+
+   /*
+    * TX ring, drained by the THR empty interrupt. All the fields below are
+    * protected by disabling the interrupts. A `tx_fifo_size` of 0 means that
+    * the ring is not used: writes just poll the UART.
+    */
+   u32 tx_fifo_size;
+   u32 tx_waiters;                 /* writers waiting for room in the ring */
+   bool tx_intr_on;                /* THR empty interrupt enabled */
+   bool tx_wakeup_pending;         /* ser_tx_bh_handler() is enqueued */
+   struct ringbuf tx_rb;
+   struct kcond tx_cond;
+   char tx_buf[SERIAL_TX_BUF_SIZE];
 };
 
 struct serial_device legacy_serial_ports[] =
@@ -45,6 +63,198 @@ struct serial_device legacy_serial_ports[] =
    },
 };
 
+static struct serial_device *serial_get_device(u16 port)
+{
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++)
+      if (legacy_serial_ports[i].ioport == port)
+         return &legacy_serial_ports[i];
+
+   return NULL;
+}
+
+/* Move up to a FIFO-full of bytes from the ring to the UART */
+static void serial_tx_fill_fifo(struct serial_device *dev)
+{
+   u8 c;
+
+   ASSERT(!are_interrupts_enabled());
+
+   for (u32 i = 0; i < dev->tx_fifo_size; i++) {
+
+      if (!ringbuf_read_elem1(&dev->tx_rb, &c))
+         break;
+
+      serial_write_nowait(dev->ioport, (char)c);
+   }
+}
+
+/* Send all the bytes in the ring by polling (panic and no-sleep cases) */
+static void serial_tx_flush_polled(struct serial_device *dev)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   while (!ringbuf_is_empty(&dev->tx_rb)) {
+      serial_wait_for_write(dev->ioport);
+      serial_tx_fill_fifo(dev);
+   }
+}
+
+static void serial_tx_start(struct serial_device *dev)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (dev->tx_intr_on)
+      return; /* the IRQ handler will take care of the new bytes */
+
+   if (serial_write_ready(dev->ioport))
+      serial_tx_fill_fifo(dev);
+
+   serial_set_tx_intr(dev->ioport, true);
+   dev->tx_intr_on = true;
+}
+
+static void ser_tx_bh_handler(void *ctx)
+{
+   struct serial_device *const dev = ctx;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      dev->tx_wakeup_pending = false;
+   }
+   enable_interrupts(&var);
+
+   kcond_signal_all(&dev->tx_cond);
+}
+
+/* Handles the THR empty interrupt. Returns true if it was pending */
+static bool serial_tx_irq(struct serial_device *dev)
+{
+   bool handled = false;
+   ulong var;
+
+   disable_interrupts(&var);
+
+   if (dev->tx_intr_on && serial_write_ready(dev->ioport)) {
+
+      handled = true;
+
+      if (ringbuf_is_empty(&dev->tx_rb)) {
+
+         /* Nothing more to send: that also clears the interrupt */
+         serial_set_tx_intr(dev->ioport, false);
+         dev->tx_intr_on = false;
+
+      } else {
+
+         serial_tx_fill_fifo(dev);
+      }
+
+      /* Wake up the writers once half of the ring is free */
+      if (dev->tx_waiters && !dev->tx_wakeup_pending &&
+          ringbuf_get_elems(&dev->tx_rb) <= SERIAL_TX_BUF_SIZE / 2)
+      {
+         if (wth_enqueue_on(dev->wth, &ser_tx_bh_handler, dev))
+            dev->tx_wakeup_pending = true;
+      }
+   }
+
+   enable_interrupts(&var);
+   return handled;
+}
+
+/*
+ * Write `buf` to the serial port. When the TX ring is available, the bytes
+ * are just copied there and sent by the IRQ handler, in bursts filling the
+ * UART's FIFO: the caller blocks only when the ring is full. Callers which
+ * cannot sleep make room in the ring by polling the UART instead. During
+ * panic, everything is sent by polling, after flushing the ring.
+ */
+void serial_write_buf(u16 port, const char *buf, size_t len)
+{
+   struct serial_device *dev = serial_get_device(port);
+   bool can_sleep;
+   ulong var;
+   size_t n;
+
+   if (!dev || !dev->tx_fifo_size || UNLIKELY(in_panic())) {
+
+      if (dev && dev->tx_fifo_size) {
+         disable_interrupts(&var);
+         {
+            serial_tx_flush_polled(dev);
+         }
+         enable_interrupts(&var);
+      }
+
+      for (size_t i = 0; i < len; i++)
+         serial_write(port, buf[i]);
+
+      return;
+   }
+
+   /*
+    * Worker threads must not sleep here: the serial one, in particular, is
+    * the one running ser_tx_bh_handler() to wake up the writers.
+    */
+   can_sleep = is_preemption_enabled() &&
+               !in_irq() &&
+               !is_worker_thread(get_curr_task());
+
+   while (len > 0) {
+
+      disable_interrupts(&var);
+      {
+         n = ringbuf_write_bytes(&dev->tx_rb, (u8 *)buf, len);
+
+         if (n)
+            serial_tx_start(dev);
+
+         if (n < len) {
+
+            if (can_sleep) {
+
+               dev->tx_waiters++;
+
+            } else {
+
+               /* Make room in the ring by sending one FIFO-full of bytes */
+               serial_wait_for_write(port);
+               serial_tx_fill_fifo(dev);
+            }
+         }
+      }
+      enable_interrupts(&var);
+
+      buf += n;
+      len -= n;
+
+      if (!len || !can_sleep)
+         continue;
+
+      /*
+       * The ring is full: wait for the IRQ handler to drain it. The timeout
+       * is just a safety net for lost interrupts: in that case, kick the
+       * transmission by polling.
+       */
+      if (!kcond_wait(&dev->tx_cond, NULL, TIME_SLICE_TICKS)) {
+
+         disable_interrupts(&var);
+         {
+            if (serial_write_ready(port))
+               serial_tx_fill_fifo(dev);
+         }
+         enable_interrupts(&var);
+      }
+
+      disable_interrupts(&var);
+      {
+         dev->tx_waiters--;
+      }
+      enable_interrupts(&var);
+   }
+}
+
 static void ser_bh_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
@@ -64,9 +274,15 @@ static void ser_bh_handler(void *ctx)
 static enum irq_action serial_con_irq_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
+   const bool tx_handled = serial_tx_irq(dev);
+
+   if (!serial_read_ready(dev->ioport)) {
+
+      if (tx_handled)
+         return IRQ_HANDLED;
 
-   if (!serial_read_ready(dev->ioport))
       return IRQ_NOT_HANDLED; /* Not an IRQ from this "device" [irq sharing] */
+   }
 
    if (dev->jobs_cnt >= 2)
       return IRQ_HANDLED;
@@ -125,12 +341,22 @@ static void init_serial_comm(void)
 
       dev->tty = get_serial_tty((int)i);
       dev->wth = wth;
+
+      ringbuf_init(&dev->tx_rb, SERIAL_TX_BUF_SIZE, 1, dev->tx_buf);
+      kcond_init(&dev->tx_cond);
    }
 
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com1);
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com3);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com2);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com4);
+
+   /* Now that the IRQ handlers are in place, switch to the TX rings */
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++) {
+
+      struct serial_device *dev = &legacy_serial_ports[i];
+      dev->tx_fifo_size = serial_get_tx_fifo_size(dev->ioport);
+   }
 }
 
 static struct module serial_module = {
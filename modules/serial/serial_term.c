@@ -56,14 +56,18 @@ static void
 sterm_action_write(term *_t, const char *buf, size_t len)
 {
    struct sterm *const t = _t;
+   size_t start = 0;
 
-   for (u32 i = 0; i < len; i++) {
+   for (size_t i = 0; i < len; i++) {
 
-      if (buf[i] == '\n')
-         serial_write(t->serial_port_fwd, '\r');
-
-      serial_write(t->serial_port_fwd, buf[i]);
+      if (buf[i] == '\n') {
+         serial_write_buf(t->serial_port_fwd, buf + start, i - start);
+         serial_write_buf(t->serial_port_fwd, "\r\n", 2);
+         start = i + 1;
+      }
    }
+
+   serial_write_buf(t->serial_port_fwd, buf + start, len - start);
 }
 
 static ALWAYS_INLINE void
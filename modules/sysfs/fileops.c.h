@@ -359,6 +359,9 @@ int sysfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (sh->type != VFS_FILE)
       return -EACCES;
 
+   if (um->flags & MAP_PRIVATE)
+      return -EINVAL; /* copy-on-write is not supported here */
+
    if (flags & VFS_MM_DONT_MMAP)
       return 0;
 
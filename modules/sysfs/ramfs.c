@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/fs/ramfs.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+/* sysfs path: /syst/ramfs */
+
+DEF_STATIC_SYSOBJ_PROP(fault_around, &sysobj_ptype_rw_ulong);
+DEF_STATIC_SYSOBJ_PROP(faults, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(fault_pages, &sysobj_ptype_ro_ulong);
+
+DEF_STATIC_SYSOBJ_TYPE(ramfs_sysobj_type,
+                       &prop_fault_around,
+                       &prop_faults,
+                       &prop_fault_pages,
+                       NULL);
+
+DEF_STATIC_SYSOBJ(ramfs_sysobj,
+                  &ramfs_sysobj_type,
+                  NULL,
+                  &ramfs_fault_around,
+                  &ramfs_fault_stats.faults,
+                  &ramfs_fault_stats.pages);
+
+void
+sysfs_create_ramfs_obj(void)
+{
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "ramfs", &ramfs_sysobj))
+      panic("sysfs: unable to register object 'ramfs'");
+}
@@ -16,6 +16,8 @@
 #include <tilck/kernel/modules.h>
 #include <tilck/kernel/sort.h>
 
+#include <sys/mman.h>     // system header
+
 #include "sysfs_int.h"
 #include "dents.c.h"
 #include "inodes.c.h"
@@ -25,6 +27,7 @@
 #include "lock_and_retain.c.h"
 
 void sysfs_create_config_obj(void);
+void sysfs_create_ramfs_obj(void);
 static struct mnt_fs *sysfs;
 
 static int
@@ -756,6 +759,7 @@ init_sysfs(void)
       panic("Unable to create default objects");
 
    sysfs_create_config_obj();
+   sysfs_create_ramfs_obj();
 }
 
 static struct module sysfs_module = {
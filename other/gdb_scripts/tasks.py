@@ -63,9 +63,10 @@ def get_proc(pid):
 def get_handles(proc):
 
    handles_list = []
-   handles = proc['handles']
+   fdt = proc['fdt']
+   handles = fdt['handles']
 
-   for i in range(bu.config.MAX_HANDLES):
+   for i in range(int(fdt['size'])):
       if handles[i]:
          handles_list.append(i)
 
@@ -73,16 +74,19 @@ def get_handles(proc):
 
 def get_handle(proc, n):
 
-   if n not in range(0, bu.config.MAX_HANDLES):
+   fdt = proc['fdt']
+
+   if n not in range(0, int(fdt['size'])):
       return None
 
-   return proc['handles'][n].cast(tt.fs_handle_base_p)
+   return fdt['handles'][n].cast(tt.fs_handle_base_p)
 
 def get_handle_num(proc, handle_obj_ptr):
 
-   handles = proc['handles']
+   fdt = proc['fdt']
+   handles = fdt['handles']
 
-   for i in range(bu.config.MAX_HANDLES):
+   for i in range(int(fdt['size'])):
 
       if handles[i] == handle_obj_ptr:
          return i
@@ -6,6 +6,7 @@
 
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/kmalloc_debug.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/self_tests.h>
 
@@ -49,16 +50,72 @@ static void kmalloc_perf_per_size(u32 size)
           size, duration / (u64) iters);
 }
 
-void selftest_kmalloc_perf(void)
+/*
+ * Allocate and immediately free an object, like most of the kernel's short
+ * lived objects do: that's the best case for the object caches.
+ */
+static void kmalloc_perf_hot_size(u32 size)
 {
-   const int iters = 1000;
-   printk("*** kmalloc perf test ***\n");
+   const int iters = 100000;
+   u64 start, duration;
+   void *ptr;
 
-   allocations = kalloc_array_obj(void *, 10000);
+   start = RDTSC();
 
-   if (!allocations)
-      panic("No enough memory for the 'allocations' buffer");
+   for (int i = 0; i < iters; i++) {
+
+      if (!(ptr = kmalloc(size)))
+         panic("We were unable to allocate %u bytes\n", size);
+
+      kfree2(ptr, size);
+   }
+
+   duration = RDTSC() - start;
+   kmalloc_perf_print_iters(iters);
+   printk(NO_PREFIX "Cycles per kmalloc(%6i) + kfree [hot]: %" PRIu64 "\n",
+          size, duration / (u64) iters);
+}
+
+/*
+ * Measure just kfree() on chunks from the main heaps: its cost is dominated by
+ * the lookup of the heap containing the chunk, which must not depend on the
+ * number of heaps.
+ */
+static void kmalloc_perf_main_heaps_kfree(u32 size)
+{
+   const int iters = size <= 16*KB ? 1000 : 100;
+   struct debug_kmalloc_heap_info hi;
+   u64 start, duration;
+   int heaps_count = 0;
+
+   while (heaps_count < KMALLOC_HEAPS_COUNT &&
+          debug_kmalloc_get_heap_info(heaps_count, &hi))
+   {
+      heaps_count++;
+   }
+
+   for (int i = 0; i < iters; i++) {
+
+      allocations[i] = kmalloc(size);
+
+      if (!allocations[i])
+         panic("We were unable to allocate %u bytes\n", size);
+   }
 
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++)
+      kfree2(allocations[i], size);
+
+   duration = RDTSC() - start;
+   kmalloc_perf_print_iters(iters);
+   printk(NO_PREFIX "Cycles per kfree(%6i) [%d heaps]: %" PRIu64 "\n",
+          size, heaps_count, duration / (u64) iters);
+}
+
+static void kmalloc_perf_random(void)
+{
+   const int iters = 1000;
    u64 start = RDTSC();
 
    for (int i = 0; i < iters; i++) {
@@ -81,15 +138,53 @@ void selftest_kmalloc_perf(void)
 
    printk(NO_PREFIX
           "Cycles per kmalloc(RANDOM) + kfree: %" PRIu64 "\n", duration);
+}
+
+static void kmalloc_perf_run(void)
+{
+   kmalloc_perf_random();
+
+   for (u32 s = 32; s <= 2*KB; s *= 4) {
+
+      if (se_is_stop_requested())
+         return;
+
+      kmalloc_perf_hot_size(s);
+   }
 
    for (u32 s = 32; s <= 256*KB; s *= 2) {
 
       if (se_is_stop_requested())
-         break;
+         return;
 
       kmalloc_perf_per_size(s);
    }
+}
+
+void selftest_kmalloc_perf(void)
+{
+   bool caches_were_enabled;
+   printk("*** kmalloc perf test ***\n");
+
+   allocations = kalloc_array_obj(void *, 10000);
+
+   if (!allocations)
+      panic("No enough memory for the 'allocations' buffer");
+
+   printk("Object caches: OFF\n");
+   caches_were_enabled = debug_kmalloc_set_caches_enabled(false);
+   kmalloc_perf_run();
+
+   if (!se_is_stop_requested()) {
+      printk("Object caches: ON\n");
+      debug_kmalloc_set_caches_enabled(true);
+      kmalloc_perf_run();
+   }
+
+   for (u32 s = 4*KB; s <= 64*KB && !se_is_stop_requested(); s *= 4)
+      kmalloc_perf_main_heaps_kfree(s);
 
+   debug_kmalloc_set_caches_enabled(caches_were_enabled);
    kfree_array_obj(allocations, void *, 10000);
 
    if (se_is_stop_requested())
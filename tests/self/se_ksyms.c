@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_debug.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/self_tests.h>
+
+#define KSYMS_PERF_ITERS            100000
+#define KSYMS_PERF_LINEAR_ITERS       1000
+#define KSYMS_PERF_SAMPLES             256
+
+struct ksyms_linear_ctx {
+
+   ulong vaddr;
+   const char *name;
+   struct elf_symbol_info res;
+   bool found;
+};
+
+static struct elf_symbol_info ksyms_samples[KSYMS_PERF_SAMPLES];
+static u32 ksyms_samples_count;
+static u32 ksyms_sized_count;
+
+static int ksyms_count_cb(struct elf_symbol_info *info, void *arg)
+{
+   if (info->size && *info->name)
+      ksyms_sized_count++;
+
+   return 0;
+}
+
+static int ksyms_sample_cb(struct elf_symbol_info *info, void *arg)
+{
+   const u32 stride = MAX(ksyms_sized_count / KSYMS_PERF_SAMPLES, 1u);
+   u32 *n = arg;
+
+   if (!info->size || !*info->name)
+      return 0;
+
+   if ((*n)++ % stride == 0)
+      ksyms_samples[ksyms_samples_count++] = *info;
+
+   return ksyms_samples_count == KSYMS_PERF_SAMPLES;
+}
+
+/* Reference implementation of the lookups: the linear scan of .symtab */
+static int ksyms_linear_cb(struct elf_symbol_info *info, void *arg)
+{
+   struct ksyms_linear_ctx *ctx = arg;
+   const ulong va = (ulong)info->vaddr;
+
+   if (ctx->name) {
+
+      if (strcmp(info->name, ctx->name))
+         return 0;
+
+   } else {
+
+      if (!IN_RANGE(ctx->vaddr, va, va + info->size))
+         return 0;
+   }
+
+   ctx->res = *info;
+   ctx->found = true;
+   return 1;
+}
+
+static void ksyms_check_sample(struct elf_symbol_info *sym)
+{
+   const ulong va = (ulong)sym->vaddr + sym->size / 2;
+   struct ksyms_linear_ctx ctx;
+   const char *name;
+   u32 size;
+   long off;
+
+   ctx = (struct ksyms_linear_ctx) { .vaddr = va };
+   foreach_symbol(ksyms_linear_cb, &ctx);
+   VERIFY(ctx.found);
+
+   name = find_sym_at_addr(va, &off, &size);
+
+   if (!name)
+      panic("find_sym_at_addr(%p): not found", TO_PTR(va));
+
+   /*
+    * With overlapping symbols (not just aliases), the index might return
+    * a different symbol than the linear scan: just check that it contains
+    * the address.
+    */
+   if (name != ctx.res.name)
+      printk("NOTE: %p: %s instead of %s\n", TO_PTR(va), name, ctx.res.name);
+
+   VERIFY(off >= 0 && (ulong)off < size);
+
+   ctx = (struct ksyms_linear_ctx) { .name = sym->name };
+   foreach_symbol(ksyms_linear_cb, &ctx);
+   VERIFY(ctx.found);
+   VERIFY(find_addr_of_symbol(sym->name) == (ulong)ctx.res.vaddr);
+}
+
+void selftest_ksyms_perf(void)
+{
+   struct ksyms_linear_ctx ctx;
+   u64 start, duration;
+   u32 n = 0;
+
+   if (!KERNEL_SYMBOLS) {
+      printk("Skipping the test: no kernel symbols\n");
+      se_regular_end();
+      return;
+   }
+
+   ksyms_sized_count = 0;
+   ksyms_samples_count = 0;
+   foreach_symbol(ksyms_count_cb, NULL);
+   foreach_symbol(ksyms_sample_cb, &n);
+   VERIFY(ksyms_samples_count > 0);
+
+   printk("Symbols with size: %u, samples: %u\n",
+          ksyms_sized_count, ksyms_samples_count);
+
+   for (u32 i = 0; i < ksyms_samples_count; i++)
+      ksyms_check_sample(&ksyms_samples[i]);
+
+   /* No symbol can contain the address 0 */
+   VERIFY(find_sym_at_addr(0, NULL, NULL) == NULL);
+   VERIFY(find_addr_of_symbol("__non_existent_symbol__") == 0);
+
+   start = RDTSC();
+
+   for (u32 i = 0; i < KSYMS_PERF_ITERS; i++) {
+      struct elf_symbol_info *s = &ksyms_samples[i % ksyms_samples_count];
+      find_sym_at_addr((ulong)s->vaddr, NULL, NULL);
+   }
+
+   duration = RDTSC() - start;
+   printk("find_sym_at_addr():    %8" PRIu64 " cycles\n",
+          duration / KSYMS_PERF_ITERS);
+
+   start = RDTSC();
+
+   for (u32 i = 0; i < KSYMS_PERF_ITERS; i++) {
+      struct elf_symbol_info *s = &ksyms_samples[i % ksyms_samples_count];
+      find_addr_of_symbol(s->name);
+   }
+
+   duration = RDTSC() - start;
+   printk("find_addr_of_symbol(): %8" PRIu64 " cycles\n",
+          duration / KSYMS_PERF_ITERS);
+
+   start = RDTSC();
+
+   for (u32 i = 0; i < KSYMS_PERF_LINEAR_ITERS; i++) {
+      struct elf_symbol_info *s = &ksyms_samples[i % ksyms_samples_count];
+      ctx = (struct ksyms_linear_ctx) { .vaddr = (ulong)s->vaddr };
+      foreach_symbol(ksyms_linear_cb, &ctx);
+   }
+
+   duration = RDTSC() - start;
+   printk("linear scan by addr:   %8" PRIu64 " cycles\n",
+          duration / KSYMS_PERF_LINEAR_ITERS);
+
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(ksyms_perf, se_short, &selftest_ksyms_perf)
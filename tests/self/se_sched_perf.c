@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/self_tests.h>
+
+#define SCHED_PERF_MAX_THREADS          256
+#define SCHED_PERF_TOT_YIELDS        100000
+
+static int sched_perf_tids[SCHED_PERF_MAX_THREADS];
+
+static void sched_perf_thread(void *arg)
+{
+   const u32 iters = (u32)(ulong)arg;
+
+   for (u32 i = 0; i < iters; i++)
+      kernel_yield();
+}
+
+static void do_sched_perf(u32 n)
+{
+   const u32 iters = MAX(SCHED_PERF_TOT_YIELDS / n, 100u);
+   u64 start, duration;
+
+   for (u32 i = 0; i < n; i++) {
+
+      sched_perf_tids[i] = kthread_create(sched_perf_thread, 0, TO_PTR(iters));
+
+      if (sched_perf_tids[i] < 0)
+         panic("Unable to create kthread #%u", i);
+   }
+
+   /*
+    * Once we start waiting on the threads, they'll all be runnable and each
+    * kernel_yield() will cause a context switch to another runnable thread.
+    */
+   start = RDTSC();
+   kthread_join_all(sched_perf_tids, n, true);
+   duration = RDTSC() - start;
+
+   printk("[%3u runnable] Cycles per context switch: %" PRIu64 "\n",
+          n, duration / ((u64)n * iters));
+}
+
+void selftest_sched_perf(void)
+{
+   printk("\n");
+   printk("Context switch cost vs. runnable tasks count\n");
+   printk("---------------------------------------------\n\n");
+
+   for (u32 n = 1; n <= SCHED_PERF_MAX_THREADS; n *= 4) {
+
+      if (se_is_stop_requested())
+         break;
+
+      do_sched_perf(n);
+   }
+
+   if (se_is_stop_requested())
+      se_interrupted_end();
+   else
+      se_regular_end();
+}
+
+REGISTER_SELF_TEST(sched_perf, se_med, &selftest_sched_perf)
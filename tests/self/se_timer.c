@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/self_tests.h>
+
+#include "se_data.h"
+
+#define TW_PERF_TICKS        (16 * TW_ROOT_SIZE)
+#define TW_PERF_MAX_DELAY    (8 * TIMER_HZ)
+
+static u32 tw_perf_rand_delay(u32 *r)
+{
+   *r = (*r + 1) % RANDOM_VALUES_COUNT;
+   return 1 + random_values[*r] % TW_PERF_MAX_DELAY;
+}
+
+static void do_timer_wheel_perf(struct timer_wheel *tw, u32 n)
+{
+   struct list fired = STATIC_LIST_INIT(fired);
+   struct task *tasks, *pos, *temp;
+   struct list *expired;
+   u64 start, cycles = 0;
+   u32 r = 0, expired_cnt = 0;
+
+   VERIFY(n <= RANDOM_VALUES_COUNT);
+
+   if (!(tasks = kzalloc_array_obj(struct task, n)))
+      panic("No enough memory for %u fake tasks", n);
+
+   timer_wheel_init(tw);
+
+   for (u32 i = 0; i < n; i++) {
+      list_node_init(&tasks[i].wakeup_timer_node);
+      timer_wheel_add(tw, &tasks[i], tw_perf_rand_delay(&r));
+   }
+
+   disable_preemption();
+
+   for (u32 t = 0; t < TW_PERF_TICKS; t++) {
+
+      start = RDTSC();
+      {
+         expired = timer_wheel_advance(tw);
+
+         list_for_each(pos, temp, expired, wakeup_timer_node) {
+            pos->wakeup_tick = 0;
+            list_remove(&pos->wakeup_timer_node);
+            list_add_tail(&fired, &pos->wakeup_timer_node);
+            expired_cnt++;
+         }
+      }
+      cycles += RDTSC() - start;
+
+      /* Re-arm the fired timers, like periodic sleepers would do */
+      list_for_each(pos, temp, &fired, wakeup_timer_node) {
+         list_remove(&pos->wakeup_timer_node);
+         timer_wheel_add(tw, pos, tw_perf_rand_delay(&r));
+      }
+   }
+
+   enable_preemption();
+
+   for (u32 i = 0; i < n; i++)
+      timer_wheel_del(tw, &tasks[i]);
+
+   kfree_array_obj(tasks, struct task, n);
+
+   printk("[%4u timers] Cycles per tick: %6" PRIu64 " ",
+          n, cycles / TW_PERF_TICKS);
+   printk(NO_PREFIX "(expired/tick: %u.%02u)\n",
+          expired_cnt / TW_PERF_TICKS,
+          (expired_cnt * 100 / TW_PERF_TICKS) % 100);
+}
+
+void selftest_timer_wheel_perf(void)
+{
+   struct timer_wheel *tw;
+
+   if (!(tw = kalloc_obj(struct timer_wheel)))
+      panic("No enough memory for the timer wheel");
+
+   printk("\n");
+   printk("Timer wheel per-tick cost\n");
+   printk("---------------------------------------------\n\n");
+
+   for (u32 n = 10; n <= 1000; n *= 10) {
+
+      if (se_is_stop_requested())
+         break;
+
+      do_timer_wheel_perf(tw, n);
+   }
+
+   kfree_obj(tw, struct timer_wheel);
+
+   if (se_is_stop_requested())
+      se_interrupted_end();
+   else
+      se_regular_end();
+}
+
+REGISTER_SELF_TEST(timer_wheel_perf, se_med, &selftest_timer_wheel_perf)
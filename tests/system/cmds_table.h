@@ -25,8 +25,16 @@ CMD_ENTRY(vfork_perf,   TT_LONG,   true)
 CMD_ENTRY(syscall_perf, TT_MED,    true)
 CMD_ENTRY(fpu,          TT_SHORT,  true)
 CMD_ENTRY(brk,          TT_SHORT,  true)
+CMD_ENTRY(brk_perf,     TT_SHORT,  true)
 CMD_ENTRY(mmap,         TT_MED,    true)
 CMD_ENTRY(mmap2,        TT_SHORT,  true)
+CMD_ENTRY(mmap_huge,    TT_SHORT,  true)
+CMD_ENTRY(mmap_fork,    TT_SHORT,  true)
+CMD_ENTRY(tlb_perf,     TT_MED,    true)
+CMD_ENTRY(madvise,      TT_SHORT,  true)
+CMD_ENTRY(madvise2,     TT_SHORT,  true)
+CMD_ENTRY(mremap,       TT_SHORT,  true)
+CMD_ENTRY(mremap_perf,  TT_MED,    true)
 CMD_ENTRY(kcow,         TT_SHORT,  true)
 CMD_ENTRY(wpid1,        TT_SHORT,  true)
 CMD_ENTRY(wpid2,        TT_SHORT,  true)
@@ -50,8 +58,9 @@ CMD_ENTRY(fs4,          TT_SHORT,  true)
 CMD_ENTRY(fs5,          TT_SHORT,  true)
 CMD_ENTRY(fs6,          TT_SHORT,  true)
 CMD_ENTRY(fs7,          TT_SHORT,  true)
-CMD_ENTRY(fs_perf1,     TT_SHORT,  true)
-CMD_ENTRY(fs_perf2,     TT_SHORT,  true)
+CMD_ENTRY(fs_perf1,     TT_MED,    true)
+CMD_ENTRY(fs_perf2,     TT_MED,    true)
+CMD_ENTRY(fd_perf,      TT_MED,    true)
 CMD_ENTRY(fmmap1,       TT_SHORT,  true)
 CMD_ENTRY(fmmap2,       TT_SHORT,  true)
 CMD_ENTRY(fmmap3,       TT_SHORT,  true)
@@ -59,6 +68,9 @@ CMD_ENTRY(fmmap4,       TT_SHORT,  true)
 CMD_ENTRY(fmmap5,       TT_SHORT,  true)
 CMD_ENTRY(fmmap6,       TT_SHORT,  true)
 CMD_ENTRY(fmmap7,       TT_SHORT,  true)
+CMD_ENTRY(fmmap8,       TT_SHORT,  true)
+CMD_ENTRY(fmmap9,       TT_SHORT,  true)
+CMD_ENTRY(fmmap_perf,   TT_MED,    true)
 CMD_ENTRY(pipe1,        TT_SHORT,  true)
 CMD_ENTRY(pipe2,        TT_SHORT,  true)
 CMD_ENTRY(pipe3,        TT_SHORT,  true)
@@ -73,7 +85,22 @@ CMD_ENTRY(select1,      TT_SHORT,  true)
 CMD_ENTRY(select2,      TT_SHORT,  true)
 CMD_ENTRY(select3,      TT_SHORT,  true)
 CMD_ENTRY(select4,      TT_SHORT,  true)
+CMD_ENTRY(epoll1,       TT_SHORT,  true)
+CMD_ENTRY(epoll2,       TT_SHORT,  true)
+CMD_ENTRY(epoll_perf,   TT_MED,    true)
+CMD_ENTRY(eventfd1,     TT_SHORT,  true)
+CMD_ENTRY(timerfd1,     TT_SHORT,  true)
+CMD_ENTRY(eventfd_perf, TT_MED,    true)
+CMD_ENTRY(futex1,       TT_SHORT,  true)
+CMD_ENTRY(futex_perf,   TT_SHORT,  true)
+CMD_ENTRY(futex_cont,   TT_MED,    true)
+CMD_ENTRY(futex_cv,     TT_SHORT,  true)
+CMD_ENTRY(thread1,      TT_SHORT,  true)
+CMD_ENTRY(thread2,      TT_SHORT,  true)
+CMD_ENTRY(thread_perf,  TT_MED,    true)
+CMD_ENTRY(thread_cpy,   TT_MED,    true)
 CMD_ENTRY(execve0,      TT_SHORT,  true)
+CMD_ENTRY(execve_perf,  TT_MED,    true)
 CMD_ENTRY(vfork0,       TT_SHORT,  true)
 CMD_ENTRY(extra,        TT_MED,    true)
 CMD_ENTRY(fatmm1,       TT_SHORT,  true)
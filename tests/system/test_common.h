@@ -3,11 +3,23 @@
 #pragma once
 #include "devshell.h"
 
+struct timespec;
+
 void create_test_file(const char *path, int n);
 int remove_test_file(const char *path, int n);
 void remove_test_file_expecting_success(const char *path, int n);
 bool running_on_tilck(void);
 void not_on_tilck_message(void);
+long ramfs_sysfs_read(const char *name);
+void ramfs_sysfs_write(const char *name, long val);
+
+long futex(u32 *uaddr, int op, u32 val,
+           const struct timespec *ts, u32 *uaddr2, u32 val3);
+
+int run_in_child_or_skip(const char *label,
+                         const char *skip_reason,
+                         int (*child_func)(void *),
+                         void *arg);
 
 int test_sig(void (*child_func)(void *),
              void *arg,
@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static int epoll_add(int epfd, int fd, u32 events)
+{
+   struct epoll_event ev = {
+      .events = events,
+      .data.fd = fd,
+   };
+
+   return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void read_one_byte(int fd)
+{
+   char c;
+   int rc = read(fd, &c, 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+}
+
+static void write_one_byte(int fd)
+{
+   int rc = write(fd, "x", 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+}
+
+/* Level-triggered vs edge-triggered, EPOLL_CTL_MOD/DEL and EPOLLONESHOT */
+int cmd_epoll1(int argc, char **argv)
+{
+   struct epoll_event evs[4];
+   struct epoll_event ev;
+   int lt[2], et[2];
+   int epfd, rc;
+
+   epfd = epoll_create1(EPOLL_CLOEXEC);
+   DEVSHELL_CMD_ASSERT(epfd >= 0);
+   DEVSHELL_CMD_ASSERT(fcntl(epfd, F_GETFD) & FD_CLOEXEC);
+
+   rc = pipe(lt);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = pipe(et);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = epoll_add(epfd, lt[0], EPOLLIN);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = epoll_add(epfd, et[0], EPOLLIN | EPOLLET);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Error cases */
+   rc = epoll_add(epfd, lt[0], EPOLLIN);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EEXIST);
+   rc = epoll_add(epfd, epfd, EPOLLIN);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = epoll_add(lt[0], et[0], EPOLLIN);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = epoll_ctl(epfd, EPOLL_CTL_DEL, lt[1], NULL);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOENT);
+   rc = epoll_wait(epfd, evs, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   /* Nothing is ready: both with timeout = 0 and timeout > 0 */
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = epoll_wait(epfd, evs, 4, 50 /* ms */);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   write_one_byte(lt[1]);
+   write_one_byte(et[1]);
+
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 2);
+
+   /* Without reading, only the level-triggered fd is reported again */
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(evs[0].data.fd == lt[0]);
+   DEVSHELL_CMD_ASSERT(evs[0].events == EPOLLIN);
+
+   read_one_byte(lt[0]);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* A new edge for the edge-triggered fd */
+   write_one_byte(et[1]);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(evs[0].data.fd == et[0]);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Make it level-triggered and one-shot: reported just once */
+   ev = (struct epoll_event) {
+      .events = EPOLLIN | EPOLLONESHOT,
+      .data.fd = et[0],
+   };
+
+   rc = epoll_ctl(epfd, EPOLL_CTL_MOD, et[0], &ev);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(evs[0].data.fd == et[0]);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* EPOLL_CTL_MOD re-arms it */
+   rc = epoll_ctl(epfd, EPOLL_CTL_MOD, et[0], &ev);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+
+   rc = epoll_ctl(epfd, EPOLL_CTL_DEL, et[0], NULL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Closing a watched fd removes it from the interest list */
+   write_one_byte(lt[1]);
+   close(lt[0]);
+   rc = epoll_wait(epfd, evs, 4, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   close(lt[1]);
+   close(et[0]);
+   close(et[1]);
+   close(epfd);
+   return 0;
+}
+
+/* Blocking epoll_wait() woken up by a child writing on a pipe */
+int cmd_epoll2(int argc, char **argv)
+{
+   struct epoll_event evs[2];
+   int pipefd[2];
+   int epfd, rc, wstatus;
+   pid_t childpid;
+
+   rc = pipe(pipefd);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   epfd = epoll_create(1);
+   DEVSHELL_CMD_ASSERT(epfd >= 0);
+
+   rc = epoll_add(epfd, pipefd[0], EPOLLIN);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   childpid = fork();
+   DEVSHELL_CMD_ASSERT(childpid >= 0);
+
+   if (!childpid) {
+      usleep(100 * 1000);
+      write_one_byte(pipefd[1]);
+      usleep(100 * 1000);
+      close(pipefd[1]); /* close the last writer: POLLHUP */
+      exit(0);
+   }
+
+   close(pipefd[1]);
+
+   do {
+      rc = epoll_wait(epfd, evs, 2, 3000 /* ms */);
+   } while (rc < 0 && errno == EINTR);
+
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(evs[0].events & EPOLLIN);
+   read_one_byte(pipefd[0]);
+
+   do {
+      rc = epoll_wait(epfd, evs, 2, -1);
+   } while (rc < 0 && errno == EINTR);
+
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(evs[0].events & EPOLLHUP);
+
+   rc = waitpid(childpid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   close(pipefd[0]);
+   close(epfd);
+   return 0;
+}
+
+#define EPOLL_PERF_FDS               1000
+#define EPOLL_PERF_ACTIVE               4
+#define EPOLL_PERF_ITERS             1000
+
+/* The kernel limits the number of fds per poll() call: split it */
+#define EPOLL_PERF_POLL_CHUNK         500
+
+static int epoll_perf_pipes[EPOLL_PERF_FDS][2];
+static struct pollfd epoll_perf_pfds[EPOLL_PERF_FDS];
+
+static void epoll_perf_close_pipes(int count)
+{
+   for (int i = 0; i < count; i++) {
+      close(epoll_perf_pipes[i][0]);
+      close(epoll_perf_pipes[i][1]);
+   }
+}
+
+static int epoll_perf_do_poll(void)
+{
+   int rc, tot = 0;
+
+   for (int i = 0; i < EPOLL_PERF_FDS; i += EPOLL_PERF_POLL_CHUNK) {
+      rc = poll(epoll_perf_pfds + i, EPOLL_PERF_POLL_CHUNK, 0);
+      DEVSHELL_CMD_ASSERT(rc >= 0);
+      tot += rc;
+   }
+
+   return tot;
+}
+
+/*
+ * Compare the cost of poll() and epoll_wait() with many watched fds, but just
+ * a few of them ready. epoll_wait() should not depend on the number of fds.
+ */
+int cmd_epoll_perf(int argc, char **argv)
+{
+   struct epoll_event evs[EPOLL_PERF_ACTIVE * 2];
+   u64 start, c_poll, c_epoll;
+   int epfd, rc;
+
+   STATIC_ASSERT(!(EPOLL_PERF_FDS % EPOLL_PERF_POLL_CHUNK));
+
+   for (int i = 0; i < EPOLL_PERF_FDS; i++) {
+
+      if (pipe(epoll_perf_pipes[i]) < 0) {
+
+         if (errno == EMFILE || errno == ENOMEM) {
+            printf("SKIP: cannot create %d pipes\n", EPOLL_PERF_FDS);
+            epoll_perf_close_pipes(i);
+            return 0;
+         }
+
+         DEVSHELL_CMD_ASSERT(false);
+      }
+   }
+
+   epfd = epoll_create1(0);
+   DEVSHELL_CMD_ASSERT(epfd >= 0);
+
+   for (int i = 0; i < EPOLL_PERF_FDS; i++) {
+
+      epoll_perf_pfds[i] = (struct pollfd) {
+         .fd = epoll_perf_pipes[i][0],
+         .events = POLLIN,
+      };
+
+      rc = epoll_add(epfd, epoll_perf_pipes[i][0], EPOLLIN);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   /* Make a few fds, spread across the set, ready */
+   for (int i = 0; i < EPOLL_PERF_ACTIVE; i++) {
+      const int idx = i * (EPOLL_PERF_FDS / EPOLL_PERF_ACTIVE);
+      write_one_byte(epoll_perf_pipes[idx][1]);
+   }
+
+   DEVSHELL_CMD_ASSERT(epoll_perf_do_poll() == EPOLL_PERF_ACTIVE);
+   rc = epoll_wait(epfd, evs, EPOLL_PERF_ACTIVE * 2, 0);
+   DEVSHELL_CMD_ASSERT(rc == EPOLL_PERF_ACTIVE);
+
+   start = RDTSC();
+
+   for (int i = 0; i < EPOLL_PERF_ITERS; i++)
+      epoll_perf_do_poll();
+
+   c_poll = (RDTSC() - start) / EPOLL_PERF_ITERS;
+   start = RDTSC();
+
+   for (int i = 0; i < EPOLL_PERF_ITERS; i++) {
+      rc = epoll_wait(epfd, evs, EPOLL_PERF_ACTIVE * 2, 0);
+      DEVSHELL_CMD_ASSERT(rc == EPOLL_PERF_ACTIVE);
+   }
+
+   c_epoll = (RDTSC() - start) / EPOLL_PERF_ITERS;
+
+   close(epfd);
+   epoll_perf_close_pipes(EPOLL_PERF_FDS);
+
+   printf("Avg. cost in cycles with %d fds, %d ready:\n\n",
+          EPOLL_PERF_FDS, EPOLL_PERF_ACTIVE);
+   printf("   poll():       %10" PRIu64 "\n", c_poll);
+   printf("   epoll_wait(): %10" PRIu64 "\n", c_epoll);
+   printf("\n");
+
+   if (running_on_tilck())
+      DEVSHELL_CMD_ASSERT(c_epoll < c_poll);
+
+   return 0;
+}
@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "devshell.h"
+
+static u64 efd_read(int fd)
+{
+   u64 val;
+   int rc = read(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(val));
+   return val;
+}
+
+static void efd_write(int fd, u64 val)
+{
+   int rc = write(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(val));
+}
+
+static bool is_fd_readable(int fd, int timeout_ms)
+{
+   struct pollfd pfd = { .fd = fd, .events = POLLIN };
+   int rc;
+
+   do {
+      rc = poll(&pfd, 1, timeout_ms);
+   } while (rc < 0 && errno == EINTR);
+
+   DEVSHELL_CMD_ASSERT(rc >= 0);
+   return rc > 0 && (pfd.revents & POLLIN);
+}
+
+int cmd_eventfd1(int argc, char **argv)
+{
+   u64 val;
+   int fd, rc;
+
+   fd = eventfd(3, EFD_NONBLOCK | EFD_CLOEXEC);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+   DEVSHELL_CMD_ASSERT(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+
+   /* Counter semantics: read() returns the whole counter and resets it */
+   DEVSHELL_CMD_ASSERT(is_fd_readable(fd, 0));
+   efd_write(fd, 2);
+   efd_write(fd, 5);
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 10);
+   DEVSHELL_CMD_ASSERT(!is_fd_readable(fd, 0));
+
+   rc = read(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+
+   /* Short buffers and the reserved value are rejected */
+   rc = read(fd, &val, sizeof(val) - 1);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   val = ~0ull;
+   rc = write(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   /* The counter cannot overflow: the writer has to wait */
+   efd_write(fd, ~0ull - 1);
+   val = 1;
+   rc = write(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == ~0ull - 1);
+   close(fd);
+
+   /* Semaphore semantics: read() returns 1 and decrements the counter */
+   fd = eventfd(2, EFD_NONBLOCK | EFD_SEMAPHORE);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 1);
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 1);
+   rc = read(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   close(fd);
+
+   fd = eventfd(0, 0x12345678);
+   DEVSHELL_CMD_ASSERT(fd < 0 && errno == EINVAL);
+   return 0;
+}
+
+static void timerfd_set(int fd, int flags, long value_ms, long interval_ms)
+{
+   struct itimerspec its = {
+      .it_value = {
+         .tv_sec = value_ms / 1000,
+         .tv_nsec = (value_ms % 1000) * 1000000,
+      },
+      .it_interval = {
+         .tv_sec = interval_ms / 1000,
+         .tv_nsec = (interval_ms % 1000) * 1000000,
+      },
+   };
+
+   int rc = timerfd_settime(fd, flags, &its, NULL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
+int cmd_timerfd1(int argc, char **argv)
+{
+   struct itimerspec its;
+   struct timespec now;
+   u64 val;
+   int fd, rc;
+
+   fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+
+   /* Disarmed */
+   rc = read(fd, &val, sizeof(val));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   DEVSHELL_CMD_ASSERT(!is_fd_readable(fd, 50));
+
+   /* One-shot timer: poll() has to wake up when it expires */
+   timerfd_set(fd, 0, 50, 0);
+   rc = timerfd_gettime(fd, &its);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(its.it_value.tv_sec || its.it_value.tv_nsec);
+   DEVSHELL_CMD_ASSERT(!its.it_interval.tv_sec && !its.it_interval.tv_nsec);
+
+   DEVSHELL_CMD_ASSERT(is_fd_readable(fd, 3000));
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 1);
+   DEVSHELL_CMD_ASSERT(!is_fd_readable(fd, 100));
+
+   rc = timerfd_gettime(fd, &its);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(!its.it_value.tv_sec && !its.it_value.tv_nsec);
+
+   /* Periodic timer: the expirations accumulate until read() */
+   timerfd_set(fd, 0, 20, 20);
+   usleep(250 * 1000);
+   val = efd_read(fd);
+   printf("Periodic timer (20 ms): %" PRIu64 " expirations in 250 ms\n", val);
+   DEVSHELL_CMD_ASSERT(val >= 5);
+
+   /* Disarm it */
+   timerfd_set(fd, 0, 0, 0);
+   DEVSHELL_CMD_ASSERT(!is_fd_readable(fd, 100));
+
+   /* Absolute time in the past: expires immediately */
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   its = (struct itimerspec) { .it_value = now };
+   rc = timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(is_fd_readable(fd, 3000));
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 1);
+
+   /* Blocking read() */
+   close(fd);
+   fd = timerfd_create(CLOCK_REALTIME, 0);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+   timerfd_set(fd, 0, 30, 0);
+   DEVSHELL_CMD_ASSERT(efd_read(fd) == 1);
+   close(fd);
+
+   its.it_value.tv_nsec = 1000000000;
+   rc = timerfd_settime(0, 0, &its, NULL);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   return 0;
+}
+
+#define WAKEUP_PERF_ITERS            2000
+
+/*
+ * Measure the round-trip latency of a wake-up between two tasks, ping-pong
+ * style, using two eventfds or two pipes.
+ */
+static u64 wakeup_round_trip(int ping[2], int pong[2], bool use_efd)
+{
+   int rc, wstatus;
+   u64 start, val = 1;
+   pid_t pid;
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      for (int i = 0; i < WAKEUP_PERF_ITERS; i++) {
+
+         if (read(ping[0], &val, use_efd ? 8 : 1) <= 0)
+            exit(1);
+
+         if (write(pong[1], &val, use_efd ? 8 : 1) <= 0)
+            exit(1);
+      }
+
+      exit(0);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < WAKEUP_PERF_ITERS; i++) {
+
+      rc = write(ping[1], &val, use_efd ? 8 : 1);
+      DEVSHELL_CMD_ASSERT(rc > 0);
+
+      rc = read(pong[0], &val, use_efd ? 8 : 1);
+      DEVSHELL_CMD_ASSERT(rc > 0);
+   }
+
+   start = (RDTSC() - start) / WAKEUP_PERF_ITERS;
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   return start;
+}
+
+int cmd_eventfd_perf(int argc, char **argv)
+{
+   int ping[2], pong[2];
+   u64 c_pipe, c_efd;
+   int rc;
+
+   rc = pipe(ping);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = pipe(pong);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   c_pipe = wakeup_round_trip(ping, pong, false);
+
+   close(ping[0]); close(ping[1]);
+   close(pong[0]); close(pong[1]);
+
+   ping[0] = ping[1] = eventfd(0, 0);
+   pong[0] = pong[1] = eventfd(0, 0);
+   DEVSHELL_CMD_ASSERT(ping[0] >= 0 && pong[0] >= 0);
+
+   c_efd = wakeup_round_trip(ping, pong, true);
+
+   close(ping[0]);
+   close(pong[0]);
+
+   printf("Avg. wake-up round-trip cost in cycles:\n\n");
+   printf("   pipes:    %10" PRIu64 "\n", c_pipe);
+   printf("   eventfds: %10" PRIu64 "\n", c_efd);
+   printf("\n");
+   return 0;
+}
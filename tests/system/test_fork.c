@@ -16,6 +16,7 @@
 
 #include "devshell.h"
 #include "sysenter.h"
+#include "test_common.h"
 
 static int sysenter_fork(void)
 {
@@ -87,9 +88,8 @@ int cmd_fork0(int argc, char **argv)
    return fork_test(&fork);
 }
 
-static int do_fork_perf(int (*fork_func)(void))
+static int do_fork_perf_iters(int (*fork_func)(void), int iters)
 {
-   const int iters = 150000;
    int rc, wstatus, child_pid;
    ull_t start, duration;
 
@@ -125,6 +125,123 @@ static int do_fork_perf(int (*fork_func)(void))
    return 0;
 }
 
+static void kill_and_wait_children(int *pids, int n)
+{
+   for (int i = 0; i < n; i++)
+      kill(pids[i], SIGKILL);
+
+   for (int i = 0; i < n; i++)
+      waitpid(pids[i], NULL, 0);
+}
+
+/*
+ * Measure the cost of fork() while there are `n` other live processes in the
+ * system: with a proper PID allocator, it should not depend on `n`.
+ */
+static int do_fork_perf_with_tasks(int (*fork_func)(void), int n, int iters)
+{
+   int *pids = calloc((size_t)n, sizeof(int));
+   int rc;
+
+   if (n && !pids) {
+      printf("Out of memory\n");
+      return 1;
+   }
+
+   for (int i = 0; i < n; i++) {
+
+      pids[i] = fork();
+
+      if (pids[i] < 0) {
+         perror("fork() failed");
+         kill_and_wait_children(pids, i);
+         free(pids);
+         return 1;
+      }
+
+      if (!pids[i]) {
+         while (true)
+            pause();
+      }
+   }
+
+   printf("[%4d extra tasks] ", n);
+   fflush(stdout);
+   rc = do_fork_perf_iters(fork_func, iters);
+
+   kill_and_wait_children(pids, n);
+   free(pids);
+   return rc;
+}
+
+/*
+ * Measure the cost of fork() in a process having `rss_mb` MB of memory
+ * actually allocated: with page tables shared on fork, it should not depend
+ * much on that. The measurement is done in a child process, which might be
+ * killed by the kernel if there's not enough memory.
+ */
+struct fork_perf_rss_args {
+   int (*fork_func)(void);
+   int rss_mb;
+   int iters;
+};
+
+static int fork_perf_rss_child(void *arg)
+{
+   const struct fork_perf_rss_args *a = arg;
+   const size_t page_size = getpagesize();
+   const size_t len = (size_t)a->rss_mb * MB;
+   char *buf;
+
+   buf = mmap(NULL,
+              len,
+              PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE,
+              -1,
+              0);
+
+   if (buf == (void *)-1)
+      return 2;
+
+   for (size_t off = 0; off < len; off += page_size)
+      buf[off] = 1;
+
+   return do_fork_perf_iters(a->fork_func, a->iters);
+}
+
+static int do_fork_perf_with_rss(int (*fork_func)(void), int rss_mb, int iters)
+{
+   struct fork_perf_rss_args args = { fork_func, rss_mb, iters };
+   char label[32];
+
+   snprintf(label, sizeof(label), "[%4d MB RSS]", rss_mb);
+
+   return run_in_child_or_skip(label,
+                               "not enough memory",
+                               &fork_perf_rss_child,
+                               &args);
+}
+
+static int do_fork_perf(int (*fork_func)(void))
+{
+   static const int extra_tasks[] = { 0, 64, 256 };
+   static const int rss_mb[] = { 1, 16, 128 };
+   int rc;
+
+   if ((rc = do_fork_perf_iters(fork_func, 150000)))
+      return rc;
+
+   for (int i = 0; i < ARRAY_SIZE(extra_tasks); i++)
+      if ((rc = do_fork_perf_with_tasks(fork_func, extra_tasks[i], 10000)))
+         return rc;
+
+   for (int i = 0; i < ARRAY_SIZE(rss_mb); i++)
+      if ((rc = do_fork_perf_with_rss(fork_func, rss_mb[i], 2000)))
+         return rc;
+
+   return 0;
+}
+
 int cmd_fork_se(int argc, char **argv)
 {
    return fork_test(&sysenter_fork);
@@ -192,6 +309,46 @@ int cmd_execve0(int argc, char **argv)
    return 0;
 }
 
+/*
+ * Measure the cost of fork() + execve() + exit() + waitpid(), executing
+ * devshell itself. That's dominated by the loading of the ELF file and by the
+ * page faults of its startup code, therefore it depends on how lazily the
+ * kernel maps its segments (the writable ones in particular).
+ */
+int cmd_execve_perf(int argc, char **argv)
+{
+   const char *devshell_path = get_devshell_path();
+   const int iters = 1000;
+   int rc, pid, wstatus;
+   ull_t start, duration;
+
+   if (argc >= 1 && !strcmp(argv[0], "--child"))
+      return 0;
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+
+      pid = fork();
+      DEVSHELL_CMD_ASSERT(pid >= 0);
+
+      if (!pid) {
+         execl(devshell_path, "devshell", "-c", "execve_perf", "--child", NULL);
+         perror("execl");
+         _exit(123);
+      }
+
+      rc = waitpid(pid, &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pid);
+      DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus));
+      DEVSHELL_CMD_ASSERT(WEXITSTATUS(wstatus) == 0);
+   }
+
+   duration = RDTSC() - start;
+   printf("fork + execve + exit + wait: %llu cycles\n", duration / iters);
+   return 0;
+}
+
 int cmd_fork1(int argc, char **argv)
 {
    int rc, pid, wstatus;
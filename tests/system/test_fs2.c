@@ -575,3 +575,269 @@ int cmd_fmmap7(int argc, char **argv)
    unlink(test_file);
    return rc;
 }
+
+/* Fault across many small mappings of the same file */
+int cmd_fmmap8(int argc, char **argv)
+{
+   const int count = 1000;
+   const size_t page_size = getpagesize();
+   ull_t start, duration;
+   char **maps;
+   int fd, rc, val;
+
+   maps = calloc(count, sizeof(char *));
+   DEVSHELL_CMD_ASSERT(maps != NULL);
+
+   fd = open(test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   /* Sparse file: each page will be allocated and mapped on fault */
+   rc = ftruncate(fd, (off_t)(count * page_size));
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < count; i++) {
+
+      maps[i] = mmap(NULL,                   /* addr */
+                     page_size,              /* length */
+                     PROT_READ | PROT_WRITE, /* prot */
+                     MAP_SHARED,             /* flags */
+                     fd,                     /* fd */
+                     (off_t)(i * page_size));
+
+      DEVSHELL_CMD_ASSERT(maps[i] != (void *)-1);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < count; i++)
+      memcpy(maps[i], &i, sizeof(i));      /* page fault */
+
+   duration = RDTSC() - start;
+   printf("Cycles per fault with %d mappings: %llu\n",
+          count, duration / (ull_t)count);
+
+   /* Un-map half of the mappings: the other ones must be still there */
+   for (int i = 0; i < count; i += 2) {
+      rc = munmap(maps[i], page_size);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   for (int i = 1; i < count; i += 2) {
+      memcpy(&val, maps[i], sizeof(val));
+      DEVSHELL_CMD_ASSERT(val == i);
+   }
+
+   /* Check the data through read() as well */
+   for (int i = 0; i < count; i++) {
+
+      rc = (int)lseek(fd, (off_t)(i * page_size), SEEK_SET);
+      DEVSHELL_CMD_ASSERT(rc == (int)(i * page_size));
+
+      rc = read(fd, &val, sizeof(val));
+      DEVSHELL_CMD_ASSERT(rc == sizeof(val));
+      DEVSHELL_CMD_ASSERT(val == i);
+   }
+
+   for (int i = 1; i < count; i += 2) {
+      rc = munmap(maps[i], page_size);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   close(fd);
+   rc = unlink(test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   free(maps);
+   return 0;
+}
+
+/* Private file mappings: the writes must NOT reach the file */
+int cmd_fmmap9(int argc, char **argv)
+{
+   const size_t page_size = getpagesize();
+   char *page_size_buf, *vaddr;
+   char buf[32];
+   int fd, rc;
+
+   page_size_buf = malloc(page_size);
+   DEVSHELL_CMD_ASSERT(page_size_buf != NULL);
+
+   fd = open(test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   for (int i = 0; i < 2; i++) {
+      memset(page_size_buf, 'A' + i, page_size);
+      rc = write(fd, page_size_buf, page_size);
+      DEVSHELL_CMD_ASSERT(rc == page_size);
+   }
+
+   /* Re-open the file read-only: PROT_WRITE is allowed with MAP_PRIVATE */
+   close(fd);
+   fd = open(test_file, O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   vaddr = mmap(NULL,                   /* addr */
+                2 * page_size,          /* length */
+                PROT_READ | PROT_WRITE, /* prot */
+                MAP_PRIVATE,            /* flags */
+                fd,                     /* fd */
+                0);                     /* offset */
+
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+   DEVSHELL_CMD_ASSERT(vaddr[0] == 'A');
+   DEVSHELL_CMD_ASSERT(vaddr[page_size] == 'B');
+
+   strcpy(vaddr, test_str);
+   DEVSHELL_CMD_ASSERT(!strcmp(vaddr, test_str));
+   DEVSHELL_CMD_ASSERT(vaddr[page_size] == 'B');
+
+   /* The file must still contain the original data */
+   rc = read(fd, buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+
+   for (int i = 0; i < sizeof(buf); i++)
+      DEVSHELL_CMD_ASSERT(buf[i] == 'A');
+
+   rc = munmap(vaddr, 2 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* A new mapping must see the file's content, not the old private copy */
+   vaddr = mmap(NULL, page_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+   DEVSHELL_CMD_ASSERT(vaddr[0] == 'A');
+
+   rc = munmap(vaddr, page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   close(fd);
+   free(page_size_buf);
+   rc = unlink(test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+#define FMMAP_PERF_FILE_SZ                (64 * MB)
+#define RAMFS_SYSFS_DIR                   "/syst/ramfs/"
+
+/* Returns the value of a /syst/ramfs property or -1, if it's not available */
+long ramfs_sysfs_read(const char *name)
+{
+   char path[64], buf[32] = {0};
+   int fd, rc;
+
+   sprintf(path, RAMFS_SYSFS_DIR "%s", name);
+
+   if ((fd = open(path, O_RDONLY)) < 0)
+      return -1;
+
+   rc = read(fd, buf, sizeof(buf) - 1);
+   close(fd);
+   return rc > 0 ? strtol(buf, NULL, 10) : -1;
+}
+
+void ramfs_sysfs_write(const char *name, long val)
+{
+   char path[64], buf[32];
+   int fd, rc;
+
+   sprintf(path, RAMFS_SYSFS_DIR "%s", name);
+   sprintf(buf, "%ld\n", val);
+
+   fd = open(path, O_WRONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   rc = write(fd, buf, strlen(buf));
+   DEVSHELL_CMD_ASSERT(rc == (int)strlen(buf));
+   close(fd);
+}
+
+/*
+ * Sequential read, through a shared mapping, of a file whose blocks have
+ * been all allocated by write() *after* mmap(): all the pages have to be
+ * mapped on fault. Returns the count of faults or -1, if not available.
+ */
+static long fmmap_perf_read(int fd, const char *label)
+{
+   const size_t page_size = getpagesize();
+   const long faults0 = ramfs_sysfs_read("faults");
+   const long pages0 = ramfs_sysfs_read("fault_pages");
+   long faults1, pages1;
+   ull_t start, duration;
+   volatile char *vaddr;
+   char *buf;
+   int rc;
+
+   rc = ftruncate(fd, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = ftruncate(fd, FMMAP_PERF_FILE_SZ);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   vaddr = mmap(NULL, FMMAP_PERF_FILE_SZ, PROT_READ, MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+
+   buf = malloc(MB);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+
+   for (size_t off = 0; off < FMMAP_PERF_FILE_SZ; off += MB) {
+
+      for (size_t i = 0; i < MB; i += page_size)
+         buf[i] = (char)((off + i) / page_size);
+
+      rc = pwrite(fd, buf, MB, (off_t)off);
+      DEVSHELL_CMD_ASSERT(rc == MB);
+   }
+
+   free(buf);
+   start = RDTSC();
+
+   for (size_t off = 0; off < FMMAP_PERF_FILE_SZ; off += page_size)
+      DEVSHELL_CMD_ASSERT(vaddr[off] == (char)(off / page_size));
+
+   duration = RDTSC() - start;
+   faults1 = ramfs_sysfs_read("faults");
+   pages1 = ramfs_sysfs_read("fault_pages");
+
+   printf("[%-16s] %6llu cycles/page", label,
+          duration / (FMMAP_PERF_FILE_SZ / page_size));
+
+   if (faults0 >= 0 && faults1 >= 0)
+      printf(", faults: %6ld, pages mapped: %6ld\n",
+             faults1 - faults0, pages1 - pages0);
+   else
+      printf("\n");
+
+   rc = munmap((void *)vaddr, FMMAP_PERF_FILE_SZ);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return faults0 >= 0 ? faults1 - faults0 : -1;
+}
+
+/* Benchmark the fault-around of ramfs with a 64 MB sequential mmap read */
+int cmd_fmmap_perf(int argc, char **argv)
+{
+   const long fault_around = ramfs_sysfs_read("fault_around");
+   const long pages = FMMAP_PERF_FILE_SZ / getpagesize();
+   long faults;
+   int fd, rc;
+
+   fd = open(test_file, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   if (fault_around >= 0) {
+
+      ramfs_sysfs_write("fault_around", 1);
+      faults = fmmap_perf_read(fd, "no fault-around");
+      ramfs_sysfs_write("fault_around", fault_around);
+
+      DEVSHELL_CMD_ASSERT(faults == pages);
+   }
+
+   faults = fmmap_perf_read(fd, "fault-around");
+
+   if (fault_around >= 2)
+      DEVSHELL_CMD_ASSERT(faults <= pages / fault_around);
+
+   close(fd);
+   rc = unlink(test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
@@ -44,33 +44,147 @@ void remove_test_file_expecting_success(const char *path, int n)
    DEVSHELL_CMD_ASSERT(rc == 0);
 }
 
-int cmd_fs_perf1(int argc, char **argv)
+static void stat_test_file(const char *path, int n)
 {
-   const int n = 1000;
-   u64 start, end, elapsed;
-   const char *dest_dir = argc > 0 ? argv[0] : "/tmp";
-   printf("Using '%s' as test dir\n", dest_dir);
+   char abs_path[256];
+   struct stat statbuf;
+   int rc;
+
+   sprintf(abs_path, "%s/test_%03d", path, n);
+   rc = stat(abs_path, &statbuf);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
+static void fs_perf1_run(const char *dest_dir, int n)
+{
+   u64 start, c_creat, c_stat, c_unlink;
 
    start = RDTSC();
 
    for (int i = 0; i < n; i++)
       create_test_file(dest_dir, i);
 
-   end = RDTSC();
-   elapsed = (end - start) / n;
+   c_creat = (RDTSC() - start) / (u64)n;
    start = RDTSC();
 
-   printf("Avg. creat() cost:  %4" PRIu64 " cycles\n", elapsed);
+   for (int i = 0; i < n; i++)
+      stat_test_file(dest_dir, (int)((i * 7919LL) % n));
+
+   c_stat = (RDTSC() - start) / (u64)n;
+   start = RDTSC();
 
    for (int i = 0; i < n; i++)
      remove_test_file_expecting_success(dest_dir, i);
 
-   end = RDTSC();
-   elapsed = (end - start) / n;
-   printf("Avg. unlink() cost: %4" PRIu64 " cycles\n", elapsed);
+   c_unlink = (RDTSC() - start) / (u64)n;
+
+   printf("%7d files | %10" PRIu64 " | %10" PRIu64 " | %10" PRIu64 "\n",
+          n, c_creat, c_stat, c_unlink);
+}
+
+int cmd_fs_perf1(int argc, char **argv)
+{
+   const char *dest_dir = argc > 0 ? argv[0] : "/tmp";
+   printf("Using '%s' as test dir\n", dest_dir);
+   printf("\nAvg. cost in cycles:\n\n");
+   printf("  dir size    |   creat()  |   stat()   |  unlink()\n");
+   printf("--------------+------------+------------+-----------\n");
+
+   for (int n = 1000; n <= 100000; n *= 10)
+      fs_perf1_run(dest_dir, n);
+
+   printf("\n");
    return 0;
 }
 
+#define FS_PERF2_MIN_XFER          (4 * KB)
+#define FS_PERF2_MAX_XFER         (16 * MB)
+#define FS_PERF2_TOT_DATA         (32 * MB)
+
+static u64 fs_perf2_now_us(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
+
+/*
+ * Transfer FS_PERF2_TOT_DATA bytes to/from `fd` using `xfer`-sized read() or
+ * write() calls, rewinding every FS_PERF2_MAX_XFER bytes. Short transfers are
+ * handled as regular programs do. Returns the elapsed time in microseconds.
+ */
+static u64 fs_perf2_do_xfer(int fd, char *buf, size_t xfer, bool wr, int *calls)
+{
+   u64 start = fs_perf2_now_us();
+   size_t tot = 0;
+   ssize_t rc;
+
+   *calls = 0;
+
+   while (tot < FS_PERF2_TOT_DATA) {
+
+      const size_t off = tot % FS_PERF2_MAX_XFER;
+      const size_t len = MIN(xfer, (size_t)FS_PERF2_MAX_XFER - off);
+
+      if (!off) {
+         rc = lseek(fd, 0, SEEK_SET);
+         DEVSHELL_CMD_ASSERT(rc == 0);
+      }
+
+      if (wr)
+         rc = write(fd, buf + off % xfer, len);
+      else
+         rc = read(fd, buf + off % xfer, len);
+
+      DEVSHELL_CMD_ASSERT(rc > 0);
+      tot += (size_t)rc;
+      (*calls)++;
+   }
+
+   return MAX(fs_perf2_now_us() - start, 1ull);
+}
+
+static void fs_perf2_transfer_sizes(const char *dest_dir)
+{
+   int fd, rc, wr_calls, rd_calls;
+   u64 wr_us, rd_us;
+   char path[256];
+   char *buf;
+
+   buf = malloc(FS_PERF2_MAX_XFER);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+   memset(buf, 'x', FS_PERF2_MAX_XFER);
+
+   sprintf(path, "%s/test_file", dest_dir);
+   fd = open(path, O_RDWR | O_CREAT, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   printf("\n");
+   printf(" xfer size | write MB/s | calls/xfer | read MB/s | calls/xfer\n");
+   printf("-----------+------------+------------+-----------+-----------\n");
+
+   for (size_t x = FS_PERF2_MIN_XFER; x <= FS_PERF2_MAX_XFER; x *= 4) {
+
+      const int xfers = FS_PERF2_TOT_DATA / (int)x;
+
+      wr_us = fs_perf2_do_xfer(fd, buf, x, true, &wr_calls);
+      rd_us = fs_perf2_do_xfer(fd, buf, x, false, &rd_calls);
+
+      printf("%6zu KB | %10" PRIu64 " | %10d | %9" PRIu64 " | %10d\n",
+             x / KB,
+             (u64)FS_PERF2_TOT_DATA / wr_us,       /* bytes/us = MB/s */
+             wr_calls / xfers,
+             (u64)FS_PERF2_TOT_DATA / rd_us,
+             rd_calls / xfers);
+   }
+
+   close(fd);
+   free(buf);
+
+   rc = unlink(path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
 int cmd_fs_perf2(int argc, char **argv)
 {
    const int n = 1024;
@@ -107,5 +221,117 @@ int cmd_fs_perf2(int argc, char **argv)
 
    rc = unlink(path);
    DEVSHELL_CMD_ASSERT(rc == 0);
+
+   fs_perf2_transfer_sizes(dest_dir);
+   return 0;
+}
+
+#define FD_PERF_COUNT            10000
+
+static int fd_perf_fds[FD_PERF_COUNT];
+
+static void fd_perf_close_all(int count)
+{
+   int rc;
+
+   for (int i = 0; i < count; i++) {
+      rc = close(fd_perf_fds[i]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+}
+
+/* Returns false if the per-process limit of handles is too low */
+static bool fd_perf_open_all(const char *path)
+{
+   for (int i = 0; i < FD_PERF_COUNT; i++) {
+
+      fd_perf_fds[i] = open(path, O_RDONLY);
+
+      if (fd_perf_fds[i] < 0 && errno == EMFILE) {
+         fd_perf_close_all(i);
+         return false;
+      }
+
+      DEVSHELL_CMD_ASSERT(fd_perf_fds[i] >= 0);
+      DEVSHELL_CMD_ASSERT(!i || fd_perf_fds[i] > fd_perf_fds[i - 1]);
+   }
+
+   return true;
+}
+
+int cmd_fd_perf(int argc, char **argv)
+{
+   const char *dest_dir = argc > 0 ? argv[0] : "/tmp";
+   u64 start, c_open, c_close, c_dup, c_fork;
+   int fd, rc, wstatus, pid;
+   char path[256];
+
+   sprintf(path, "%s/fd_perf_file", dest_dir);
+   fd = open(path, O_RDONLY | O_CREAT, 0644);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+   close(fd);
+
+   start = RDTSC();
+
+   if (!fd_perf_open_all(path)) {
+      printf("SKIP: the limit of handles per process is too low\n");
+      unlink(path);
+      return 0;
+   }
+
+   c_open = (RDTSC() - start) / FD_PERF_COUNT;
+
+   /* The lowest free fd has to be re-used, even in a table this big */
+   rc = close(fd_perf_fds[FD_PERF_COUNT / 3]);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   fd = open(path, O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd == fd_perf_fds[FD_PERF_COUNT / 3]);
+
+   /* F_DUPFD_CLOEXEC must set FD_CLOEXEC on the new fd */
+   fd = fcntl(fd_perf_fds[0], F_DUPFD_CLOEXEC, fd_perf_fds[0] + 1);
+   DEVSHELL_CMD_ASSERT(fd > fd_perf_fds[FD_PERF_COUNT - 1]);
+   DEVSHELL_CMD_ASSERT(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+   close(fd);
+
+   /* fork() has to copy the whole table */
+   start = RDTSC();
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid)
+      _exit(0);
+
+   c_fork = RDTSC() - start;
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+
+   /* Make every other fd free and fill the holes with dup() */
+   for (int i = 0; i < FD_PERF_COUNT; i += 2) {
+      rc = close(fd_perf_fds[i]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < FD_PERF_COUNT; i += 2) {
+      fd = dup(fd_perf_fds[i + 1]);
+      DEVSHELL_CMD_ASSERT(fd == fd_perf_fds[i]);
+   }
+
+   c_dup = (RDTSC() - start) / (FD_PERF_COUNT / 2);
+
+   start = RDTSC();
+   fd_perf_close_all(FD_PERF_COUNT);
+   c_close = (RDTSC() - start) / FD_PERF_COUNT;
+
+   rc = unlink(path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("Avg. cost in cycles with %d open fds:\n\n", FD_PERF_COUNT);
+   printf("   open():  %10" PRIu64 "\n", c_open);
+   printf("   close(): %10" PRIu64 "\n", c_close);
+   printf("   dup():   %10" PRIu64 "\n", c_dup);
+   printf("   fork():  %10" PRIu64 "\n", c_fork);
+   printf("\n");
    return 0;
 }
@@ -0,0 +1,333 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/futex.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+long
+futex(u32 *uaddr, int op, u32 val,
+      const struct timespec *ts, u32 *uaddr2, u32 val3)
+{
+#ifdef SYS_futex_time64
+   return syscall(SYS_futex_time64, uaddr, op, val, ts, uaddr2, val3);
+#else
+   return syscall(SYS_futex, uaddr, op, val, ts, uaddr2, val3);
+#endif
+}
+
+static u64 get_monotonic_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (u64)ts.tv_sec * 1000 + (u64)ts.tv_nsec / 1000000;
+}
+
+/*
+ * The classic 3-state futex mutex: 0 = unlocked, 1 = locked, 2 = locked with
+ * (maybe) waiters. The kernel is entered only when there's contention.
+ */
+
+static void fmutex_lock(u32 *m)
+{
+   u32 c = __sync_val_compare_and_swap(m, 0, 1);
+
+   if (!c)
+      return; /* fast path: no syscall */
+
+   if (c != 2)
+      c = __atomic_exchange_n(m, 2, __ATOMIC_ACQUIRE);
+
+   while (c) {
+      futex(m, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+      c = __atomic_exchange_n(m, 2, __ATOMIC_ACQUIRE);
+   }
+}
+
+static void fmutex_unlock(u32 *m)
+{
+   if (__atomic_fetch_sub(m, 1, __ATOMIC_RELEASE) != 1) {
+      __atomic_store_n(m, 0, __ATOMIC_RELEASE);
+      futex(m, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+   }
+}
+
+int cmd_futex1(int argc, char **argv)
+{
+   static u32 words[2];
+   struct timespec ts;
+   u64 start, elapsed;
+   int rc;
+
+   /* The value does not match: no sleep */
+   words[0] = 1;
+   rc = futex(&words[0], FUTEX_WAIT, 0, NULL, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+
+   /* Nobody is waiting */
+   rc = futex(&words[0], FUTEX_WAKE, 1, NULL, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Relative timeout */
+   ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 100 * 1000 * 1000 };
+   start = get_monotonic_ms();
+   rc = futex(&words[0], FUTEX_WAIT_PRIVATE, 1, &ts, NULL, 0);
+   elapsed = get_monotonic_ms() - start;
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ETIMEDOUT);
+   DEVSHELL_CMD_ASSERT(elapsed >= 90);
+
+   /* FUTEX_WAIT_BITSET uses an absolute timeout */
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ts.tv_nsec += 50 * 1000 * 1000;
+
+   if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000 * 1000 * 1000;
+   }
+
+   rc = futex(&words[0], FUTEX_WAIT_BITSET, 1, &ts, NULL, 0x3);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ETIMEDOUT);
+
+   /* ... which is already expired now */
+   rc = futex(&words[0], FUTEX_WAIT_BITSET, 1, &ts, NULL, 0x3);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ETIMEDOUT);
+
+   /* Error cases */
+   rc = futex(&words[0], FUTEX_WAIT_BITSET, 1, NULL, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = futex((u32 *)((char *)&words[0] + 1), FUTEX_WAKE, 1, NULL, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 1000 * 1000 * 1000 };
+   rc = futex(&words[0], FUTEX_WAIT, 1, &ts, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = futex(&words[0], FUTEX_CMP_REQUEUE, 1, (void *)1, &words[1], 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   rc = futex(&words[0], FUTEX_CMP_REQUEUE, 1, (void *)1, &words[1], 1);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+#define FUTEX_PERF_ITERS           100000
+
+/*
+ * The uncontended lock/unlock of a futex-based mutex must never enter the
+ * kernel: compare its cost with the cost of the cheapest syscall.
+ */
+int cmd_futex_perf(int argc, char **argv)
+{
+   static u32 m;
+   u64 start, c_lock, c_syscall;
+
+   start = RDTSC();
+
+   for (int i = 0; i < FUTEX_PERF_ITERS; i++) {
+      fmutex_lock(&m);
+      fmutex_unlock(&m);
+   }
+
+   c_lock = (RDTSC() - start) / FUTEX_PERF_ITERS;
+   DEVSHELL_CMD_ASSERT(m == 0);
+
+   start = RDTSC();
+
+   for (int i = 0; i < FUTEX_PERF_ITERS; i++)
+      syscall(SYS_getuid);
+
+   c_syscall = (RDTSC() - start) / FUTEX_PERF_ITERS;
+
+   printf("Avg. cost in cycles:\n\n");
+   printf("   uncontended lock + unlock: %10" PRIu64 "\n", c_lock);
+   printf("   getuid() syscall:          %10" PRIu64 "\n", c_syscall);
+   printf("\n");
+
+   if (running_on_tilck())
+      DEVSHELL_CMD_ASSERT(c_lock < c_syscall);
+
+   return 0;
+}
+
+#define CONT_THREADS               4
+#define CONT_ITERS                 20000
+#define CONT_INCS                  64
+#define CONT_HOLD_MS               300
+
+static u32 cont_mutex;
+static volatile u64 cont_counter;
+
+static u64 get_thread_cpu_ms(void)
+{
+   struct rusage ru;
+   int rc = getrusage(RUSAGE_THREAD, &ru);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   return (u64)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000 +
+          (u64)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+}
+
+static void *futex_cont_thread(void *arg)
+{
+   for (int i = 0; i < CONT_ITERS; i++) {
+
+      fmutex_lock(&cont_mutex);
+
+      /* Long enough to get preempted, sometimes, while holding the lock */
+      for (int j = 0; j < CONT_INCS; j++)
+         cont_counter++;
+
+      fmutex_unlock(&cont_mutex);
+   }
+
+   return NULL;
+}
+
+static void *futex_waiter_thread(void *arg)
+{
+   u64 *cpu_ms = arg;
+   u64 start = get_thread_cpu_ms();
+
+   fmutex_lock(&cont_mutex);
+   fmutex_unlock(&cont_mutex);
+
+   *cpu_ms = get_thread_cpu_ms() - start;
+   return NULL;
+}
+
+/*
+ * Measure the throughput of the futex mutex with several threads contending
+ * for it and check that the threads waiting for it sleep in the kernel,
+ * instead of burning CPU.
+ */
+int cmd_futex_cont(int argc, char **argv)
+{
+   pthread_t th[CONT_THREADS];
+   u64 cpu_ms[CONT_THREADS];
+   u64 start, elapsed;
+   int rc;
+
+   cont_mutex = 0;
+   cont_counter = 0;
+   start = get_monotonic_ms();
+
+   for (int i = 0; i < CONT_THREADS; i++) {
+      rc = pthread_create(&th[i], NULL, &futex_cont_thread, NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   for (int i = 0; i < CONT_THREADS; i++) {
+      rc = pthread_join(th[i], NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   elapsed = MAX(get_monotonic_ms() - start, (u64)1);
+   DEVSHELL_CMD_ASSERT(cont_mutex == 0);
+   DEVSHELL_CMD_ASSERT(cont_counter == (u64)CONT_THREADS*CONT_ITERS*CONT_INCS);
+
+   printf("Contended lock + unlock, %d threads:\n\n", CONT_THREADS);
+   printf("   throughput: %10" PRIu64 " ops/sec\n",
+          (u64)CONT_THREADS * CONT_ITERS * 1000 / elapsed);
+   printf("\n");
+
+   /* Now, hold the lock for a while: the waiters have to sleep */
+   fmutex_lock(&cont_mutex);
+
+   for (int i = 0; i < CONT_THREADS; i++) {
+      rc = pthread_create(&th[i], NULL, &futex_waiter_thread, &cpu_ms[i]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   usleep(CONT_HOLD_MS * 1000);
+   fmutex_unlock(&cont_mutex);
+
+   for (int i = 0; i < CONT_THREADS; i++) {
+      rc = pthread_join(th[i], NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   printf("CPU time of the waiters, lock held for %d ms:\n\n", CONT_HOLD_MS);
+
+   for (int i = 0; i < CONT_THREADS; i++)
+      printf("   waiter %d: %4" PRIu64 " ms\n", i, cpu_ms[i]);
+
+   printf("\n");
+
+   for (int i = 0; i < CONT_THREADS; i++)
+      DEVSHELL_CMD_ASSERT(cpu_ms[i] < CONT_HOLD_MS / 10);
+
+   return 0;
+}
+
+#define CV_ROUNDS                  5000
+
+static pthread_mutex_t cv_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+static int cv_turn;
+
+static void *cv_pong_thread(void *arg)
+{
+   pthread_mutex_lock(&cv_lock);
+
+   for (int i = 0; i < CV_ROUNDS; i++) {
+
+      while (cv_turn != 1)
+         pthread_cond_wait(&cv, &cv_lock);
+
+      cv_turn = 0;
+      pthread_cond_signal(&cv);
+   }
+
+   pthread_mutex_unlock(&cv_lock);
+   return NULL;
+}
+
+/*
+ * Ping-pong between two threads with a condition variable: every round-trip
+ * costs two futex wake-ups and two context switches.
+ */
+int cmd_futex_cv(int argc, char **argv)
+{
+   u64 start, start_ms, cycles, elapsed;
+   pthread_t th;
+   int rc;
+
+   cv_turn = 0;
+   rc = pthread_create(&th, NULL, &cv_pong_thread, NULL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   start_ms = get_monotonic_ms();
+   start = RDTSC();
+   pthread_mutex_lock(&cv_lock);
+
+   for (int i = 0; i < CV_ROUNDS; i++) {
+
+      cv_turn = 1;
+      pthread_cond_signal(&cv);
+
+      while (cv_turn != 0)
+         pthread_cond_wait(&cv, &cv_lock);
+   }
+
+   pthread_mutex_unlock(&cv_lock);
+   cycles = (RDTSC() - start) / CV_ROUNDS;
+   elapsed = MAX(get_monotonic_ms() - start_ms, (u64)1);
+
+   rc = pthread_join(th, NULL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("Condvar ping-pong between two threads:\n\n");
+   printf("   round-trip: %10" PRIu64 " cycles\n", cycles);
+   printf("   throughput: %10" PRIu64 " round-trips/sec\n",
+          (u64)CV_ROUNDS * 1000 / elapsed);
+   printf("\n");
+   return 0;
+}
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <time.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
@@ -28,6 +29,45 @@ void not_on_tilck_message(void)
    fprintf(stderr, "[SKIP]: Test designed to run exclusively on Tilck\n");
 }
 
+/*
+ * Run `child_func(arg)` in a child process, after printing `label` there, and
+ * return its exit code. The child is expected to exit with 2 when it cannot
+ * get the resources it needs, while it might be killed with SIGKILL when
+ * running out of memory: in both the cases, print `label` followed by "[SKIP]"
+ * and `skip_reason`, and return 0.
+ */
+int run_in_child_or_skip(const char *label,
+                         const char *skip_reason,
+                         int (*child_func)(void *),
+                         void *arg)
+{
+   int rc, pid, wstatus;
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+      printf("%s ", label);
+      fflush(stdout);
+      exit(child_func(arg));
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+
+   if (WIFSIGNALED(wstatus) && WTERMSIG(wstatus) != SIGKILL) {
+      print_waitpid_change(pid, wstatus);
+      return 1;
+   }
+
+   if (WIFSIGNALED(wstatus) || WEXITSTATUS(wstatus) == 2) {
+      printf("%s [SKIP] %s\n", label, skip_reason);
+      return 0;
+   }
+
+   return WEXITSTATUS(wstatus);
+}
+
 
 int cmd_loop(int argc, char **argv)
 {
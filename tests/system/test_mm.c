@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#define _GNU_SOURCE /* for mremap() */
+
 #include <tilck_gen_headers/config_mm.h>
 
 #include <stdio.h>
@@ -9,11 +11,13 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -52,6 +56,69 @@ int cmd_brk(int argc, char **argv)
    return 0;
 }
 
+static long get_rss_kb(void)
+{
+   struct rusage buf;
+   int rc = getrusage(RUSAGE_SELF, &buf);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return buf.ru_maxrss;
+}
+
+/*
+ * Grow the heap with brk() by a large amount, touching just a small part of
+ * it: the RSS must grow only by the touched part (unless MMAP_NO_COW=1).
+ */
+int cmd_brk_perf(int argc, char **argv)
+{
+   static const size_t jumps[] = { 4 * MB, 32 * MB, 128 * MB };
+   const size_t touched = 4 * MB;
+   const bool on_tilck = !!getenv("TILCK");
+
+   void *orig_brk = (void *)syscall(SYS_brk, 0);
+   long rss0, rss1, rss2;
+   ull_t start, duration;
+   char *b;
+
+   for (int i = 0; i < ARRAY_SIZE(jumps); i++) {
+
+      rss0 = get_rss_kb();
+
+      start = RDTSC();
+      b = (void *)syscall(SYS_brk, orig_brk + jumps[i]);
+      duration = RDTSC() - start;
+
+      if (b != orig_brk + jumps[i]) {
+         printf("brk(+%zu MB) failed: skip\n", jumps[i] / MB);
+         syscall(SYS_brk, orig_brk);
+         continue;
+      }
+
+      rss1 = get_rss_kb();
+
+      for (size_t off = 0; off < touched; off += 4096) {
+         DEVSHELL_CMD_ASSERT(((char *)orig_brk)[off] == 0);
+         ((char *)orig_brk)[off] = 1;
+      }
+
+      rss2 = get_rss_kb();
+
+      printf("brk(+%3zu MB): %8llu K cycles, RSS: %6ld KB -> "
+             "%6ld KB (after brk) -> %6ld KB (after touching %zu MB)\n",
+             jumps[i] / MB, duration / 1000,
+             rss0, rss1, rss2, touched / MB);
+
+      if (on_tilck && !MMAP_NO_COW) {
+         DEVSHELL_CMD_ASSERT(rss1 - rss0 < (long)(touched / KB));
+         DEVSHELL_CMD_ASSERT(rss2 - rss1 >= (long)(touched / KB));
+      }
+
+      b = (void *)syscall(SYS_brk, orig_brk);
+      DEVSHELL_CMD_ASSERT(b == orig_brk);
+   }
+
+   return 0;
+}
+
 int cmd_mmap(int argc, char **argv)
 {
    const int iters_count = 10;
@@ -159,6 +226,627 @@ int cmd_mmap2(int argc, char **argv)
    return 0;
 }
 
+/* Check that each page in [begin, end) of `buf` starts with its own index */
+static bool check_pages(char *buf, size_t begin, size_t end)
+{
+   const size_t page_size = getpagesize();
+
+   for (size_t off = begin; off < end; off += page_size) {
+      if (buf[off] != (char)(off / page_size))
+         return false;
+   }
+
+   return true;
+}
+
+/*
+ * Unmap, both in the parent and in the child, a 4 MB aligned part of an
+ * anonymous mapping right after fork(), while its page table is still shared.
+ */
+int cmd_mmap_fork(int argc, char **argv)
+{
+   const size_t len = 12 * MB;
+   const size_t page_size = getpagesize();
+   size_t hole, hole_end;
+   int pid, wstatus, rc;
+   char *buf;
+
+   buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   if (buf == (void *)-1) {
+      printf("[SKIP] mmap() failed: %s\n", strerror(errno));
+      return 0;
+   }
+
+   /* The 4 MB aligned part to unmap: `len` is big enough to contain one */
+   hole = (((ulong)buf + 4 * MB - 1) & ~(4 * MB - 1)) - (ulong)buf;
+   hole_end = hole + 4 * MB;
+
+   for (size_t off = 0; off < len; off += page_size)
+      buf[off] = (char)(off / page_size);
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      if (munmap(buf + hole, 4 * MB))
+         exit(1);
+
+      if (!check_pages(buf, 0, hole) || !check_pages(buf, hole_end, len))
+         exit(2);
+
+      exit(0);
+   }
+
+   rc = munmap(buf + hole, 4 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(buf, 0, hole));
+   DEVSHELL_CMD_ASSERT(check_pages(buf, hole_end, len));
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   if (hole) {
+      rc = munmap(buf, hole);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   rc = munmap(buf + hole_end, len - hole_end);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+/*
+ * Check that MAP_HUGETLB mappings behave exactly like the regular ones, even
+ * when the kernel has to split their big pages: fork() (copy-on-write) and
+ * partial munmap(). Finally, unmap a whole big page.
+ */
+int cmd_mmap_huge(int argc, char **argv)
+{
+   const size_t len = 8 * MB;
+   const size_t page_size = getpagesize();
+   int pid, wstatus, rc;
+   size_t hole;
+   char *buf;
+
+   buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+
+   if (buf == (void *)-1) {
+      printf("[SKIP] mmap(MAP_HUGETLB) failed: %s\n", strerror(errno));
+      return 0;
+   }
+
+   for (size_t off = 0; off < len; off += page_size) {
+      DEVSHELL_CMD_ASSERT(buf[off] == 0);
+      buf[off] = (char)(off / page_size);
+   }
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      for (size_t off = 0; off < len; off += page_size) {
+
+         if (buf[off] != (char)(off / page_size))
+            exit(1);
+
+         buf[off] = 'c';
+      }
+
+      exit(0);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   /* The writes of the child must not be visible here */
+   for (size_t off = 0; off < len; off += page_size)
+      DEVSHELL_CMD_ASSERT(buf[off] == (char)(off / page_size));
+
+   /* Unmap a single page in the middle of the mapping */
+   rc = munmap(buf + len / 2, page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   buf[len / 2 - page_size] = 'a';
+   buf[len / 2 + page_size] = 'b';
+
+   rc = munmap(buf, len / 2);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = munmap(buf + len / 2 + page_size, len / 2 - page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Now unmap a whole big page, without splitting it first */
+   buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+   DEVSHELL_CMD_ASSERT(buf != (void *)-1);
+
+   hole = (((ulong)buf + 4 * MB - 1) & ~(4 * MB - 1)) - (ulong)buf;
+
+   for (size_t off = 0; off < len; off += page_size)
+      buf[off] = (char)(off / page_size);
+
+   rc = munmap(buf + hole, 4 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(buf, 0, hole));
+   DEVSHELL_CMD_ASSERT(check_pages(buf, hole + 4 * MB, len));
+
+   if (hole) {
+      rc = munmap(buf, hole);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   rc = munmap(buf + hole + 4 * MB, len - hole - 4 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+#define TLB_PERF_LEN                   (256 * MB)
+#define TLB_PERF_ACCESSES          (4 * 1000 * 1000)
+#define TLB_PERF_FILE             "/tmp/tlb_perf_file"
+
+struct tlb_perf_args {
+   int flags;
+   int fd;
+};
+
+static int tlb_perf_child(void *arg)
+{
+   const struct tlb_perf_args *a = arg;
+   const size_t page_size = getpagesize();
+   volatile char *buf;
+   ull_t start, duration;
+   unsigned seed = 1234;
+
+   buf = mmap(NULL, TLB_PERF_LEN, PROT_READ | PROT_WRITE, a->flags, a->fd, 0);
+
+   if (buf == (void *)-1)
+      return 2;
+
+   for (size_t off = 0; off < TLB_PERF_LEN; off += page_size)
+      buf[off] = 1;
+
+   start = RDTSC();
+
+   for (int i = 0; i < TLB_PERF_ACCESSES; i++) {
+      seed = seed * 1664525 + 1013904223;     /* LCG */
+      (void)buf[(seed >> 4) & (TLB_PERF_LEN - 1)];
+   }
+
+   duration = RDTSC() - start;
+   printf("%3llu cycles/access\n", duration / TLB_PERF_ACCESSES);
+   return 0;
+}
+
+static int tlb_perf_run(const char *name, int flags, int fd)
+{
+   struct tlb_perf_args args = { flags, fd };
+   char label[32];
+
+   snprintf(label, sizeof(label), "[%-18s]", name);
+
+   return run_in_child_or_skip(label,
+                               "not enough memory or no big pages",
+                               &tlb_perf_child,
+                               &args);
+}
+
+/* Fill a ramfs file with 4 MB writes: that allows ramfs to use big extents */
+static int tlb_perf_create_file(void)
+{
+   const size_t chunk = 4 * MB;
+   char *zeros;
+   int fd, rc;
+
+   zeros = mmap(NULL, chunk, PROT_READ | PROT_WRITE,
+                MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   if (zeros == (void *)-1)
+      return -1;
+
+   fd = open(TLB_PERF_FILE, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   for (size_t off = 0; off < TLB_PERF_LEN; off += chunk) {
+
+      if ((rc = write(fd, zeros, chunk)) != (int)chunk) {
+         close(fd);
+         unlink(TLB_PERF_FILE);
+         fd = -1;
+         break;
+      }
+   }
+
+   munmap(zeros, chunk);
+   return fd;
+}
+
+/*
+ * TLB-pressure benchmark: random reads over a 256 MB buffer, mapped with
+ * regular pages or with big pages (MAP_HUGETLB). Each case runs in its own
+ * child process: running out of memory there just skips the case.
+ */
+int cmd_tlb_perf(int argc, char **argv)
+{
+   const int anon = MAP_ANONYMOUS | MAP_PRIVATE;
+   int rc, fd;
+
+   if ((rc = tlb_perf_run("anon, 4 KB pages", anon, -1)))
+      return rc;
+
+   if ((rc = tlb_perf_run("anon, MAP_HUGETLB", anon | MAP_HUGETLB, -1)))
+      return rc;
+
+   if ((fd = tlb_perf_create_file()) < 0) {
+      printf("[%-18s] [SKIP] not enough memory\n", "ramfs, MAP_HUGETLB");
+      return 0;
+   }
+
+   rc = tlb_perf_run("ramfs, MAP_HUGETLB", MAP_SHARED | MAP_HUGETLB, fd);
+   close(fd);
+   unlink(TLB_PERF_FILE);
+   return rc;
+}
+
+static void mremap_fill(char *buf, size_t off, size_t end)
+{
+   for (; off < end; off += 4096)
+      buf[off] = (char)(off / 4096 + 1);
+}
+
+static void mremap_check(char *buf, size_t off, size_t end)
+{
+   for (; off < end; off += 4096)
+      DEVSHELL_CMD_ASSERT(buf[off] == (char)(off / 4096 + 1));
+}
+
+int cmd_mremap(int argc, char **argv)
+{
+   const size_t pg = getpagesize();
+   char *a, *b, *p;
+   int rc;
+
+   a = mmap(NULL, 2 * pg, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(a != (void *)-1);
+
+   b = mmap(NULL, 2 * pg, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(b != (void *)-1);
+
+   mremap_fill(a, 0, 2 * pg);
+
+   if (b == a + 2 * pg) {
+
+      /* `a` cannot grow in place */
+      p = mremap(a, 2 * pg, 4 * pg, 0);
+      DEVSHELL_CMD_ASSERT(p == (void *)-1 && errno == ENOMEM);
+   }
+
+   /* Grow `a`, in place or not */
+   p = mremap(a, 2 * pg, 4 * pg, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(p != (void *)-1);
+
+   mremap_check(p, 0, 2 * pg);
+   DEVSHELL_CMD_ASSERT(p[2 * pg] == 0 && p[3 * pg] == 0);
+   mremap_fill(p, 2 * pg, 4 * pg);
+   a = p;
+
+   /* `b` has still its content */
+   b[0] = 'b';
+   DEVSHELL_CMD_ASSERT(b[0] == 'b');
+
+   rc = munmap(b, 2 * pg);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Now, the range after `a` might be free: try again, then shrink */
+   p = mremap(a, 4 * pg, 16 * pg, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(p != (void *)-1);
+   mremap_check(p, 0, 4 * pg);
+   mremap_fill(p, 4 * pg, 16 * pg);
+   a = p;
+
+   p = mremap(a, 16 * pg, 3 * pg, 0);
+   DEVSHELL_CMD_ASSERT(p == a);
+   mremap_check(a, 0, 3 * pg);
+
+   /* Invalid parameters */
+   p = mremap(a + 1, pg, 2 * pg, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(p == (void *)-1 && errno == EINVAL);
+
+   p = mremap(a, 3 * pg, 0, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(p == (void *)-1 && errno == EINVAL);
+
+   rc = munmap(a, 3 * pg);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+#define MREMAP_PERF_MAX                (256 * MB)
+
+/*
+ * Grow a buffer by doubling its size up to MREMAP_PERF_MAX, like realloc()
+ * does for a growing buffer, writing each new page. Use mremap() or, when
+ * `use_mremap` is false, mmap() + memcpy() + munmap().
+ */
+static int mremap_perf_child(void *arg)
+{
+   const bool use_mremap = *(bool *)arg;
+   const size_t pg = getpagesize();
+   ull_t start, duration;
+   char *buf, *p;
+   size_t len = pg;
+
+   buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   if (buf == (void *)-1)
+      return 2;
+
+   mremap_fill(buf, 0, len);
+   start = RDTSC();
+
+   for (; len < MREMAP_PERF_MAX; len *= 2) {
+
+      if (use_mremap) {
+
+         p = mremap(buf, len, 2 * len, MREMAP_MAYMOVE);
+
+      } else {
+
+         p = mmap(NULL, 2 * len, PROT_READ | PROT_WRITE,
+                  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+         if (p != (void *)-1) {
+            memcpy(p, buf, len);
+            munmap(buf, len);
+         }
+      }
+
+      if (p == (void *)-1)
+         return 2;
+
+      buf = p;
+      mremap_fill(buf, len, 2 * len);
+   }
+
+   duration = RDTSC() - start;
+   mremap_check(buf, 0, len);
+
+   printf("%6llu M cycles\n", duration / 1000000);
+   munmap(buf, len);
+   return 0;
+}
+
+static int mremap_perf_run(const char *name, bool use_mremap)
+{
+   char label[32];
+
+   snprintf(label, sizeof(label), "[%-22s]", name);
+
+   return run_in_child_or_skip(label,
+                               "not enough memory",
+                               &mremap_perf_child,
+                               &use_mremap);
+}
+
+/* Benchmark a realloc()-like doubling loop up to MREMAP_PERF_MAX */
+int cmd_mremap_perf(int argc, char **argv)
+{
+   int rc;
+
+   if ((rc = mremap_perf_run("mmap + memcpy + munmap", false)))
+      return rc;
+
+   return mremap_perf_run("mremap", true);
+}
+
+#define MADVISE_LEN                     (4 * MB)
+#define MADVISE_FILE               "/tmp/madvise_file"
+
+static void madvise_fill(volatile char *buf, size_t len, char val)
+{
+   for (size_t off = 0; off < len; off += 4096)
+      buf[off] = val;
+}
+
+static void madvise_check_fill(volatile char *buf, size_t len, char val)
+{
+   for (size_t off = 0; off < len; off += 4096)
+      DEVSHELL_CMD_ASSERT(buf[off] == val);
+}
+
+/*
+ * MADV_DONTNEED must give back the memory of the anonymous mappings (reading
+ * zeros afterwards) and drop the private copies of the file mappings (reading
+ * the file's content afterwards).
+ */
+int cmd_madvise(int argc, char **argv)
+{
+   const bool on_tilck = !!getenv("TILCK");
+   const size_t page_size = getpagesize();
+   long rss0, rss1;
+   char *buf;
+   int fd, rc;
+
+   buf = mmap(NULL, MADVISE_LEN, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(buf != (void *)-1);
+
+   madvise_fill(buf, MADVISE_LEN, 'a');
+   rss0 = get_rss_kb();
+
+   rc = madvise(buf, MADVISE_LEN, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rss1 = get_rss_kb();
+   printf("anon: RSS %ld KB -> %ld KB after MADV_DONTNEED\n", rss0, rss1);
+
+   if (on_tilck && !MMAP_NO_COW)
+      DEVSHELL_CMD_ASSERT(rss0 - rss1 >= (long)(MADVISE_LEN / KB));
+
+   madvise_check_fill(buf, MADVISE_LEN, 0);
+
+   /* The memory must be still usable */
+   madvise_fill(buf, MADVISE_LEN, 'b');
+   madvise_check_fill(buf, MADVISE_LEN, 'b');
+
+   rc = madvise(buf + 1, page_size, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   rc = munmap(buf, MADVISE_LEN);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Anonymous mapping with big pages: they get split by MADV_DONTNEED */
+   buf = mmap(NULL, 2 * MADVISE_LEN, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+
+   if (buf != (void *)-1) {
+
+      madvise_fill(buf, 2 * MADVISE_LEN, 'h');
+
+      rc = madvise(buf + MADVISE_LEN, page_size, MADV_DONTNEED);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      DEVSHELL_CMD_ASSERT(buf[MADVISE_LEN] == 0);
+      DEVSHELL_CMD_ASSERT(buf[MADVISE_LEN + page_size] == 'h');
+
+      rc = madvise(buf, 2 * MADVISE_LEN, MADV_DONTNEED);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      madvise_check_fill(buf, 2 * MADVISE_LEN, 0);
+
+      madvise_fill(buf, 2 * MADVISE_LEN, 'i');
+      madvise_check_fill(buf, 2 * MADVISE_LEN, 'i');
+
+      rc = munmap(buf, 2 * MADVISE_LEN);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   /* Private file mapping */
+   fd = open(MADVISE_FILE, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   buf = malloc(4 * page_size);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+   memset(buf, 'f', 4 * page_size);
+
+   rc = write(fd, buf, 4 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == (int)(4 * page_size));
+   free(buf);
+
+   buf = mmap(NULL, 4 * page_size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE, fd, 0);
+   DEVSHELL_CMD_ASSERT(buf != (void *)-1);
+
+   madvise_fill(buf, 4 * page_size, 'p');
+
+   /* Drop the copies of the pages 1 and 2 only */
+   rc = madvise(buf + page_size, 2 * page_size, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   DEVSHELL_CMD_ASSERT(buf[0 * page_size] == 'p');
+   DEVSHELL_CMD_ASSERT(buf[1 * page_size] == 'f');
+   DEVSHELL_CMD_ASSERT(buf[2 * page_size] == 'f');
+   DEVSHELL_CMD_ASSERT(buf[3 * page_size] == 'p');
+
+   /* Writing again must make a new private copy */
+   buf[page_size] = 'q';
+   DEVSHELL_CMD_ASSERT(buf[page_size] == 'q');
+
+   rc = munmap(buf, 4 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   close(fd);
+   rc = unlink(MADVISE_FILE);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+/*
+ * Sequential read, through a new shared mapping with the given advice, of the
+ * madvise file, whose blocks are all allocated by write() *after* mmap().
+ * Returns the count of ramfs faults during the read.
+ */
+static long madvise_fault_read(int fd, char *buf, int advice)
+{
+   volatile char *vaddr;
+   long faults0;
+   int rc;
+
+   rc = ftruncate(fd, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = ftruncate(fd, MADVISE_LEN);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   vaddr = mmap(NULL, MADVISE_LEN, PROT_READ, MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+
+   rc = pwrite(fd, buf, MADVISE_LEN, 0);
+   DEVSHELL_CMD_ASSERT(rc == MADVISE_LEN);
+
+   rc = madvise((void *)vaddr, MADVISE_LEN, advice);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   faults0 = ramfs_sysfs_read("faults");
+   madvise_check_fill(vaddr, MADVISE_LEN, 'r');
+
+   rc = munmap((void *)vaddr, MADVISE_LEN);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return ramfs_sysfs_read("faults") - faults0;
+}
+
+/*
+ * Check the count of ramfs faults while reading a file with each advice:
+ * MADV_WILLNEED must prefault all the pages, MADV_SEQUENTIAL must map them in
+ * windows larger than the default one and MADV_RANDOM must map them one by
+ * one.
+ */
+int cmd_madvise2(int argc, char **argv)
+{
+   const long pages = MADVISE_LEN / getpagesize();
+   long f_normal, f_seq, f_rand, f_will;
+   char *buf;
+   int fd, rc;
+
+   if (ramfs_sysfs_read("faults") < 0) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   buf = malloc(MADVISE_LEN);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+   memset(buf, 'r', MADVISE_LEN);
+
+   fd = open(MADVISE_FILE, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   f_normal = madvise_fault_read(fd, buf, MADV_NORMAL);
+   f_seq = madvise_fault_read(fd, buf, MADV_SEQUENTIAL);
+   f_rand = madvise_fault_read(fd, buf, MADV_RANDOM);
+   f_will = madvise_fault_read(fd, buf, MADV_WILLNEED);
+
+   printf("Faults for %ld pages: normal: %ld, sequential: %ld, "
+          "random: %ld, willneed: %ld\n",
+          pages, f_normal, f_seq, f_rand, f_will);
+
+   DEVSHELL_CMD_ASSERT(f_rand == pages);
+   DEVSHELL_CMD_ASSERT(f_seq <= f_normal);
+   DEVSHELL_CMD_ASSERT(f_seq <= pages / 256); /* RAMFS_FAULT_AROUND_MAX */
+   DEVSHELL_CMD_ASSERT(f_will == 0);
+
+   close(fd);
+   free(buf);
+   rc = unlink(MADVISE_FILE);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
 static size_t fork_oom_alloc_size;
 
 static void fork_oom_child(void *buf)
@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static int shared_counter;
+static __thread int tls_var = 42;
+
+static void *thread_basic_func(void *arg)
+{
+   int *tid = arg;
+
+   *tid = (int)syscall(SYS_gettid);
+
+   /* Each thread has its own copy of the TLS vars */
+   if (tls_var != 42)
+      return (void *)1;
+
+   tls_var = *tid;
+   __atomic_fetch_add(&shared_counter, 1, __ATOMIC_SEQ_CST);
+   return (void *)(long)tls_var;
+}
+
+int cmd_thread1(int argc, char **argv)
+{
+   const int pid = getpid();
+   pthread_t th[4];
+   int tids[4];
+   void *ret;
+   int rc;
+
+   shared_counter = 0;
+
+   for (int i = 0; i < 4; i++) {
+      rc = pthread_create(&th[i], NULL, &thread_basic_func, &tids[i]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   for (int i = 0; i < 4; i++) {
+
+      rc = pthread_join(th[i], &ret);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      /* Every thread has its own TID but they all share our PID */
+      DEVSHELL_CMD_ASSERT(tids[i] != pid);
+      DEVSHELL_CMD_ASSERT((long)ret == tids[i]);
+   }
+
+   DEVSHELL_CMD_ASSERT(shared_counter == 4);
+   DEVSHELL_CMD_ASSERT(tls_var == 42);
+   DEVSHELL_CMD_ASSERT(syscall(SYS_gettid) == pid);
+   return 0;
+}
+
+static void *thread_sleep_forever(void *arg)
+{
+   u32 *word = arg;
+
+   while (true)
+      futex(word, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+
+   return NULL;
+}
+
+static void *thread_exit_group(void *arg)
+{
+   usleep(50 * 1000);
+   exit(23);
+}
+
+/*
+ * exit() from any thread has to terminate the whole process, including the
+ * threads sleeping on a futex.
+ */
+int cmd_thread2(int argc, char **argv)
+{
+   static u32 word;
+   int rc, wstatus;
+   pthread_t th;
+   pid_t pid;
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      if (pthread_create(&th, NULL, &thread_sleep_forever, &word))
+         exit(1);
+
+      if (pthread_create(&th, NULL, &thread_exit_group, NULL))
+         exit(1);
+
+      thread_sleep_forever(&word);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 23);
+   return 0;
+}
+
+#define THREAD_PERF_ITERS          500
+
+static void *thread_nop(void *arg)
+{
+   return arg;
+}
+
+/*
+ * Measure the cost of a pthread_create() + pthread_join() round-trip and
+ * compare it with the cost of doing the same with fork() + waitpid().
+ */
+int cmd_thread_perf(int argc, char **argv)
+{
+   u64 start, c_thread, c_fork;
+   int rc, wstatus;
+   pthread_t th;
+   pid_t pid;
+
+   start = RDTSC();
+
+   for (int i = 0; i < THREAD_PERF_ITERS; i++) {
+      rc = pthread_create(&th, NULL, &thread_nop, NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      rc = pthread_join(th, NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   c_thread = (RDTSC() - start) / THREAD_PERF_ITERS;
+   start = RDTSC();
+
+   for (int i = 0; i < THREAD_PERF_ITERS; i++) {
+
+      pid = fork();
+      DEVSHELL_CMD_ASSERT(pid >= 0);
+
+      if (!pid)
+         exit(0);
+
+      rc = waitpid(pid, &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pid);
+   }
+
+   c_fork = (RDTSC() - start) / THREAD_PERF_ITERS;
+
+   printf("Avg. create + join cost in cycles:\n\n");
+   printf("   pthread_create() + pthread_join(): %10" PRIu64 "\n", c_thread);
+   printf("   fork() + waitpid():                %10" PRIu64 "\n", c_fork);
+   printf("\n");
+
+   if (running_on_tilck())
+      DEVSHELL_CMD_ASSERT(c_thread < c_fork);
+
+   return 0;
+}
+
+#define MEMCPY_BUF_SIZE            (4 * MB)
+#define MEMCPY_THREADS             4
+#define MEMCPY_ITERS               8
+
+struct memcpy_slice {
+
+   char *dst;
+   const char *src;
+   size_t len;
+};
+
+static void *thread_memcpy(void *arg)
+{
+   struct memcpy_slice *s = arg;
+
+   for (int i = 0; i < MEMCPY_ITERS; i++)
+      memcpy(s->dst, s->src, s->len);
+
+   return NULL;
+}
+
+static u64 parallel_memcpy(char *dst, const char *src, int nthreads)
+{
+   struct memcpy_slice slices[MEMCPY_THREADS];
+   pthread_t th[MEMCPY_THREADS];
+   const size_t len = MEMCPY_BUF_SIZE / nthreads;
+   u64 start;
+   int rc;
+
+   start = RDTSC();
+
+   for (int i = 0; i < nthreads; i++) {
+
+      slices[i] = (struct memcpy_slice) {
+         .dst = dst + i * len,
+         .src = src + i * len,
+         .len = len,
+      };
+
+      rc = pthread_create(&th[i], NULL, &thread_memcpy, &slices[i]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   for (int i = 0; i < nthreads; i++) {
+      rc = pthread_join(th[i], NULL);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   return RDTSC() - start;
+}
+
+/*
+ * Split a large memcpy() among several threads writing to the same buffer.
+ * Tilck runs on a single CPU, so no speed-up is expected: this checks that
+ * the threads really share the address space and measures the overhead.
+ */
+int cmd_thread_cpy(int argc, char **argv)
+{
+   char *src, *dst;
+   u64 c_single, c_multi;
+
+   src = malloc(MEMCPY_BUF_SIZE);
+   dst = malloc(MEMCPY_BUF_SIZE);
+   DEVSHELL_CMD_ASSERT(src != NULL && dst != NULL);
+
+   for (size_t i = 0; i < MEMCPY_BUF_SIZE; i++)
+      src[i] = (char)(i * 7 + 3);
+
+   memset(dst, 0, MEMCPY_BUF_SIZE);
+   c_single = parallel_memcpy(dst, src, 1);
+   DEVSHELL_CMD_ASSERT(!memcmp(dst, src, MEMCPY_BUF_SIZE));
+
+   memset(dst, 0, MEMCPY_BUF_SIZE);
+   c_multi = parallel_memcpy(dst, src, MEMCPY_THREADS);
+   DEVSHELL_CMD_ASSERT(!memcmp(dst, src, MEMCPY_BUF_SIZE));
+
+   printf("memcpy() of %d MB x %d, cycles:\n\n",
+          MEMCPY_BUF_SIZE / MB, MEMCPY_ITERS);
+   printf("   1 thread:  %12" PRIu64 "\n", c_single);
+   printf("   %d threads: %12" PRIu64 "\n", MEMCPY_THREADS, c_multi);
+   printf("\n");
+
+   free(dst);
+   free(src);
+   return 0;
+}
@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/fs/fd_table.h>
+   #include <tilck/kernel/fs/vfs.h>
+}
+
+using namespace std;
+using namespace testing;
+
+class fd_table_test : public Test {
+public:
+
+   struct fd_table t;
+   vector<fs_handle_base> handles;
+
+   void SetUp() override {
+
+      fd_table_init(&t);
+
+      if (MAX_HANDLES < 512)
+         GTEST_SKIP() << "MAX_HANDLES is too small for this test";
+
+      init_kmalloc_for_tests();
+      handles.resize(MAX_HANDLES);
+   }
+
+   void TearDown() override {
+      fd_table_destroy(&t);
+   }
+
+   int open_lowest(int ge = 0) {
+
+      int fd = fd_table_get_free_fd(&t, ge);
+
+      if (fd >= 0)
+         fd_table_install(&t, fd, &handles[fd]);
+
+      return fd;
+   }
+};
+
+TEST_F(fd_table_test, lowest_free_fd)
+{
+   for (int i = 0; i < 100; i++)
+      ASSERT_EQ(open_lowest(), i);
+
+   fd_table_remove(&t, 70);
+   fd_table_remove(&t, 5);
+   fd_table_remove(&t, 33);
+
+   EXPECT_EQ(open_lowest(), 5);
+   EXPECT_EQ(open_lowest(), 33);
+   EXPECT_EQ(open_lowest(), 70);
+   EXPECT_EQ(open_lowest(), 100);
+   EXPECT_EQ(open_lowest(50), 101);
+   EXPECT_EQ(open_lowest(500), 500);
+   EXPECT_EQ(t.open_count, 103u);
+}
+
+TEST_F(fd_table_test, grow_up_to_the_limit)
+{
+   for (int i = 0; i < MAX_HANDLES; i++)
+      ASSERT_EQ(open_lowest(), i);
+
+   EXPECT_EQ(fd_table_get_free_fd(&t, 0), -EMFILE);
+   EXPECT_EQ(fd_table_reserve(&t, MAX_HANDLES), -EBADF);
+
+   fd_table_remove(&t, MAX_HANDLES / 2);
+   EXPECT_EQ(open_lowest(), MAX_HANDLES / 2);
+
+   for (int i = 0; i < MAX_HANDLES; i++)
+      ASSERT_EQ(fd_table_remove(&t, i), &handles[i]);
+
+   EXPECT_EQ(t.open_count, 0u);
+   EXPECT_EQ(fd_table_next_open_fd(&t, 0), -1);
+}
+
+TEST_F(fd_table_test, cloexec_and_copy)
+{
+   struct fd_table t2;
+   vector<int> fds;
+   int fd;
+
+   for (int i = 0; i < 300; i++)
+      ASSERT_EQ(open_lowest(), i);
+
+   fd_table_set_cloexec(&t, 3, true);
+   fd_table_set_cloexec(&t, 64, true);
+   fd_table_set_cloexec(&t, 299, true);
+   EXPECT_TRUE(handles[64].fd_flags & FD_CLOEXEC);
+
+   ASSERT_EQ(fd_table_copy(&t2, &t), 0);
+   EXPECT_EQ(t2.size, t.size);
+   EXPECT_EQ(t2.open_count, 300u);
+   EXPECT_EQ(fd_table_get(&t2, 150), &handles[150]);
+
+   for (fd = fd_table_next_cloexec_fd(&t2, 0);
+        fd >= 0;
+        fd = fd_table_next_cloexec_fd(&t2, fd + 1))
+   {
+      fds.push_back(fd);
+      fd_table_remove(&t2, fd);
+   }
+
+   EXPECT_EQ(fds, vector<int>({3, 64, 299}));
+   EXPECT_EQ(t2.open_count, 297u);
+   EXPECT_EQ(fd_table_get(&t2, 64), nullptr);
+   EXPECT_EQ(fd_table_get(&t, 64), &handles[64]);
+   fd_table_destroy(&t2);
+}
@@ -23,9 +23,10 @@ TEST(fork_dup_all_handles, trigger_inside_path)
    vfs_mock mock;
    process pi = {};
    fs_handle_base handles[3] = {}, dup_handles[2] = {};
-   pi.handles[0] = &handles[0];
-   pi.handles[1] = &handles[1];
-   pi.handles[2] = &handles[2];
+   fd_table_init(&pi.fdt);
+   fd_table_install(&pi.fdt, 0, &handles[0]);
+   fd_table_install(&pi.fdt, 1, &handles[1]);
+   fd_table_install(&pi.fdt, 2, &handles[2]);
 
    EXPECT_CALL(mock, vfs_dup(&handles[0], _))
       .WillOnce(
@@ -47,4 +48,6 @@ TEST(fork_dup_all_handles, trigger_inside_path)
    EXPECT_CALL(mock, vfs_close(&dup_handles[0]));
    EXPECT_CALL(mock, vfs_close(&dup_handles[1]));
    ASSERT_EQ(fork_dup_all_handles(&pi), -ENOMEM);
+   ASSERT_EQ(pi.fdt.open_count, 0u);
+   ASSERT_EQ(fd_table_next_open_fd(&pi.fdt, 0), -1);
 }
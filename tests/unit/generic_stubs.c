@@ -35,9 +35,12 @@ void setup_sysenter_interface() { }
 void pdir_clone() { }
 void pdir_deep_clone() { }
 void pdir_destroy() { }
+void pdir_get_user_rss() { NOT_REACHED(); }
 void set_curr_pdir() { }
 void arch_specific_new_proc_setup() { NOT_REACHED(); }
 void arch_specific_free_proc() { NOT_REACHED(); }
+int arch_specific_set_thread_tls() { NOT_REACHED(); return -1; }
+void arch_specific_free_thread_tls() { NOT_REACHED(); }
 void fpu_context_begin() { }
 void fpu_context_end() { }
 void map_zero_pages() { NOT_REACHED(); }
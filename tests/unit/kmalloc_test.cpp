@@ -21,6 +21,7 @@ extern "C" {
    #include <tilck/common/utils.h>
 
    #include <tilck/kernel/kmalloc.h>
+   #include <tilck/kernel/kmalloc_debug.h>
    #include <tilck/kernel/paging.h>
    #include <tilck/kernel/self_tests.h>
 
@@ -891,3 +892,103 @@ TEST_F(kmalloc_test, partial_free)
 
    kmalloc_destroy_heap(&h);
 }
+
+TEST_F(kmalloc_test, kmalloc_at)
+{
+   void *ptr;
+   size_t s;
+
+   struct kmalloc_heap h;
+   kmalloc_create_heap(&h,
+                       MB,                           /* vaddr */
+                       KMALLOC_MIN_HEAP_SIZE,        /* heap size */
+                       KMALLOC_MIN_HEAP_SIZE / 16,   /* min block size */
+                       KMALLOC_MIN_HEAP_SIZE / 8,    /* alloc block size */
+                       false,                        /* linear mapping */
+                       NULL,                         /* metadata_nodes */
+                       fake_alloc_and_map_func,
+                       fake_free_and_map_func);
+
+   const size_t mbs = h.min_block_size;
+
+   s = 3 * mbs;
+   ptr = per_heap_kmalloc(&h, &s, KMALLOC_FL_MULTI_STEP | mbs);
+
+   EXPECT_EQ(s, 3 * mbs);
+   EXPECT_EQ(ptr, (void *)h.vaddr);
+   EXPECT_EQ(h.mem_allocated, 3 * mbs);
+
+   /* Grow the chunk in place, up to 8 blocks */
+   EXPECT_TRUE(per_heap_kmalloc_at(&h, (char *)ptr + 3 * mbs, 5 * mbs,
+                                   KMALLOC_FL_MULTI_STEP | mbs));
+   EXPECT_EQ(h.mem_allocated, 8 * mbs);
+
+   /* Overlapping ranges must be rejected, without side effects */
+   EXPECT_FALSE(per_heap_kmalloc_at(&h, (char *)ptr + 7 * mbs, 2 * mbs,
+                                    KMALLOC_FL_MULTI_STEP | mbs));
+   EXPECT_EQ(h.mem_allocated, 8 * mbs);
+
+   /* Ranges outside the heap too */
+   EXPECT_FALSE(per_heap_kmalloc_at(&h, (char *)ptr + 12 * mbs, 8 * mbs,
+                                    KMALLOC_FL_MULTI_STEP | mbs));
+   EXPECT_EQ(h.mem_allocated, 8 * mbs);
+
+   /* The whole chunk can be freed at once */
+   s = 8 * mbs;
+   per_heap_kfree(&h, ptr, &s, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+
+   EXPECT_EQ(s, 8 * mbs);
+   EXPECT_EQ(h.mem_allocated, 0u);
+
+   /* Now the whole heap is free */
+   s = h.size;
+   ptr = per_heap_kmalloc(&h, &s, 0);
+
+   EXPECT_EQ(ptr, (void *)h.vaddr);
+   EXPECT_EQ(s, h.size);
+
+   kmalloc_destroy_heap(&h);
+}
+
+TEST_F(kmalloc_test, object_caches)
+{
+   struct debug_kmalloc_stats stats;
+   struct kmalloc_cache_stats *c = &stats.caches[2];   /* 128 bytes */
+   void *ptrs[64];
+   void *a, *b;
+
+   debug_kmalloc_set_caches_enabled(true);
+
+   a = kmalloc(100);
+   ASSERT_TRUE(a != NULL);
+   kfree2(a, 100);
+
+   /* Same size class: we must get the chunk back from the magazine */
+   b = kmalloc(120);
+   EXPECT_EQ(a, b);
+   kfree2(b, 120);
+
+   debug_kmalloc_get_stats(&stats);
+   EXPECT_EQ(c->obj_size, 128u);
+   EXPECT_EQ(c->hits, 1u);
+   EXPECT_EQ(c->misses, 1u);
+   EXPECT_EQ(c->frees_cached, 2u);
+   EXPECT_EQ(c->frees_to_heap, 0u);
+   EXPECT_EQ(c->cached, 1u);
+
+   /* Overflow the magazine */
+   for (u32 i = 0; i < ARRAY_SIZE(ptrs); i++)
+      ASSERT_TRUE((ptrs[i] = kmalloc(128)) != NULL);
+
+   for (u32 i = 0; i < ARRAY_SIZE(ptrs); i++)
+      kfree2(ptrs[i], 128);
+
+   debug_kmalloc_get_stats(&stats);
+   EXPECT_EQ(c->cached, c->depth);
+   EXPECT_EQ(c->frees_to_heap, ARRAY_SIZE(ptrs) - c->depth);
+
+   /* Disabling the caches gives all the chunks back to the heaps */
+   debug_kmalloc_set_caches_enabled(false);
+   debug_kmalloc_get_stats(&stats);
+   EXPECT_EQ(c->cached, 0u);
+}
@@ -76,6 +76,16 @@ int map_page(pdir_t *, void *vaddr, ulong paddr, u32 pg_flags)
    return 0;
 }
 
+int map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags)
+{
+   return map_page(pdir, vaddrp, KERNEL_VA_TO_PA(zero_page), pg_flags);
+}
+
+int map_big_page(pdir_t *, void *vaddr, ulong paddr, u32 pg_flags)
+{
+   return -EOPNOTSUPP;
+}
+
 size_t
 map_pages(pdir_t *pdir,
           void *vaddr,
@@ -125,6 +135,11 @@ size_t unmap_pages_permissive(pdir_t *pd, void *va, size_t count, bool do_free)
    return count;
 }
 
+int pdir_own_page_tables(pdir_t *, void *, size_t, bool)
+{
+   return 0;
+}
+
 bool is_mapped(pdir_t *, void *vaddrp)
 {
    ulong vaddr = (ulong)vaddrp & PAGE_MASK;
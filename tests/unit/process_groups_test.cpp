@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/process.h>
+   #include <tilck/kernel/sched.h>
+   #include <tilck/kernel/errno.h>
+}
+
+using namespace testing;
+
+class process_groups_test : public Test {
+public:
+
+   process p[3];
+
+   void SetUp() override {
+
+      init_kmalloc_for_tests();
+
+      for (int i = 0; i < 3; i++) {
+         p[i] = {};
+         p[i].pid = i + 1;
+         list_node_init(&p[i].pgrp_node);
+      }
+   }
+
+   void TearDown() override {
+
+      for (int i = 0; i < 3; i++) {
+         if (p[i].pgrp)
+            sched_leave_process_group(&p[i]);
+      }
+   }
+};
+
+TEST_F(process_groups_test, new_session)
+{
+   ASSERT_EQ(sched_set_process_group(&p[0], 1, 1), 0);
+
+   EXPECT_EQ(p[0].pgid, 1);
+   EXPECT_EQ(p[0].sid, 1);
+   EXPECT_EQ(sched_count_proc_in_group(1), 1);
+   EXPECT_EQ(sched_get_session_of_group(1), 1);
+
+   sched_leave_process_group(&p[0]);
+
+   EXPECT_EQ(p[0].pgrp, nullptr);
+   EXPECT_EQ(sched_count_proc_in_group(1), 0);
+   EXPECT_EQ(sched_get_session_of_group(1), -ESRCH);
+}
+
+TEST_F(process_groups_test, setpgid_moves)
+{
+   ASSERT_EQ(sched_set_process_group(&p[0], 1, 1), 0);
+   ASSERT_EQ(sched_set_process_group(&p[1], 1, 1), 0);
+   ASSERT_EQ(sched_set_process_group(&p[2], 1, 1), 0);
+   EXPECT_EQ(sched_count_proc_in_group(1), 3);
+
+   /* setpgid(0, 0) in p[1]: new group in the same session */
+   ASSERT_EQ(sched_set_process_group(&p[1], 2, 1), 0);
+   EXPECT_EQ(p[1].pgid, 2);
+   EXPECT_EQ(p[1].sid, 1);
+   EXPECT_EQ(sched_count_proc_in_group(1), 2);
+   EXPECT_EQ(sched_count_proc_in_group(2), 1);
+   EXPECT_EQ(sched_get_session_of_group(2), 1);
+
+   /* setpgid(3, 2): join an existing group */
+   ASSERT_EQ(sched_set_process_group(&p[2], 2, 1), 0);
+   EXPECT_EQ(sched_count_proc_in_group(1), 1);
+   EXPECT_EQ(sched_count_proc_in_group(2), 2);
+
+   /* Moving to the current group is a no-op */
+   ASSERT_EQ(sched_set_process_group(&p[2], 2, 1), 0);
+   EXPECT_EQ(sched_count_proc_in_group(2), 2);
+
+   /* Emptying a group destroys it, but not the session */
+   ASSERT_EQ(sched_set_process_group(&p[0], 2, 1), 0);
+   EXPECT_EQ(sched_count_proc_in_group(1), 0);
+   EXPECT_EQ(sched_get_session_of_group(1), -ESRCH);
+   EXPECT_EQ(sched_count_proc_in_group(2), 3);
+   EXPECT_EQ(sched_get_session_of_group(2), 1);
+}
+
+TEST_F(process_groups_test, setsid_moves)
+{
+   ASSERT_EQ(sched_set_process_group(&p[0], 1, 1), 0);
+   ASSERT_EQ(sched_set_process_group(&p[1], 1, 1), 0);
+
+   /* setsid() in p[1] */
+   ASSERT_EQ(sched_set_process_group(&p[1], 2, 2), 0);
+   EXPECT_EQ(p[1].pgid, 2);
+   EXPECT_EQ(p[1].sid, 2);
+   EXPECT_EQ(sched_count_proc_in_group(1), 1);
+   EXPECT_EQ(sched_get_session_of_group(1), 1);
+   EXPECT_EQ(sched_get_session_of_group(2), 2);
+
+   /* p[2] gets forked by p[1] and then calls setpgid(0, 0) */
+   ASSERT_EQ(sched_set_process_group(&p[2], 2, 2), 0);
+   ASSERT_EQ(sched_set_process_group(&p[2], 3, 2), 0);
+   EXPECT_EQ(sched_count_proc_in_group(2), 1);
+   EXPECT_EQ(sched_count_proc_in_group(3), 1);
+   EXPECT_EQ(sched_get_session_of_group(3), 2);
+
+   /* The session survives its leader's group as long as it has groups */
+   sched_leave_process_group(&p[1]);
+   EXPECT_EQ(sched_get_session_of_group(2), -ESRCH);
+   EXPECT_EQ(sched_get_session_of_group(3), 2);
+
+   /* The last process leaving the session destroys it */
+   sched_leave_process_group(&p[2]);
+   EXPECT_EQ(sched_get_session_of_group(3), -ESRCH);
+   EXPECT_EQ(sched_get_session_of_group(1), 1);
+}
@@ -99,6 +99,35 @@ TEST(insertion_sort_generic, random)
    ASSERT_TRUE(my_is_sorted((ulong *)&vec[0], vec.size(), less_than_cmp_int));
 }
 
+TEST(heap_sort_generic, basic_test)
+{
+   long vec[] = { 3, 4, 1, 0, -3, 10, 2 };
+
+   heap_sort_generic((ulong *)&vec, sizeof(long),
+                     ARRAY_SIZE(vec), less_than_cmp_int);
+   ASSERT_TRUE(my_is_sorted((ulong *)vec, ARRAY_SIZE(vec), less_than_cmp_int));
+}
+
+TEST(heap_sort_generic, random)
+{
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine e(seed);
+   lognormal_distribution<> dist(5.0, 3);
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   vector<long> vec;
+   random_fill_vec(e, dist, vec, 1000);
+   vector<long> copy = vec;
+
+   heap_sort_generic((ulong *)&vec[0], sizeof(vec[0]),
+                     vec.size(), less_than_cmp_int);
+   ASSERT_TRUE(my_is_sorted((ulong *)&vec[0], vec.size(), less_than_cmp_int));
+
+   sort(copy.begin(), copy.end());
+   ASSERT_TRUE(copy == vec);
+}
+
 bool array_reverse_ptr_check(const vector<ulong> &vec)
 {
    vector<ulong> copy = vec;
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <chrono>
+#include <vector>
 #include "vfs_test.h"
 
 using namespace std;
@@ -45,3 +47,58 @@ TEST_F(ramfs_perf, creat)
    for (int i = 0; i < 100; i++)
       create_test_file(i);
 }
+
+static double elapsed_sec(chrono::steady_clock::time_point start)
+{
+   return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void ramfs_stream_file(size_t file_size, size_t xfer)
+{
+   vector<char> buf(xfer, 'x');
+   chrono::steady_clock::time_point start;
+   double wr_sec, rd_sec;
+   fs_handle h;
+   ssize_t rc;
+
+   rc = vfs_open("/stream_file", &h, O_CREAT | O_RDWR, 0644);
+   ASSERT_EQ(rc, 0);
+
+   start = chrono::steady_clock::now();
+
+   for (size_t tot = 0; tot < file_size; tot += xfer) {
+      rc = vfs_write(h, buf.data(), xfer);
+      ASSERT_EQ(rc, (ssize_t)xfer);
+   }
+
+   wr_sec = elapsed_sec(start);
+
+   rc = vfs_seek(h, 0, SEEK_SET);
+   ASSERT_EQ(rc, 0);
+
+   start = chrono::steady_clock::now();
+
+   for (size_t tot = 0; tot < file_size; tot += xfer) {
+      rc = vfs_read(h, buf.data(), xfer);
+      ASSERT_EQ(rc, (ssize_t)xfer);
+   }
+
+   rd_sec = elapsed_sec(start);
+
+   vfs_close(h);
+   rc = vfs_unlink("/stream_file");
+   ASSERT_EQ(rc, 0);
+
+   printf("[ xfer: %7zu KB ] write: %6.0f MB/s, read: %6.0f MB/s\n",
+          xfer / KB,
+          (double)file_size / MB / wr_sec,
+          (double)file_size / MB / rd_sec);
+}
+
+TEST_F(ramfs_perf, sequential_rw)
+{
+   const size_t file_size = 32 * MB;
+
+   for (size_t xfer = 4 * KB; xfer <= 4 * MB; xfer *= 4)
+      ramfs_stream_file(file_size, xfer);
+}
@@ -242,6 +242,100 @@ TEST_F(vfs_ramfs, create_and_unlink_file)
    ASSERT_EQ(rc, -ENOENT);
 }
 
+TEST_F(vfs_ramfs, dcache_invalidation)
+{
+   struct k_stat64 st;
+   fs_handle h;
+   int rc;
+
+   /* Cache a negative entry, then create the file */
+   ASSERT_EQ(vfs_stat64("/f1", &st, true), -ENOENT);
+
+   rc = vfs_open("/f1", &h, O_CREAT | O_RDWR, 0644);
+   ASSERT_EQ(rc, 0);
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_stat64("/f1", &st, true), 0);
+
+   /* Both the old and the new name are now cached: rename */
+   ASSERT_EQ(vfs_stat64("/f2", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_rename("/f1", "/f2"), 0);
+   ASSERT_EQ(vfs_stat64("/f1", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/f2", &st, true), 0);
+
+   ASSERT_EQ(vfs_unlink("/f2"), 0);
+   ASSERT_EQ(vfs_stat64("/f2", &st, true), -ENOENT);
+
+   /* Negative entries inside a removed dir must not survive it */
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+   ASSERT_EQ(vfs_stat64("/d/x", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_rmdir("/d"), 0);
+   ASSERT_EQ(vfs_stat64("/d/x", &st, true), -ENOENT);
+
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+   rc = vfs_open("/d/x", &h, O_CREAT | O_RDWR, 0644);
+   ASSERT_EQ(rc, 0);
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_stat64("/d/x", &st, true), 0);
+   ASSERT_EQ(vfs_unlink("/d/x"), 0);
+   ASSERT_EQ(vfs_rmdir("/d"), 0);
+}
+
+TEST_F(vfs_ramfs, many_dir_entries)
+{
+   const int n = 5000;
+   struct k_stat64 st;
+   char path[300];
+   fs_handle h;
+   int rc;
+
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+
+   for (int i = 0; i < n; i++) {
+      sprintf(path, "/d/file_with_a_longer_name_%d", i);
+      rc = vfs_open(path, &h, O_CREAT | O_RDWR, 0644);
+      ASSERT_EQ(rc, 0);
+      vfs_close(h);
+   }
+
+   for (int i = n - 1; i >= 0; i--) {
+      sprintf(path, "/d/file_with_a_longer_name_%d", i);
+      ASSERT_EQ(vfs_stat64(path, &st, true), 0) << path;
+   }
+
+   ASSERT_EQ(vfs_stat64("/d/file_with_a_longer_name_", &st, true), -ENOENT);
+
+   /* The longest name allowed has 254 chars, plus the final \0 */
+   sprintf(path, "/d/%s", string(254, 'x').c_str());
+   rc = vfs_open(path, &h, O_CREAT | O_RDWR, 0644);
+   ASSERT_EQ(rc, 0);
+   vfs_close(h);
+   ASSERT_EQ(vfs_stat64(path, &st, true), 0);
+   ASSERT_EQ(vfs_unlink(path), 0);
+
+   sprintf(path, "/d/%s", string(255, 'x').c_str());
+   rc = vfs_open(path, &h, O_CREAT | O_RDWR, 0644);
+   ASSERT_EQ(rc, -ENAMETOOLONG);
+
+   for (int i = 0; i < n; i += 2) {
+      sprintf(path, "/d/file_with_a_longer_name_%d", i);
+      ASSERT_EQ(vfs_unlink(path), 0);
+   }
+
+   for (int i = 0; i < n; i++) {
+      sprintf(path, "/d/file_with_a_longer_name_%d", i);
+      ASSERT_EQ(vfs_stat64(path, &st, true), i % 2 ? 0 : -ENOENT) << path;
+   }
+
+   for (int i = 1; i < n; i += 2) {
+      sprintf(path, "/d/file_with_a_longer_name_%d", i);
+      ASSERT_EQ(vfs_unlink(path), 0);
+   }
+
+   ASSERT_EQ(vfs_rmdir("/d"), 0);
+}
+
 void vfs_ramfs::test_pread_pwrite_seek(bool fseek)
 {
    const off_t data_size = 2 * MB;
@@ -17,6 +17,7 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/kd.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <poll.h>
 
@@ -279,6 +280,76 @@ retry:
    free(buf);
 }
 
+static double timeval_to_sec(const struct timeval *tv)
+{
+   return tv->tv_sec + tv->tv_usec / 1.0e6;
+}
+
+void serial_perf_test(void)
+{
+   const size_t tot = 1024 * 1024;
+   struct timespec ts_before, ts_after;
+   struct rusage ru_before, ru_after;
+   double tot_time, cpu_time;
+   char *buf, tot_time_s[32], cpu_time_s[32];
+   ssize_t r;
+   size_t written;
+   int fd;
+
+   fd = open("/dev/ttyS0", O_WRONLY);
+
+   if (fd < 0) {
+      perror("Open /dev/ttyS0 failed");
+      return;
+   }
+
+   buf = malloc(tot);
+
+   if (!buf) {
+      fprintf(stderr, "Out of memory\n");
+      close(fd);
+      return;
+   }
+
+   /* Rows of printable characters */
+   for (size_t i = 0; i < tot; i++)
+      buf[i] = (i % 80 == 79) ? '\n' : (char)('!' + i % 80);
+
+   getrusage(RUSAGE_SELF, &ru_before);
+   clock_gettime(CLOCK_REALTIME, &ts_before);
+
+   for (r = 0, written = 0; written < tot; written += (size_t)r) {
+
+      r = write(fd, buf + written, tot - written);
+
+      if (r < 0) {
+         perror("write() failed");
+         goto out;
+      }
+   }
+
+   clock_gettime(CLOCK_REALTIME, &ts_after);
+   getrusage(RUSAGE_SELF, &ru_after);
+
+   tot_time = timespec_diff(&ts_after, &ts_before);
+   cpu_time = timeval_to_sec(&ru_after.ru_stime)
+            - timeval_to_sec(&ru_before.ru_stime)
+            + timeval_to_sec(&ru_after.ru_utime)
+            - timeval_to_sec(&ru_before.ru_utime);
+
+   timespec_to_human_str(tot_time_s, sizeof(tot_time_s), tot_time);
+   timespec_to_human_str(cpu_time_s, sizeof(cpu_time_s), cpu_time);
+
+   printf("\nWritten %zu bytes to /dev/ttyS0\n", tot);
+   printf("Tot time:   %s\n", tot_time_s);
+   printf("CPU time:   %s (%.1f%%)\n", cpu_time_s, 100.0 * cpu_time / tot_time);
+   printf("Throughput: %.0f bytes/sec\n", tot / tot_time);
+
+out:
+   free(buf);
+   close(fd);
+}
+
 void read_nonblock(void)
 {
    int rc;
@@ -500,6 +571,7 @@ static struct {
 #endif
 
    CMD_ENTRY("-p", console_perf_test),
+   CMD_ENTRY("-sp", serial_perf_test),
    CMD_ENTRY("-n", read_nonblock),
    CMD_ENTRY("-nr", read_nonblock_rawmode),
    CMD_ENTRY("-fr", write_full_row),